@@ -0,0 +1,92 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <monotonic-time/monotonic_time.h>
+#include <swamp-runtime/dynamic_memory.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+#define BENCHMARK_MEMORY_SIZE (16 * 1024 * 1024)
+#define BENCHMARK_ROUND_COUNT (200)
+
+typedef struct AllocBenchmarkCase {
+    const char* name;
+    size_t itemCount;
+    size_t itemSize;
+    size_t itemAlign;
+} AllocBenchmarkCase;
+
+// Item sizes that are typical for swamp values: strings, list structs, lists of Int and lists of records
+static const AllocBenchmarkCase g_cases[] = {
+    {"characters", 12, 1, 1},
+    {"SwampList", 1, sizeof(SwampList), 8},
+    {"List Int", 64, sizeof(SwampInt32), sizeof(SwampInt32)},
+    {"List record", 256, 48, 8},
+};
+
+// Allocates until the memory is almost full, for a number of rounds. Returns the number of allocations per second.
+static double runCase(SwampDynamicMemory* memory, const AllocBenchmarkCase* benchmarkCase, int emulatePoison,
+                      double* octetsPerSecond)
+{
+    size_t octetSize = benchmarkCase->itemCount * benchmarkCase->itemSize;
+    size_t allocationCount = (BENCHMARK_MEMORY_SIZE / (octetSize + benchmarkCase->itemAlign)) - 1;
+    size_t checksum = 0;
+
+    MonotonicTimeNanoseconds before = monotonicTimeNanosecondsNow();
+    for (size_t round = 0; round < BENCHMARK_ROUND_COUNT; ++round) {
+        swampDynamicMemoryReset(memory);
+        for (size_t i = 0; i < allocationCount; ++i) {
+            uint8_t* p = swampDynamicMemoryAlloc(memory, benchmarkCase->itemCount, benchmarkCase->itemSize,
+                                                 benchmarkCase->itemAlign);
+            // The allocator always wrote a poison pattern before SWAMP_DYNAMIC_MEMORY_POISON
+            if (emulatePoison) {
+                tc_memset_octets(p, 0xfd, octetSize);
+            }
+            *p = (uint8_t) i;
+            checksum += (uintptr_t) p;
+        }
+    }
+    MonotonicTimeNanoseconds after = monotonicTimeNanosecondsNow();
+
+    double seconds = (after - before) / 1000000000.0;
+    double totalAllocations = (double) allocationCount * BENCHMARK_ROUND_COUNT;
+    *octetsPerSecond = totalAllocations * octetSize / seconds;
+
+    if (checksum == 0) {
+        CLOG_INFO("checksum is zero")
+    }
+
+    return totalAllocations / seconds;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    uint8_t* octets = tc_malloc(BENCHMARK_MEMORY_SIZE);
+    SwampDynamicMemory memory;
+    swampDynamicMemoryInit(&memory, octets, BENCHMARK_MEMORY_SIZE);
+
+    CLOG_INFO("%-12s %16s %16s %12s %12s", "case", "poisoned (M/s)", "current (M/s)", "poisoned MB/s",
+              "current MB/s")
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); ++i) {
+        const AllocBenchmarkCase* benchmarkCase = &g_cases[i];
+        double poisonedOctetsPerSecond;
+        double currentOctetsPerSecond;
+        double poisoned = runCase(&memory, benchmarkCase, 1, &poisonedOctetsPerSecond);
+        double current = runCase(&memory, benchmarkCase, 0, &currentOctetsPerSecond);
+        CLOG_INFO("%-12s %16.1f %16.1f %12.0f %12.0f", benchmarkCase->name, poisoned / 1000000.0,
+                  current / 1000000.0, poisonedOctetsPerSecond / (1024.0 * 1024.0),
+                  currentOctetsPerSecond / (1024.0 * 1024.0))
+    }
+
+    swampDynamicMemoryDestroy(&memory);
+    tc_free(octets);
+
+    return 0;
+}
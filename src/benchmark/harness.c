@@ -0,0 +1,229 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "harness.h"
+#include <clog/clog.h>
+#include <stdlib.h> // qsort, strtoul
+#include <string.h> // strstr
+#include <tiny-libc/tiny_libc.h>
+
+#define BENCHMARK_MAX_SAMPLE_COUNT (10000)
+
+void benchmarkHarnessInit(BenchmarkHarness* self)
+{
+    self->warmupSampleCount = 3;
+    self->sampleCount = 30;
+    self->minSampleTimeNs = 10 * 1000 * 1000;
+    self->filter = 0;
+    self->format = BenchmarkFormatText;
+    self->outputFilename = 0;
+    self->results = 0;
+    self->resultCount = 0;
+    self->resultCapacity = 0;
+    self->samples = 0;
+}
+
+void benchmarkHarnessDestroy(BenchmarkHarness* self)
+{
+    tc_free(self->results);
+    tc_free(self->samples);
+    self->results = 0;
+    self->samples = 0;
+    self->resultCount = 0;
+}
+
+static void benchmarkHarnessUsage(void)
+{
+    fprintf(stderr, "options:\n"
+                    "  --format text|json|csv  output format (text)\n"
+                    "  --output <filename>     write the results to a file instead of stdout\n"
+                    "  --filter <substring>    only run benchmarks with the substring in the name\n"
+                    "  --samples <count>       measured samples per benchmark (30)\n"
+                    "  --warmup <count>        samples thrown away before measuring (3)\n"
+                    "  --min-sample-ms <ms>    minimum time of each sample (10)\n");
+}
+
+// Options that are not for the harness are left for the caller, e.g. --pack
+int benchmarkHarnessParseArguments(BenchmarkHarness* self, int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* option = argv[i];
+        int hasValue = i + 1 < argc;
+        const char* value = hasValue ? argv[i + 1] : 0;
+        if (tc_str_equal(option, "--help")) {
+            benchmarkHarnessUsage();
+            return -1;
+        } else if (tc_str_equal(option, "--format") && hasValue) {
+            if (tc_str_equal(value, "json")) {
+                self->format = BenchmarkFormatJson;
+            } else if (tc_str_equal(value, "csv")) {
+                self->format = BenchmarkFormatCsv;
+            } else if (tc_str_equal(value, "text")) {
+                self->format = BenchmarkFormatText;
+            } else {
+                fprintf(stderr, "unknown format '%s'\n", value);
+                return -2;
+            }
+        } else if (tc_str_equal(option, "--output") && hasValue) {
+            self->outputFilename = value;
+        } else if (tc_str_equal(option, "--filter") && hasValue) {
+            self->filter = value;
+        } else if (tc_str_equal(option, "--samples") && hasValue) {
+            self->sampleCount = strtoul(value, 0, 10);
+        } else if (tc_str_equal(option, "--warmup") && hasValue) {
+            self->warmupSampleCount = strtoul(value, 0, 10);
+        } else if (tc_str_equal(option, "--min-sample-ms") && hasValue) {
+            self->minSampleTimeNs = (MonotonicTimeNanoseconds) strtoul(value, 0, 10) * 1000 * 1000;
+        } else {
+            continue;
+        }
+        i++;
+    }
+
+    if (self->sampleCount == 0 || self->sampleCount > BENCHMARK_MAX_SAMPLE_COUNT) {
+        fprintf(stderr, "sample count must be 1 to %d\n", BENCHMARK_MAX_SAMPLE_COUNT);
+        return -3;
+    }
+
+    return 0;
+}
+
+int benchmarkHarnessShouldRun(const BenchmarkHarness* self, const char* name)
+{
+    return self->filter == 0 || strstr(name, self->filter) != 0;
+}
+
+static MonotonicTimeNanoseconds benchmarkTime(BenchmarkFn fn, void* userData, size_t iterationCount)
+{
+    MonotonicTimeNanoseconds before = monotonicTimeNanosecondsNow();
+    fn(userData, iterationCount);
+    return monotonicTimeNanosecondsNow() - before;
+}
+
+// Doubles the iterations until a sample is long enough to not be dominated by the timer resolution
+static size_t benchmarkCalibrate(const BenchmarkHarness* self, BenchmarkFn fn, void* userData)
+{
+    size_t iterationCount = 1;
+    while (1) {
+        MonotonicTimeNanoseconds time = benchmarkTime(fn, userData, iterationCount);
+        if (time >= self->minSampleTimeNs || iterationCount >= ((size_t) 1 << 30)) {
+            return iterationCount;
+        }
+        if (time * 8 < self->minSampleTimeNs) {
+            iterationCount *= 8;
+        } else {
+            iterationCount *= 2;
+        }
+    }
+}
+
+static int benchmarkCompareDouble(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, the samples must be sorted
+static double benchmarkPercentile(const double* sortedSamples, size_t count, size_t percent)
+{
+    size_t rank = (percent * count + 99) / 100;
+    return sortedSamples[rank == 0 ? 0 : rank - 1];
+}
+
+void benchmarkHarnessRun(BenchmarkHarness* self, const char* name, BenchmarkFn fn, void* userData,
+                         size_t operationCount)
+{
+    if (!benchmarkHarnessShouldRun(self, name)) {
+        return;
+    }
+
+    if (self->resultCount == self->resultCapacity) {
+        self->resultCapacity = self->resultCapacity == 0 ? 32 : self->resultCapacity * 2;
+        self->results = tc_realloc(self->results, sizeof(self->results[0]) * self->resultCapacity);
+    }
+    if (self->samples == 0) {
+        self->samples = tc_malloc_type_count(double, BENCHMARK_MAX_SAMPLE_COUNT);
+    }
+
+    size_t iterationCount = benchmarkCalibrate(self, fn, userData);
+    for (size_t i = 0; i < self->warmupSampleCount; ++i) {
+        benchmarkTime(fn, userData, iterationCount);
+    }
+
+    double operationsPerSample = (double) iterationCount * (double) operationCount;
+    double sum = 0;
+    for (size_t i = 0; i < self->sampleCount; ++i) {
+        self->samples[i] = benchmarkTime(fn, userData, iterationCount) / operationsPerSample;
+        sum += self->samples[i];
+    }
+    qsort(self->samples, self->sampleCount, sizeof(self->samples[0]), benchmarkCompareDouble);
+
+    BenchmarkResult* result = &self->results[self->resultCount++];
+    tc_snprintf(result->name, sizeof(result->name), "%s", name);
+    result->operationCount = operationCount;
+    result->iterationCount = iterationCount;
+    result->sampleCount = self->sampleCount;
+    result->minNs = self->samples[0];
+    result->meanNs = sum / self->sampleCount;
+    result->p50Ns = benchmarkPercentile(self->samples, self->sampleCount, 50);
+    result->p90Ns = benchmarkPercentile(self->samples, self->sampleCount, 90);
+    result->p99Ns = benchmarkPercentile(self->samples, self->sampleCount, 99);
+    result->maxNs = self->samples[self->sampleCount - 1];
+
+    // Progress goes to stderr, so the results can be piped
+    fprintf(stderr, "%-40s %12.2f ns/op\n", name, result->p50Ns);
+}
+
+void benchmarkHarnessWrite(const BenchmarkHarness* self, FILE* fp)
+{
+    switch (self->format) {
+        case BenchmarkFormatJson:
+            fprintf(fp, "{\n  \"unit\": \"ns/op\",\n  \"warmupSamples\": %zu,\n  \"benchmarks\": [", self->warmupSampleCount);
+            for (size_t i = 0; i < self->resultCount; ++i) {
+                const BenchmarkResult* r = &self->results[i];
+                fprintf(fp,
+                        "%s\n    {\"name\": \"%s\", \"operations\": %zu, \"iterations\": %zu, \"samples\": %zu, "
+                        "\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+                        i == 0 ? "" : ",", r->name, r->operationCount, r->iterationCount, r->sampleCount, r->minNs,
+                        r->meanNs, r->p50Ns, r->p90Ns, r->p99Ns, r->maxNs);
+            }
+            fprintf(fp, "\n  ]\n}\n");
+            break;
+        case BenchmarkFormatCsv:
+            fprintf(fp, "name,operations,iterations,samples,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+            for (size_t i = 0; i < self->resultCount; ++i) {
+                const BenchmarkResult* r = &self->results[i];
+                fprintf(fp, "%s,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", r->name, r->operationCount,
+                        r->iterationCount, r->sampleCount, r->minNs, r->meanNs, r->p50Ns, r->p90Ns, r->p99Ns, r->maxNs);
+            }
+            break;
+        case BenchmarkFormatText:
+            fprintf(fp, "%-40s %10s %10s %10s %10s %10s\n", "benchmark (ns/op)", "min", "p50", "p90", "p99", "max");
+            for (size_t i = 0; i < self->resultCount; ++i) {
+                const BenchmarkResult* r = &self->results[i];
+                fprintf(fp, "%-40s %10.2f %10.2f %10.2f %10.2f %10.2f\n", r->name, r->minNs, r->p50Ns, r->p90Ns,
+                        r->p99Ns, r->maxNs);
+            }
+            break;
+    }
+}
+
+int benchmarkHarnessWriteResults(const BenchmarkHarness* self)
+{
+    if (self->outputFilename == 0) {
+        benchmarkHarnessWrite(self, stdout);
+        return 0;
+    }
+
+    FILE* fp = fopen(self->outputFilename, "w");
+    if (fp == 0) {
+        CLOG_SOFT_ERROR("could not open '%s' for writing", self->outputFilename)
+        return -1;
+    }
+    benchmarkHarnessWrite(self, fp);
+    fclose(fp);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_BENCHMARK_HARNESS_H
+#define SWAMP_RUNTIME_SRC_BENCHMARK_HARNESS_H
+
+#include <monotonic-time/monotonic_time.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Runs the measured operation iterationCount times
+typedef void (*BenchmarkFn)(void* userData, size_t iterationCount);
+
+typedef enum BenchmarkFormat {
+    BenchmarkFormatText,
+    BenchmarkFormatJson,
+    BenchmarkFormatCsv,
+} BenchmarkFormat;
+
+// All times are nanoseconds per operation
+typedef struct BenchmarkResult {
+    char name[64];
+    size_t operationCount; // operations per iteration, e.g. opcodes or list items
+    size_t iterationCount; // iterations per sample
+    size_t sampleCount;
+    double minNs;
+    double meanNs;
+    double p50Ns;
+    double p90Ns;
+    double p99Ns;
+    double maxNs;
+} BenchmarkResult;
+
+// Each benchmark is first calibrated so that a sample takes at least minSampleTimeNs. Then warmupSampleCount
+// samples are thrown away before sampleCount samples are measured.
+typedef struct BenchmarkHarness {
+    size_t warmupSampleCount;
+    size_t sampleCount;
+    MonotonicTimeNanoseconds minSampleTimeNs;
+    const char* filter;
+    BenchmarkFormat format;
+    const char* outputFilename;
+    BenchmarkResult* results;
+    size_t resultCount;
+    size_t resultCapacity;
+    double* samples;
+} BenchmarkHarness;
+
+void benchmarkHarnessInit(BenchmarkHarness* self);
+void benchmarkHarnessDestroy(BenchmarkHarness* self);
+int benchmarkHarnessParseArguments(BenchmarkHarness* self, int argc, char* argv[]);
+int benchmarkHarnessShouldRun(const BenchmarkHarness* self, const char* name);
+void benchmarkHarnessRun(BenchmarkHarness* self, const char* name, BenchmarkFn fn, void* userData,
+                         size_t operationCount);
+int benchmarkHarnessWriteResults(const BenchmarkHarness* self);
+void benchmarkHarnessWrite(const BenchmarkHarness* self, FILE* fp);
+
+#endif // SWAMP_RUNTIME_SRC_BENCHMARK_HARNESS_H
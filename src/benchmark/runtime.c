@@ -0,0 +1,975 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "harness.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <swamp-runtime/clone.h>
+#include <swamp-runtime/compact.h>
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/copy_plan.h>
+#include <swamp-runtime/core/list.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/decode.h>
+#include <swamp-runtime/execute.h>
+#include <swamp-runtime/fixup.h>
+#include <swamp-runtime/ledger.h>
+#include <swamp-runtime/opcodes.h>
+#include <swamp-runtime/parallel.h>
+#include <swamp-runtime/swamp.h>
+#include <swamp-runtime/swamp_allocate.h>
+#include <swamp-runtime/types.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/typeinfo.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+// The unit of each benchmark: dispatch.* is per opcode, call.* per call, list.* per list item, state.* per entity,
+// alloc.* per allocation and unpack.* per function in the ledger. All bytecode is written here, no pack is needed.
+#define BENCHMARK_LIST_COUNT (10000)
+#define BENCHMARK_ENTITY_COUNT (10000)
+#define BENCHMARK_ENTITY_PATH_COUNT (4)
+#define BENCHMARK_POSITION_COUNT (100000)
+#define BENCHMARK_SHARED_NAME_COUNT (64)
+#define BENCHMARK_SHARED_PATH_COUNT (16)
+#define BENCHMARK_FRAME_CHANGE_INTERVAL (16)
+#define BENCHMARK_ALLOC_COUNT (1000)
+#define BENCHMARK_UNPACK_FUNC_COUNT (2000)
+#define BENCHMARK_STATIC_MEMORY_SIZE (2 * 1024 * 1024)
+#define BENCHMARK_DYNAMIC_MEMORY_SIZE (4 * 1024 * 1024)
+
+// Frame of the loop functions. The loop is a tail call with n counting down.
+#define LOOP_RETURN (0)
+#define LOOP_N (4)
+#define LOOP_ACC (8)
+#define LOOP_LIST (16)
+#define LOOP_FN (24)
+#define LOOP_CONSTANT (32)
+#define LOOP_BOOL (36)
+#define LOOP_TEMP (40)
+#define LOOP_TEMP2 (44)
+#define LOOP_CALL_FRAME (48)
+#define LOOP_CURRY_TARGET (56)
+#define LOOP_PARAMETERS_OCTET_SIZE (28)
+#define LOOP_OVERHEAD_OPCODE_COUNT (6)
+
+typedef struct BenchmarkCode {
+    uint8_t octets[1024];
+    size_t count;
+} BenchmarkCode;
+
+static void emit8(BenchmarkCode* self, uint8_t value)
+{
+    self->octets[self->count++] = value;
+}
+
+static void emit16(BenchmarkCode* self, uint16_t value)
+{
+    tc_memcpy_octets(&self->octets[self->count], &value, sizeof(value));
+    self->count += sizeof(value);
+}
+
+static void emit32(BenchmarkCode* self, uint32_t value)
+{
+    tc_memcpy_octets(&self->octets[self->count], &value, sizeof(value));
+    self->count += sizeof(value);
+}
+
+static void emitOperator(BenchmarkCode* self, uint8_t opcode, uint32_t target, uint32_t a, uint32_t b)
+{
+    emit8(self, opcode);
+    emit32(self, target);
+    emit32(self, a);
+    emit32(self, b);
+}
+
+static void emitLoadInteger(BenchmarkCode* self, uint32_t target, int32_t value)
+{
+    emit8(self, SwampOpcodeLoadInteger);
+    emit32(self, target);
+    emit32(self, (uint32_t) value);
+}
+
+static void emitMemCopy(BenchmarkCode* self, uint32_t target, uint32_t source, uint16_t octetCount)
+{
+    emit8(self, SwampOpcodeMemCopy);
+    emit32(self, target);
+    emit32(self, source);
+    emit16(self, octetCount);
+}
+
+// if n == 0 then acc
+static void emitLoopStart(BenchmarkCode* self)
+{
+    emitLoadInteger(self, LOOP_CONSTANT, 0);
+    emitOperator(self, SwampOpcodeIntEqual, LOOP_BOOL, LOOP_N, LOOP_CONSTANT);
+    emit8(self, SwampOpcodeBranchFalse);
+    emit32(self, LOOP_BOOL);
+    emit16(self, 1 + 4 + 4 + 2 + 1);
+    emitMemCopy(self, LOOP_RETURN, LOOP_ACC, sizeof(SwampInt32));
+    emit8(self, SwampOpcodeReturn);
+}
+
+// else loop (n - 1) ...
+static void emitLoopEnd(BenchmarkCode* self)
+{
+    emitLoadInteger(self, LOOP_CONSTANT, 1);
+    emitOperator(self, SwampOpcodeIntSub, LOOP_N, LOOP_N, LOOP_CONSTANT);
+    emit8(self, SwampOpcodeTailCall);
+}
+
+typedef void (*BenchmarkEmitBodyFn)(BenchmarkCode* self);
+
+static void emitArithmeticBody(BenchmarkCode* self)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        emitOperator(self, SwampOpcodeIntAdd, LOOP_ACC, LOOP_ACC, LOOP_N);
+        emitOperator(self, SwampOpcodeIntSub, LOOP_ACC, LOOP_ACC, LOOP_N);
+        emitOperator(self, SwampOpcodeIntXor, LOOP_ACC, LOOP_ACC, LOOP_N);
+        emitOperator(self, SwampOpcodeIntXor, LOOP_ACC, LOOP_ACC, LOOP_N);
+    }
+}
+
+static void emitCompareBranchBody(BenchmarkCode* self)
+{
+    for (size_t i = 0; i < 8; ++i) {
+        emitOperator(self, SwampOpcodeIntLess, LOOP_BOOL, LOOP_ACC, LOOP_N);
+        emit8(self, SwampOpcodeBranchFalse);
+        emit32(self, LOOP_BOOL);
+        emit16(self, 0);
+    }
+}
+
+static void emitMemoryCopyBody(BenchmarkCode* self)
+{
+    for (size_t i = 0; i < 8; ++i) {
+        emitMemCopy(self, LOOP_TEMP, LOOP_ACC, sizeof(SwampInt32));
+        emitLoadInteger(self, LOOP_TEMP2, (int32_t) i);
+    }
+}
+
+static void emitListConjBody(BenchmarkCode* self)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        emit8(self, SwampOpcodeListConj);
+        emit32(self, LOOP_LIST);
+        emit32(self, LOOP_LIST);
+        emit32(self, LOOP_N);
+        emit16(self, sizeof(SwampInt32));
+        emit8(self, sizeof(SwampInt32));
+    }
+}
+
+// acc = identity acc
+static void emitCallBody(BenchmarkCode* self)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        emitMemCopy(self, LOOP_CALL_FRAME + 4, LOOP_ACC, sizeof(SwampInt32));
+        emit8(self, SwampOpcodeCall);
+        emit32(self, LOOP_CALL_FRAME);
+        emit32(self, LOOP_FN);
+        emitMemCopy(self, LOOP_ACC, LOOP_CALL_FRAME, sizeof(SwampInt32));
+    }
+}
+
+// add acc, a curried function is allocated but never called
+static void emitCurryBody(BenchmarkCode* self)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        emit8(self, SwampOpcodeCurry);
+        emit32(self, LOOP_CURRY_TARGET);
+        emit16(self, 0);
+        emit8(self, sizeof(SwampInt32));
+        emit32(self, LOOP_FN);
+        emit32(self, LOOP_ACC);
+        emit16(self, sizeof(SwampInt32));
+    }
+}
+
+// A ledger and the static memory that it points into, the same as after the fixup of a pack
+typedef struct BenchmarkProgram {
+    uint8_t* octets;
+    size_t octetCount;
+    SwampConstantLedgerEntry entries[BENCHMARK_UNPACK_FUNC_COUNT + 1];
+    size_t entryCount;
+    SwampLedger ledger;
+    SwampStaticMemory staticMemory;
+} BenchmarkProgram;
+
+static void programInit(BenchmarkProgram* self)
+{
+    self->octets = tc_malloc(BENCHMARK_STATIC_MEMORY_SIZE);
+    tc_mem_clear(self->octets, BENCHMARK_STATIC_MEMORY_SIZE);
+    self->octetCount = 8;
+    self->entryCount = 0;
+}
+
+static void programDestroy(BenchmarkProgram* self)
+{
+    tc_free(self->octets);
+}
+
+static void* programAllocate(BenchmarkProgram* self, size_t octetCount)
+{
+    size_t offset = (self->octetCount + 7) & ~(size_t) 7;
+    if (offset + octetCount > BENCHMARK_STATIC_MEMORY_SIZE) {
+        CLOG_ERROR("benchmark static memory is too small")
+    }
+    self->octetCount = offset + octetCount;
+
+    return self->octets + offset;
+}
+
+static const SwampFunc* programAddFunc(BenchmarkProgram* self, const char* name, const BenchmarkCode* code,
+                                       size_t parameterCount, size_t parametersOctetSize, size_t returnOctetSize,
+                                       size_t returnAlign, uint16_t typeIndex)
+{
+    if (self->entryCount == BENCHMARK_UNPACK_FUNC_COUNT) {
+        CLOG_ERROR("too many benchmark functions")
+    }
+
+    uint8_t* opcodes = programAllocate(self, code->count);
+    tc_memcpy_octets(opcodes, code->octets, code->count);
+    char* debugName = programAllocate(self, tc_strlen(name) + 1);
+    tc_memcpy_octets(debugName, name, tc_strlen(name) + 1);
+
+    SwampFunc* func = programAllocate(self, sizeof(SwampFunc));
+    func->func.type = SwampFunctionTypeInternal;
+    func->parameterCount = parameterCount;
+    func->parametersOctetSize = parametersOctetSize;
+    func->opcodes = opcodes;
+    func->opcodeCount = code->count;
+    func->returnOctetSize = returnOctetSize;
+    func->returnAlign = returnAlign;
+    func->debugName = debugName;
+    func->typeIndex = typeIndex;
+
+    SwampConstantLedgerEntry* entry = &self->entries[self->entryCount++];
+    entry->constantType = LedgerTypeFunc;
+    entry->offset = (uint32_t) ((uint8_t*) func - self->octets);
+
+    return func;
+}
+
+static void programDone(BenchmarkProgram* self)
+{
+    self->entries[self->entryCount].constantType = 0;
+    self->entries[self->entryCount].offset = 0;
+    swampLedgerInit(&self->ledger, (const uint8_t*) self->entries, sizeof(self->entries[0]) * (self->entryCount + 1),
+                    self->octets);
+    swampStaticMemoryInit(&self->staticMemory, self->octets, BENCHMARK_STATIC_MEMORY_SIZE);
+}
+
+static const SwampFunc* programAddLoop(BenchmarkProgram* self, const char* name, BenchmarkEmitBodyFn emitBody)
+{
+    BenchmarkCode code;
+    code.count = 0;
+    emitLoopStart(&code);
+    emitBody(&code);
+    emitLoopEnd(&code);
+
+    return programAddFunc(self, name, &code, 4, LOOP_PARAMETERS_OCTET_SIZE, sizeof(SwampInt32), sizeof(SwampInt32), 0);
+}
+
+// The types are written the way swtisDeserialize() leaves them. The state is a list of entities.
+typedef struct BenchmarkEntity {
+    SwampInt32 id;
+    SwampInt32 x;
+    SwampInt32 y;
+    const SwampString* name;
+    const SwampList* path;
+} BenchmarkEntity;
+
+typedef struct BenchmarkTypes {
+    SwtiType intType;
+    SwtiType stringType;
+    SwtiListType intListType;
+    SwtiRecordTypeField positionFields[2];
+    SwtiRecordType positionType;
+    SwtiRecordTypeField entityFields[4];
+    SwtiRecordType entityType;
+    SwtiListType stateType;
+    SwtiListType positionListType;
+    const SwtiType* duplicateParameterTypes[2];
+    SwtiFunctionType duplicateType;
+    const SwtiType* chunkTypes[1];
+    SwtiChunk chunk;
+} BenchmarkTypes;
+
+static void typesInitField(SwtiRecordTypeField* field, const char* name, const SwtiType* fieldType, size_t offset)
+{
+    field->name = name;
+    field->fieldType = fieldType;
+    field->memoryOffsetInfo.memoryOffset = offset;
+}
+
+static void typesInit(BenchmarkTypes* self)
+{
+    tc_mem_clear(self, sizeof(*self));
+    self->intType.type = SwtiTypeInt;
+    self->intType.name = "Int";
+    self->stringType.type = SwtiTypeString;
+    self->stringType.name = "String";
+    self->intListType.internal.type = SwtiTypeList;
+    self->intListType.internal.name = "List";
+    self->intListType.itemType = &self->intType;
+
+    typesInitField(&self->positionFields[0], "x", &self->intType, 0);
+    typesInitField(&self->positionFields[1], "y", &self->intType, sizeof(SwampInt32));
+    self->positionType.internal.type = SwtiTypeRecord;
+    self->positionType.internal.name = "Position";
+    self->positionType.fieldCount = 2;
+    self->positionType.fields = self->positionFields;
+
+    typesInitField(&self->entityFields[0], "id", &self->intType, offsetof(BenchmarkEntity, id));
+    typesInitField(&self->entityFields[1], "position", (const SwtiType*) &self->positionType,
+                   offsetof(BenchmarkEntity, x));
+    typesInitField(&self->entityFields[2], "name", &self->stringType, offsetof(BenchmarkEntity, name));
+    typesInitField(&self->entityFields[3], "path", (const SwtiType*) &self->intListType,
+                   offsetof(BenchmarkEntity, path));
+    self->entityType.internal.type = SwtiTypeRecord;
+    self->entityType.internal.name = "Entity";
+    self->entityType.fieldCount = 4;
+    self->entityType.fields = self->entityFields;
+
+    self->stateType.internal.type = SwtiTypeList;
+    self->stateType.internal.name = "List";
+    self->stateType.itemType = (const SwtiType*) &self->entityType;
+
+    self->positionListType.internal.type = SwtiTypeList;
+    self->positionListType.internal.name = "List";
+    self->positionListType.itemType = (const SwtiType*) &self->positionType;
+
+    // List.concatMap looks up the return type of the function
+    self->duplicateParameterTypes[0] = &self->intType;
+    self->duplicateParameterTypes[1] = (const SwtiType*) &self->intListType;
+    self->duplicateType.internal.type = SwtiTypeFunction;
+    self->duplicateType.internal.name = "Int -> List Int";
+    self->duplicateType.parameterCount = 2;
+    self->duplicateType.parameterTypes = self->duplicateParameterTypes;
+    self->chunkTypes[0] = (const SwtiType*) &self->duplicateType;
+    self->chunk.types = self->chunkTypes;
+    self->chunk.typeCount = 1;
+}
+
+typedef struct BenchmarkRuntime {
+    BenchmarkProgram program;
+    SwampDecodedProgram decodedProgram;
+    BenchmarkTypes types;
+    uint8_t* dynamicMemoryOctets;
+    SwampDynamicMemory dynamicMemory;
+    uint8_t* sourceMemoryOctets;
+    SwampDynamicMemory sourceMemory; // the input lists and state, never reset
+    uint8_t* frameMemoryOctets;
+    SwampDynamicMemory frameMemory; // what a frame allocated on top of the state in sourceMemory
+    SwampCopyPlanCache copyPlans; // there is no SwampUnpack that owns them
+    SwampCompactor compactor;
+    SwampDebugInfoFiles debugInfoFiles;
+    SwampMachineContext contexts[2];
+    const char* contextNames[2];
+
+    const SwampFunc* loops[6];
+    const char* loopNames[6];
+    size_t loopOperationCounts[6];
+    const SwampFunc** loopFns[6]; // the function that is stored in the fn parameter of the loop
+    const SwampFunc* identity;
+    const SwampFunc* add;
+    const SwampFunc* twice;
+    const SwampFunc* duplicate;
+
+    const SwampList* intList;
+    const SwampList* state;
+    const SwampList* sharedState; // the same as state, but the names and paths are shared between the entities
+    const SwampList* positions;
+    const SwampList* frameState; // the state after a frame that changed every BENCHMARK_FRAME_CHANGE_INTERVAL entity
+} BenchmarkRuntime;
+
+static void runtimeAddLoop(BenchmarkRuntime* self, size_t index, const char* name, BenchmarkEmitBodyFn emitBody,
+                           size_t operationCount, const SwampFunc** fn)
+{
+    self->loops[index] = programAddLoop(&self->program, name, emitBody);
+    self->loopNames[index] = name;
+    self->loopOperationCounts[index] = operationCount;
+    self->loopFns[index] = fn;
+}
+
+static void runtimeInitFunctions(BenchmarkRuntime* self)
+{
+    BenchmarkProgram* program = &self->program;
+    programInit(program);
+
+    runtimeAddLoop(self, 0, "dispatch.int-arithmetic", emitArithmeticBody, LOOP_OVERHEAD_OPCODE_COUNT + 16,
+                   &self->identity);
+    runtimeAddLoop(self, 1, "dispatch.compare-branch", emitCompareBranchBody, LOOP_OVERHEAD_OPCODE_COUNT + 16,
+                   &self->identity);
+    runtimeAddLoop(self, 2, "dispatch.memory-copy", emitMemoryCopyBody, LOOP_OVERHEAD_OPCODE_COUNT + 16,
+                   &self->identity);
+    runtimeAddLoop(self, 3, "dispatch.list-conj", emitListConjBody, LOOP_OVERHEAD_OPCODE_COUNT + 4, &self->identity);
+    runtimeAddLoop(self, 4, "call.call-return", emitCallBody, 4, &self->identity);
+    runtimeAddLoop(self, 5, "call.curry-create", emitCurryBody, 4, &self->add);
+
+    BenchmarkCode code;
+
+    // identity : Int -> Int
+    code.count = 0;
+    emitMemCopy(&code, 0, 4, sizeof(SwampInt32));
+    emit8(&code, SwampOpcodeReturn);
+    self->identity = programAddFunc(program, "identity", &code, 1, 4, sizeof(SwampInt32), sizeof(SwampInt32), 0);
+
+    // add : Int -> Int -> Int
+    code.count = 0;
+    emitOperator(&code, SwampOpcodeIntAdd, 0, 4, 8);
+    emit8(&code, SwampOpcodeReturn);
+    self->add = programAddFunc(program, "add", &code, 2, 8, sizeof(SwampInt32), sizeof(SwampInt32), 0);
+
+    // twice : Int -> Int
+    code.count = 0;
+    emitOperator(&code, SwampOpcodeIntAdd, 0, 4, 4);
+    emit8(&code, SwampOpcodeReturn);
+    self->twice = programAddFunc(program, "twice", &code, 1, 4, sizeof(SwampInt32), sizeof(SwampInt32), 0);
+
+    // duplicate : Int -> List Int
+    code.count = 0;
+    emit8(&code, SwampOpcodeListCreate);
+    emit32(&code, 0);
+    emit16(&code, sizeof(SwampInt32));
+    emit8(&code, sizeof(SwampInt32));
+    emit8(&code, 2);
+    emit32(&code, 8);
+    emit32(&code, 8);
+    emit8(&code, SwampOpcodeReturn);
+    self->duplicate = programAddFunc(program, "duplicate", &code, 1, 4, sizeof(SwampList*), 8, 0);
+
+    programDone(program);
+}
+
+static void runtimeInitValues(BenchmarkRuntime* self)
+{
+    SwampDynamicMemory* memory = &self->sourceMemory;
+
+    SwampInt32 items[BENCHMARK_LIST_COUNT];
+    for (size_t i = 0; i < BENCHMARK_LIST_COUNT; ++i) {
+        items[i] = (SwampInt32) i;
+    }
+    self->intList = swampListAllocate(memory, items, BENCHMARK_LIST_COUNT, sizeof(SwampInt32), sizeof(SwampInt32));
+
+    SwampList* state = swampListAllocatePrepare(memory, BENCHMARK_ENTITY_COUNT, sizeof(BenchmarkEntity), 8);
+    BenchmarkEntity* entities = (BenchmarkEntity*) state->value;
+    char name[32];
+    for (size_t i = 0; i < BENCHMARK_ENTITY_COUNT; ++i) {
+        BenchmarkEntity* entity = &entities[i];
+        entity->id = (SwampInt32) i;
+        entity->x = (SwampInt32) (i % 320);
+        entity->y = (SwampInt32) (i / 320);
+        tc_snprintf(name, 32, "entity %zu", i);
+        entity->name = swampStringAllocate(memory, name);
+        entity->path = swampListAllocate(memory, items, BENCHMARK_ENTITY_PATH_COUNT, sizeof(SwampInt32),
+                                         sizeof(SwampInt32));
+    }
+    self->state = state;
+
+    const SwampString* sharedNames[BENCHMARK_SHARED_NAME_COUNT];
+    for (size_t i = 0; i < BENCHMARK_SHARED_NAME_COUNT; ++i) {
+        tc_snprintf(name, 32, "entity type %zu", i);
+        sharedNames[i] = swampStringAllocate(memory, name);
+    }
+    const SwampList* sharedPaths[BENCHMARK_SHARED_PATH_COUNT];
+    for (size_t i = 0; i < BENCHMARK_SHARED_PATH_COUNT; ++i) {
+        sharedPaths[i] = swampListAllocate(memory, &items[i], BENCHMARK_ENTITY_PATH_COUNT, sizeof(SwampInt32),
+                                           sizeof(SwampInt32));
+    }
+    SwampList* sharedState = swampListAllocatePrepare(memory, BENCHMARK_ENTITY_COUNT, sizeof(BenchmarkEntity), 8);
+    BenchmarkEntity* sharedEntities = (BenchmarkEntity*) sharedState->value;
+    for (size_t i = 0; i < BENCHMARK_ENTITY_COUNT; ++i) {
+        sharedEntities[i] = entities[i];
+        sharedEntities[i].name = sharedNames[i % BENCHMARK_SHARED_NAME_COUNT];
+        sharedEntities[i].path = sharedPaths[i % BENCHMARK_SHARED_PATH_COUNT];
+    }
+    self->sharedState = sharedState;
+
+    SwampList* positions = swampListAllocatePrepare(memory, BENCHMARK_POSITION_COUNT, 2 * sizeof(SwampInt32),
+                                                    sizeof(SwampInt32));
+    SwampInt32* coordinates = (SwampInt32*) positions->value;
+    for (size_t i = 0; i < BENCHMARK_POSITION_COUNT; ++i) {
+        coordinates[i * 2] = (SwampInt32) (i % 320);
+        coordinates[i * 2 + 1] = (SwampInt32) (i / 320);
+    }
+    self->positions = positions;
+
+    SwampDynamicMemory* frameMemory = &self->frameMemory;
+    SwampList* frameState = swampListAllocatePrepare(frameMemory, BENCHMARK_ENTITY_COUNT, sizeof(BenchmarkEntity), 8);
+    BenchmarkEntity* frameEntities = (BenchmarkEntity*) frameState->value;
+    for (size_t i = 0; i < BENCHMARK_ENTITY_COUNT; ++i) {
+        frameEntities[i] = entities[i];
+        if (i % BENCHMARK_FRAME_CHANGE_INTERVAL == 0) {
+            tc_snprintf(name, 32, "moved entity %zu", i);
+            frameEntities[i].name = swampStringAllocate(frameMemory, name);
+            frameEntities[i].path = swampListAllocate(frameMemory, &items[1], BENCHMARK_ENTITY_PATH_COUNT,
+                                                      sizeof(SwampInt32), sizeof(SwampInt32));
+        }
+    }
+    self->frameState = frameState;
+}
+
+static void runtimeInit(BenchmarkRuntime* self)
+{
+    runtimeInitFunctions(self);
+    if (swampDecodedProgramInit(&self->decodedProgram, &self->program.ledger, &self->program.staticMemory) < 0) {
+        CLOG_ERROR("could not decode the benchmark program")
+    }
+    typesInit(&self->types);
+
+    self->dynamicMemoryOctets = tc_malloc(BENCHMARK_DYNAMIC_MEMORY_SIZE);
+    swampDynamicMemoryInitGrowable(&self->dynamicMemory, self->dynamicMemoryOctets, BENCHMARK_DYNAMIC_MEMORY_SIZE,
+                                   BENCHMARK_DYNAMIC_MEMORY_SIZE);
+    self->sourceMemoryOctets = tc_malloc(BENCHMARK_DYNAMIC_MEMORY_SIZE);
+    swampDynamicMemoryInit(&self->sourceMemory, self->sourceMemoryOctets, BENCHMARK_DYNAMIC_MEMORY_SIZE);
+    self->frameMemoryOctets = tc_malloc(BENCHMARK_DYNAMIC_MEMORY_SIZE);
+    swampDynamicMemoryInit(&self->frameMemory, self->frameMemoryOctets, BENCHMARK_DYNAMIC_MEMORY_SIZE);
+    swampCopyPlanCacheInit(&self->copyPlans);
+    swampCompactorInit(&self->compactor, &self->copyPlans);
+    runtimeInitValues(self);
+
+    static const char* filenames[] = {"benchmark.swamp"};
+    self->debugInfoFiles.count = 1;
+    self->debugInfoFiles.filenames = filenames;
+
+    self->contextNames[0] = "raw";
+    self->contextNames[1] = "decoded";
+    for (size_t i = 0; i < 2; ++i) {
+        SwampMachineContext* context = &self->contexts[i];
+        swampContextInit(context, &self->dynamicMemory, &self->program.staticMemory, &self->types.chunk, 0,
+                         &self->debugInfoFiles, self->contextNames[i]);
+        context->decodedProgram = i == 1 ? &self->decodedProgram : 0;
+        // List.concatMap collects the items in the temp result
+        tc_free(context->tempResult);
+        context->tempResultSize = BENCHMARK_LIST_COUNT * 2 * sizeof(SwampInt32) + 16;
+        context->tempResult = tc_malloc(context->tempResultSize);
+    }
+}
+
+static void runtimeDestroy(BenchmarkRuntime* self)
+{
+    for (size_t i = 0; i < 2; ++i) {
+        swampContextDestroy(&self->contexts[i]);
+    }
+    swampDynamicMemoryDestroy(&self->dynamicMemory);
+    swampDynamicMemoryDestroy(&self->sourceMemory);
+    swampDynamicMemoryDestroy(&self->frameMemory);
+    swampCompactorDestroy(&self->compactor);
+    swampCopyPlanCacheDestroy(&self->copyPlans);
+    tc_free(self->dynamicMemoryOctets);
+    tc_free(self->sourceMemoryOctets);
+    tc_free(self->frameMemoryOctets);
+    swampDecodedProgramDestroy(&self->decodedProgram);
+    programDestroy(&self->program);
+}
+
+typedef struct BenchmarkCase {
+    BenchmarkRuntime* runtime;
+    SwampMachineContext* context;
+    const SwampFunc* func;
+    const SwampFunction* fn;
+    const void* coreFunction;
+    size_t itemCount;
+    size_t itemSize;
+    size_t itemAlign;
+    const void* state;
+    const SwtiType* stateType;
+    SwampWorkerPool* pool;
+} BenchmarkCase;
+
+static void runLoop(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+    SwampMachineContext* context = self->context;
+
+    swampDynamicMemoryReset(context->dynamicMemory);
+    uint8_t* bp = context->bp;
+    *(SwampInt32*) (bp + LOOP_N) = (SwampInt32) iterationCount;
+    *(SwampInt32*) (bp + LOOP_ACC) = 0;
+    *(const SwampList**) (bp + LOOP_LIST) = swampListEmptyAllocate(context->dynamicMemory);
+    *(const SwampFunc**) (bp + LOOP_FN) = (const SwampFunc*) self->fn;
+
+    SwampResult result;
+    result.expectedOctetSize = sizeof(SwampInt32);
+    SwampParameters parameters;
+    parameters.parameterCount = 4;
+    parameters.octetSize = LOOP_PARAMETERS_OCTET_SIZE;
+    if (swampRun(&result, context, self->func, parameters, 0) < 0) {
+        CLOG_ERROR("benchmark loop '%s' failed", self->func->debugName)
+    }
+}
+
+// The same as List.map does for each range
+static void runPreparedCall(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+    const SwampList* list = self->runtime->intList;
+    SwampInt32* target = (SwampInt32*) self->context->tempResult;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        SwampPreparedCall call;
+        SwampPreparedCallArgument item = {list->itemSize, list->itemAlign};
+        if (swampPreparedCallInit(&call, self->context, self->fn, &item, 1) < 0) {
+            CLOG_ERROR("could not prepare call")
+        }
+        if (swampPreparedCallInvokeMany(&call, list->value, list->count, list->itemSize, (uint8_t*) target,
+                                        sizeof(SwampInt32)) < 0) {
+            CLOG_ERROR("prepared call failed")
+        }
+    }
+}
+
+typedef void (*BenchmarkListMapFn)(SwampList** result, SwampMachineContext* context, const SwampFunction** fn,
+                                   const SwampList** list);
+typedef void (*BenchmarkListFoldlFn)(void* result, SwampMachineContext* context, const SwampUnknownType* fn,
+                                     const SwampUnknownType* initialValue, const SwampUnknownType* list);
+
+// map and concatMap take typed arguments
+static void runListMap(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+    BenchmarkListMapFn map = (BenchmarkListMapFn) self->coreFunction;
+    const SwampList* list = self->runtime->intList;
+    const SwampFunction* fn = self->fn;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampDynamicMemoryReset(self->context->dynamicMemory);
+        SwampList* result = 0;
+        map(&result, self->context, &fn, &list);
+        if (result == 0 || result->count == 0) {
+            CLOG_ERROR("list function did not return a list")
+        }
+    }
+}
+
+// foldl takes its arguments with sizes, the same as SwampOpcodeCallExternalWithExtendedSizes
+static void runListFoldl(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+    BenchmarkListFoldlFn foldl = (BenchmarkListFoldlFn) self->coreFunction;
+    const SwampList* list = self->runtime->intList;
+    SwampInt32 initialValue = 0;
+
+    SwampUnknownType fnArgument = {&self->fn, sizeof(SwampFunction*), 8};
+    SwampUnknownType initialValueArgument = {&initialValue, sizeof(SwampInt32), sizeof(SwampInt32)};
+    SwampUnknownType listArgument = {&list, sizeof(SwampList*), 8};
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        SwampInt32 result;
+        foldl(&result, self->context, &fnArgument, &initialValueArgument, &listArgument);
+    }
+}
+
+static void runClone(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampDynamicMemoryReset(&self->runtime->dynamicMemory);
+        void* cloned;
+        if (swampClone(&self->runtime->compactor, self->state, self->stateType, &self->runtime->dynamicMemory, 0, 0,
+                       &cloned) < 0) {
+            CLOG_ERROR("clone failed")
+        }
+    }
+}
+
+static void runCompact(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampDynamicMemoryReset(&self->runtime->dynamicMemory);
+        void* compacted;
+        if (swampCompact(&self->runtime->compactor, self->state, self->stateType, &self->runtime->dynamicMemory, 0,
+                         0, &compacted) < 0) {
+            CLOG_ERROR("compact failed")
+        }
+    }
+}
+
+static void runCompactParallel(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampDynamicMemoryReset(&self->runtime->dynamicMemory);
+        void* compacted;
+        if (swampCompactParallel(&self->runtime->compactor, self->state, self->stateType,
+                                 &self->runtime->dynamicMemory, 0, 0, self->pool, &compacted, 0) < 0) {
+            CLOG_ERROR("parallel compact failed")
+        }
+    }
+}
+
+// Only what the frame allocated is moved, the entities that did not change are kept in the source memory
+static void runCompactGenerational(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampDynamicMemoryReset(&self->runtime->dynamicMemory);
+        void* compacted;
+        if (swampCompactGenerational(&self->runtime->compactor, self->state, self->stateType,
+                                     &self->runtime->frameMemory, &self->runtime->dynamicMemory, &compacted, 0) < 0) {
+            CLOG_ERROR("generational compact failed")
+        }
+    }
+}
+
+static void runAlloc(void* userData, size_t iterationCount)
+{
+    const BenchmarkCase* self = (const BenchmarkCase*) userData;
+    SwampDynamicMemory* memory = &self->runtime->dynamicMemory;
+    size_t checksum = 0;
+
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampDynamicMemoryReset(memory);
+        for (size_t j = 0; j < BENCHMARK_ALLOC_COUNT; ++j) {
+            uint8_t* p = swampDynamicMemoryAlloc(memory, self->itemCount, self->itemSize, self->itemAlign);
+            *p = (uint8_t) j;
+            checksum += (uintptr_t) p;
+        }
+    }
+
+    if (checksum == 0) {
+        CLOG_INFO("checksum is zero")
+    }
+}
+
+// The ledger part of unpacking a large pack: building the index and decoding all functions
+typedef struct UnpackBenchmark {
+    BenchmarkProgram program;
+} UnpackBenchmark;
+
+static void unpackBenchmarkInit(UnpackBenchmark* self)
+{
+    programInit(&self->program);
+    char name[32];
+    for (size_t i = 0; i < BENCHMARK_UNPACK_FUNC_COUNT; ++i) {
+        BenchmarkCode code;
+        code.count = 0;
+        emitLoopStart(&code);
+        switch (i % 3) {
+            case 0:
+                emitArithmeticBody(&code);
+                break;
+            case 1:
+                emitCompareBranchBody(&code);
+                break;
+            default:
+                emitCallBody(&code);
+                break;
+        }
+        emitLoopEnd(&code);
+        tc_snprintf(name, 32, "Module%zu.func%zu", i / 100, i);
+        programAddFunc(&self->program, name, &code, 4, LOOP_PARAMETERS_OCTET_SIZE, sizeof(SwampInt32),
+                       sizeof(SwampInt32), (uint16_t) (i % 64));
+    }
+    programDone(&self->program);
+}
+
+static void runUnpackIndex(void* userData, size_t iterationCount)
+{
+    UnpackBenchmark* self = (UnpackBenchmark*) userData;
+    for (size_t i = 0; i < iterationCount; ++i) {
+        swampLedgerBuildIndex(&self->program.ledger);
+        swampLedgerDestroyIndex(&self->program.ledger);
+    }
+}
+
+static void runUnpackDecode(void* userData, size_t iterationCount)
+{
+    UnpackBenchmark* self = (UnpackBenchmark*) userData;
+    for (size_t i = 0; i < iterationCount; ++i) {
+        SwampDecodedProgram decodedProgram;
+        if (swampDecodedProgramInit(&decodedProgram, &self->program.ledger, &self->program.staticMemory) < 0) {
+            CLOG_ERROR("decode failed")
+        }
+        swampDecodedProgramDestroy(&decodedProgram);
+    }
+}
+
+static void runDispatchBenchmarks(BenchmarkHarness* harness, BenchmarkRuntime* runtime)
+{
+    char name[64];
+    for (size_t c = 0; c < 2; ++c) {
+        for (size_t i = 0; i < sizeof(runtime->loops) / sizeof(runtime->loops[0]); ++i) {
+            BenchmarkCase benchmarkCase = {
+                .runtime = runtime, .context = &runtime->contexts[c], .func = runtime->loops[i]};
+            benchmarkCase.fn = (const SwampFunction*) *runtime->loopFns[i];
+            tc_snprintf(name, 64, "%s.%s", runtime->loopNames[i], runtime->contextNames[c]);
+            benchmarkHarnessRun(harness, name, runLoop, &benchmarkCase, runtime->loopOperationCounts[i]);
+        }
+    }
+}
+
+static void runCallBenchmarks(BenchmarkHarness* harness, BenchmarkRuntime* runtime)
+{
+    SwampInt32 curriedValue = 1;
+    const SwampFunction* curried = (const SwampFunction*) swampCurryFuncAllocate(
+        &runtime->sourceMemory, 0, sizeof(SwampInt32), runtime->add, &curriedValue, sizeof(curriedValue));
+
+    char name[64];
+    for (size_t c = 0; c < 2; ++c) {
+        BenchmarkCase benchmarkCase = {.runtime = runtime, .context = &runtime->contexts[c]};
+        benchmarkCase.fn = (const SwampFunction*) runtime->twice;
+        tc_snprintf(name, 64, "call.prepared.%s", runtime->contextNames[c]);
+        benchmarkHarnessRun(harness, name, runPreparedCall, &benchmarkCase, BENCHMARK_LIST_COUNT);
+
+        benchmarkCase.fn = curried;
+        tc_snprintf(name, 64, "call.curried.%s", runtime->contextNames[c]);
+        benchmarkHarnessRun(harness, name, runPreparedCall, &benchmarkCase, BENCHMARK_LIST_COUNT);
+    }
+}
+
+static void runListBenchmarks(BenchmarkHarness* harness, BenchmarkRuntime* runtime)
+{
+    char name[64];
+    for (size_t c = 0; c < 2; ++c) {
+        BenchmarkCase benchmarkCase = {.runtime = runtime, .context = &runtime->contexts[c]};
+
+        benchmarkCase.fn = (const SwampFunction*) runtime->twice;
+        benchmarkCase.coreFunction = swampCoreListFindFunction("List.map");
+        tc_snprintf(name, 64, "list.map.%s", runtime->contextNames[c]);
+        benchmarkHarnessRun(harness, name, runListMap, &benchmarkCase, BENCHMARK_LIST_COUNT);
+
+        benchmarkCase.fn = (const SwampFunction*) runtime->add;
+        benchmarkCase.coreFunction = swampCoreListFindFunction("List.foldl");
+        tc_snprintf(name, 64, "list.foldl.%s", runtime->contextNames[c]);
+        benchmarkHarnessRun(harness, name, runListFoldl, &benchmarkCase, BENCHMARK_LIST_COUNT);
+
+        benchmarkCase.fn = (const SwampFunction*) runtime->duplicate;
+        benchmarkCase.coreFunction = swampCoreListFindFunction("List.concatMap");
+        tc_snprintf(name, 64, "list.concatMap.%s", runtime->contextNames[c]);
+        benchmarkHarnessRun(harness, name, runListMap, &benchmarkCase, BENCHMARK_LIST_COUNT);
+    }
+}
+
+static void runStateBenchmarks(BenchmarkHarness* harness, BenchmarkRuntime* runtime)
+{
+    BenchmarkCase benchmarkCase = {.runtime = runtime};
+    benchmarkCase.state = &runtime->state;
+    benchmarkCase.stateType = (const SwtiType*) &runtime->types.stateType;
+    benchmarkHarnessRun(harness, "state.clone", runClone, &benchmarkCase, BENCHMARK_ENTITY_COUNT);
+    benchmarkHarnessRun(harness, "state.compact", runCompact, &benchmarkCase, BENCHMARK_ENTITY_COUNT);
+
+    benchmarkCase.state = &runtime->sharedState;
+    if (benchmarkHarnessShouldRun(harness, "state.clone-shared")) {
+        SwampCompactStats stats;
+        void* cloned;
+        swampDynamicMemoryReset(&runtime->dynamicMemory);
+        swampCloneWithStats(&runtime->compactor, benchmarkCase.state, benchmarkCase.stateType,
+                            &runtime->dynamicMemory, 0, 0, &cloned, &stats);
+        size_t clonedOctetCount = swampDynamicMemoryAllocatedSize(&runtime->dynamicMemory);
+        fprintf(stderr, "state.clone-shared: %zu octets, %zu objects copied, %zu shared references saved %zu octets\n",
+                clonedOctetCount, stats.objectCount, stats.sharedReferenceCount, stats.sharedOctetCount);
+    }
+    benchmarkHarnessRun(harness, "state.clone-shared", runClone, &benchmarkCase, BENCHMARK_ENTITY_COUNT);
+
+    // No pointers in the items, so the list is copied with a single memcpy
+    benchmarkCase.state = &runtime->positions;
+    benchmarkCase.stateType = (const SwtiType*) &runtime->types.positionListType;
+    benchmarkHarnessRun(harness, "state.clone-positions", runClone, &benchmarkCase, BENCHMARK_POSITION_COUNT);
+    benchmarkHarnessRun(harness, "state.compact-positions", runCompact, &benchmarkCase, BENCHMARK_POSITION_COUNT);
+
+    benchmarkCase.state = &runtime->frameState;
+    benchmarkCase.stateType = (const SwtiType*) &runtime->types.stateType;
+    if (benchmarkHarnessShouldRun(harness, "state.compact-generational")) {
+        SwampCompactStats stats;
+        void* compacted;
+        swampDynamicMemoryReset(&runtime->dynamicMemory);
+        swampCompactGenerational(&runtime->compactor, benchmarkCase.state, benchmarkCase.stateType,
+                                 &runtime->frameMemory, &runtime->dynamicMemory, &compacted, &stats);
+        fprintf(stderr, "state.compact-generational: %zu octets, %zu objects moved, %zu references kept\n",
+                swampDynamicMemoryAllocatedSize(&runtime->dynamicMemory), stats.objectCount,
+                stats.keptReferenceCount);
+    }
+    benchmarkHarnessRun(harness, "state.compact-frame", runCompact, &benchmarkCase, BENCHMARK_ENTITY_COUNT);
+    benchmarkHarnessRun(harness, "state.compact-generational", runCompactGenerational, &benchmarkCase,
+                        BENCHMARK_ENTITY_COUNT);
+
+    // The calling thread is one of the cores, so the pool has one thread less
+    benchmarkCase.state = &runtime->state;
+    static const size_t coreCounts[] = {1, 2, 4, 8, 16};
+    for (size_t i = 0; i < sizeof(coreCounts) / sizeof(coreCounts[0]); ++i) {
+        char name[64];
+        tc_snprintf(name, 64, "state.compact-parallel-%zu", coreCounts[i]);
+        if (!benchmarkHarnessShouldRun(harness, name)) {
+            continue;
+        }
+        SwampWorkerPool pool;
+        if (swampWorkerPoolInit(&pool, coreCounts[i] - 1) < 0) {
+            continue;
+        }
+        benchmarkCase.pool = &pool;
+        benchmarkHarnessRun(harness, name, runCompactParallel, &benchmarkCase, BENCHMARK_ENTITY_COUNT);
+        swampWorkerPoolDestroy(&pool);
+    }
+}
+
+static void runAllocBenchmarks(BenchmarkHarness* harness, BenchmarkRuntime* runtime)
+{
+    BenchmarkCase benchmarkCase = {.runtime = runtime};
+    benchmarkCase.itemCount = 1;
+    benchmarkCase.itemSize = sizeof(SwampList);
+    benchmarkCase.itemAlign = 8;
+    benchmarkHarnessRun(harness, "alloc.list-struct", runAlloc, &benchmarkCase, BENCHMARK_ALLOC_COUNT);
+
+    benchmarkCase.itemCount = 64;
+    benchmarkCase.itemSize = sizeof(SwampInt32);
+    benchmarkCase.itemAlign = sizeof(SwampInt32);
+    benchmarkHarnessRun(harness, "alloc.list-int-64", runAlloc, &benchmarkCase, BENCHMARK_ALLOC_COUNT);
+
+    benchmarkCase.itemCount = 12;
+    benchmarkCase.itemSize = 1;
+    benchmarkCase.itemAlign = 1;
+    benchmarkHarnessRun(harness, "alloc.characters", runAlloc, &benchmarkCase, BENCHMARK_ALLOC_COUNT);
+}
+
+static void runUnpackBenchmarks(BenchmarkHarness* harness)
+{
+    if (!benchmarkHarnessShouldRun(harness, "unpack.")) {
+        return;
+    }
+
+    UnpackBenchmark* unpack = tc_malloc_type(UnpackBenchmark);
+    unpackBenchmarkInit(unpack);
+    benchmarkHarnessRun(harness, "unpack.ledger-index", runUnpackIndex, unpack, BENCHMARK_UNPACK_FUNC_COUNT);
+    benchmarkHarnessRun(harness, "unpack.decode", runUnpackDecode, unpack, BENCHMARK_UNPACK_FUNC_COUNT);
+    programDestroy(&unpack->program);
+    tc_free(unpack);
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    BenchmarkHarness harness;
+    benchmarkHarnessInit(&harness);
+    if (benchmarkHarnessParseArguments(&harness, argc, argv) < 0) {
+        return 1;
+    }
+
+    BenchmarkRuntime* runtime = tc_malloc_type(BenchmarkRuntime);
+    runtimeInit(runtime);
+
+    runDispatchBenchmarks(&harness, runtime);
+    runCallBenchmarks(&harness, runtime);
+    runListBenchmarks(&harness, runtime);
+    runStateBenchmarks(&harness, runtime);
+    runAllocBenchmarks(&harness, runtime);
+    runUnpackBenchmarks(&harness);
+
+    int errorCode = benchmarkHarnessWriteResults(&harness);
+
+    runtimeDestroy(runtime);
+    tc_free(runtime);
+    benchmarkHarnessDestroy(&harness);
+
+    return errorCode < 0 ? 1 : 0;
+}
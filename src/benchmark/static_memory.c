@@ -0,0 +1,207 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <monotonic-time/monotonic_time.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/debug_variables.h>
+#include <swamp-runtime/fixup.h>
+#include <swamp-runtime/relocation.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+// Roughly the shape of a large game pack: many functions with opcodes, debug lines and variables, plus constants
+#define BENCHMARK_FUNC_COUNT (4000)
+#define BENCHMARK_OPCODE_COUNT (1024)
+#define BENCHMARK_LINE_COUNT (48)
+#define BENCHMARK_VARIABLE_COUNT (8)
+#define BENCHMARK_STRING_COUNT (4000)
+#define BENCHMARK_EXTERNAL_FUNC_COUNT (200)
+#define BENCHMARK_ROUND_COUNT (20)
+
+typedef struct BenchmarkPack {
+    uint8_t* octets;
+    size_t octetCount;
+    size_t capacity;
+    SwampConstantLedgerEntry* entries;
+    size_t entryCount;
+} BenchmarkPack;
+
+static size_t packAllocate(BenchmarkPack* self, size_t octetCount)
+{
+    size_t offset = (self->octetCount + 7) & ~(size_t) 7;
+    self->octetCount = offset + octetCount;
+    if (self->octetCount > self->capacity) {
+        CLOG_ERROR("benchmark pack is too small")
+    }
+
+    return offset;
+}
+
+static size_t packAllocateString(BenchmarkPack* self, const char* s)
+{
+    size_t length = tc_strlen(s);
+    size_t offset = packAllocate(self, length + 1);
+    tc_memcpy_octets(self->octets + offset, s, length + 1);
+    return offset;
+}
+
+static void packAddEntry(BenchmarkPack* self, uint32_t constantType, size_t offset)
+{
+    SwampConstantLedgerEntry* entry = &self->entries[self->entryCount++];
+    entry->constantType = constantType;
+    entry->offset = (uint32_t) offset;
+}
+
+// Writes the static memory the way the compiler does, with all pointers stored as offsets into the static memory
+static void packInit(BenchmarkPack* self)
+{
+    self->capacity = 16 * 1024 * 1024;
+    self->octets = tc_malloc(self->capacity);
+    tc_mem_clear(self->octets, self->capacity);
+    self->octetCount = 8;
+    self->entries = tc_malloc_type_count(SwampConstantLedgerEntry,
+                                         BENCHMARK_FUNC_COUNT + BENCHMARK_STRING_COUNT + BENCHMARK_EXTERNAL_FUNC_COUNT + 1);
+    self->entryCount = 0;
+
+    char name[64];
+    for (size_t i = 0; i < BENCHMARK_FUNC_COUNT; ++i) {
+        size_t funcOffset = packAllocate(self, sizeof(SwampFunc));
+        size_t opcodesOffset = packAllocate(self, BENCHMARK_OPCODE_COUNT);
+        tc_memset_octets(self->octets + opcodesOffset, (uint8_t) i, BENCHMARK_OPCODE_COUNT);
+
+        size_t linesOffset = packAllocate(self, sizeof(SwampDebugInfoLines));
+        size_t lineEntriesOffset = packAllocate(self, BENCHMARK_LINE_COUNT * sizeof(SwampDebugInfoLinesEntry));
+        SwampDebugInfoLines* lines = (SwampDebugInfoLines*) (self->octets + linesOffset);
+        lines->count = BENCHMARK_LINE_COUNT;
+        lines->lines = (const SwampDebugInfoLinesEntry*) lineEntriesOffset;
+
+        size_t variablesOffset = packAllocate(self, sizeof(SwampDebugInfoVariables));
+        size_t variableEntriesOffset = packAllocate(self,
+                                                    BENCHMARK_VARIABLE_COUNT * sizeof(SwampDebugInfoVariablesEntry));
+        for (size_t j = 0; j < BENCHMARK_VARIABLE_COUNT; ++j) {
+            tc_snprintf(name, 64, "variable%zu", j);
+            size_t nameOffset = packAllocateString(self, name);
+            SwampDebugInfoVariablesEntry* variable =
+                (SwampDebugInfoVariablesEntry*) (self->octets + variableEntriesOffset) + j;
+            variable->name = (const char*) nameOffset;
+        }
+        SwampDebugInfoVariables* variables = (SwampDebugInfoVariables*) (self->octets + variablesOffset);
+        variables->count = BENCHMARK_VARIABLE_COUNT;
+        variables->variables = (const SwampDebugInfoVariablesEntry*) variableEntriesOffset;
+
+        tc_snprintf(name, 64, i == 0 ? "main" : "func%zu", i);
+        size_t debugNameOffset = packAllocateString(self, name);
+
+        SwampFunc* func = (SwampFunc*) (self->octets + funcOffset);
+        func->func.type = SwampFunctionTypeInternal;
+        func->opcodes = (const uint8_t*) opcodesOffset;
+        func->opcodeCount = BENCHMARK_OPCODE_COUNT;
+        func->debugName = (const char*) debugNameOffset;
+        func->debugInfoLines = (const SwampDebugInfoLines*) linesOffset;
+        func->debugInfoVariables = (const SwampDebugInfoVariables*) variablesOffset;
+        packAddEntry(self, LedgerTypeFunc, funcOffset);
+    }
+
+    for (size_t i = 0; i < BENCHMARK_STRING_COUNT; ++i) {
+        tc_snprintf(name, 64, "constant string %zu", i);
+        size_t charactersOffset = packAllocateString(self, name);
+        size_t stringOffset = packAllocate(self, sizeof(SwampString));
+        SwampString* str = (SwampString*) (self->octets + stringOffset);
+        str->characters = (const char*) charactersOffset;
+        str->characterCount = tc_strlen(name);
+        packAddEntry(self, LedgerTypeString, stringOffset);
+    }
+
+    for (size_t i = 0; i < BENCHMARK_EXTERNAL_FUNC_COUNT; ++i) {
+        tc_snprintf(name, 64, "Module.external%zu", i);
+        size_t nameOffset = packAllocateString(self, name);
+        size_t funcOffset = packAllocate(self, sizeof(SwampFunctionExternal));
+        SwampFunctionExternal* func = (SwampFunctionExternal*) (self->octets + funcOffset);
+        func->func.type = SwampFunctionTypeExternal;
+        func->parameterCount = 1;
+        func->fullyQualifiedName = (const char*) nameOffset;
+        packAddEntry(self, LedgerTypeExternalFunc, funcOffset);
+    }
+
+    packAddEntry(self, 0, 0);
+}
+
+static void packDestroy(BenchmarkPack* self)
+{
+    tc_free(self->octets);
+    tc_free(self->entries);
+}
+
+static void benchmarkExternal(void* result, struct SwampMachineContext* context, const void* argument1)
+{
+}
+
+static const void* benchmarkBind(const char* fullyQualifiedName)
+{
+    return (const void*) benchmarkExternal;
+}
+
+// A fixup needs its own writable copy of the static memory for every load
+static double runFixup(const BenchmarkPack* pack, uint8_t* copy)
+{
+    const SwampFunc* entry = 0;
+    MonotonicTimeNanoseconds before = monotonicTimeNanosecondsNow();
+    for (size_t round = 0; round < BENCHMARK_ROUND_COUNT; ++round) {
+        tc_memcpy_octets(copy, pack->octets, pack->octetCount);
+        entry = swampFixupLedger(copy, benchmarkBind, pack->entries);
+    }
+    MonotonicTimeNanoseconds after = monotonicTimeNanosecondsNow();
+
+    if (entry == 0) {
+        CLOG_ERROR("fixup did not find main")
+    }
+
+    return (after - before) / 1000000.0 / BENCHMARK_ROUND_COUNT;
+}
+
+static double runRelocation(const BenchmarkPack* pack, size_t* resolvedOctetCount)
+{
+    const SwampFunc* entry = 0;
+    MonotonicTimeNanoseconds before = monotonicTimeNanosecondsNow();
+    for (size_t round = 0; round < BENCHMARK_ROUND_COUNT; ++round) {
+        SwampStaticRelocation relocation;
+        swampStaticRelocationInit(&relocation, pack->octets, benchmarkBind, 0, pack->entries, &entry);
+        *resolvedOctetCount = relocation.resolvedOctetCount;
+        swampStaticRelocationDestroy(&relocation);
+    }
+    MonotonicTimeNanoseconds after = monotonicTimeNanosecondsNow();
+
+    if (entry == 0) {
+        CLOG_ERROR("relocation did not find main")
+    }
+
+    return (after - before) / 1000000.0 / BENCHMARK_ROUND_COUNT;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    BenchmarkPack pack;
+    packInit(&pack);
+    uint8_t* copy = tc_malloc(pack.octetCount);
+
+    size_t resolvedOctetCount = 0;
+    double fixupMilliseconds = runFixup(&pack, copy);
+    double relocationMilliseconds = runRelocation(&pack, &resolvedOctetCount);
+
+    CLOG_INFO("static memory %zu octets, %zu ledger entries", pack.octetCount, pack.entryCount - 1)
+    CLOG_INFO("%-22s %12s %18s", "load", "ms", "private octets")
+    CLOG_INFO("%-22s %12.3f %18zu", "copy and fixup", fixupMilliseconds, pack.octetCount)
+    CLOG_INFO("%-22s %12.3f %18zu", "position independent", relocationMilliseconds, resolvedOctetCount)
+
+    tc_free(copy);
+    packDestroy(&pack);
+
+    return 0;
+}
@@ -13,6 +13,7 @@
 #include <swamp-runtime/compact.h>
 #include <swamp-runtime/context.h>
 #include <swamp-runtime/core/core.h>
+#include <swamp-runtime/decode.h>
 #include <swamp-runtime/log.h>
 #include <swamp-runtime/opcodes.h>
 #include <swamp-runtime/swamp.h>
@@ -119,10 +120,12 @@ int main(int argc, char* argv[])
     if (initFunc == 0) {
         CLOG_ERROR("could not find 'init'-function");
     }
+    // Two old generations that take turns, and a nursery for everything that is allocated during a frame
     SwampDynamicMemory dynamicMemory[3];
     size_t dynamicMemoryIndex = 0;
     SwampDynamicMemory* dynamicMemoryToUse = &dynamicMemory[dynamicMemoryIndex];
     SwampDynamicMemory* dynamicMemoryNext = &dynamicMemory[!dynamicMemoryIndex];
+    SwampDynamicMemory* nursery = &dynamicMemory[2];
     for (size_t i = 0; i < 3; ++i) {
         swampDynamicMemoryInitOwnAlloc(&dynamicMemory[i], 128 * 1024);
     }
@@ -131,7 +134,7 @@ int main(int argc, char* argv[])
     initResult.expectedOctetSize = initFunc->returnOctetSize;
 
     SwampMachineContext initContext;
-    initContext.dynamicMemory = &dynamicMemory[2];
+    initContext.dynamicMemory = nursery;
 
     initContext.stackMemory.maximumStackMemory = 32 * 1024;
     initContext.stackMemory.memory = malloc(initContext.stackMemory.maximumStackMemory);
@@ -140,10 +143,20 @@ int main(int argc, char* argv[])
     initContext.typeInfo = &unpack.typeInfoChunk;
 
     SwampStaticMemory staticMemory;
-    swampStaticMemoryInit(&staticMemory, (uint8_t*) unpack.constantStaticMemoryOctets,
-                          unpack.constantStaticMemoryMaxSize);
+    swampUnpackStaticMemoryInit(&unpack, &staticMemory);
     initContext.constantStaticMemory = &staticMemory;
 
+    SwampDecodedProgram decodedProgram;
+    int decodeErr = swampDecodedProgramInit(&decodedProgram, &unpack.ledger, &staticMemory);
+    if (decodeErr < 0) {
+        SWAMP_ERROR("couldn't decode %d", decodeErr)
+        return decodeErr;
+    }
+    initContext.decodedProgram = &decodedProgram;
+    initContext.tempPool = 0;
+    initContext.workerPool = 0;
+    initContext.profiler = 0;
+
     SwampParameters initParameters;
     initParameters.octetSize = 0;
     initParameters.parameterCount = 0;
@@ -161,14 +174,21 @@ int main(int argc, char* argv[])
     const SwampFunc* mainFunc = swampLedgerFindFunction(&unpack.ledger, "main"); // unpack.entry;
     swampDynamicMemoryReset(dynamicMemoryNext);
     swampDynamicMemoryReset(dynamicMemoryToUse);
-    tc_memcpy_octets(dynamicMemoryToUse->memory, initContext.bp, initFunc->returnOctetSize);
-    dynamicMemoryToUse->p += initFunc->returnOctetSize;
-
 
+    SwampCompactor compactor;
+    swampCompactorInit(&compactor, &unpack.copyPlans);
 
+    void* state;
+    int initCompactErr = swampCompactGenerational(&compactor, initContext.bp, initReturnType, nursery,
+                                                  dynamicMemoryToUse, &state, 0);
+    if (initCompactErr < 0) {
+        return initCompactErr;
+    }
+    size_t liveOctetCount = swampDynamicMemoryAllocatedSize(dynamicMemoryToUse);
+    swampDynamicMemoryReset(nursery);
 
     SwampMachineContext mainContext;
-    mainContext.dynamicMemory = dynamicMemoryToUse;
+    mainContext.dynamicMemory = nursery;
 
 
 
@@ -177,6 +197,10 @@ int main(int argc, char* argv[])
     mainContext.tempResult = malloc(2 * 1024);
     mainContext.typeInfo = &unpack.typeInfoChunk;
     mainContext.constantStaticMemory = initContext.constantStaticMemory;
+    mainContext.decodedProgram = &decodedProgram;
+    mainContext.tempPool = 0;
+    mainContext.workerPool = 0;
+    mainContext.profiler = 0;
 
     for (size_t gameplayLoop = 0; gameplayLoop < 120; ++gameplayLoop) {
         SwampResult result;
@@ -193,7 +217,7 @@ int main(int argc, char* argv[])
         swampMemoryPositionAlign(&mainPos, initFunc->returnAlign);
 
 
-        tc_memcpy_octets(mainContext.bp + mainPos, dynamicMemoryToUse->memory, initFunc->returnOctetSize);
+        tc_memcpy_octets(mainContext.bp + mainPos, state, initFunc->returnOctetSize);
         mainPos += initFunc->returnOctetSize;
 
         swampMemoryPositionAlign(&mainPos, 8);
@@ -221,6 +245,7 @@ int main(int argc, char* argv[])
 
         CLOG_INFO("starting MAIN()");
         size_t allocatedBefore = mainContext.dynamicMemory->p - mainContext.dynamicMemory->memory;
+        size_t opcodeCountBefore = swampRunExecutedOpcodeCount();
 
         MonotonicTimeNanoseconds beforeNs = monotonicTimeNanosecondsNow();
         int worked = swampRun(&result, &mainContext, mainFunc, parameters, 1);
@@ -233,6 +258,13 @@ int main(int argc, char* argv[])
         CLOG_INFO("performance: %lu microseconds allocations: %lu", (afterNs - beforeNs) / 1000,
                   (allocatedAfter - allocatedBefore) / 1024);
 
+        // Only available if swamp-runtime is built with SWAMP_RUNTIME_COUNT_OPCODES
+        size_t opcodeCount = swampRunExecutedOpcodeCount() - opcodeCountBefore;
+        if (opcodeCount > 0) {
+            CLOG_INFO("performance: %zu opcodes %.2f ns/opcode", opcodeCount,
+                      (double) (afterNs - beforeNs) / (double) opcodeCount);
+        }
+
         const SwtiType* mainFuncType = swtiChunkTypeFromIndex(initContext.typeInfo, initFunc->typeIndex);
         const SwtiFunctionType* mainFnType = (const SwtiFunctionType*) mainFuncType;
         const SwtiType* mainReturnType = mainFnType->parameterTypes[mainFnType->parameterCount - 1];
@@ -243,29 +275,46 @@ int main(int argc, char* argv[])
 
 
 
-        void* compactedState;
-        int compactErr = swampClone(mainContext.bp, mainReturnType, dynamicMemoryNext, &compactedState);
+        // Only what was allocated this frame is moved, the rest of the state is already in the old generation
+        SwampCompactStats compactStats;
+        int compactErr = swampCompactGenerational(&compactor, mainContext.bp, mainReturnType, nursery,
+                                                  dynamicMemoryToUse, &state, &compactStats);
         if (compactErr < 0) {
             return compactErr;
         }
+        swampDynamicMemoryReset(nursery);
 
         CLOG_INFO("main.update %d compacted: %s", gameplayLoop,
-                  swampDumpToAsciiString(compactedState, mainReturnType, 0, mainTempStr, 32 * 1024));
-
-        CLOG_INFO("compacted memory: %d", swampDynamicMemoryAllocatedSize(dynamicMemoryNext));
-        swampDynamicMemoryDebugOutput(dynamicMemoryNext);
-
-        dynamicMemoryIndex = !dynamicMemoryIndex;
-        dynamicMemoryToUse = &dynamicMemory[dynamicMemoryIndex];
-        dynamicMemoryNext = &dynamicMemory[!dynamicMemoryIndex];
-        swampDynamicMemoryReset(dynamicMemoryNext);
-        mainContext.dynamicMemory = dynamicMemoryToUse;
+                  swampDumpToAsciiString(state, mainReturnType, 0, mainTempStr, 32 * 1024));
+        CLOG_INFO("compacted objects: %zu kept: %zu", compactStats.objectCount, compactStats.keptReferenceCount);
+
+        // The old generation keeps what is no longer referenced, so when it has grown to twice the state it is all
+        // moved to the other old generation
+        size_t oldOctetCount = swampDynamicMemoryAllocatedSize(dynamicMemoryToUse);
+        if (oldOctetCount > 2 * liveOctetCount) {
+            compactErr = swampCompactGenerational(&compactor, state, mainReturnType, dynamicMemoryToUse,
+                                                  dynamicMemoryNext, &state, 0);
+            if (compactErr < 0) {
+                return compactErr;
+            }
+            liveOctetCount = swampDynamicMemoryAllocatedSize(dynamicMemoryNext);
+            CLOG_INFO("compacted old generation: %zu to %zu", oldOctetCount, liveOctetCount);
+            swampDynamicMemoryDebugOutput(dynamicMemoryNext);
+
+            dynamicMemoryIndex = !dynamicMemoryIndex;
+            dynamicMemoryToUse = &dynamicMemory[dynamicMemoryIndex];
+            dynamicMemoryNext = &dynamicMemory[!dynamicMemoryIndex];
+            swampDynamicMemoryReset(dynamicMemoryNext);
+        }
     }
 
     // swampContextDestroy(&mainContext);
+    swampCompactorDestroy(&compactor);
+    swampDecodedProgramDestroy(&decodedProgram);
     swampUnpackFree(&unpack);
     swampDynamicMemoryDestroy(&dynamicMemory[0]);
     swampDynamicMemoryDestroy(&dynamicMemory[1]);
+    swampDynamicMemoryDestroy(&dynamicMemory[2]);
 
     return 0;
 }
@@ -0,0 +1,69 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_ALLOCATION_PROFILER_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_ALLOCATION_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct SwampFunc;
+struct SwampDebugInfoFiles;
+
+// Allocations are grouped on the Swamp function and opcode that made them, and what allocated (an opcode name, an
+// external function name or the debug name given to swampDynamicMemoryAllocDebug()).
+typedef struct SwampAllocationSite {
+    const struct SwampFunc* func; // zero for allocations made outside of swampRun()
+    uint32_t opcodePosition; // somewhere within the opcode, resolves to the same debug line
+    const char* source;
+    size_t frameOctetCount;
+    size_t frameCount;
+    size_t lastFrameOctetCount;
+    size_t lastFrameCount;
+    size_t peakFrameOctetCount;
+    size_t totalOctetCount;
+    size_t totalCount;
+} SwampAllocationSite;
+
+// Attributes every allocation of a SwampDynamicMemory to its allocation site. Set
+// SwampDynamicMemory::allocationProfiler to enable it. A frame ends on every swampDynamicMemoryReset().
+typedef struct SwampAllocationProfiler {
+    SwampAllocationSite* sites;
+    size_t siteCount;
+    size_t siteCapacity;
+
+    // The current site, set by swampRun() before opcodes and external functions that allocate
+    const struct SwampFunc* func;
+    uint32_t opcodePosition;
+    const char* source;
+
+    size_t frameIndex;
+    size_t frameOctetCount;
+    size_t lastFrameOctetCount;
+    size_t peakFrameOctetCount;
+} SwampAllocationProfiler;
+
+typedef struct SwampAllocationProfilerSite {
+    const struct SwampFunc* func;
+    uint32_t opcodePosition;
+    const char* source;
+} SwampAllocationProfilerSite;
+
+void swampAllocationProfilerInit(SwampAllocationProfiler* self);
+void swampAllocationProfilerDestroy(SwampAllocationProfiler* self);
+void swampAllocationProfilerReset(SwampAllocationProfiler* self);
+
+void swampAllocationProfilerSetSite(SwampAllocationProfiler* self, const struct SwampFunc* func,
+                                    uint32_t opcodePosition, const char* source);
+void swampAllocationProfilerSaveSite(const SwampAllocationProfiler* self, SwampAllocationProfilerSite* site);
+void swampAllocationProfilerRestoreSite(SwampAllocationProfiler* self, const SwampAllocationProfilerSite* site);
+
+void swampAllocationProfilerAdd(SwampAllocationProfiler* self, size_t octetCount, const char* debugName);
+void swampAllocationProfilerEndFrame(SwampAllocationProfiler* self);
+
+void swampAllocationProfilerWriteReport(const SwampAllocationProfiler* self, const struct SwampDebugInfoFiles* files,
+                                        FILE* fp);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_ALLOCATION_PROFILER_H
@@ -0,0 +1,33 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_BINDING_REGISTRY_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_BINDING_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <swamp-runtime/core/bind.h>
+
+// Binding lists are added once (e.g. one per module, or the core registry plus the app bindings) and then built
+// into a perfect hash, so a lookup is two hashes and a single name compare no matter how many bindings there are.
+// Names that are added more than once resolve to the first one added.
+typedef struct SwampBindingRegistry {
+    const SwampBindingInfo** infos;
+    size_t infoCount;
+    size_t infoCapacity;
+    const SwampBindingInfo** slots; // null for empty slots
+    size_t slotCount;
+    uint32_t* displacements; // hash seed for each bucket, zero for empty buckets
+    size_t bucketCount;
+} SwampBindingRegistry;
+
+void swampBindingRegistryInit(SwampBindingRegistry* self);
+void swampBindingRegistryDestroy(SwampBindingRegistry* self);
+void swampBindingRegistryAdd(SwampBindingRegistry* self, const SwampBindingInfo* infos, size_t count);
+void swampBindingRegistryAddRegistry(SwampBindingRegistry* self, const SwampBindingRegistry* other);
+int swampBindingRegistryBuild(SwampBindingRegistry* self);
+const void* swampBindingRegistryFind(const SwampBindingRegistry* self, const char* fullyQualifiedName);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_BINDING_REGISTRY_H
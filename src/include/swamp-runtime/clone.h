@@ -5,11 +5,18 @@
 #ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_CLONE_H
 #define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_CLONE_H
 
+#include <swamp-runtime/compact.h>
+
 struct SwampDynamicMemory;
 struct SwampUnmanagedMemory;
 struct SwtiType;
 
-int swampClone(const void* state, const struct SwtiType* stateType, struct SwampDynamicMemory* targetMemory,
-               struct SwampUnmanagedMemory* targetUnmanagedMemory, struct SwampUnmanagedMemory* sourceUnmanagedMemory, void** clonedState);
+int swampClone(SwampCompactor* compactor, const void* state, const struct SwtiType* stateType,
+               struct SwampDynamicMemory* targetMemory, struct SwampUnmanagedMemory* targetUnmanagedMemory,
+               struct SwampUnmanagedMemory* sourceUnmanagedMemory, void** clonedState);
+int swampCloneWithStats(SwampCompactor* compactor, const void* state, const struct SwtiType* stateType,
+                        struct SwampDynamicMemory* targetMemory, struct SwampUnmanagedMemory* targetUnmanagedMemory,
+                        struct SwampUnmanagedMemory* sourceUnmanagedMemory, void** clonedState,
+                        SwampCompactStats* stats);
 
 #endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_CLONE_H
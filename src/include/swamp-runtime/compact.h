@@ -5,12 +5,70 @@
 #ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_COMPACT_H
 #define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_COMPACT_H
 
+#include <stddef.h>
+
+struct SwampCompactForwarding;
+struct SwampCopyPlanCache;
 struct SwampDynamicMemory;
 struct SwampUnmanagedMemory;
+struct SwampWorkerPool;
 struct SwtiType;
 
-int swampCompact(const void* state, const struct SwtiType* stateType, struct SwampDynamicMemory* targetMemory,
-                 struct SwampUnmanagedMemory* targetUnmanagedMemory,struct SwampUnmanagedMemory* sourceUnmanagedMemory, void** compactedState);
+// Objects are lists, arrays, strings, blobs and unmanaged. An object that is referenced more than once is only
+// copied the first time, the other references are shared. The table that keeps track of that is kept in the
+// compactor and reused between compactions.
+typedef struct SwampCompactStats {
+    size_t objectCount; // objects that were copied
+    size_t sharedReferenceCount; // references to an object that was already copied
+    size_t sharedOctetCount; // octets that the shared references would have been copied to
+    size_t keptReferenceCount; // references outside of the nursery, see swampCompactGenerational()
+} SwampCompactStats;
+
+// Owned by the caller, since a compactor can only be used by one compaction (or clone) at a time. Use one for each
+// machine or thread that compacts. An unmanaged clone function that clones must use a compactor of its own.
+typedef struct SwampCompactor {
+    struct SwampCopyPlanCache* copyPlans; // usually SwampUnpack::copyPlans, must outlive the compactor
+    struct SwampCompactForwarding* forwarding;
+    struct SwampCompactParts* parts; // only used by swampCompactParallel(), memory of the parts is kept between calls
+    int isCompacting;
+} SwampCompactor;
+
+void swampCompactorInit(SwampCompactor* self, struct SwampCopyPlanCache* copyPlans);
+void swampCompactorDestroy(SwampCompactor* self);
+
+int swampCompact(SwampCompactor* compactor, const void* state, const struct SwtiType* stateType,
+                 struct SwampDynamicMemory* targetMemory, struct SwampUnmanagedMemory* targetUnmanagedMemory,
+                 struct SwampUnmanagedMemory* sourceUnmanagedMemory, void** compactedState);
+int swampCompactWithStats(SwampCompactor* compactor, const void* state, const struct SwtiType* stateType,
+                          struct SwampDynamicMemory* targetMemory, struct SwampUnmanagedMemory* targetUnmanagedMemory,
+                          struct SwampUnmanagedMemory* sourceUnmanagedMemory, void** compactedState,
+                          SwampCompactStats* stats);
+
+// Only the objects in the nursery (usually everything allocated this frame) are moved to the old generation. The
+// state can only reference older objects from there, so everything outside of the nursery is kept as it is,
+// including unmanaged that must be owned by the caller. The old generation is only appended to, and the objects
+// that are no longer referenced are left behind. To get rid of them, now and then compact the state to a reset memory
+// with the old generation as the nursery.
+int swampCompactGenerational(SwampCompactor* compactor, const void* state, const struct SwtiType* stateType,
+                             const struct SwampDynamicMemory* nursery, struct SwampDynamicMemory* oldGeneration,
+                             void** compactedState, SwampCompactStats* stats);
+
+// Top-level lists and arrays with at least this many items are split into several parts by swampCompactParallel()
+#if !defined SWAMP_COMPACT_PARALLEL_MINIMUM_ITEM_COUNT
+#define SWAMP_COMPACT_PARALLEL_MINIMUM_ITEM_COUNT (1024)
+#endif
+
+// Same as swampCompactWithStats(), but the top-level references of the state, and the items of large top-level
+// lists, are split into parts that are compacted on all threads of the pool. Each part is compacted into memory of
+// its own, which is then copied after the state, in the same order every time.
+// Objects are only shared within a part. An object that is referenced from more than one part is copied once for each
+// of them, so the compacted state can be larger than with swampCompactWithStats(), and the copies are no longer the
+// same object. Only use it for states where that does not matter, and measure that it is faster on the target hardware.
+// Without worker threads, it is the same as swampCompactWithStats().
+int swampCompactParallel(SwampCompactor* compactor, const void* state, const struct SwtiType* stateType,
+                         struct SwampDynamicMemory* targetMemory, struct SwampUnmanagedMemory* targetUnmanagedMemory,
+                         struct SwampUnmanagedMemory* sourceUnmanagedMemory, struct SwampWorkerPool* pool,
+                         void** compactedState, SwampCompactStats* stats);
 
 
 #endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_COMPACT_H
@@ -13,11 +13,15 @@
 struct SwtiChunk;
 struct SwampFunc;
 struct SwampDebugInfoFiles;
+struct SwampDecodedProgram;
+struct SwampInstruction;
+struct SwampWorkerPool;
 
 typedef struct SwampCallStackEntry {
     const uint8_t* pc;
     const uint8_t* basePointer;
     const struct SwampFunc* func;
+    const struct SwampInstruction* instruction; // only used when running pre-decoded instructions
     MonotonicTimeNanoseconds debugBeforeTimeNs;
 } SwampCallStackEntry;
 
@@ -46,6 +50,27 @@ void swampUnmanagedMemoryDestroy(SwampUnmanagedMemory* self);
 int swampUnmanagedMemoryOwns(const SwampUnmanagedMemory* self, const struct SwampUnmanaged* unmanaged);
 void swampUnmanagedMemoryMove(SwampUnmanagedMemory* target, SwampUnmanagedMemory* source, const struct SwampUnmanaged* unmanaged);
 
+// Stack and call stack memory for one nesting level of temp contexts
+typedef struct SwampMachineContextPoolEntry {
+    uint8_t* stackMemory;
+    SwampCallStackEntry* callStackEntries;
+} SwampMachineContextPoolEntry;
+
+// Temp contexts are always destroyed in the reverse order they are created, so each nesting depth reuses the
+// same entry and creating a temp context only allocates memory the first time a depth is reached.
+typedef struct SwampMachineContextPool {
+    SwampMachineContextPoolEntry* entries;
+    size_t entryCount;
+    size_t entryCapacity;
+    size_t depth;
+    size_t maxDepth; // high water mark of nested temp contexts
+    size_t createCount;
+} SwampMachineContextPool;
+
+void swampMachineContextPoolInit(SwampMachineContextPool* self);
+void swampMachineContextPoolDestroy(SwampMachineContextPool* self);
+void swampMachineContextPoolDebugOutput(const SwampMachineContextPool* self);
+
 typedef struct SwampMachineContext {
     SwampStackMemory stackMemory;
     uint8_t* bp;
@@ -61,6 +86,11 @@ typedef struct SwampMachineContext {
     const struct SwampMachineContext* parent;
     const char* debugString;
     SwampUnmanagedMemory* unmanagedMemory;
+    const struct SwampDecodedProgram* decodedProgram;
+    SwampMachineContextPool* tempPool; // shared by the context and all temp contexts created from it
+    struct SwampWorkerPool* workerPool; // optional, lets List.map and friends run on several threads
+    const struct SwampFunctionExternal* externalFunction; // set for each external call, used by the typed thunks
+    struct SwampProfiler* profiler; // optional, see profiler.h
     int hackIsPredicting;
 } SwampMachineContext;
 
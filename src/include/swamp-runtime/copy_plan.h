@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_COPY_PLAN_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_COPY_PLAN_H
+
+#include <stddef.h>
+
+struct SwtiType;
+struct SwampCopyPlan;
+
+typedef enum SwampCopyStepType {
+    SwampCopyStepList,
+    SwampCopyStepArray,
+    SwampCopyStepString,
+    SwampCopyStepBlob,
+    SwampCopyStepUnmanaged,
+    SwampCopyStepCustom,
+    SwampCopyStepFunction,
+    SwampCopyStepUnsupported
+} SwampCopyStepType;
+
+typedef struct SwampCopyStep {
+    SwampCopyStepType type;
+    size_t offset; // from the start of the value
+    const struct SwampCopyPlan* itemPlan; // list and array items
+    struct SwampCopyPlan* variantPlans; // custom types, one plan for each variant
+    size_t variantCount;
+} SwampCopyStep;
+
+// How to copy a value of a type: the value is copied as a whole, then the steps fix up every pointer in it.
+// Records, tuples and aliases are flattened into the offsets, so scalars of any kind and count are covered by
+// that single copy and need no steps at all.
+typedef struct SwampCopyPlan {
+    const struct SwtiType* type;
+    SwampCopyStep* steps;
+    size_t stepCount;
+    size_t stepCapacity;
+    int containsReferences; // zero if a list or array of the type can be copied with a single memcpy
+} SwampCopyPlan;
+
+// Plans are compiled the first time a type is asked for and then cached, keyed on the type pointer. The cache must be
+// destroyed together with the types, so SwampUnpack owns one for its type information. Compiling a plan changes the
+// cache, so two threads can only use the same cache for types that have already been found once.
+typedef struct SwampCopyPlanCache {
+    SwampCopyPlan** plans; // open addressing on the type pointer, null for empty slots
+    size_t planCount;
+    size_t planCapacity;
+} SwampCopyPlanCache;
+
+void swampCopyPlanCacheInit(SwampCopyPlanCache* self);
+void swampCopyPlanCacheDestroy(SwampCopyPlanCache* self);
+const SwampCopyPlan* swampCopyPlanFind(SwampCopyPlanCache* self, const struct SwtiType* type);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_COPY_PLAN_H
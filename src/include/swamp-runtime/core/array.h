@@ -8,5 +8,6 @@
 #include <swamp-runtime/swamp.h>
 
 const void* swampCoreArrayFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreArrayBindings(size_t* outCount);
 
 #endif
@@ -12,6 +12,10 @@ typedef struct SwampBindingInfo {
     const void* fn;
 } SwampBindingInfo;
 
+struct SwampBindingRegistry;
+
+const void* swampBindingInfoFind(const SwampBindingInfo* infos, size_t count, const char* fullyQualifiedName);
+const struct SwampBindingRegistry* swampCoreBindingRegistry(void);
 const void* swampCoreFindFunction(const char* function_name);
 
 #endif
@@ -12,5 +12,6 @@
 struct SwampMachineContext;
 
 const void* swampCoreBlobFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreBlobBindings(size_t* outCount);
 
 #endif
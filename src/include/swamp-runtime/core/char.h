@@ -8,5 +8,6 @@
 #include <swamp-runtime/swamp.h>
 
 const void* swampCoreCharFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreCharBindings(size_t* outCount);
 
 #endif
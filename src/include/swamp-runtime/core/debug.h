@@ -11,5 +11,6 @@
 void swampCoreDebugLog(const SwampString** result, SwampMachineContext* context, const SwampInt32* typeIndex, const void* value);
 void swampCoreDebugToString(const SwampString** result, SwampMachineContext* context, const SwampInt32* typeIndex, const void* value);
 const void* swampCoreDebugFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreDebugBindings(size_t* outCount);
 
 #endif
@@ -8,5 +8,6 @@
 #include <swamp-runtime/swamp.h>
 
 const void* swampCoreIntFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreIntBindings(size_t* outCount);
 
 #endif
@@ -10,6 +10,7 @@
 struct SwampMachineContext;
 
 const void* swampCoreListFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreListBindings(size_t* outCount);
 
 void swampCoreListHead(SwampMaybe* result, struct SwampMachineContext* context, const SwampList** list);
 
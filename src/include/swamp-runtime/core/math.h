@@ -11,5 +11,6 @@ struct SwampMachineContext;
 
 void swampCoreMathRemainderBy(SwampInt32* result, struct SwampMachineContext* context, const SwampInt32* divider, const SwampInt32* value);
 const void* swampCoreMathFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreMathBindings(size_t* outCount);
 
 #endif
@@ -14,6 +14,7 @@ struct SwampFunction;
 struct SwtiFunctionType;
 
 const void* swampCoreMaybeFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreMaybeBindings(size_t* outCount);
 const struct SwtiType* swampCoreMaybeReturnType(const struct SwtiChunk* typeInfo, const struct SwampFunction* fn);
 
 const struct SwtiFunctionType* swampCoreGetFunctionType(const struct SwtiChunk* typeInfo, const struct SwampFunction* fn);
@@ -8,5 +8,6 @@
 #include <swamp-runtime/swamp.h>
 
 const void* swampCoreStringFindFunction(const char* fullyQualifiedName);
+const struct SwampBindingInfo* swampCoreStringBindings(size_t* outCount);
 
 #endif
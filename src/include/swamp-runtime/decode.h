@@ -0,0 +1,65 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_DECODE_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SwampFunc;
+struct SwampLedger;
+struct SwampStaticMemory;
+struct SwampString;
+
+typedef struct SwampInstructionCase {
+    int32_t value;
+    const struct SwampInstruction* target;
+} SwampInstructionCase;
+
+// Open addressing hash table entry for string patterns, string is null for empty entries
+typedef struct SwampInstructionStringCase {
+    uint32_t hash;
+    const struct SwampString* string;
+    const struct SwampInstruction* target;
+} SwampInstructionStringCase;
+
+// Pre-decoded, fixed width version of an opcode. Stack positions are kept relative to the base pointer, jumps
+// are absolute.
+typedef struct SwampInstruction {
+    const void* handler; // label address when direct threaded dispatch is used
+    const struct SwampInstruction* jump;
+    const void* data; // static memory pointer, case table or variable length operands, depending on opcode
+    uint32_t operands[5];
+    uint16_t opcode;
+    uint16_t instructionCount; // number of decoded instructions it executes, more than one for fused instructions
+    uint32_t opcodePosition; // octet position in SwampFunc::opcodes, for debug info lookups
+} SwampInstruction;
+
+typedef struct SwampDecodedFunc {
+    const struct SwampFunc* func;
+    const SwampInstruction* instructions;
+    size_t instructionCount;
+} SwampDecodedFunc;
+
+typedef struct SwampDecodedProgram {
+    SwampDecodedFunc* funcs;
+    size_t funcCount;
+    const SwampDecodedFunc** lookup;
+    size_t lookupCapacity;
+    SwampInstruction* instructions;
+    size_t instructionCount;
+    uint8_t* data;
+    size_t dataSize;
+} SwampDecodedProgram;
+
+int swampDecodedProgramInit(SwampDecodedProgram* self, const struct SwampLedger* ledger,
+                            const struct SwampStaticMemory* constantStaticMemory);
+void swampDecodedProgramDestroy(SwampDecodedProgram* self);
+const SwampDecodedFunc* swampDecodedProgramFind(const SwampDecodedProgram* self, const struct SwampFunc* func);
+
+// Implemented in swamp.c, returns the label that executes the opcode (direct threaded dispatch only)
+const void* swampRunInstructionHandler(uint16_t opcode);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_DECODE_H
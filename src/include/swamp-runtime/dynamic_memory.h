@@ -9,6 +9,8 @@
 #include <stdint.h>
 
 struct ImprintAllocator;
+struct SwampString;
+struct SwampAllocationProfiler;
 
 typedef struct SwampDynamicMemoryLedgerEntry {
     const char* debugName;
@@ -17,6 +19,22 @@ typedef struct SwampDynamicMemoryLedgerEntry {
     size_t itemAlign;
 } SwampDynamicMemoryLedgerEntry;
 
+typedef struct SwampDynamicMemoryBlock {
+    uint8_t* memory;
+    size_t octetSize;
+} SwampDynamicMemoryBlock;
+
+typedef struct SwampDynamicMemoryStats {
+    size_t allocatedSize;
+    size_t peakAllocatedSize;
+    size_t blockCount;
+    size_t blocksInUseCount;
+    size_t blocksOctetSize;
+    size_t growCount;
+} SwampDynamicMemoryStats;
+
+// memory, maxAllocatedSize and p always refer to the current block, so allocating is the same bump allocation
+// for fixed and growable dynamic memory.
 typedef struct SwampDynamicMemory {
     uint8_t* memory;
     size_t maxAllocatedSize;
@@ -25,9 +43,29 @@ typedef struct SwampDynamicMemory {
     size_t ledgerCount;
     size_t ledgerCapacity;
     size_t ownAlloc;
+    SwampDynamicMemoryBlock* blocks; // only used for growable dynamic memory
+    size_t blockCount;
+    size_t blockCapacity;
+    size_t blockIndex;
+    size_t blockOctetSize;
+    size_t previousBlocksAllocatedSize;
+    size_t peakAllocatedSize; // only updated on reset and when moving to a new block
+    size_t growCount;
+    uint8_t* conjFront; // first item of the most recent list conj, see swampAllocateListConj()
+    uint8_t* conjBufferStart;
+    char* stringAppendEnd; // terminating zero of the most recent string append, see swampAllocateStringAppend()
+    char* stringAppendBufferEnd;
+    const struct SwampString** unterminatedStrings; // open addressing, strings whose terminating zero was overwritten
+    size_t unterminatedStringCount;
+    size_t unterminatedStringCapacity;
+    struct SwampAllocationProfiler* allocationProfiler; // optional, see allocation_profiler.h
 } SwampDynamicMemory;
 
 void swampDynamicMemoryInit(SwampDynamicMemory* self, void* memory, size_t maxOctetSize);
+void swampDynamicMemoryInitSlice(SwampDynamicMemory* self, void* memory, size_t maxOctetSize);
+void swampDynamicMemoryInitGrowable(SwampDynamicMemory* self, void* memory, size_t maxOctetSize, size_t blockOctetSize);
+void swampDynamicMemoryInitGrowableSlice(SwampDynamicMemory* self, void* memory, size_t maxOctetSize,
+                                         size_t blockOctetSize);
 void swampDynamicMemoryInitOwnAlloc(SwampDynamicMemory* self, struct ImprintAllocator* allocator, size_t maxOctetSize);
 void swampDynamicMemoryDestroy(SwampDynamicMemory* self);
 void swampDynamicMemoryDebugOutput(const SwampDynamicMemory* self);
@@ -37,5 +75,8 @@ void* swampDynamicMemoryAlloc(SwampDynamicMemory* self, size_t itemCount, size_t
 void* swampDynamicMemoryAllocDebug(SwampDynamicMemory* self, size_t itemCount, size_t itemSize, size_t align,
                                    const char* debug);
 size_t swampDynamicMemoryAllocatedSize(const SwampDynamicMemory* self);
+int swampDynamicMemoryOwns(const SwampDynamicMemory* self, const void* pointer);
+int swampDynamicMemoryReserve(SwampDynamicMemory* self, size_t octetCount);
+void swampDynamicMemoryGetStats(const SwampDynamicMemory* self, SwampDynamicMemoryStats* stats);
 
 #endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_DYNAMIC_MEMORY_H
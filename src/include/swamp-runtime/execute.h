@@ -7,7 +7,39 @@
 
 #include <swamp-runtime/types.h>
 
+struct SwampMachineContext;
+struct SwampDecodedFunc;
+
 int swampGetFunc(const SwampFunction* func, const SwampFunc** outFn);
 SwampMemoryPosition swampExecutePrepare(const SwampFunction* func, const void* bp, const SwampFunc** outFn);
 
+#define SWAMP_PREPARED_CALL_MAX_ARGUMENT_COUNT (4)
+
+// The arguments that are not curried
+typedef struct SwampPreparedCallArgument {
+    size_t octetSize;
+    size_t align;
+} SwampPreparedCallArgument;
+
+// A function that is resolved and validated once, and then invoked for many arguments (e.g. every item in List.map).
+// Arguments are written to context->bp + argumentPositions[i] and the return value is read from context->bp.
+typedef struct SwampPreparedCall {
+    struct SwampMachineContext* context;
+    const SwampFunc* func;
+    const struct SwampDecodedFunc* decodedFunc;
+    const uint8_t* curryOctets;
+    size_t curryOctetSize;
+    SwampMemoryPosition curryPosition;
+    SwampMemoryPosition argumentsPosition; // first position after the return value and the curried parameters
+    SwampMemoryPosition argumentPositions[SWAMP_PREPARED_CALL_MAX_ARGUMENT_COUNT];
+    size_t argumentCount;
+    SwampResult result;
+} SwampPreparedCall;
+
+int swampPreparedCallInit(SwampPreparedCall* self, struct SwampMachineContext* context, const SwampFunction* fn,
+                          const SwampPreparedCallArgument* arguments, size_t argumentCount);
+int swampPreparedCallInvoke(SwampPreparedCall* self);
+int swampPreparedCallInvokeMany(SwampPreparedCall* self, const uint8_t* items, size_t itemCount, size_t itemSize,
+                                uint8_t* results, size_t resultStride);
+
 #endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_EXECUTE_H
@@ -0,0 +1,21 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_EXTERNAL_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_EXTERNAL_H
+
+#include <swamp-runtime/types.h>
+
+// All external functions are called through SwampFunctionExternal::call. Functions with the uniform
+// SwampExternalFunctionArguments signature are called directly. Typed functions (SwampExternalFunction0 to
+// SwampExternalFunction5) are called through a thunk for their parameter count, that reads the typed function from
+// context->externalFunction.
+void swampFunctionExternalBindArguments(SwampFunctionExternal* self, SwampExternalFunctionArguments function);
+int swampFunctionExternalBindTyped(SwampFunctionExternal* self, SwampExternalFunction typedFunction);
+
+// Tries bindArgumentsFn first (if set), then bindFn
+int swampFunctionExternalBind(SwampFunctionExternal* self, SwampResolveExternalFunction bindFn,
+                              SwampResolveExternalFunctionArguments bindArgumentsFn);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_EXTERNAL_H
@@ -30,5 +30,10 @@ typedef struct SwampConstantLedgerEntry {
 #define LedgerTypeDebugInfoFiles (6)
 
 const struct SwampFunc* swampFixupLedger(const uint8_t* const dynamicMemoryOctets, SwampResolveExternalFunction fn, const struct SwampConstantLedgerEntry* entries);
+// Same as swampFixupLedger(), but external functions are first looked up with bindArgumentsFn, see external.h
+const struct SwampFunc* swampFixupLedgerWithArguments(const uint8_t* const dynamicMemoryOctets,
+                                                      SwampResolveExternalFunction fn,
+                                                      SwampResolveExternalFunctionArguments bindArgumentsFn,
+                                                      const struct SwampConstantLedgerEntry* entries);
 
 #endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_FIXUP_H
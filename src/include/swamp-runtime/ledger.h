@@ -12,15 +12,50 @@ struct SwampConstantLedgerEntry;
 struct SwampFunc;
 struct SwampResourceNameChunkEntry;
 struct SwampDebugInfoFiles;
+struct SwampStaticRelocation;
+
+// Ledger types go from 1 to LedgerTypeDebugInfoFiles, see fixup.h
+#define SWAMP_LEDGER_TYPE_COUNT (7)
+
+// Open addressing hash table entry for function names, func is null for empty entries
+typedef struct SwampLedgerNameEntry {
+    uint32_t hash;
+    const struct SwampFunc* func;
+} SwampLedgerNameEntry;
+
+// Functions with the same type index are stored after each other in SwampLedgerIndex::funcsByTypeIndex
+typedef struct SwampLedgerTypeIndexEntry {
+    uint16_t typeIndex;
+    size_t first;
+    size_t count; // zero for empty entries
+} SwampLedgerTypeIndexEntry;
+
+typedef struct SwampLedgerIndex {
+    SwampLedgerNameEntry* names;
+    size_t nameCapacity;
+    SwampLedgerTypeIndexEntry* typeIndices;
+    size_t typeIndexCapacity;
+    const struct SwampFunc** funcsByTypeIndex;
+    size_t funcCount;
+    const void* firstOfType[SWAMP_LEDGER_TYPE_COUNT];
+} SwampLedgerIndex;
 
 typedef struct SwampLedger {
     const uint8_t* ledgerOctets;
     size_t ledgerSize;
     const uint8_t* constantStaticMemory;
+    const struct SwampStaticRelocation* relocation; // only set for position independent static memory
+    SwampLedgerIndex* index; // built by swampLedgerBuildIndex(), lookups walk the ledger until then
 } SwampLedger;
 
 void swampLedgerInit(SwampLedger* self, const uint8_t* ledgerOctets, size_t ledgerSize, const uint8_t* constantStaticMemory);
+void swampLedgerBuildIndex(SwampLedger* self);
+void swampLedgerDestroyIndex(SwampLedger* self);
+const void* swampLedgerEntryPointer(const SwampLedger* self, const struct SwampConstantLedgerEntry* entry);
 const struct SwampFunc* swampLedgerFindFunction(const SwampLedger* self, const char* name);
+const struct SwampFunc* const* swampLedgerFindFunctionsWithTypeIndex(const SwampLedger* self, uint16_t typeIndex,
+                                                                     size_t* outCount);
+const void* swampLedgerFindFirstOfType(const SwampLedger* self, uint32_t constantType);
 const struct SwampDebugInfoFiles* swampLedgerGetDebugInfoFiles(const SwampLedger* self);
 const struct SwampResourceNameChunkEntry* swampLedgerFindResourceNames(const SwampLedger* self);
 
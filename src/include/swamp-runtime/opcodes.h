@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 
+const char* swampOpcodeName(uint8_t opcode);
+
 // -------------------------------------------------------------
 // Opcodes
 // -------------------------------------------------------------
@@ -73,5 +75,27 @@
 #define SwampOpcodeBooleanEqual 0x32
 #define SwampOpcodeBooleanNotEqual 0x33
 // -------------------------------------------------------------
+// Only used in decoded instructions and never in packs. Superinstructions and lowered case lookups
+// -------------------------------------------------------------
+#define SwampOpcodeFusedIntEqualBranchFalse 0x80
+#define SwampOpcodeFusedIntNotEqualBranchFalse 0x81
+#define SwampOpcodeFusedIntLessBranchFalse 0x82
+#define SwampOpcodeFusedIntLessEqualBranchFalse 0x83
+#define SwampOpcodeFusedIntGreaterBranchFalse 0x84
+#define SwampOpcodeFusedIntGreaterOrEqualBranchFalse 0x85
+#define SwampOpcodeFusedIntEqualBranchTrue 0x86
+#define SwampOpcodeFusedIntNotEqualBranchTrue 0x87
+#define SwampOpcodeFusedIntLessBranchTrue 0x88
+#define SwampOpcodeFusedIntLessEqualBranchTrue 0x89
+#define SwampOpcodeFusedIntGreaterBranchTrue 0x8a
+#define SwampOpcodeFusedIntGreaterOrEqualBranchTrue 0x8b
+#define SwampOpcodeFusedIntAddImmediate 0x8c
+#define SwampOpcodeFusedIntSubImmediate 0x8d
+#define SwampOpcodeFusedMemCopyMulti 0x8e
+// -------------------------------------------------------------
+#define SwampOpcodeDecodedEnumCaseTable 0x90
+#define SwampOpcodeDecodedPatternMatchingIntTable 0x91
+#define SwampOpcodeDecodedPatternMatchingIntSorted 0x92
+// -------------------------------------------------------------
 
 #endif
@@ -0,0 +1,71 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_PARALLEL_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_PARALLEL_H
+
+#include <swamp-runtime/context.h>
+
+#if !defined SWAMP_PARALLEL_USE_PTHREADS
+#if defined TORNADO_OS_WINDOWS
+#define SWAMP_PARALLEL_USE_PTHREADS (0)
+#else
+#define SWAMP_PARALLEL_USE_PTHREADS (1)
+#endif
+#endif
+
+#if SWAMP_PARALLEL_USE_PTHREADS
+#include <pthread.h>
+#endif
+
+#define SWAMP_WORKER_POOL_MAX_THREAD_COUNT (15)
+// Collections with fewer items than this are always mapped on the calling thread
+#define SWAMP_WORKER_POOL_MINIMUM_ITEM_COUNT (2048)
+// Dynamic memory each task can allocate during a parallel run. A task that needs more moves on to blocks of its own,
+// and the whole range is then run again on the calling thread, see swampParallelFor().
+#define SWAMP_WORKER_POOL_SLICE_OCTET_SIZE (256 * 1024)
+
+// Memory owned by one task, reused between parallel runs
+typedef struct SwampWorkerSlot {
+    SwampMachineContextPool tempPool;
+    SwampDynamicMemory dynamicMemory; // slice of the dynamic memory of the calling context
+    SwampUnmanagedMemory unmanagedMemory;
+    uint8_t* tempResult;
+    size_t tempResultSize;
+} SwampWorkerSlot;
+
+typedef void (*SwampWorkerPoolTask)(void* userData, size_t taskIndex);
+
+// Worker threads plus the calling thread, which always runs tasks as well. Set it as the workerPool of a root
+// context to let List.map and friends run on all threads.
+typedef struct SwampWorkerPool {
+#if SWAMP_PARALLEL_USE_PTHREADS
+    pthread_t threads[SWAMP_WORKER_POOL_MAX_THREAD_COUNT];
+    pthread_mutex_t mutex;
+    pthread_cond_t workAvailable;
+    pthread_cond_t workDone;
+#endif
+    size_t threadCount;
+    SwampWorkerPoolTask task;
+    void* taskUserData;
+    size_t taskCount;
+    size_t nextTaskIndex;
+    size_t completedTaskCount;
+    size_t generation;
+    int quit;
+    SwampWorkerSlot slots[SWAMP_WORKER_POOL_MAX_THREAD_COUNT + 1];
+    size_t minimumItemCount;
+    size_t sliceOctetSize;
+    size_t serialRerunCount; // parallel runs where a task did not fit in its slice
+} SwampWorkerPool;
+
+int swampWorkerPoolInit(SwampWorkerPool* self, size_t threadCount);
+void swampWorkerPoolDestroy(SwampWorkerPool* self);
+void swampWorkerPoolRun(SwampWorkerPool* self, SwampWorkerPoolTask task, void* userData, size_t taskCount);
+
+typedef void (*SwampParallelRange)(SwampMachineContext* context, size_t startIndex, size_t endIndex, void* userData);
+
+void swampParallelFor(SwampMachineContext* context, size_t count, SwampParallelRange range, void* userData);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_PARALLEL_H
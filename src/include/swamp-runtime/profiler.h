@@ -0,0 +1,85 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_PROFILER_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_PROFILER_H
+
+#include <monotonic-time/monotonic_time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct SwampMachineContext;
+struct SwampFunc;
+struct SwampDebugInfoLinesEntry;
+struct SwampDebugInfoFiles;
+
+#define SWAMP_PROFILER_DEFAULT_SAMPLE_INTERVAL (1024)
+#define SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT (32)
+#define SWAMP_PROFILER_MAX_RUN_DEPTH (32)
+
+typedef struct SwampProfilerFunction {
+    const void* function; // SwampFunc or SwampFunctionExternal
+    uint64_t callCount;
+    MonotonicTimeNanoseconds inclusiveTimeNs;
+    MonotonicTimeNanoseconds exclusiveTimeNs;
+    size_t lastSampleIndex; // so recursive functions only get inclusive time once per sample
+} SwampProfilerFunction;
+
+// A node in the tree of sampled call stacks. Node zero is the root.
+typedef struct SwampProfilerNode {
+    const struct SwampFunc* func;
+    const struct SwampDebugInfoLinesEntry* line;
+    size_t parent;
+    size_t firstChild;
+    size_t nextSibling;
+    size_t depth;
+    MonotonicTimeNanoseconds selfTimeNs;
+    size_t sampleCount;
+} SwampProfilerNode;
+
+// Sampling profiler for swampRun(). Set SwampMachineContext::profiler to enable it, and back to zero to disable it.
+// Every executed opcode is counted. Every sampleInterval opcodes the call stacks of all running contexts (nested
+// swampRun() calls from external functions) are sampled, and the time since the previous sample is given to the sampled stack. The function times are
+// estimates from the samples. The time spent in external functions is given to the calling function.
+// Only for contexts that run on a single thread, worker contexts are never profiled.
+typedef struct SwampProfiler {
+    size_t sampleInterval;
+    size_t countdown;
+    size_t runDepth;
+    const struct SwampMachineContext* runContexts[SWAMP_PROFILER_MAX_RUN_DEPTH];
+    size_t sampleCount;
+    MonotonicTimeNanoseconds lastSampleTimeNs;
+    MonotonicTimeNanoseconds sampledTimeNs;
+    uint64_t opcodeCounts[256];
+
+    SwampProfilerFunction* functions;
+    size_t functionCount;
+    size_t functionCapacity;
+
+    SwampProfilerNode* nodes;
+    size_t nodeCount;
+    size_t nodeCapacity;
+    size_t maxNodeDepth;
+} SwampProfiler;
+
+void swampProfilerInit(SwampProfiler* self, size_t sampleInterval);
+void swampProfilerDestroy(SwampProfiler* self);
+void swampProfilerReset(SwampProfiler* self);
+
+void swampProfilerRunBegin(SwampProfiler* self, const struct SwampMachineContext* context, const struct SwampFunc* func);
+void swampProfilerRunEnd(SwampProfiler* self);
+void swampProfilerCall(SwampProfiler* self, const void* function);
+void swampProfilerSample(SwampProfiler* self, const struct SwampMachineContext* context, uint32_t opcodePosition);
+
+const SwampProfilerFunction* swampProfilerFindFunction(const SwampProfiler* self, const void* function);
+void swampProfilerCallCountHistogram(const SwampProfiler* self,
+                                     size_t histogram[SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT]);
+
+int swampProfilerWriteCollapsed(const SwampProfiler* self, const struct SwampDebugInfoFiles* files, FILE* fp);
+int swampProfilerWriteCollapsedFilename(const SwampProfiler* self, const struct SwampDebugInfoFiles* files,
+                                        const char* filename);
+void swampProfilerWriteReport(const SwampProfiler* self, FILE* fp);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_PROFILER_H
@@ -0,0 +1,41 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_RELOCATION_H
+#define SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_RELOCATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <swamp-runtime/types.h>
+
+struct SwampConstantLedgerEntry;
+struct SwampFunc;
+
+typedef struct SwampStaticRelocationEntry {
+    uint32_t offset;
+    const void* resolved;
+} SwampStaticRelocationEntry;
+
+// Position independent alternative to swampFixupLedger(). The static memory is never written to, so it can be
+// shared read-only between processes. Instead, each ledger constant that holds pointers is copied once into
+// resolvedOctets with its offsets turned into absolute pointers. Everything else (opcodes, characters, debug
+// lines) is used directly from the static memory.
+typedef struct SwampStaticRelocation {
+    const uint8_t* staticMemory;
+    SwampStaticRelocationEntry* entries; // sorted on offset
+    size_t entryCount;
+    uint8_t* resolvedOctets;
+    size_t resolvedOctetCount;
+} SwampStaticRelocation;
+
+int swampStaticRelocationInit(SwampStaticRelocation* self, const uint8_t* staticMemory,
+                              SwampResolveExternalFunction bindFn,
+                              SwampResolveExternalFunctionArguments bindArgumentsFn,
+                              const struct SwampConstantLedgerEntry* entries,
+                              const struct SwampFunc** outEntryFunc);
+void swampStaticRelocationDestroy(SwampStaticRelocation* self);
+const void* swampStaticRelocationGet(const SwampStaticRelocation* self, uint32_t offset);
+
+#endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_RELOCATION_H
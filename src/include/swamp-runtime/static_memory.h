@@ -8,12 +8,17 @@
 #include <stdint.h>
 #include <stddef.h>
 
+struct SwampStaticRelocation;
+
 typedef struct SwampStaticMemory {
    uint8_t* memory;
    size_t maxAllocatedSize;
+   const struct SwampStaticRelocation* relocation; // only set for position independent static memory
 } SwampStaticMemory;
 
 void swampStaticMemoryInit(SwampStaticMemory* self, const void* memory, size_t maxOctetSize);
+void swampStaticMemoryInitRelocated(SwampStaticMemory* self, const void* memory, size_t maxOctetSize,
+                                    const struct SwampStaticRelocation* relocation);
 const void* swampStaticMemoryGet(const SwampStaticMemory* self, uint32_t position);
 
 #endif // SWAMP_RUNTIME_SRC_INCLUDE_SWAMP_RUNTIME_DYNAMIC_MEMORY_H
@@ -10,9 +10,14 @@
 #include <swamp-runtime/stack_memory.h>
 
 struct SwampMachineContext;
+struct SwampDecodedFunc;
 
 int swampRun(SwampResult* result, struct SwampMachineContext* context, const SwampFunc* f, SwampParameters run_parameters,
              SwampBool verbose_flag);
+// Same as swampRun, but skips the parameter and result validation. Use SwampPreparedCall instead of calling it directly.
+int swampRunPrepared(SwampResult* result, struct SwampMachineContext* context, const SwampFunc* f,
+                     const struct SwampDecodedFunc* decodedFunc);
+size_t swampRunExecutedOpcodeCount(void);
 
 
 #endif
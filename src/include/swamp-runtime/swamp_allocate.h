@@ -13,6 +13,9 @@
 
 const struct SwampString* swampStringAllocate( SwampDynamicMemory* self, const char* s);
 const SwampString* swampStringAllocateWithSize(SwampDynamicMemory* self, const char* s, size_t stringLength);
+const SwampString* swampAllocateStringAppend(SwampDynamicMemory* self, const SwampString* a, const SwampString* b);
+void swampStringTerminateAll(SwampDynamicMemory* self);
+void swampStringMoveUnterminated(SwampDynamicMemory* target, const SwampDynamicMemory* source);
 struct SwampFunc* swampFuncAllocate( SwampDynamicMemory* self, const uint8_t* opcodes, size_t opcodeCount,
                                     size_t parametersOctetSize, size_t returnOctetSize);
 struct SwampCurryFunc * swampCurryFuncAllocate( SwampDynamicMemory* self, uint16_t typeIdIndex, uint8_t firstAlign, const SwampFunc* sourceFunc, const void* parameters, size_t parametersOctetSize);
@@ -25,6 +28,8 @@ SwampArray* swampArrayAllocatePrepare(SwampDynamicMemory* self, size_t itemCount
 SwampList* swampListAllocatePrepare( SwampDynamicMemory* self, size_t itemCount, size_t itemSize, size_t itemAlign);
 const  SwampList* swampListAllocateNoCopy( SwampDynamicMemory* self, const void* itemMemory, size_t itemCount, size_t itemSize, size_t itemAlign);
 const  SwampList* swampAllocateListAppendNoCopy( SwampDynamicMemory* self, const SwampList* a, const SwampList* b);
+const SwampList* swampAllocateListConj(SwampDynamicMemory* self, const SwampList* list, const void* item,
+                                       size_t itemSize, size_t itemAlign);
 SwampBlob* swampBlobAllocate( SwampDynamicMemory* self, const uint8_t* octets, size_t octetCount);
 SwampBlob* swampBlobAllocatePrepare( SwampDynamicMemory* self, size_t octetCount);
 
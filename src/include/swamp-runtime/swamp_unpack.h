@@ -5,12 +5,23 @@
 #ifndef swamp_unpack_h
 #define swamp_unpack_h
 
+#include <swamp-runtime/copy_plan.h>
 #include <swamp-runtime/types.h>
 #include <swamp-typeinfo/chunk.h>
 #include <swamp-runtime/ledger.h>
+#include <swamp-runtime/relocation.h>
 
 struct SwampFunc;
 struct ImprintAllocator;
+struct SwampStaticMemory;
+
+#if !defined SWAMP_UNPACK_USE_MMAP
+#if defined TORNADO_OS_WINDOWS
+#define SWAMP_UNPACK_USE_MMAP (0)
+#else
+#define SWAMP_UNPACK_USE_MMAP (1)
+#endif
+#endif
 
 
 typedef struct SwampOctetStream {
@@ -27,17 +38,32 @@ typedef struct SwampUnpack {
     const uint8_t* constantStaticMemoryOctets;
     size_t constantStaticMemorySize;
     size_t constantStaticMemoryMaxSize;
+    int ownsConstantStaticMemory;
 
     SwampLedger ledger;
+    int ownsLedger;
 
-} SwampUnpack;
+    // Set before unpacking to leave the static memory untouched, see SwampStaticRelocation
+    int positionIndependent;
+    SwampStaticRelocation relocation;
 
-typedef const void* (*SwampResolveExternalFunction)(const char* fullyQualifiedName);
+    // Optionally set before unpacking, to bind external functions with the uniform ABI, see external.h
+    SwampResolveExternalFunctionArguments bindArgumentsFn;
+
+    // Private copy-on-write mapping of the pack file, see swampUnpackFilename()
+    uint8_t* mappedOctets;
+    size_t mappedOctetCount;
+
+    // How to compact and clone the types in typeInfoChunk, see SwampCompactor
+    SwampCopyPlanCache copyPlans;
+
+} SwampUnpack;
 
 void swampUnpackInit(SwampUnpack* self, int verboseFlag);
 void swampUnpackFree(SwampUnpack* self);
 int swampUnpackFilename(SwampUnpack* self, const char* packFilename, SwampResolveExternalFunction bindFn, int verboseFlag, struct  ImprintAllocator* allocator);
 int swampUnpackSwampOctetStream(SwampUnpack* self, SwampOctetStream* s, SwampResolveExternalFunction bindFn, int verboseFlag, struct ImprintAllocator* allocator);
 const struct SwampFunc* swampUnpackEntryPoint(SwampUnpack* self);
+void swampUnpackStaticMemoryInit(const SwampUnpack* self, struct SwampStaticMemory* staticMemory);
 
 #endif
@@ -91,12 +91,21 @@ typedef struct SwampResult {
 
 typedef uint8_t SwampMaybe;
 
+// characters can be shared with a longer string created by a string append, so use characterCount
+// rather than relying on a terminating zero. All strings are terminated before an external function is called,
+// see swampStringTerminateAll().
 typedef struct SwampString {
     const char* characters;
     size_t characterCount;
 } SwampString;
 
 int swampStringEqual(const SwampString* a, const SwampString* b);
+uint32_t swampStringHash(const SwampString* self);
+
+#define SWAMP_FNV1A_OFFSET_BASIS (2166136261u)
+
+// FNV-1a, continuing from hash. Start with SWAMP_FNV1A_OFFSET_BASIS.
+uint32_t swampHashFnv1a(uint32_t hash, const void* octets, size_t octetCount);
 
 typedef const SwampString* SwampStringReference;
 typedef const SwampString** SwampStringReferenceData;
@@ -194,6 +203,8 @@ typedef struct SwampCurryFunc {
 
 struct SwampMachineContext;
 
+// Any of SwampExternalFunction0 to SwampExternalFunction5, cast back to the one for the parameter count before calling
+typedef void (*SwampExternalFunction)(void);
 typedef void (*SwampExternalFunction0)(void* result, struct SwampMachineContext* context);
 typedef void (*SwampExternalFunction1)(void* result, struct SwampMachineContext* context, const void* argument1);
 typedef void (*SwampExternalFunction2)(void* result, struct SwampMachineContext* context, const void* argument1, const void* argument2);
@@ -203,25 +214,34 @@ typedef void (*SwampExternalFunction5)(void* result, struct SwampMachineContext*
                                        const void* argument2, const void* argument3, const void* argument4,
                                        const void* argument5);
 
+// The uniform external function ABI. The same signature for all arities, so the interpreter calls all external
+// functions with a single indirect call. arguments[i] points to argument i.
+typedef void (*SwampExternalFunctionArguments)(void* result, struct SwampMachineContext* context,
+                                               const void* const* arguments, size_t argumentCount);
+
+typedef const void* (*SwampResolveExternalFunction)(const char* fullyQualifiedName);
+typedef SwampExternalFunctionArguments (*SwampResolveExternalFunctionArguments)(const char* fullyQualifiedName);
 
+#define SWAMP_FUNCTION_EXTERNAL_MAX_PARAMETER_COUNT (8)
+#define SWAMP_FUNCTION_EXTERNAL_MAX_TYPED_PARAMETER_COUNT (5)
+#define SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT (32)
 
 typedef struct SwampFunctionExternalPosRange {
     uint32_t pos;
     uint32_t range;
 } SwampFunctionExternalPosRange;
 
+// The layout is written by the compiler. The function slots are only set when binding, see external.h
 typedef struct SwampFunctionExternal {
     SwampFunction func;
     size_t parameterCount;
     SwampFunctionExternalPosRange returnValue;
-    SwampFunctionExternalPosRange parameters[8];
-    SwampExternalFunction1 function1;
-    SwampExternalFunction2 function2;
-    SwampExternalFunction3 function3;
-    SwampExternalFunction4 function4;
+    SwampFunctionExternalPosRange parameters[SWAMP_FUNCTION_EXTERNAL_MAX_PARAMETER_COUNT];
+    SwampExternalFunctionArguments call; // always set, a thunk for typed functions
+    SwampExternalFunction typedFunction; // only used by the thunk
+    const void* reservedFunctions[2];
     const char* fullyQualifiedName;
-    SwampExternalFunction0 function0;
-    SwampExternalFunction5 function5;
+    const void* reservedFunctionsAfterName[2];
 } SwampFunctionExternal;
 
 struct SwampMachineContext;
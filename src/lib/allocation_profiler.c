@@ -0,0 +1,212 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <stdlib.h> // qsort
+#include <swamp-runtime/allocation_profiler.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+void swampAllocationProfilerInit(SwampAllocationProfiler* self)
+{
+    self->sites = 0;
+    self->siteCapacity = 0;
+    swampAllocationProfilerReset(self);
+}
+
+void swampAllocationProfilerDestroy(SwampAllocationProfiler* self)
+{
+    tc_free(self->sites);
+    self->sites = 0;
+    self->siteCapacity = 0;
+    self->siteCount = 0;
+}
+
+void swampAllocationProfilerReset(SwampAllocationProfiler* self)
+{
+    if (self->sites) {
+        tc_mem_clear(self->sites, sizeof(self->sites[0]) * self->siteCapacity);
+    }
+    self->siteCount = 0;
+    self->func = 0;
+    self->opcodePosition = 0;
+    self->source = 0;
+    self->frameIndex = 0;
+    self->frameOctetCount = 0;
+    self->lastFrameOctetCount = 0;
+    self->peakFrameOctetCount = 0;
+}
+
+void swampAllocationProfilerSetSite(SwampAllocationProfiler* self, const SwampFunc* func, uint32_t opcodePosition,
+                                    const char* source)
+{
+    self->func = func;
+    self->opcodePosition = opcodePosition;
+    self->source = source;
+}
+
+// Nested swampRun() calls change the site, so the external function that made the call is restored afterwards
+void swampAllocationProfilerSaveSite(const SwampAllocationProfiler* self, SwampAllocationProfilerSite* site)
+{
+    site->func = self->func;
+    site->opcodePosition = self->opcodePosition;
+    site->source = self->source;
+}
+
+void swampAllocationProfilerRestoreSite(SwampAllocationProfiler* self, const SwampAllocationProfilerSite* site)
+{
+    self->func = site->func;
+    self->opcodePosition = site->opcodePosition;
+    self->source = site->source;
+}
+
+static size_t swampAllocationProfilerSlot(const SwampAllocationSite* sites, size_t capacity, const SwampFunc* func,
+                                          uint32_t opcodePosition, const char* source)
+{
+    size_t mask = capacity - 1;
+    uintptr_t hash = ((uintptr_t) func >> 3) ^ ((uintptr_t) source >> 1) ^ ((uintptr_t) opcodePosition << 7);
+    size_t i = (hash * 2654435761u) & mask;
+    while (sites[i].source != 0 &&
+           !(sites[i].func == func && sites[i].opcodePosition == opcodePosition && sites[i].source == source)) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static void swampAllocationProfilerGrow(SwampAllocationProfiler* self)
+{
+    size_t capacity = self->siteCapacity == 0 ? 256 : self->siteCapacity * 2;
+    SwampAllocationSite* sites = tc_malloc_type_count(SwampAllocationSite, capacity);
+    tc_mem_clear(sites, sizeof(sites[0]) * capacity);
+    for (size_t i = 0; i < self->siteCapacity; ++i) {
+        const SwampAllocationSite* site = &self->sites[i];
+        if (site->source) {
+            sites[swampAllocationProfilerSlot(sites, capacity, site->func, site->opcodePosition, site->source)] =
+                *site;
+        }
+    }
+    tc_free(self->sites);
+    self->sites = sites;
+    self->siteCapacity = capacity;
+}
+
+// The debug name is used as source if given, so allocations from swampCompact() and friends can be told apart
+void swampAllocationProfilerAdd(SwampAllocationProfiler* self, size_t octetCount, const char* debugName)
+{
+    const char* source = debugName ? debugName : (self->source ? self->source : "unknown");
+
+    if ((self->siteCount + 1) * 2 > self->siteCapacity) {
+        swampAllocationProfilerGrow(self);
+    }
+
+    SwampAllocationSite* site = &self->sites[swampAllocationProfilerSlot(self->sites, self->siteCapacity, self->func,
+                                                                         self->opcodePosition, source)];
+    if (site->source == 0) {
+        site->func = self->func;
+        site->opcodePosition = self->opcodePosition;
+        site->source = source;
+        self->siteCount++;
+    }
+
+    site->frameOctetCount += octetCount;
+    site->frameCount++;
+    site->totalOctetCount += octetCount;
+    site->totalCount++;
+    self->frameOctetCount += octetCount;
+}
+
+void swampAllocationProfilerEndFrame(SwampAllocationProfiler* self)
+{
+    for (size_t i = 0; i < self->siteCapacity; ++i) {
+        SwampAllocationSite* site = &self->sites[i];
+        if (site->source == 0) {
+            continue;
+        }
+        site->lastFrameOctetCount = site->frameOctetCount;
+        site->lastFrameCount = site->frameCount;
+        if (site->frameOctetCount > site->peakFrameOctetCount) {
+            site->peakFrameOctetCount = site->frameOctetCount;
+        }
+        site->frameOctetCount = 0;
+        site->frameCount = 0;
+    }
+
+    self->lastFrameOctetCount = self->frameOctetCount;
+    if (self->frameOctetCount > self->peakFrameOctetCount) {
+        self->peakFrameOctetCount = self->frameOctetCount;
+    }
+    self->frameOctetCount = 0;
+    self->frameIndex++;
+}
+
+static int swampAllocationProfilerCompareLastFrame(const void* a, const void* b)
+{
+    const SwampAllocationSite* x = *(const SwampAllocationSite* const*) a;
+    const SwampAllocationSite* y = *(const SwampAllocationSite* const*) b;
+    if (x->lastFrameOctetCount != y->lastFrameOctetCount) {
+        return x->lastFrameOctetCount < y->lastFrameOctetCount ? 1 : -1;
+    }
+    if (x->peakFrameOctetCount != y->peakFrameOctetCount) {
+        return x->peakFrameOctetCount < y->peakFrameOctetCount ? 1 : -1;
+    }
+    return 0;
+}
+
+static void swampAllocationProfilerWriteLocation(const SwampAllocationSite* site, const SwampDebugInfoFiles* files,
+                                                 FILE* fp)
+{
+    if (site->func == 0) {
+        fprintf(fp, "%-48s", "(outside of swampRun)");
+        return;
+    }
+
+    const SwampDebugInfoLinesEntry* line = 0;
+    if (site->func->debugInfoLines) {
+        line = swampDebugInfoFindLinesDebugLines(site->func->debugInfoLines, (uint16_t) site->opcodePosition);
+    }
+
+    const char* filename = "";
+    if (line && files) {
+        swampDebugInfoFilesFindFile(files, line->sourceFileId, &filename);
+    }
+
+    char location[256];
+    if (line) {
+        tc_snprintf(location, 256, "%s (%s:%d)", site->func->debugName, filename ? filename : "",
+                    line->startLocation.line + 1);
+    } else {
+        tc_snprintf(location, 256, "%s (@%04X)", site->func->debugName, site->opcodePosition);
+    }
+    fprintf(fp, "%-48s", location);
+}
+
+// Sites sorted on the octets allocated in the last completed frame
+void swampAllocationProfilerWriteReport(const SwampAllocationProfiler* self, const SwampDebugInfoFiles* files,
+                                        FILE* fp)
+{
+    fprintf(fp, "frames: %zu last frame: %zu octets peak frame: %zu octets\n", self->frameIndex,
+            self->lastFrameOctetCount, self->peakFrameOctetCount);
+
+    const SwampAllocationSite** sorted = tc_malloc_type_count(const SwampAllocationSite*, self->siteCount + 1);
+    size_t count = 0;
+    for (size_t i = 0; i < self->siteCapacity; ++i) {
+        if (self->sites[i].source) {
+            sorted[count++] = &self->sites[i];
+        }
+    }
+    qsort(sorted, count, sizeof(sorted[0]), swampAllocationProfilerCompareLastFrame);
+
+    fprintf(fp, "%-48s %-24s %12s %8s %12s %14s %10s\n", "site", "source", "frame octets", "frame", "peak octets",
+            "total octets", "total");
+    for (size_t i = 0; i < count; ++i) {
+        const SwampAllocationSite* site = sorted[i];
+        swampAllocationProfilerWriteLocation(site, files, fp);
+        fprintf(fp, " %-24s %12zu %8zu %12zu %14zu %10zu\n", site->source, site->lastFrameOctetCount,
+                site->lastFrameCount, site->peakFrameOctetCount, site->totalOctetCount, site->totalCount);
+    }
+
+    tc_free(sorted);
+}
@@ -0,0 +1,206 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-runtime/binding_registry.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+// Give up on a bucket after this many seeds, it only happens if the hash is broken
+#define SWAMP_BINDING_REGISTRY_MAX_SEED (1u << 20)
+
+const void* swampBindingInfoFind(const SwampBindingInfo* infos, size_t count, const char* fullyQualifiedName)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (tc_str_equal(infos[i].name, fullyQualifiedName)) {
+            return infos[i].fn;
+        }
+    }
+
+    return 0;
+}
+
+// FNV-1a with a seed, followed by a finalizer so that the low bits can be used directly
+static uint32_t swampBindingRegistryHash(const char* name, uint32_t seed)
+{
+    uint32_t hash = swampHashFnv1a(SWAMP_FNV1A_OFFSET_BASIS ^ (seed * 0x9e3779b1u), name, tc_strlen(name));
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+
+    return hash;
+}
+
+static size_t swampBindingRegistryPowerOfTwo(size_t count)
+{
+    size_t capacity = 1;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+void swampBindingRegistryInit(SwampBindingRegistry* self)
+{
+    self->infos = 0;
+    self->infoCount = 0;
+    self->infoCapacity = 0;
+    self->slots = 0;
+    self->slotCount = 0;
+    self->displacements = 0;
+    self->bucketCount = 0;
+}
+
+void swampBindingRegistryDestroy(SwampBindingRegistry* self)
+{
+    tc_free(self->infos);
+    tc_free(self->slots);
+    tc_free(self->displacements);
+    swampBindingRegistryInit(self);
+}
+
+// The infos are referenced, not copied, so they must outlive the registry (usually they are static const arrays).
+// Call swampBindingRegistryBuild() after all infos are added.
+void swampBindingRegistryAdd(SwampBindingRegistry* self, const SwampBindingInfo* infos, size_t count)
+{
+    if (self->infoCount + count > self->infoCapacity) {
+        size_t capacity = self->infoCapacity == 0 ? 64 : self->infoCapacity;
+        while (capacity < self->infoCount + count) {
+            capacity *= 2;
+        }
+        self->infos = tc_realloc(self->infos, sizeof(self->infos[0]) * capacity);
+        self->infoCapacity = capacity;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        self->infos[self->infoCount++] = &infos[i];
+    }
+}
+
+// Adds all bindings of another registry, e.g. the core registry to an app registry
+void swampBindingRegistryAddRegistry(SwampBindingRegistry* self, const SwampBindingRegistry* other)
+{
+    for (size_t i = 0; i < other->infoCount; ++i) {
+        swampBindingRegistryAdd(self, other->infos[i], 1);
+    }
+}
+
+// Hash and displace: the names are first hashed into small buckets. Starting with the largest bucket, each
+// bucket then gets the first seed that puts all of its names into free slots.
+int swampBindingRegistryBuild(SwampBindingRegistry* self)
+{
+    tc_free(self->slots);
+    tc_free(self->displacements);
+
+    self->bucketCount = swampBindingRegistryPowerOfTwo(self->infoCount / 2 + 1);
+    self->slotCount = swampBindingRegistryPowerOfTwo(self->infoCount * 2 + 1);
+    self->displacements = tc_malloc_type_count(uint32_t, self->bucketCount);
+    tc_mem_clear(self->displacements, sizeof(self->displacements[0]) * self->bucketCount);
+    self->slots = tc_malloc_type_count(const SwampBindingInfo*, self->slotCount);
+    tc_mem_clear(self->slots, sizeof(self->slots[0]) * self->slotCount);
+
+    // Sort the infos into buckets, keeping the order they were added in. Later duplicates are dropped.
+    size_t* bucketStart = tc_malloc_type_count(size_t, self->bucketCount + 1);
+    tc_mem_clear(bucketStart, sizeof(bucketStart[0]) * (self->bucketCount + 1));
+    for (size_t i = 0; i < self->infoCount; ++i) {
+        uint32_t bucket = swampBindingRegistryHash(self->infos[i]->name, 0) & (self->bucketCount - 1);
+        bucketStart[bucket + 1]++;
+    }
+    for (size_t i = 0; i < self->bucketCount; ++i) {
+        bucketStart[i + 1] += bucketStart[i];
+    }
+
+    const SwampBindingInfo** members = tc_malloc_type_count(const SwampBindingInfo*, self->infoCount + 1);
+    size_t* memberCounts = tc_malloc_type_count(size_t, self->bucketCount);
+    tc_mem_clear(memberCounts, sizeof(memberCounts[0]) * self->bucketCount);
+    size_t maxMemberCount = 0;
+    for (size_t i = 0; i < self->infoCount; ++i) {
+        const SwampBindingInfo* info = self->infos[i];
+        uint32_t bucket = swampBindingRegistryHash(info->name, 0) & (self->bucketCount - 1);
+        const SwampBindingInfo** bucketMembers = &members[bucketStart[bucket]];
+        int isDuplicate = 0;
+        for (size_t j = 0; j < memberCounts[bucket]; ++j) {
+            if (tc_str_equal(bucketMembers[j]->name, info->name)) {
+                isDuplicate = 1;
+                break;
+            }
+        }
+        if (!isDuplicate) {
+            bucketMembers[memberCounts[bucket]++] = info;
+            if (memberCounts[bucket] > maxMemberCount) {
+                maxMemberCount = memberCounts[bucket];
+            }
+        }
+    }
+
+    size_t* candidateSlots = tc_malloc_type_count(size_t, maxMemberCount + 1);
+    int errorCode = 0;
+    for (size_t size = maxMemberCount; size > 0 && errorCode == 0; --size) {
+        for (size_t bucket = 0; bucket < self->bucketCount; ++bucket) {
+            if (memberCounts[bucket] != size) {
+                continue;
+            }
+            const SwampBindingInfo** bucketMembers = &members[bucketStart[bucket]];
+            uint32_t seed;
+            for (seed = 1; seed < SWAMP_BINDING_REGISTRY_MAX_SEED; ++seed) {
+                size_t placedCount = 0;
+                for (; placedCount < size; ++placedCount) {
+                    size_t slot = swampBindingRegistryHash(bucketMembers[placedCount]->name, seed) &
+                                  (self->slotCount - 1);
+                    if (self->slots[slot] != 0) {
+                        break;
+                    }
+                    size_t j = 0;
+                    while (j < placedCount && candidateSlots[j] != slot) {
+                        j++;
+                    }
+                    if (j != placedCount) {
+                        break;
+                    }
+                    candidateSlots[placedCount] = slot;
+                }
+                if (placedCount == size) {
+                    break;
+                }
+            }
+            if (seed == SWAMP_BINDING_REGISTRY_MAX_SEED) {
+                CLOG_SOFT_ERROR("swampBindingRegistryBuild: could not find a seed for bucket %zu", bucket)
+                errorCode = -1;
+                break;
+            }
+            for (size_t j = 0; j < size; ++j) {
+                self->slots[candidateSlots[j]] = bucketMembers[j];
+            }
+            self->displacements[bucket] = seed;
+        }
+    }
+
+    tc_free(candidateSlots);
+    tc_free(memberCounts);
+    tc_free(members);
+    tc_free(bucketStart);
+
+    return errorCode;
+}
+
+const void* swampBindingRegistryFind(const SwampBindingRegistry* self, const char* fullyQualifiedName)
+{
+    if (self->bucketCount == 0) {
+        return 0;
+    }
+
+    uint32_t seed = self->displacements[swampBindingRegistryHash(fullyQualifiedName, 0) & (self->bucketCount - 1)];
+    if (seed == 0) {
+        return 0;
+    }
+
+    const SwampBindingInfo* info = self->slots[swampBindingRegistryHash(fullyQualifiedName, seed) &
+                                               (self->slotCount - 1)];
+    if (info == 0 || !tc_str_equal(info->name, fullyQualifiedName)) {
+        return 0;
+    }
+
+    return info->fn;
+}
@@ -7,175 +7,477 @@
 #include <swamp-runtime/compact.h>
 #include <swamp-runtime/clone.h>
 #include <swamp-runtime/context.h>
+#include <swamp-runtime/copy_plan.h>
+#include <swamp-runtime/parallel.h>
 #include <swamp-runtime/types.h>
 #include <swamp-typeinfo/typeinfo.h>
 #include <swamp-dump/dump_ascii.h>
 #include <tiny-libc/tiny_libc.h>
 
-static int compactOrClone(void* v, const SwtiType* type, int doClone, SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory, SwampUnmanagedMemory* sourceUnmanagedMemory)
+// Every list, array, string, blob and unmanaged is copied once, and all references to it are forwarded to that
+// copy. Sharing in the state is kept that way, instead of each reference getting its own copy.
+#if !defined SWAMP_COMPACT_FORWARDING
+#define SWAMP_COMPACT_FORWARDING (1)
+#endif
+
+typedef struct SwampCompactForward {
+    const void* source;
+    void* target;
+    uint32_t octetCount; // everything that was allocated when the source was copied
+    uint32_t generation; // the slot is empty unless it is from the current compaction
+} SwampCompactForward;
+
+// Open addressing on the source pointer. The table is kept between compactions and emptied by moving on to the next
+// generation, since allocating and clearing it each time costs more than the compaction itself.
+typedef struct SwampCompactForwarding {
+    SwampCompactForward* forwards;
+    size_t count;
+    size_t capacity;
+    uint32_t generation;
+} SwampCompactForwarding;
+
+// More parts than threads, so that a thread that is done early can take another part
+#define SWAMP_COMPACT_PARALLEL_PARTS_PER_TASK (4)
+#define SWAMP_COMPACT_PART_OCTET_SIZE (64 * 1024)
+#define SWAMP_COMPACT_PART_OUT_OF_ROOM (-10)
+
+// Some of the top-level references, or a range of the items of a top-level list, compacted into memory of its own.
+// The memory is copied to the target when all parts are done, and the pointers into it are moved along with it.
+typedef struct SwampCompactPart {
+    SwampCopyPlan plan; // some of the steps of the state plan, or the plan of the list items
+    uint8_t* target;
+    const uint8_t* source;
+    size_t valueCount;
+    size_t valueSize; // zero for the state, since only the octets of the steps are copied
+    SwampCompactForwarding forwarding;
+    uint8_t* octets; // kept between compactions, grown when a part runs out of room
+    size_t octetCapacity;
+    size_t missingOctetCount;
+    SwampDynamicMemory memory;
+    void*** relocations; // every pointer that points into memory
+    size_t relocationCount;
+    size_t relocationCapacity;
+    const SwampUnmanaged* unmanaged[SWAMP_MACHINE_CONTEXT_UNMANAGED_CONTAINER_COUNT]; // moved by the calling thread
+    size_t unmanagedCount;
+    uint8_t* compacted; // where memory was copied to in the target
+    SwampCompactStats stats;
+    int result;
+} SwampCompactPart;
+
+typedef struct SwampCompactParts {
+    SwampCompactPart* parts;
+    size_t count;
+    size_t capacity;
+} SwampCompactParts;
+
+typedef struct SwampCompactPass {
+    int doClone;
+    SwampDynamicMemory* targetMemory;
+    SwampUnmanagedMemory* targetUnmanagedMemory;
+    SwampUnmanagedMemory* sourceUnmanagedMemory;
+    SwampCompactForwarding* forwarding;
+    const SwampDynamicMemory* nursery; // only objects in it are copied, zero to copy everything
+    SwampCompactPart* part; // only set when compacting a part for swampCompactParallel()
+    SwampCompactStats stats;
+} SwampCompactPass;
+
+static void swampCompactForwardingClear(SwampCompactForwarding* self)
 {
-    switch (type->type) {
-        case SwtiTypeBoolean:
-        case SwtiTypeInt:
-        case SwtiTypeFixed:
-        case SwtiTypeChar:
-            return 0;
-        case SwtiTypeRecord: {
-            const SwtiRecordType* record = (const SwtiRecordType*) type;
-            for (size_t i = 0; i < record->fieldCount; i++) {
-                const SwtiRecordTypeField* field = &record->fields[i];
-                int errorCode = compactOrClone((uint8_t*)v + field->memoryOffsetInfo.memoryOffset, field->fieldType, doClone, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
-                if (errorCode != 0) {
-                    return errorCode;
-                }
-            }
-        } break;
-        case SwtiTypeTuple: {
-            const SwtiTupleType * record = (const SwtiTupleType*) type;
-            for (size_t i = 0; i < record->fieldCount; i++) {
-                const SwtiTupleTypeField * field = &record->fields[i];
-                int errorCode = compactOrClone((uint8_t*)v + field->memoryOffsetInfo.memoryOffset, field->fieldType, doClone, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
-                if (errorCode != 0) {
-                    return errorCode;
-                }
-            }
-        } break;
-        case SwtiTypeCustom: {
-            const SwtiCustomType* custom = (const SwtiCustomType*) type;
-            const uint8_t enumIndex = *(const uint8_t*) v;
-            if (enumIndex >= custom->variantCount) {
-                CLOG_ERROR("compactOrClone: illegal variant index %d", enumIndex)
-            }
-            const SwtiCustomTypeVariant* variant = custom->variantTypes[enumIndex];
-            for (size_t i = 0; i < variant->paramCount; ++i) {
-                const SwtiCustomTypeVariantField* field = &variant->fields[i];
-                int errorCode = compactOrClone(((uint8_t*) v + field->memoryOffsetInfo.memoryOffset), field->fieldType,
-                                               doClone, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
-                if (errorCode != 0) {
-                    return errorCode;
-                }
-            }
-        } break;
-        case SwtiTypeArray: {
-            const SwtiArrayType* arrayType = ((const SwtiArrayType*) type);
-            SwampArray** _array = (SwampArray**) v;
-            const SwampArray* array = *_array;
-            SwampArray* newArrayStruct = swampDynamicMemoryAllocDebug(targetMemory, 1, sizeof(SwampArray), 8,
-                                                                      "SwampArray");
-
-            void* newItems = swampDynamicMemoryAllocDebug(targetMemory, array->count, array->itemSize,
-                                                                array->itemAlign, "array items");
-            tc_memcpy_octets(newItems, array->value, array->count * array->itemSize);
-            *newArrayStruct = *array;
-            newArrayStruct->value = newItems;
-            uint8_t* p = (uint8_t* ) newArrayStruct->value;
-            for (size_t i = 0; i < newArrayStruct->count; i++) {
-                int errorCode = compactOrClone((void*)p, arrayType->itemType, doClone, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
-                if (errorCode != 0) {
-                    return errorCode;
-                }
+    self->count = 0;
+    self->generation++;
+    if (self->generation == 0) {
+        tc_mem_clear(self->forwards, sizeof(self->forwards[0]) * self->capacity);
+        self->generation = 1;
+    }
+}
 
-                p += newArrayStruct->itemSize;
-            }
+static size_t swampCompactForwardingSlot(const SwampCompactForward* forwards, size_t capacity, uint32_t generation,
+                                         const void* source)
+{
+    size_t mask = capacity - 1;
+    size_t i = ((uintptr_t) source >> 4) & mask;
+    while (forwards[i].generation == generation && forwards[i].source != source) {
+        i = (i + 1) & mask;
+    }
 
-            *_array = newArrayStruct;
-        } break;
-        case SwtiTypeList: {
-            const SwtiListType* listType = ((const SwtiListType*) type);
-            SwampList** _list = (SwampList**) v;
-            const SwampList* list = *_list;
-            SwampList* newArrayStruct = swampDynamicMemoryAllocDebug(targetMemory, 1, sizeof(SwampList), 8,
-                                                                      "SwampList");
-
-            void* newItems = swampDynamicMemoryAllocDebug(targetMemory, list->count, list->itemSize,
-                                                                list->itemAlign, "list items");
-            tc_memcpy_octets(newItems, list->value, list->count * list->itemSize);
-            *newArrayStruct = *list;
-            newArrayStruct->value = newItems;
-            uint8_t* p = (uint8_t*) newArrayStruct->value;
-            for (size_t i = 0; i < newArrayStruct->count; i++) {
-                int errorCode = compactOrClone((void*)p, listType->itemType, doClone, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
-                if (errorCode != 0) {
-                    return errorCode;
-                }
+    return i;
+}
 
-                p += newArrayStruct->itemSize;
-            }
+static void swampCompactForwardingGrow(SwampCompactForwarding* self)
+{
+    size_t capacity = self->capacity == 0 ? 1024 : self->capacity * 2;
+    SwampCompactForward* forwards = tc_malloc_type_count(SwampCompactForward, capacity);
+    tc_mem_clear(forwards, sizeof(forwards[0]) * capacity);
+    for (size_t i = 0; i < self->capacity; ++i) {
+        const SwampCompactForward* forward = &self->forwards[i];
+        if (forward->generation == self->generation) {
+            forwards[swampCompactForwardingSlot(forwards, capacity, self->generation, forward->source)] = *forward;
+        }
+    }
+    tc_free(self->forwards);
+    self->forwards = forwards;
+    self->capacity = capacity;
+}
 
-            *_list = newArrayStruct;
-        } break;
-        case SwtiTypeFunction:
+static const SwampCompactForward* swampCompactForwardingFind(const SwampCompactForwarding* self, const void* source)
+{
+    if (self->count == 0) {
+        return 0;
+    }
+    const SwampCompactForward* forward = &self->forwards[swampCompactForwardingSlot(self->forwards, self->capacity,
+                                                                                     self->generation, source)];
+    return forward->generation == self->generation ? forward : 0;
+}
+
+static void swampCompactForwardingAdd(SwampCompactForwarding* self, const void* source, void* target,
+                                      size_t octetCount)
+{
+    if ((self->count + 1) * 2 > self->capacity) {
+        swampCompactForwardingGrow(self);
+    }
+    SwampCompactForward* forward = &self->forwards[swampCompactForwardingSlot(self->forwards, self->capacity,
+                                                                               self->generation, source)];
+    forward->source = source;
+    forward->target = target;
+    forward->octetCount = (uint32_t) octetCount;
+    forward->generation = self->generation;
+    self->count++;
+}
+
+static void swampCompactForwardingDestroy(SwampCompactForwarding* self)
+{
+    tc_free(self->forwards);
+    self->forwards = 0;
+    self->count = 0;
+    self->capacity = 0;
+}
+
+static void swampCompactPartsDestroy(SwampCompactParts* self)
+{
+    for (size_t i = 0; i < self->capacity; ++i) {
+        SwampCompactPart* part = &self->parts[i];
+        swampCompactForwardingDestroy(&part->forwarding);
+        tc_free(part->octets);
+        tc_free(part->relocations);
+    }
+    tc_free(self->parts);
+    self->parts = 0;
+    self->count = 0;
+    self->capacity = 0;
+}
+
+void swampCompactorInit(SwampCompactor* self, SwampCopyPlanCache* copyPlans)
+{
+    self->copyPlans = copyPlans;
+    self->forwarding = tc_malloc_type(SwampCompactForwarding);
+    tc_mem_clear(self->forwarding, sizeof(*self->forwarding));
+    self->parts = tc_malloc_type(SwampCompactParts);
+    tc_mem_clear(self->parts, sizeof(*self->parts));
+    self->isCompacting = 0;
+}
+
+void swampCompactorDestroy(SwampCompactor* self)
+{
+    swampCompactForwardingDestroy(self->forwarding);
+    tc_free(self->forwarding);
+    self->forwarding = 0;
+    swampCompactPartsDestroy(self->parts);
+    tc_free(self->parts);
+    self->parts = 0;
+}
+
+static int compactOrCloneValue(SwampCompactPass* self, uint8_t* v, const SwampCopyPlan* plan);
+
+// Lists and arrays have the same layout, only the debug names differ
+static int compactOrCloneCollection(SwampCompactPass* self, SwampArray** _collection, const SwampCopyPlan* itemPlan,
+                                    const char* structDebugName, const char* itemsDebugName)
+{
+    const SwampArray* collection = *_collection;
+    SwampArray* newCollection = swampDynamicMemoryAllocDebug(self->targetMemory, 1, sizeof(SwampArray), 8,
+                                                             structDebugName);
+    *newCollection = *collection;
+    *_collection = newCollection;
+
+    // Empty lists have no items and no item align, see swampListEmptyAllocate(). The source value can still point
+    // to memory that is about to be reset, e.g. from swampListAllocateNoCopy().
+    if (collection->count == 0) {
+        newCollection->value = 0;
+        return 0;
+    }
+
+    void* newItems = swampDynamicMemoryAllocDebug(self->targetMemory, collection->count, collection->itemSize,
+                                                  collection->itemAlign, itemsDebugName);
+    tc_memcpy_octets(newItems, collection->value, collection->count * collection->itemSize);
+    newCollection->value = newItems;
+    if (!itemPlan->containsReferences) {
+        return 0;
+    }
+
+    uint8_t* p = (uint8_t*) newCollection->value;
+    for (size_t i = 0; i < newCollection->count; i++) {
+        int errorCode = compactOrCloneValue(self, p, itemPlan);
+        if (errorCode != 0) {
+            return errorCode;
+        }
+
+        p += newCollection->itemSize;
+    }
+
+    return 0;
+}
+
+// Copies what the reference points to and sets the reference to the copy
+static int compactOrCloneObject(SwampCompactPass* self, const SwampCopyStep* step, void** reference)
+{
+    switch (step->type) {
+        case SwampCopyStepArray:
+            return compactOrCloneCollection(self, (SwampArray**) reference, step->itemPlan, "SwampArray",
+                                            "array items");
+        case SwampCopyStepList:
+            return compactOrCloneCollection(self, (SwampList**) reference, step->itemPlan, "SwampList",
+                                            "list items");
+        case SwampCopyStepFunction:
             return -1;
-        case SwtiTypeString: {
-            const SwampString** _str = (const SwampString**) v;
+        case SwampCopyStepString: {
+            const SwampString** _str = (const SwampString**) reference;
             const SwampString* str = *_str;
-            SwampString* newStrStruct = swampDynamicMemoryAllocDebug(targetMemory, 1, sizeof(SwampString), 8,
+            SwampString* newStrStruct = swampDynamicMemoryAllocDebug(self->targetMemory, 1, sizeof(SwampString), 8,
                                                                      "SwampString");
-            char* newCharacters = swampDynamicMemoryAllocDebug(targetMemory, str->characterCount + 1, 1, 1, "characters");
-            tc_memcpy_octets(newCharacters, str->characters, str->characterCount + 1);
+            char* newCharacters = swampDynamicMemoryAllocDebug(self->targetMemory, str->characterCount + 1, 1, 1,
+                                                               "characters");
+            // The characters can be shared with a longer string, so the terminating zero is not always there
+            tc_memcpy_octets(newCharacters, str->characters, str->characterCount);
+            newCharacters[str->characterCount] = 0;
             newStrStruct->characters = newCharacters;
             newStrStruct->characterCount = str->characterCount;
             *_str = newStrStruct;
         } break;
-        case SwtiTypeAny:
-        case SwtiTypeAnyMatchingTypes:
-        case SwtiTypeResourceName:
+        case SwampCopyStepUnsupported:
             CLOG_ERROR("not supported in this version")
             break;
-        case SwtiTypeUnmanaged: {
-            SwampUnmanaged** _unmanaged = (SwampUnmanaged**) v;
+        case SwampCopyStepUnmanaged: {
+            SwampUnmanaged** _unmanaged = (SwampUnmanaged**) reference;
             const SwampUnmanaged* unmanaged = *_unmanaged;
 
-            if (doClone) {
-                //CLOG_VERBOSE("attempting to clone unmanaged  (%p)", unmanaged);
+            if (self->doClone) {
                 CLOG_VERBOSE("attempting to clone unmanaged '%s' (%p)", unmanaged->debugName, (const void*) unmanaged)
-                int result = unmanaged->clone(_unmanaged, targetMemory, targetUnmanagedMemory);
+                int result = unmanaged->clone(_unmanaged, self->targetMemory, self->targetUnmanagedMemory);
                 if (*_unmanaged == 0) {
                     CLOG_ERROR("what happened")
                 }
                 if (result < 0) {
                     return result;
                 }
+            } else if (self->part) {
+                // The unmanaged memories are not thread safe
+                if (self->part->unmanagedCount == SWAMP_MACHINE_CONTEXT_UNMANAGED_CONTAINER_COUNT) {
+                    CLOG_ERROR("too many unmanaged in one part")
+                }
+                self->part->unmanaged[self->part->unmanagedCount++] = unmanaged;
             } else {
-#if 0
-            CLOG_VERBOSE("attempting to compact unmanaged '%s' (%p)", unmanaged->debugName, unmanaged);
-#endif
-                swampUnmanagedMemoryMove(targetUnmanagedMemory, sourceUnmanagedMemory, unmanaged);
+                swampUnmanagedMemoryMove(self->targetUnmanagedMemory, self->sourceUnmanagedMemory, unmanaged);
                 if (*_unmanaged == 0) {
                     CLOG_ERROR("what happened")
                 }
-                return 0; // unmanaged->compact(_unmanaged, targetMemory, unmanagedMemory);
             }
         } break;
-        case SwtiTypeAlias: {
-            const SwtiAliasType* alias = (const SwtiAliasType*) type;
-            int errorCode = compactOrClone(v, alias->targetType, doClone, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
-            if (errorCode != 0) {
-                return errorCode;
-            }
-
-        } break;
-        case SwtiTypeBlob: {
-            SwampBlob** _blob = (SwampBlob**) v;
+        case SwampCopyStepBlob: {
+            SwampBlob** _blob = (SwampBlob**) reference;
             const SwampBlob* sourceBlob = *_blob;
-            SwampBlob* newBlobStruct = swampDynamicMemoryAllocDebug(targetMemory, 1, sizeof(SwampBlob), 8, "SwampBlob");
-            uint8_t* octets = swampDynamicMemoryAllocDebug(targetMemory, 1, sourceBlob->octetCount, 1, "blob");
+            SwampBlob* newBlobStruct = swampDynamicMemoryAllocDebug(self->targetMemory, 1, sizeof(SwampBlob), 8,
+                                                                    "SwampBlob");
+            uint8_t* octets = swampDynamicMemoryAllocDebug(self->targetMemory, 1, sourceBlob->octetCount, 1, "blob");
             tc_memcpy_octets(octets, sourceBlob->octets, sourceBlob->octetCount);
             *newBlobStruct = *sourceBlob;
             newBlobStruct->octets = octets;
             *_blob = newBlobStruct;
+        } break;
+        case SwampCopyStepCustom:
+            CLOG_ERROR("custom types are not references")
+            break;
+    }
 
+    return 0;
+}
+
+// Objects can only reference objects that are older than themselves, so an object outside of the nursery can be
+// kept together with everything it references
+static int isKeptByNursery(const SwampCompactPass* self, const SwampCopyStep* step, const void* source)
+{
+    switch (step->type) {
+        case SwampCopyStepFunction:
+        case SwampCopyStepUnsupported:
+            return 0;
+        case SwampCopyStepUnmanaged:
+            return 1;
+        default:
+            return !swampDynamicMemoryOwns(self->nursery, source);
+    }
+}
+
+// Enough for the object and the padding in front of its allocations
+static size_t compactPartObjectOctetCount(const SwampCopyStep* step, const void* source)
+{
+    switch (step->type) {
+        case SwampCopyStepArray:
+        case SwampCopyStepList: {
+            const SwampArray* collection = source;
+            return sizeof(SwampArray) + 8 + collection->count * collection->itemSize + 8;
+        }
+        case SwampCopyStepString:
+            return sizeof(SwampString) + 8 + ((const SwampString*) source)->characterCount + 1;
+        case SwampCopyStepBlob:
+            return sizeof(SwampBlob) + 8 + ((const SwampBlob*) source)->octetCount;
+        default:
+            return 0;
+    }
+}
+
+static void compactPartAddRelocation(SwampCompactPart* self, void** pointer)
+{
+    if (self->relocationCount == self->relocationCapacity) {
+        self->relocationCapacity = self->relocationCapacity == 0 ? 1024 : self->relocationCapacity * 2;
+        self->relocations = tc_realloc(self->relocations, sizeof(self->relocations[0]) * self->relocationCapacity);
+    }
+    self->relocations[self->relocationCount++] = pointer;
+}
+
+// The reference and the pointers in the object it was copied to
+static void compactPartAddRelocations(SwampCompactPart* self, const SwampCopyStep* step, void** reference)
+{
+    switch (step->type) {
+        case SwampCopyStepArray:
+        case SwampCopyStepList: {
+            SwampArray* collection = *reference;
+            if (collection->count != 0) {
+                compactPartAddRelocation(self, (void**) &collection->value);
+            }
         } break;
+        case SwampCopyStepString:
+            compactPartAddRelocation(self, (void**) &((SwampString*) *reference)->characters);
+            break;
+        case SwampCopyStepBlob:
+            compactPartAddRelocation(self, (void**) &((SwampBlob*) *reference)->octets);
+            break;
+        default:
+            return;
+    }
+    compactPartAddRelocation(self, reference);
+}
 
-        default: {
-            CLOG_ERROR("unknown type %d", type->type)
+static int compactOrCloneReference(SwampCompactPass* self, const SwampCopyStep* step, void** reference)
+{
+    if (self->nursery && isKeptByNursery(self, step, *reference)) {
+        self->stats.keptReferenceCount++;
+        return 0;
+    }
+
+#if SWAMP_COMPACT_FORWARDING
+    const void* source = *reference;
+    const SwampCompactForward* forward = swampCompactForwardingFind(self->forwarding, source);
+    if (forward) {
+        *reference = forward->target;
+        if (self->part && step->type != SwampCopyStepUnmanaged) {
+            compactPartAddRelocation(self->part, reference);
         }
+        self->stats.sharedReferenceCount++;
+        self->stats.sharedOctetCount += forward->octetCount;
+        return 0;
     }
+    size_t allocatedBefore = swampDynamicMemoryAllocatedSize(self->targetMemory);
+#endif
+
+    if (self->part) {
+        const SwampDynamicMemory* memory = self->targetMemory;
+        size_t octetCount = compactPartObjectOctetCount(step, *reference);
+        size_t freeOctetCount = memory->maxAllocatedSize - (memory->p - memory->memory);
+        if (octetCount > freeOctetCount) {
+            self->part->missingOctetCount = octetCount;
+            return SWAMP_COMPACT_PART_OUT_OF_ROOM;
+        }
+    }
+
+    int errorCode = compactOrCloneObject(self, step, reference);
+    if (errorCode != 0) {
+        return errorCode;
+    }
+    self->stats.objectCount++;
+    if (self->part) {
+        compactPartAddRelocations(self->part, step, reference);
+    }
+
+#if SWAMP_COMPACT_FORWARDING
+    swampCompactForwardingAdd(self->forwarding, source, *reference,
+                              swampDynamicMemoryAllocatedSize(self->targetMemory) - allocatedBefore);
+#endif
 
     return 0;
 }
 
-int swampCompact(const void* state, const SwtiType* stateType, SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,  SwampUnmanagedMemory* sourceUnmanagedMemory, void** compactedState)
+// The value itself is already copied, this only follows and copies what the references in it point to
+static int compactOrCloneValue(SwampCompactPass* self, uint8_t* v, const SwampCopyPlan* plan)
+{
+    for (size_t stepIndex = 0; stepIndex < plan->stepCount; ++stepIndex) {
+        const SwampCopyStep* step = &plan->steps[stepIndex];
+        uint8_t* p = v + step->offset;
+        int errorCode;
+        if (step->type == SwampCopyStepCustom) {
+            const uint8_t enumIndex = *p;
+            if (enumIndex >= step->variantCount) {
+                CLOG_ERROR("compactOrClone: illegal variant index %d", enumIndex)
+            }
+            errorCode = compactOrCloneValue(self, p, &step->variantPlans[enumIndex]);
+        } else {
+            errorCode = compactOrCloneReference(self, step, (void**) p);
+        }
+        if (errorCode != 0) {
+            return errorCode;
+        }
+    }
+
+    return 0;
+}
+
+static int compactOrClone(SwampCompactor* compactor, void* v, const SwtiType* type, int doClone,
+                          SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,
+                          SwampUnmanagedMemory* sourceUnmanagedMemory, const SwampDynamicMemory* nursery,
+                          SwampCompactStats* stats)
+{
+    if (compactor->isCompacting) {
+        CLOG_SOFT_ERROR("compactor is already in use, an unmanaged clone must use a compactor of its own")
+        return -4;
+    }
+    compactor->isCompacting = 1;
+
+    SwampCompactPass pass;
+    pass.doClone = doClone;
+    pass.targetMemory = targetMemory;
+    pass.targetUnmanagedMemory = targetUnmanagedMemory;
+    pass.sourceUnmanagedMemory = sourceUnmanagedMemory;
+    pass.forwarding = compactor->forwarding;
+    pass.nursery = nursery;
+    pass.part = 0;
+    swampCompactForwardingClear(pass.forwarding);
+    tc_mem_clear(&pass.stats, sizeof(pass.stats));
+
+    int result = 0;
+    const SwampCopyPlan* plan = swampCopyPlanFind(compactor->copyPlans, type);
+    if (plan->containsReferences) {
+        result = compactOrCloneValue(&pass, v, plan);
+    }
+
+    if (stats) {
+        *stats = pass.stats;
+    }
+    compactor->isCompacting = 0;
+
+    return result;
+}
+
+int swampCompactWithStats(SwampCompactor* compactor, const void* state, const SwtiType* stateType,
+                          SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,
+                          SwampUnmanagedMemory* sourceUnmanagedMemory, void** compactedState,
+                          SwampCompactStats* stats)
 {
     #if 1
     if (!swampIsBlittableOrEcs(stateType)) {
@@ -198,13 +500,24 @@ int swampCompact(const void* state, const SwtiType* stateType, SwampDynamicMemor
         *compactedState = compactedStateMemory;
     }
 
-    int result = compactOrClone(compactedStateMemory, stateType, 0, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
+    int result = compactOrClone(compactor, compactedStateMemory, stateType, 0, targetMemory, targetUnmanagedMemory,
+                                sourceUnmanagedMemory, 0, stats);
 
 
     return result;
 }
 
-int swampClone(const void* state, const SwtiType* stateType, SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory, SwampUnmanagedMemory* sourceUnmanagedMemory, void** clonedState)
+int swampCompact(SwampCompactor* compactor, const void* state, const SwtiType* stateType,
+                 SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,
+                 SwampUnmanagedMemory* sourceUnmanagedMemory, void** compactedState)
+{
+    return swampCompactWithStats(compactor, state, stateType, targetMemory, targetUnmanagedMemory,
+                                 sourceUnmanagedMemory, compactedState, 0);
+}
+
+int swampCloneWithStats(SwampCompactor* compactor, const void* state, const SwtiType* stateType,
+                        SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,
+                        SwampUnmanagedMemory* sourceUnmanagedMemory, void** clonedState, SwampCompactStats* stats)
 {
     if (!swampIsBlittableOrEcs(stateType)) {
         CLOG_ERROR("in this version, only blittable states and Ecs.World can be compacted")
@@ -223,7 +536,320 @@ int swampClone(const void* state, const SwtiType* stateType, SwampDynamicMemory*
         *clonedState = clonedStateMemory;
     }
 
-    int result = compactOrClone(clonedStateMemory, stateType, 1, targetMemory, targetUnmanagedMemory, sourceUnmanagedMemory);
+    int result = compactOrClone(compactor, clonedStateMemory, stateType, 1, targetMemory, targetUnmanagedMemory,
+                                sourceUnmanagedMemory, 0, stats);
+
+    return result;
+}
+
+int swampClone(SwampCompactor* compactor, const void* state, const SwtiType* stateType,
+               SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,
+               SwampUnmanagedMemory* sourceUnmanagedMemory, void** clonedState)
+{
+    return swampCloneWithStats(compactor, state, stateType, targetMemory, targetUnmanagedMemory,
+                               sourceUnmanagedMemory, clonedState, 0);
+}
+
+int swampCompactGenerational(SwampCompactor* compactor, const void* state, const SwtiType* stateType,
+                             const SwampDynamicMemory* nursery, SwampDynamicMemory* oldGeneration,
+                             void** compactedState, SwampCompactStats* stats)
+{
+    if (!swampIsBlittableOrEcs(stateType)) {
+        CLOG_ERROR("in this version, only blittable states and Ecs.World can be compacted %s", stateType->name)
+        return -3;
+    }
+
+    if (nursery == oldGeneration) {
+        CLOG_ERROR("the nursery can not be the old generation")
+        return -2;
+    }
+
+    SwtiMemorySize size = swtiGetMemorySize(stateType);
+    SwtiMemoryAlign align = swtiGetMemoryAlign(stateType);
+
+    void* compactedStateMemory = swampDynamicMemoryAllocDebug(oldGeneration, 1, size, align, "state");
+    tc_memcpy_octets(compactedStateMemory, state, size);
+    if (compactedState) {
+        *compactedState = compactedStateMemory;
+    }
+
+    return compactOrClone(compactor, compactedStateMemory, stateType, 0, oldGeneration, 0, 0, nursery, stats);
+}
+
+// The octets of the value that a step of the state plan fixes up
+static size_t compactStepOctetCount(const SwampCopyStep* step)
+{
+    if (step->type == SwampCopyStepCustom) {
+        return swtiGetMemorySize(step->variantPlans[0].type);
+    }
+
+    return sizeof(void*);
+}
+
+static SwampCompactPart* compactPartsAdd(SwampCompactParts* self, const SwampCopyPlan* plan, uint8_t* target,
+                                         const uint8_t* source, size_t valueCount, size_t valueSize)
+{
+    if (self->count == self->capacity) {
+        size_t capacity = self->capacity == 0 ? 64 : self->capacity * 2;
+        self->parts = tc_realloc(self->parts, sizeof(self->parts[0]) * capacity);
+        tc_mem_clear(&self->parts[self->capacity], sizeof(self->parts[0]) * (capacity - self->capacity));
+        self->capacity = capacity;
+    }
+
+    SwampCompactPart* part = &self->parts[self->count++];
+    part->plan = *plan;
+    part->target = target;
+    part->source = source;
+    part->valueCount = valueCount;
+    part->valueSize = valueSize;
+
+    return part;
+}
+
+// Every run of top-level references is split into parts, and so are the items of large top-level lists and arrays.
+// The lists and arrays that are split are allocated here, so the items stay together in the target.
+static void compactPartsSplit(SwampCompactParts* self, uint8_t* state, const uint8_t* sourceState,
+                              const SwampCopyPlan* plan, SwampDynamicMemory* targetMemory, size_t maxPartCount)
+{
+    self->count = 0;
+    size_t runStart = 0;
+    for (size_t i = 0; i <= plan->stepCount; ++i) {
+        const SwampCopyStep* step = i < plan->stepCount ? &plan->steps[i] : 0;
+        const SwampArray* collection = 0;
+        if (step && (step->type == SwampCopyStepList || step->type == SwampCopyStepArray)) {
+            collection = *(const SwampArray**) (sourceState + step->offset);
+            if (collection->count < SWAMP_COMPACT_PARALLEL_MINIMUM_ITEM_COUNT || !step->itemPlan->containsReferences) {
+                collection = 0;
+            }
+        }
+        if (step && !collection) {
+            continue;
+        }
+
+        size_t runCount = i - runStart;
+        size_t partCount = runCount < maxPartCount ? runCount : maxPartCount;
+        for (size_t j = 0; j < partCount; ++j) {
+            size_t start = runStart + runCount * j / partCount;
+            size_t end = runStart + runCount * (j + 1) / partCount;
+            SwampCompactPart* part = compactPartsAdd(self, plan, state, sourceState, 1, 0);
+            part->plan.steps = &plan->steps[start];
+            part->plan.stepCount = end - start;
+        }
+        runStart = i + 1;
+
+        if (!collection) {
+            continue;
+        }
+
+        const char* structDebugName = step->type == SwampCopyStepList ? "SwampList" : "SwampArray";
+        const char* itemsDebugName = step->type == SwampCopyStepList ? "list items" : "array items";
+        SwampArray* newCollection = swampDynamicMemoryAllocDebug(targetMemory, 1, sizeof(SwampArray), 8,
+                                                                 structDebugName);
+        *newCollection = *collection;
+        newCollection->value = swampDynamicMemoryAllocDebug(targetMemory, collection->count, collection->itemSize,
+                                                            collection->itemAlign, itemsDebugName);
+        *(SwampArray**) (state + step->offset) = newCollection;
+
+        for (size_t j = 0; j < maxPartCount; ++j) {
+            size_t start = collection->count * j / maxPartCount;
+            size_t end = collection->count * (j + 1) / maxPartCount;
+            size_t offset = start * collection->itemSize;
+            compactPartsAdd(self, step->itemPlan, (uint8_t*) newCollection->value + offset,
+                            (const uint8_t*) collection->value + offset, end - start, collection->itemSize);
+        }
+    }
+}
+
+// Copies the values from the source again, so a part that ran out of room can run again with more memory
+static void compactPartRun(SwampCompactPart* self)
+{
+    if (self->octetCapacity == 0) {
+        self->octetCapacity = SWAMP_COMPACT_PART_OCTET_SIZE;
+        self->octets = tc_malloc(self->octetCapacity);
+    }
+    swampDynamicMemoryInitSlice(&self->memory, self->octets, self->octetCapacity);
+    swampCompactForwardingClear(&self->forwarding);
+    self->relocationCount = 0;
+    self->unmanagedCount = 0;
+    self->missingOctetCount = 0;
+
+    SwampCompactPass pass;
+    pass.doClone = 0;
+    pass.targetMemory = &self->memory;
+    pass.targetUnmanagedMemory = 0;
+    pass.sourceUnmanagedMemory = 0;
+    pass.forwarding = &self->forwarding;
+    pass.nursery = 0;
+    pass.part = self;
+    tc_mem_clear(&pass.stats, sizeof(pass.stats));
+
+    if (self->valueSize == 0) {
+        for (size_t i = 0; i < self->plan.stepCount; ++i) {
+            size_t offset = self->plan.steps[i].offset;
+            tc_memcpy_octets(self->target + offset, self->source + offset, compactStepOctetCount(&self->plan.steps[i]));
+        }
+    } else {
+        tc_memcpy_octets(self->target, self->source, self->valueCount * self->valueSize);
+    }
+
+    self->result = 0;
+    for (size_t i = 0; i < self->valueCount; ++i) {
+        self->result = compactOrCloneValue(&pass, self->target + i * self->valueSize, &self->plan);
+        if (self->result != 0) {
+            break;
+        }
+    }
+    self->stats = pass.stats;
+}
+
+static void compactPartRunTask(void* userData, size_t taskIndex)
+{
+    SwampCompactParts* parts = userData;
+    compactPartRun(&parts->parts[taskIndex]);
+}
+
+// Both the pointers and where they are stored can be in the part memory
+static void compactPartRelocate(SwampCompactPart* self)
+{
+    uintptr_t start = (uintptr_t) self->memory.memory;
+    size_t octetCount = self->memory.p - self->memory.memory;
+    if (octetCount == 0) {
+        return;
+    }
+    tc_memcpy_octets(self->compacted, self->memory.memory, octetCount);
+
+    for (size_t i = 0; i < self->relocationCount; ++i) {
+        uintptr_t pointerAddress = (uintptr_t) self->relocations[i];
+        if (pointerAddress - start < octetCount) {
+            pointerAddress = (uintptr_t) self->compacted + (pointerAddress - start);
+        }
+        uint8_t** pointer = (uint8_t**) pointerAddress;
+        *pointer = self->compacted + (*pointer - self->memory.memory);
+    }
+}
+
+static void compactPartRelocateTask(void* userData, size_t taskIndex)
+{
+    SwampCompactParts* parts = userData;
+    compactPartRelocate(&parts->parts[taskIndex]);
+}
+
+// Dynamic memory does not allow very large single allocations, so it is allocated in pieces. The pieces are
+// multiples of eight and the room is reserved first, so they end up next to each other.
+static uint8_t* compactAllocContiguous(SwampDynamicMemory* memory, size_t octetCount)
+{
+    const size_t maxPieceOctetCount = 1024 * 1024;
+    octetCount = (octetCount + 7) & ~(size_t) 7;
+    swampDynamicMemoryReserve(memory, octetCount + 8);
+
+    uint8_t* start = 0;
+    while (octetCount > 0) {
+        size_t pieceOctetCount = octetCount < maxPieceOctetCount ? octetCount : maxPieceOctetCount;
+        uint8_t* piece = swampDynamicMemoryAllocDebug(memory, 1, pieceOctetCount, 8, "compacted part");
+        if (!start) {
+            start = piece;
+        }
+        octetCount -= pieceOctetCount;
+    }
+
+    return start;
+}
+
+static int compactPartsRun(SwampCompactParts* parts, uint8_t* compactedStateMemory, const void* state,
+                           const SwampCopyPlan* plan, SwampDynamicMemory* targetMemory,
+                           SwampUnmanagedMemory* targetUnmanagedMemory, SwampUnmanagedMemory* sourceUnmanagedMemory,
+                           SwampWorkerPool* pool, SwampCompactStats* stats)
+{
+    compactPartsSplit(parts, compactedStateMemory, state, plan, targetMemory,
+                      (pool->threadCount + 1) * SWAMP_COMPACT_PARALLEL_PARTS_PER_TASK);
+
+    swampWorkerPoolRun(pool, compactPartRunTask, parts, parts->count);
+
+    for (size_t i = 0; i < parts->count; ++i) {
+        SwampCompactPart* part = &parts->parts[i];
+        while (part->result == SWAMP_COMPACT_PART_OUT_OF_ROOM) {
+            tc_free(part->octets);
+            part->octetCapacity = part->octetCapacity * 2 + part->missingOctetCount;
+            part->octets = tc_malloc(part->octetCapacity);
+            compactPartRun(part);
+        }
+        if (part->result != 0) {
+            return part->result;
+        }
+    }
+
+    // The parts are copied in order, so the layout is the same no matter which thread compacted which part
+    for (size_t i = 0; i < parts->count; ++i) {
+        SwampCompactPart* part = &parts->parts[i];
+        size_t octetCount = part->memory.p - part->memory.memory;
+        part->compacted = octetCount == 0 ? 0 : compactAllocContiguous(targetMemory, octetCount);
+    }
+
+    swampWorkerPoolRun(pool, compactPartRelocateTask, parts, parts->count);
+
+    for (size_t i = 0; i < parts->count; ++i) {
+        const SwampCompactPart* part = &parts->parts[i];
+        for (size_t j = 0; j < part->unmanagedCount; ++j) {
+            // Parts do not share objects, so the same unmanaged can be in more than one of them
+            if (!swampUnmanagedMemoryOwns(targetUnmanagedMemory, part->unmanaged[j])) {
+                swampUnmanagedMemoryMove(targetUnmanagedMemory, sourceUnmanagedMemory, part->unmanaged[j]);
+            }
+        }
+        if (stats) {
+            stats->objectCount += part->stats.objectCount;
+            stats->sharedReferenceCount += part->stats.sharedReferenceCount;
+            stats->sharedOctetCount += part->stats.sharedOctetCount;
+        }
+    }
+
+    return 0;
+}
+
+int swampCompactParallel(SwampCompactor* compactor, const void* state, const SwtiType* stateType,
+                         SwampDynamicMemory* targetMemory, SwampUnmanagedMemory* targetUnmanagedMemory,
+                         SwampUnmanagedMemory* sourceUnmanagedMemory, SwampWorkerPool* pool, void** compactedState,
+                         SwampCompactStats* stats)
+{
+    if (!pool || pool->threadCount == 0) {
+        return swampCompactWithStats(compactor, state, stateType, targetMemory, targetUnmanagedMemory,
+                                     sourceUnmanagedMemory, compactedState, stats);
+    }
+
+    if (!swampIsBlittableOrEcs(stateType)) {
+        CLOG_ERROR("in this version, only blittable states and Ecs.World can be compacted %s", stateType->name)
+        return -3;
+    }
+    if (targetMemory->p != targetMemory->memory) {
+        CLOG_ERROR("target memory must be reset")
+        return -2;
+    }
+
+    SwtiMemorySize size = swtiGetMemorySize(stateType);
+    SwtiMemoryAlign align = swtiGetMemoryAlign(stateType);
+
+    uint8_t* compactedStateMemory = swampDynamicMemoryAllocDebug(targetMemory, 1, size, align, "state");
+    tc_memcpy_octets(compactedStateMemory, state, size);
+    if (compactedState) {
+        *compactedState = compactedStateMemory;
+    }
+    if (stats) {
+        tc_mem_clear(stats, sizeof(*stats));
+    }
+
+    // All plans must be compiled before the workers start, since the plan cache is not thread safe
+    const SwampCopyPlan* plan = swampCopyPlanFind(compactor->copyPlans, stateType);
+    if (!plan->containsReferences) {
+        return 0;
+    }
+
+    if (compactor->isCompacting) {
+        CLOG_SOFT_ERROR("compactor is already in use, an unmanaged clone must use a compactor of its own")
+        return -4;
+    }
+    compactor->isCompacting = 1;
+    int result = compactPartsRun(compactor->parts, compactedStateMemory, state, plan, targetMemory,
+                                 targetUnmanagedMemory, sourceUnmanagedMemory, pool, stats);
+    compactor->isCompacting = 0;
 
     return result;
 }
@@ -7,9 +7,12 @@
 #include <swamp-runtime/types.h>
 #include <tiny-libc/tiny_libc.h>
 
+#define SWAMP_CONTEXT_STACK_SIZE (32 * 1024)
+#define SWAMP_CONTEXT_CALL_STACK_MAX_COUNT (1024)
+
 static void swampCallstackAlloc(SwampCallStack * self)
 {
-    self->maxCount = 1024;
+    self->maxCount = SWAMP_CONTEXT_CALL_STACK_MAX_COUNT;
     self->entries = tc_malloc_type_count(SwampCallStackEntry, self->maxCount);
     self->count = 0;
 }
@@ -153,13 +156,81 @@ void swampUnmanagedMemoryDestroy(SwampUnmanagedMemory* self)
     swampUnmanagedMemoryReset(self);
 }
 
+void swampMachineContextPoolInit(SwampMachineContextPool* self)
+{
+    self->entries = 0;
+    self->entryCount = 0;
+    self->entryCapacity = 0;
+    self->depth = 0;
+    self->maxDepth = 0;
+    self->createCount = 0;
+}
+
+void swampMachineContextPoolDestroy(SwampMachineContextPool* self)
+{
+    if (self->depth != 0) {
+        CLOG_SOFT_ERROR("destroying context pool with %zu temp contexts in use", self->depth)
+    }
+    for (size_t i = 0; i < self->entryCount; ++i) {
+        tc_free(self->entries[i].stackMemory);
+        tc_free(self->entries[i].callStackEntries);
+    }
+    tc_free(self->entries);
+    self->entries = 0;
+    self->entryCount = 0;
+    self->entryCapacity = 0;
+}
+
+void swampMachineContextPoolDebugOutput(const SwampMachineContextPool* self)
+{
+    CLOG_INFO("context pool: created:%zu depth:%zu maxDepth:%zu allocated:%zu octets", self->createCount, self->depth,
+              self->maxDepth,
+              self->entryCount * (SWAMP_CONTEXT_STACK_SIZE +
+                                  SWAMP_CONTEXT_CALL_STACK_MAX_COUNT * sizeof(SwampCallStackEntry)))
+}
+
+static const SwampMachineContextPoolEntry* swampMachineContextPoolAcquire(SwampMachineContextPool* self)
+{
+    if (self->depth == self->entryCount) {
+        if (self->entryCount == self->entryCapacity) {
+            size_t newCapacity = self->entryCapacity == 0 ? 8 : self->entryCapacity * 2;
+            SwampMachineContextPoolEntry* newEntries = tc_malloc_type_count(SwampMachineContextPoolEntry, newCapacity);
+            if (self->entries) {
+                tc_memcpy_octets(newEntries, self->entries, self->entryCount * sizeof(SwampMachineContextPoolEntry));
+                tc_free(self->entries);
+            }
+            self->entries = newEntries;
+            self->entryCapacity = newCapacity;
+        }
+        SwampMachineContextPoolEntry* entry = &self->entries[self->entryCount++];
+        entry->stackMemory = tc_malloc(SWAMP_CONTEXT_STACK_SIZE);
+        entry->callStackEntries = tc_malloc_type_count(SwampCallStackEntry, SWAMP_CONTEXT_CALL_STACK_MAX_COUNT);
+    }
+
+    self->createCount++;
+    self->depth++;
+    if (self->depth > self->maxDepth) {
+        self->maxDepth = self->depth;
+    }
+
+    return &self->entries[self->depth - 1];
+}
+
+static void swampMachineContextPoolRelease(SwampMachineContextPool* self, const uint8_t* stackMemory)
+{
+    if (self->depth == 0 || self->entries[self->depth - 1].stackMemory != stackMemory) {
+        CLOG_ERROR("temp contexts must be destroyed in the reverse order they were created")
+    }
+    self->depth--;
+}
+
 void swampContextInit(SwampMachineContext* self, SwampDynamicMemory* dynamicMemory,
                       const SwampStaticMemory* staticMemory, const struct SwtiChunk* typeInfo, SwampUnmanagedMemory* unmanagedMemory, const struct SwampDebugInfoFiles* debugInfoFiles, const char* debugString)
 {
     self->dynamicMemory = dynamicMemory;
     self->unmanagedMemory = unmanagedMemory;
-    uint8_t* stackMemory = tc_malloc(32*1024);
-    swampStackMemoryInit(&self->stackMemory, stackMemory, 32*1024);
+    uint8_t* stackMemory = tc_malloc(SWAMP_CONTEXT_STACK_SIZE);
+    swampStackMemoryInit(&self->stackMemory, stackMemory, SWAMP_CONTEXT_STACK_SIZE);
     self->bp = self->stackMemory.memory;
     self->tempResultSize = 2 * 1024;
     self->tempResult = tc_malloc(self->tempResultSize);
@@ -168,7 +239,13 @@ void swampContextInit(SwampMachineContext* self, SwampDynamicMemory* dynamicMemo
     self->debugString = debugString;
     self->parent = 0;
     self->debugInfoFiles = debugInfoFiles;
+    self->decodedProgram = 0;
     self->hackIsPredicting = 0;
+    self->workerPool = 0;
+    self->externalFunction = 0;
+    self->profiler = 0;
+    self->tempPool = tc_malloc_type(SwampMachineContextPool);
+    swampMachineContextPoolInit(self->tempPool);
     swampCallstackAlloc(&self->callStack);
 }
 
@@ -182,19 +259,37 @@ void swampContextDestroy(SwampMachineContext* self)
     tc_free(self->stackMemory.memory);
     tc_free(self->tempResult);
     swampCallstackDestroy(&self->callStack);
+    if (self->tempPool) {
+        swampMachineContextPoolDestroy(self->tempPool);
+        tc_free(self->tempPool);
+        self->tempPool = 0;
+    }
 }
 
 void swampContextDestroyTemp(SwampMachineContext* self)
 {
+    if (self->tempPool) {
+        swampMachineContextPoolRelease(self->tempPool, self->stackMemory.memory);
+        return;
+    }
     tc_free(self->stackMemory.memory);
     swampCallstackDestroy(&self->callStack);
 }
 
 void swampContextCreateTemp(SwampMachineContext* target, const SwampMachineContext* context, const char* debugString)
 {
-    uint8_t* stackMemory = tc_malloc(32*1024);
-
-    swampStackMemoryInit(&target->stackMemory, stackMemory, 32*1024);
+    SwampMachineContextPool* pool = context->tempPool;
+    if (pool) {
+        const SwampMachineContextPoolEntry* entry = swampMachineContextPoolAcquire(pool);
+        swampStackMemoryInit(&target->stackMemory, entry->stackMemory, SWAMP_CONTEXT_STACK_SIZE);
+        target->callStack.entries = entry->callStackEntries;
+        target->callStack.maxCount = SWAMP_CONTEXT_CALL_STACK_MAX_COUNT;
+        target->callStack.count = 0;
+    } else {
+        uint8_t* stackMemory = tc_malloc(SWAMP_CONTEXT_STACK_SIZE);
+        swampStackMemoryInit(&target->stackMemory, stackMemory, SWAMP_CONTEXT_STACK_SIZE);
+        swampCallstackAlloc(&target->callStack);
+    }
 
     if (!context->debugInfoFiles) {
         CLOG_ERROR("Must have debug info")
@@ -211,6 +306,10 @@ void swampContextCreateTemp(SwampMachineContext* target, const SwampMachineConte
     target->debugInfoFiles = context->debugInfoFiles;
     target->parent = context;
     target->debugString = debugString;
+    target->decodedProgram = context->decodedProgram;
     target->hackIsPredicting = context->hackIsPredicting;
-    swampCallstackAlloc(&target->callStack);
+    target->tempPool = pool;
+    target->workerPool = context->workerPool;
+    target->externalFunction = 0;
+    target->profiler = context->profiler;
 }
@@ -0,0 +1,205 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-runtime/copy_plan.h>
+#include <swamp-typeinfo/typeinfo.h>
+#include <tiny-libc/tiny_libc.h>
+
+static void swampCopyPlanInit(SwampCopyPlan* self, const SwtiType* type)
+{
+    self->type = type;
+    self->steps = 0;
+    self->stepCount = 0;
+    self->stepCapacity = 0;
+    self->containsReferences = 0;
+}
+
+static void swampCopyPlanDestroy(SwampCopyPlan* self)
+{
+    for (size_t i = 0; i < self->stepCount; ++i) {
+        SwampCopyStep* step = &self->steps[i];
+        for (size_t j = 0; j < step->variantCount; ++j) {
+            swampCopyPlanDestroy(&step->variantPlans[j]);
+        }
+        tc_free(step->variantPlans);
+    }
+    tc_free(self->steps);
+    self->steps = 0;
+    self->stepCount = 0;
+    self->stepCapacity = 0;
+}
+
+static SwampCopyStep* swampCopyPlanAddStep(SwampCopyPlan* self, SwampCopyStepType type, size_t offset)
+{
+    if (self->stepCount == self->stepCapacity) {
+        self->stepCapacity = self->stepCapacity == 0 ? 4 : self->stepCapacity * 2;
+        self->steps = tc_realloc(self->steps, sizeof(self->steps[0]) * self->stepCapacity);
+    }
+
+    SwampCopyStep* step = &self->steps[self->stepCount++];
+    step->type = type;
+    step->offset = offset;
+    step->itemPlan = 0;
+    step->variantPlans = 0;
+    step->variantCount = 0;
+
+    return step;
+}
+
+static void swampCopyPlanCompile(SwampCopyPlan* self, SwampCopyPlanCache* cache, const SwtiType* type,
+                                 size_t offset)
+{
+    switch (type->type) {
+        case SwtiTypeBoolean:
+        case SwtiTypeInt:
+        case SwtiTypeFixed:
+        case SwtiTypeChar:
+            break;
+        case SwtiTypeRecord: {
+            const SwtiRecordType* record = (const SwtiRecordType*) type;
+            for (size_t i = 0; i < record->fieldCount; i++) {
+                const SwtiRecordTypeField* field = &record->fields[i];
+                swampCopyPlanCompile(self, cache, field->fieldType, offset + field->memoryOffsetInfo.memoryOffset);
+            }
+        } break;
+        case SwtiTypeTuple: {
+            const SwtiTupleType* tuple = (const SwtiTupleType*) type;
+            for (size_t i = 0; i < tuple->fieldCount; i++) {
+                const SwtiTupleTypeField* field = &tuple->fields[i];
+                swampCopyPlanCompile(self, cache, field->fieldType, offset + field->memoryOffsetInfo.memoryOffset);
+            }
+        } break;
+        case SwtiTypeCustom: {
+            // The variant is only known from the value, so each variant gets its own plan
+            const SwtiCustomType* custom = (const SwtiCustomType*) type;
+            SwampCopyPlan* variantPlans = tc_malloc_type_count(SwampCopyPlan, custom->variantCount);
+            size_t variantStepCount = 0;
+            for (size_t i = 0; i < custom->variantCount; ++i) {
+                const SwtiCustomTypeVariant* variant = custom->variantTypes[i];
+                swampCopyPlanInit(&variantPlans[i], type);
+                for (size_t j = 0; j < variant->paramCount; ++j) {
+                    const SwtiCustomTypeVariantField* field = &variant->fields[j];
+                    swampCopyPlanCompile(&variantPlans[i], cache, field->fieldType,
+                                         field->memoryOffsetInfo.memoryOffset);
+                }
+                variantPlans[i].containsReferences = variantPlans[i].stepCount != 0;
+                variantStepCount += variantPlans[i].stepCount;
+            }
+            if (variantStepCount == 0) {
+                for (size_t i = 0; i < custom->variantCount; ++i) {
+                    swampCopyPlanDestroy(&variantPlans[i]);
+                }
+                tc_free(variantPlans);
+                break;
+            }
+            SwampCopyStep* step = swampCopyPlanAddStep(self, SwampCopyStepCustom, offset);
+            step->variantPlans = variantPlans;
+            step->variantCount = custom->variantCount;
+        } break;
+        case SwtiTypeArray: {
+            // Recursive types find their own plan in the cache, since it is added before it is compiled
+            const SwampCopyPlan* itemPlan = swampCopyPlanFind(cache, ((const SwtiArrayType*) type)->itemType);
+            swampCopyPlanAddStep(self, SwampCopyStepArray, offset)->itemPlan = itemPlan;
+        } break;
+        case SwtiTypeList: {
+            const SwampCopyPlan* itemPlan = swampCopyPlanFind(cache, ((const SwtiListType*) type)->itemType);
+            swampCopyPlanAddStep(self, SwampCopyStepList, offset)->itemPlan = itemPlan;
+        } break;
+        case SwtiTypeFunction:
+            swampCopyPlanAddStep(self, SwampCopyStepFunction, offset);
+            break;
+        case SwtiTypeString:
+            swampCopyPlanAddStep(self, SwampCopyStepString, offset);
+            break;
+        case SwtiTypeBlob:
+            swampCopyPlanAddStep(self, SwampCopyStepBlob, offset);
+            break;
+        case SwtiTypeUnmanaged:
+            swampCopyPlanAddStep(self, SwampCopyStepUnmanaged, offset);
+            break;
+        case SwtiTypeAny:
+        case SwtiTypeAnyMatchingTypes:
+        case SwtiTypeResourceName:
+            swampCopyPlanAddStep(self, SwampCopyStepUnsupported, offset);
+            break;
+        case SwtiTypeAlias:
+            swampCopyPlanCompile(self, cache, ((const SwtiAliasType*) type)->targetType, offset);
+            break;
+        default: {
+            CLOG_ERROR("unknown type %d", type->type)
+        }
+    }
+}
+
+static size_t swampCopyPlanSlot(SwampCopyPlan* const* plans, size_t capacity, const SwtiType* type)
+{
+    size_t mask = capacity - 1;
+    size_t i = (((uintptr_t) type >> 3) * 2654435761u) & mask;
+    while (plans[i] != 0 && plans[i]->type != type) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static void swampCopyPlanCacheGrow(SwampCopyPlanCache* self)
+{
+    size_t capacity = self->planCapacity == 0 ? 64 : self->planCapacity * 2;
+    SwampCopyPlan** plans = tc_malloc_type_count(SwampCopyPlan*, capacity);
+    tc_mem_clear(plans, sizeof(plans[0]) * capacity);
+    for (size_t i = 0; i < self->planCapacity; ++i) {
+        if (self->plans[i]) {
+            plans[swampCopyPlanSlot(plans, capacity, self->plans[i]->type)] = self->plans[i];
+        }
+    }
+    tc_free(self->plans);
+    self->plans = plans;
+    self->planCapacity = capacity;
+}
+
+const SwampCopyPlan* swampCopyPlanFind(SwampCopyPlanCache* self, const SwtiType* type)
+{
+    if (self->planCapacity != 0) {
+        SwampCopyPlan* existing = self->plans[swampCopyPlanSlot(self->plans, self->planCapacity, type)];
+        if (existing) {
+            return existing;
+        }
+    }
+
+    if ((self->planCount + 1) * 2 > self->planCapacity) {
+        swampCopyPlanCacheGrow(self);
+    }
+
+    SwampCopyPlan* plan = tc_malloc_type(SwampCopyPlan);
+    swampCopyPlanInit(plan, type);
+    self->plans[swampCopyPlanSlot(self->plans, self->planCapacity, type)] = plan;
+    self->planCount++;
+
+    swampCopyPlanCompile(plan, self, type, 0);
+    plan->containsReferences = plan->stepCount != 0;
+
+    return plan;
+}
+
+void swampCopyPlanCacheInit(SwampCopyPlanCache* self)
+{
+    self->plans = 0;
+    self->planCount = 0;
+    self->planCapacity = 0;
+}
+
+void swampCopyPlanCacheDestroy(SwampCopyPlanCache* self)
+{
+    for (size_t i = 0; i < self->planCapacity; ++i) {
+        if (self->plans[i]) {
+            swampCopyPlanDestroy(self->plans[i]);
+            tc_free(self->plans[i]);
+        }
+    }
+    tc_free(self->plans);
+    self->plans = 0;
+    self->planCount = 0;
+    self->planCapacity = 0;
+}
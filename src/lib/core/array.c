@@ -108,25 +108,27 @@ static void swampCoreArraySlice(void* result, SwampMachineContext* context, cons
     //const void* ptr = ((const uint8_t*)array->value) + array->itemSize * *index;
 }
 
+static const SwampBindingInfo g_swampCoreArrayBindings[] = {
+    {"Array.fromList", SWAMP_C_FN(swampCoreArrayFromList)},
+    {"Array.toList", SWAMP_C_FN(swampCoreArrayToList)},
+    {"Array.length", SWAMP_C_FN(swampCoreArrayLength)},
+    {"Array.get", SWAMP_C_FN(swampCoreArrayGet)},
+    {"Array.grab", SWAMP_C_FN(swampCoreArrayGrab)},
+    {"Array.set", SWAMP_C_FN(swampCoreArraySet)},
+    {"Array.slice", SWAMP_C_FN(swampCoreArraySlice)},
+    {"Array.repeat", SWAMP_C_FN(swampCoreArrayRepeat)},
+};
+
+const SwampBindingInfo* swampCoreArrayBindings(size_t* outCount)
+{
+    *outCount = sizeof(g_swampCoreArrayBindings) / sizeof(g_swampCoreArrayBindings[0]);
+    return g_swampCoreArrayBindings;
+}
+
 const void* swampCoreArrayFindFunction(const char* fullyQualifiedName)
 {
-    SwampBindingInfo info[] = {
-        {"Array.fromList", SWAMP_C_FN(swampCoreArrayFromList)},
-        {"Array.toList", SWAMP_C_FN(swampCoreArrayToList)},
-        {"Array.length", SWAMP_C_FN(swampCoreArrayLength)},
-        {"Array.get", SWAMP_C_FN(swampCoreArrayGet)},
-        {"Array.grab", SWAMP_C_FN(swampCoreArrayGrab)},
-        {"Array.set", SWAMP_C_FN(swampCoreArraySet)},
-        {"Array.slice", SWAMP_C_FN(swampCoreArraySlice)},
-        {"Array.repeat", SWAMP_C_FN(swampCoreArrayRepeat)},
-    };
-
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreArrayBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
 
@@ -11,6 +11,7 @@
 #include <swamp-runtime/core/types.h>
 #include <swamp-runtime/execute.h>
 #include <swamp-runtime/panic.h>
+#include <swamp-runtime/parallel.h>
 #include <swamp-runtime/swamp.h>
 #include <swamp-runtime/swamp_allocate.h>
 #include <swamp-runtime/types.h>
@@ -105,36 +106,51 @@ static void swampCoreBlobFromList(SwampBlob** result, SwampMachineContext* conte
     *result = targetBlob;
 }
 
-// __externalfn mapToBlob : (Int -> Int) -> Blob -> Blob
-static void swampCoreBlobMapToBlob(SwampBlob** result, SwampMachineContext* context, SwampFunction** _fn, const SwampBlob** _blob)
+// Prepares a call for functions that take Int arguments and return an Int, e.g. mapToBlob
+static void swampCoreBlobPrepareIntCall(SwampPreparedCall* call, SwampMachineContext* ownContext, const SwampFunction* fn,
+                                        size_t intArgumentCount, const char* debugName)
 {
-    const SwampBlob* blob = *_blob;
-    const SwampFunction* fn = *_fn;
-    const uint8_t* sourceItemPointer = blob->octets;
+    const SwampPreparedCallArgument intArguments[2] = {{sizeof(SwampInt32), sizeof(SwampInt32)},
+                                                       {sizeof(SwampInt32), sizeof(SwampInt32)}};
+    if (intArgumentCount > 2 || swampPreparedCallInit(call, ownContext, fn, intArguments, intArgumentCount) < 0) {
+        CLOG_ERROR("%s: could not prepare function", debugName)
+    }
 
-    SwampResult fnResult;
+    if (call->func->returnOctetSize != sizeof(SwampInt32)) {
+        CLOG_ERROR("%s: function must return an Int", debugName)
+    }
+}
 
+typedef struct SwampCoreBlobMapJob {
+    const SwampFunction* fn;
+    const SwampBlob* blob;
+    uint8_t* target;
+    size_t targetItemSize;
+    size_t width;
+} SwampCoreBlobMapJob;
 
-    SwampParameters parameters;
-    parameters.parameterCount = 1;
-    parameters.octetSize = sizeof(SwampInt32);
+static void swampCoreBlobMapToBlobRange(SwampMachineContext* context, size_t startIndex, size_t endIndex, void* userData)
+{
+    const SwampCoreBlobMapJob* job = (const SwampCoreBlobMapJob*) userData;
+    const uint8_t* sourceItemPointer = job->blob->octets + startIndex;
 
     SwampMachineContext ownContext;
     swampContextCreateTemp(&ownContext, context, "mapToBlob()");
-    // , fn->returnOctetSize,
-    //                                                 fn->returnAlign
-    SwampBlob* target = swampBlobAllocatePrepare(context->dynamicMemory, blob->octetCount);
-    uint8_t* targetItemPointer = (uint8_t *)target->octets;
-    for (size_t i = 0; i < blob->octetCount; ++i) {
-        const SwampFunc* internalFunction;
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &internalFunction);
-        fnResult.expectedOctetSize = internalFunction->returnOctetSize;
 
-        SwampInt32 v = *sourceItemPointer;
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
+    SwampPreparedCall call;
+    swampCoreBlobPrepareIntCall(&call, &ownContext, job->fn, 1, "mapToBlob");
 
-        tc_memcpy_octets(ownContext.bp + pos, &v, parameters.octetSize);
-        swampRun(&fnResult, &ownContext, internalFunction, parameters, 1);
+    uint8_t* valueArgument = ownContext.bp + call.argumentPositions[0];
+
+    uint8_t* targetItemPointer = job->target + startIndex;
+    for (size_t i = startIndex; i < endIndex; ++i) {
+        SwampInt32 v = *sourceItemPointer;
+        tc_memcpy_octets(valueArgument, &v, sizeof(SwampInt32));
+        int errorCode = swampPreparedCallInvoke(&call);
+        if (errorCode < 0) {
+            swampPanic(&ownContext, "mapToBlob: function failed %d", errorCode);
+            break;
+        }
         SwampInt32 returnValue = *(SwampInt32*) ownContext.bp;
 
         *targetItemPointer = (uint8_t) returnValue;
@@ -143,6 +159,22 @@ static void swampCoreBlobMapToBlob(SwampBlob** result, SwampMachineContext* cont
     }
 
     swampContextDestroyTemp(&ownContext);
+}
+
+// __externalfn mapToBlob : (Int -> Int) -> Blob -> Blob
+static void swampCoreBlobMapToBlob(SwampBlob** result, SwampMachineContext* context, SwampFunction** _fn, const SwampBlob** _blob)
+{
+    const SwampBlob* blob = *_blob;
+    SwampBlob* target = swampBlobAllocatePrepare(context->dynamicMemory, blob->octetCount);
+
+    SwampCoreBlobMapJob job;
+    job.fn = *_fn;
+    job.blob = blob;
+    job.target = (uint8_t*) target->octets;
+    job.targetItemSize = 1;
+    job.width = 0;
+
+    swampParallelFor(context, blob->octetCount, swampCoreBlobMapToBlobRange, &job);
 
     *result = target;
 }
@@ -152,51 +184,50 @@ static void swampCoreBlobMap2(void)
 {
 }
 
-// __externalfn indexedMapToBlob : (Int -> Int -> Int) -> Blob -> Blob
-static void swampCoreBlobIndexedMapToBlob(SwampBlob** result, SwampMachineContext* context, SwampFunction** _fn,
-                             const SwampBlob** _blob)
+// Calls fn with index and octet for each octet in the blob and stores the result in target (which can be the source)
+static void swampCoreBlobIndexedMapToOctets(uint8_t* target, SwampMachineContext* context, const SwampFunction* fn,
+                                            const SwampBlob* blob, const char* debugName)
 {
-    const SwampBlob* blob = *_blob;
-    const SwampFunction* fn = *_fn;
     const uint8_t* sourceItemPointer = blob->octets;
 
-    SwampResult fnResult;
-    fnResult.expectedOctetSize = 0;
+    SwampMachineContext ownContext;
+    swampContextCreateTemp(&ownContext, context, debugName);
 
-    SwampParameters parameters;
-    parameters.parameterCount = 1;
-    parameters.octetSize = sizeof(SwampInt32);
+    SwampPreparedCall call;
+    swampCoreBlobPrepareIntCall(&call, &ownContext, fn, 2, debugName);
 
-    SwampMachineContext ownContext;
-    swampContextCreateTemp(&ownContext, context, "Blob.indexedMapToBlob");
-    // , fn->returnOctetSize,
-    //                                                 fn->returnAlign
-    SwampBlob* target = swampBlobAllocatePrepare(context->dynamicMemory, blob->octetCount);
-    uint8_t* targetItemPointer = (uint8_t *)target->octets;
+    uint8_t* indexArgument = ownContext.bp + call.argumentPositions[0];
+    uint8_t* valueArgument = ownContext.bp + call.argumentPositions[1];
+
+    uint8_t* targetItemPointer = target;
     for (size_t i = 0; i < blob->octetCount; ++i) {
-        const SwampFunc* internalFunction;
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &internalFunction);
-        fnResult.expectedOctetSize = internalFunction->returnOctetSize;
         SwampInt32 index = i;
-
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &index, sizeof(SwampInt32));
-        pos += sizeof(SwampInt32);
+        tc_memcpy_octets(indexArgument, &index, sizeof(SwampInt32));
 
         SwampInt32 v = *sourceItemPointer;
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &v, sizeof(SwampInt32));
-        pos += sizeof(SwampInt32);
+        tc_memcpy_octets(valueArgument, &v, sizeof(SwampInt32));
 
-        parameters.octetSize = pos;
-        parameters.parameterCount = internalFunction->parameterCount;
-        swampRun(&fnResult, &ownContext, internalFunction, parameters, 1);
+        int errorCode = swampPreparedCallInvoke(&call);
+        if (errorCode < 0) {
+            swampPanic(&ownContext, "%s: function failed %d", debugName, errorCode);
+            break;
+        }
         *targetItemPointer = (uint8_t) (*(SwampInt32*) ownContext.bp);
         sourceItemPointer++;
         targetItemPointer++;
     }
 
     swampContextDestroyTemp(&ownContext);
+}
+
+// __externalfn indexedMapToBlob : (Int -> Int -> Int) -> Blob -> Blob
+static void swampCoreBlobIndexedMapToBlob(SwampBlob** result, SwampMachineContext* context, SwampFunction** _fn,
+                             const SwampBlob** _blob)
+{
+    const SwampBlob* blob = *_blob;
+
+    SwampBlob* target = swampBlobAllocatePrepare(context->dynamicMemory, blob->octetCount);
+    swampCoreBlobIndexedMapToOctets((uint8_t*) target->octets, context, *_fn, blob, "Blob.indexedMapToBlob");
 
     *result = target;
 }
@@ -206,66 +237,68 @@ static void swampCoreBlobIndexedMapToBlobMutable(const SwampBlob** result, Swamp
                                    const SwampBlob** _blob)
 {
     const SwampBlob* blob = *_blob;
-    const SwampFunction* fn = *_fn;
-    const uint8_t* sourceItemPointer = blob->octets;
 
-    SwampResult fnResult;
-    fnResult.expectedOctetSize = 0;
+    swampCoreBlobIndexedMapToOctets((uint8_t*) blob->octets, context, *_fn, blob, "Blob.indexedMapToBlob!()");
 
-    SwampParameters parameters;
-    parameters.parameterCount = 1;
-    parameters.octetSize = sizeof(SwampInt32);
+    *result = blob;
+}
+
+
+static void swampCoreBlobMap2dRange(SwampMachineContext* context, size_t startIndex, size_t endIndex, void* userData)
+{
+    const SwampCoreBlobMapJob* job = (const SwampCoreBlobMapJob*) userData;
+    const uint8_t* sourceItemPointer = job->blob->octets + startIndex;
+    size_t returnSize = job->targetItemSize;
 
     SwampMachineContext ownContext;
-    swampContextCreateTemp(&ownContext, context, "Blob.indexedMapToBlob!()");
+    swampContextCreateTemp(&ownContext, context, "Blob.map2d");
 
-    uint8_t* targetItemPointer = (uint8_t *)blob->octets;
-    for (size_t i = 0; i < blob->octetCount; ++i) {
-        const SwampFunc* internalFunction;
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &internalFunction);
-        fnResult.expectedOctetSize = internalFunction->returnOctetSize;
-        SwampInt32 index = i;
+    SwampPreparedCall call;
+    SwampPreparedCallArgument arguments[2] = {{sizeof(SwampCorePosition2i), sizeof(SwampInt32)},
+                                              {sizeof(SwampInt32), sizeof(SwampInt32)}};
+    if (swampPreparedCallInit(&call, &ownContext, job->fn, arguments, 2) < 0) {
+        CLOG_ERROR("Blob.map2d: could not prepare function")
+    }
 
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &index, sizeof(SwampInt32));
-        pos += sizeof(SwampInt32);
+    if (returnSize != call.func->returnOctetSize) {
+        CLOG_ERROR("Blob.map2d: function return size mismatch %zu vs %zu", returnSize, call.func->returnOctetSize)
+    }
+
+    uint8_t* positionArgument = ownContext.bp + call.argumentPositions[0];
+    uint8_t* valueArgument = ownContext.bp + call.argumentPositions[1];
+
+    size_t width = job->width;
+    uint8_t* targetPointer = job->target + startIndex * returnSize;
+
+    for (size_t i = startIndex; i < endIndex; ++i) {
+        SwampCorePosition2i blobPosition;
+        blobPosition.x = i % width;
+        blobPosition.y = i / width;
+        tc_memcpy_octets(positionArgument, &blobPosition, sizeof(SwampCorePosition2i));
 
         SwampInt32 v = *sourceItemPointer;
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &v, sizeof(SwampInt32));
-        pos += sizeof(SwampInt32);
+        tc_memcpy_octets(valueArgument, &v, sizeof(SwampInt32));
+
+        int errorCode = swampPreparedCallInvoke(&call);
+        if (errorCode < 0) {
+            swampPanic(&ownContext, "Blob.map2d: function failed %d", errorCode);
+            break;
+        }
 
-        parameters.octetSize = pos;
-        parameters.parameterCount = internalFunction->parameterCount;
-        swampRun(&fnResult, &ownContext, internalFunction, parameters, 1);
-        *targetItemPointer = (uint8_t) (*(SwampInt32*) ownContext.bp);
         sourceItemPointer++;
-        targetItemPointer++;
+        tc_memcpy_octets(targetPointer, ownContext.bp, returnSize);
+        targetPointer += returnSize;
     }
 
     swampContextDestroyTemp(&ownContext);
-
-    *result = blob;
 }
 
-
 // __externalfn map2d : ({ x : Int, y : Int } -> Int -> a) -> { width : Int, height : Int } -> Blob -> List a
 static void swampCoreBlobMap2d(SwampList** result, SwampMachineContext* context, SwampFunction** _fn,
                         const SwampCoreSize2i* blobSize, const SwampBlob** _blob)
 {
     const SwampBlob* blob = *_blob;
     const SwampFunction* fn = *_fn;
-    const uint8_t* sourceItemPointer = blob->octets;
-
-    SwampResult fnResult;
-    fnResult.expectedOctetSize = 0;
-
-    SwampParameters parameters;
-    parameters.parameterCount = 1;
-    parameters.octetSize = sizeof(SwampInt32);
-
-    SwampMachineContext ownContext;
-    swampContextCreateTemp(&ownContext, context, "Blob.map2d");
 
     if (blobSize->width <= 0) {
         CLOG_ERROR("width must be greater than zero")
@@ -276,38 +309,15 @@ static void swampCoreBlobMap2d(SwampList** result, SwampMachineContext* context,
     SwtiMemorySize returnSize = swtiGetMemorySize(returnType);
     SwtiMemoryAlign returnAlign = swtiGetMemoryAlign(returnType);
     SwampList* preparedList = swampListAllocatePrepare(context->dynamicMemory, blob->octetCount, returnSize, returnAlign);
-    uint8_t* targetPointer = (uint8_t *) preparedList->value;
 
-    size_t width = blobSize->width;
+    SwampCoreBlobMapJob job;
+    job.fn = fn;
+    job.blob = blob;
+    job.target = (uint8_t*) preparedList->value;
+    job.targetItemSize = returnSize;
+    job.width = blobSize->width;
 
-    for (size_t i = 0; i < blob->octetCount; ++i) {
-        const SwampFunc* internalFunction;
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &internalFunction);
-        fnResult.expectedOctetSize = internalFunction->returnOctetSize;
-
-        SwampCorePosition2i blobPosition;
-        blobPosition.x = i % width;
-        blobPosition.y = i / width;
-
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &blobPosition, sizeof(SwampCorePosition2i));
-        pos += sizeof(SwampCorePosition2i);
-
-        SwampInt32 v = *sourceItemPointer;
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &v, sizeof(SwampInt32));
-        pos += sizeof(SwampInt32);
-
-        parameters.octetSize = pos;
-        parameters.parameterCount = internalFunction->parameterCount;
-        swampRun(&fnResult, &ownContext, internalFunction, parameters, 1);
-
-        sourceItemPointer++;
-        tc_memcpy_octets(targetPointer, ownContext.bp, returnSize);
-        targetPointer += returnSize;
-    }
-
-    swampContextDestroyTemp(&ownContext);
+    swampParallelFor(context, blob->octetCount, swampCoreBlobMap2dRange, &job);
 
     *result = preparedList;
 }
@@ -862,33 +872,35 @@ static void swampCoreBlobMake(SwampBlob** result, SwampMachineContext* context,
     *result = targetBlob;
 }
 
+static const SwampBindingInfo g_swampCoreBlobBindings[] = {
+    {"Blob.toString2d", SWAMP_C_FN(swampCoreBlobToString2d)},
+    {"Blob.mapToBlob", SWAMP_C_FN(swampCoreBlobMapToBlob)},
+    {"Blob.indexedMapToBlob", SWAMP_C_FN(swampCoreBlobIndexedMapToBlob)},
+    {"Blob.filterIndexedMap", SWAMP_C_FN(swampCoreBlobFilterIndexedMap)},
+    {"Blob.indexedMapToBlob!", SWAMP_C_FN(swampCoreBlobIndexedMapToBlobMutable)},
+    {"Blob.filterIndexedMap2d", SWAMP_C_FN(swampCoreBlobFilterIndexedMap2d)},
+    {"Blob.get2d", SWAMP_C_FN(swampCoreBlobGet2d)},
+    {"Blob.fromArray", SWAMP_C_FN(swampCoreBlobFromArray)},
+    {"Blob.fromList", SWAMP_C_FN(swampCoreBlobFromList)},
+    {"Blob.member", SWAMP_C_FN(swampCoreBlobMember)},
+    {"Blob.any", SWAMP_C_FN(swampCoreBlobAny)},
+    {"Blob.fill2d!", SWAMP_C_FN(swampCoreBlobFill2d)},
+    {"Blob.drawWindow2d!", SWAMP_C_FN(swampCoreBlobDrawWindow2d)},
+    {"Blob.copy2d!", SWAMP_C_FN(swampCoreBlobCopy2d)},
+    {"Blob.slice2d", SWAMP_C_FN(swampCoreBlobSlice2d)},
+    {"Blob.make", SWAMP_C_FN(swampCoreBlobMake)},
+    {"Blob.map2d", SWAMP_C_FN(swampCoreBlobMap2d)},
+};
+
+const SwampBindingInfo* swampCoreBlobBindings(size_t* outCount)
+{
+    *outCount = sizeof(g_swampCoreBlobBindings) / sizeof(g_swampCoreBlobBindings[0]);
+    return g_swampCoreBlobBindings;
+}
+
 const void* swampCoreBlobFindFunction(const char* fullyQualifiedName)
 {
-    SwampBindingInfo info[] = {
-        {"Blob.toString2d", SWAMP_C_FN(swampCoreBlobToString2d)},
-        {"Blob.mapToBlob", SWAMP_C_FN(swampCoreBlobMapToBlob)},
-        {"Blob.indexedMapToBlob", SWAMP_C_FN(swampCoreBlobIndexedMapToBlob)},
-        {"Blob.filterIndexedMap", SWAMP_C_FN(swampCoreBlobFilterIndexedMap)},
-        {"Blob.indexedMapToBlob!", SWAMP_C_FN(swampCoreBlobIndexedMapToBlobMutable)},
-        {"Blob.filterIndexedMap2d", SWAMP_C_FN(swampCoreBlobFilterIndexedMap2d)},
-        {"Blob.get2d", SWAMP_C_FN(swampCoreBlobGet2d)},
-        {"Blob.fromArray", SWAMP_C_FN(swampCoreBlobFromArray)},
-        {"Blob.fromList", SWAMP_C_FN(swampCoreBlobFromList)},
-        {"Blob.member", SWAMP_C_FN(swampCoreBlobMember)},
-        {"Blob.any", SWAMP_C_FN(swampCoreBlobAny)},
-        {"Blob.fill2d!", SWAMP_C_FN(swampCoreBlobFill2d)},
-        {"Blob.drawWindow2d!", SWAMP_C_FN(swampCoreBlobDrawWindow2d)},
-        {"Blob.copy2d!", SWAMP_C_FN(swampCoreBlobCopy2d)},
-        {"Blob.slice2d", SWAMP_C_FN(swampCoreBlobSlice2d)},
-        {"Blob.make", SWAMP_C_FN(swampCoreBlobMake)},
-        {"Blob.map2d", SWAMP_C_FN(swampCoreBlobMap2d)},
-    };
-
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreBlobBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
@@ -22,19 +22,21 @@ static void swampCoreCharToCode(SwampInt32* result, SwampMachineContext* context
     *result = *charValue;
 }
 
-const void* swampCoreCharFindFunction(const char* fullyQualifiedName)
+static const SwampBindingInfo g_swampCoreCharBindings[] = {
+    {"Char.fromCode", SWAMP_C_FN(swampCoreCharFromCode)},
+     {"Char.toCode", SWAMP_C_FN(swampCoreCharToCode)},
+    {"Char.ord", SWAMP_C_FN(swampCoreCharOrd)},
+};
+
+const SwampBindingInfo* swampCoreCharBindings(size_t* outCount)
 {
-   SwampBindingInfo info[] = {
-       {"Char.fromCode", SWAMP_C_FN(swampCoreCharFromCode)},
-        {"Char.toCode", SWAMP_C_FN(swampCoreCharToCode)},
-       {"Char.ord", SWAMP_C_FN(swampCoreCharOrd)},
-   };
+    *outCount = sizeof(g_swampCoreCharBindings) / sizeof(g_swampCoreCharBindings[0]);
+    return g_swampCoreCharBindings;
+}
 
-   for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-       if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-           return info[i].fn;
-       }
-   }
-   // SWAMP_LOG_INFO("didn't find: %s", function_name);
-   return 0;
+const void* swampCoreCharFindFunction(const char* fullyQualifiedName)
+{
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreCharBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
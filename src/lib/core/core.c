@@ -12,53 +12,58 @@
 #include <swamp-runtime/core/math.h>
 #include <swamp-runtime/core/maybe.h>
 #include <swamp-runtime/core/bind.h>
+#include <swamp-runtime/binding_registry.h>
 
-const void* swampCoreFindFunction(const char* fullyQualifiedName)
-{
-    const void* foundFn = swampCoreMathFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
+#if !defined TORNADO_OS_WINDOWS
+#include <pthread.h>
+#endif
 
-    foundFn = swampCoreListFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
+typedef const SwampBindingInfo* (*SwampCoreBindingsFn)(size_t* outCount);
 
-    foundFn = swampCoreArrayFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
+// In the same order as the modules were searched before the registry, so duplicate names resolve the same way
+static const SwampCoreBindingsFn g_swampCoreModuleBindings[] = {
+    swampCoreMathBindings,
+    swampCoreListBindings,
+    swampCoreArrayBindings,
+    swampCoreBlobBindings,
+    swampCoreMaybeBindings,
+    swampCoreIntBindings,
+    swampCoreCharBindings,
+    swampCoreStringBindings,
+    swampCoreDebugBindings,
+};
 
-    foundFn = swampCoreBlobFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
-
-    foundFn = swampCoreMaybeFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
+static SwampBindingRegistry g_swampCoreBindingRegistry;
 
-    foundFn = swampCoreIntFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
-
-    foundFn = swampCoreCharFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
+static void swampCoreBindingRegistryCreate(void)
+{
+    swampBindingRegistryInit(&g_swampCoreBindingRegistry);
+    for (size_t i = 0; i < sizeof(g_swampCoreModuleBindings) / sizeof(g_swampCoreModuleBindings[0]); ++i) {
+        size_t count;
+        const SwampBindingInfo* bindings = g_swampCoreModuleBindings[i](&count);
+        swampBindingRegistryAdd(&g_swampCoreBindingRegistry, bindings, count);
     }
+    swampBindingRegistryBuild(&g_swampCoreBindingRegistry);
+}
 
-    foundFn = swampCoreStringFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
+// All core bindings, built the first time it is used. Apps can add it to their own registry.
+const SwampBindingRegistry* swampCoreBindingRegistry(void)
+{
+#if defined TORNADO_OS_WINDOWS
+    static int isCreated = 0;
+    if (!isCreated) {
+        swampCoreBindingRegistryCreate();
+        isCreated = 1;
     }
+#else
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, swampCoreBindingRegistryCreate);
+#endif
 
-    foundFn = swampCoreDebugFindFunction(fullyQualifiedName);
-    if (foundFn) {
-        return foundFn;
-    }
+    return &g_swampCoreBindingRegistry;
+}
 
-    return 0;
+const void* swampCoreFindFunction(const char* fullyQualifiedName)
+{
+    return swampBindingRegistryFind(swampCoreBindingRegistry(), fullyQualifiedName);
 }
@@ -167,20 +167,22 @@ void swampCoreDebugToString(const SwampString** result, SwampMachineContext* con
     *result = swampStringAllocate(context->dynamicMemory, buf);
 }
 
+static const SwampBindingInfo g_swampCoreDebugBindings[] = {
+    {"Debug.log", SWAMP_C_FN(swampCoreDebugLog)},
+    //{"Debug.logAny", SWAMP_C_FN(swampCoreDebugLogAny)},
+    {"Debug.toString", SWAMP_C_FN(swampCoreDebugToString)},
+    {"Debug.panic", SWAMP_C_FN(swampCoreDebugPanic)}
+};
+
+const SwampBindingInfo* swampCoreDebugBindings(size_t* outCount)
+{
+    *outCount = sizeof(g_swampCoreDebugBindings) / sizeof(g_swampCoreDebugBindings[0]);
+    return g_swampCoreDebugBindings;
+}
+
 const void* swampCoreDebugFindFunction(const char* fullyQualifiedName)
 {
-    SwampBindingInfo info[] = {
-        {"Debug.log", SWAMP_C_FN(swampCoreDebugLog)},
-        //{"Debug.logAny", SWAMP_C_FN(swampCoreDebugLogAny)},
-        {"Debug.toString", SWAMP_C_FN(swampCoreDebugToString)},
-        {"Debug.panic", SWAMP_C_FN(swampCoreDebugPanic)}
-    };
-
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreDebugBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
@@ -18,18 +18,20 @@ static void swampCoreIntToFixed(SwampFixed32* result, SwampMachineContext* conte
     *result = *intValue * SWAMP_FIXED_FACTOR;
 }
 
-const void* swampCoreIntFindFunction(const char* fullyQualifiedName)
+static const SwampBindingInfo g_swampCoreIntBindings[] = {
+    {"Int.round", SWAMP_C_FN(swampCoreIntRound)},
+    {"Int.toFixed", SWAMP_C_FN(swampCoreIntToFixed)},
+};
+
+const SwampBindingInfo* swampCoreIntBindings(size_t* outCount)
 {
-    SwampBindingInfo info[] = {
-        {"Int.round", SWAMP_C_FN(swampCoreIntRound)},
-        {"Int.toFixed", SWAMP_C_FN(swampCoreIntToFixed)},
-    };
+    *outCount = sizeof(g_swampCoreIntBindings) / sizeof(g_swampCoreIntBindings[0]);
+    return g_swampCoreIntBindings;
+}
 
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+const void* swampCoreIntFindFunction(const char* fullyQualifiedName)
+{
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreIntBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
@@ -8,6 +8,8 @@
 #include <swamp-runtime/core/list.h>
 #include <swamp-runtime/core/maybe.h>
 #include <swamp-runtime/execute.h>
+#include <swamp-runtime/panic.h>
+#include <swamp-runtime/parallel.h>
 #include <swamp-runtime/swamp.h>
 #include <swamp-runtime/swamp_allocate.h>
 #include <swamp-runtime/types.h>
@@ -85,44 +87,54 @@ static void swampCoreListRange0(SwampList** result, SwampMachineContext* context
 }
 
 
-// (a -> b) -> List a -> List b
-static void swampCoreListMap(SwampList** result, SwampMachineContext* context, SwampFunction** _fn, const SwampList** _list)
-{
-    const SwampList* list = *_list;
-    const SwampFunction* fn = *_fn;
-    const uint8_t* sourceItemPointer = list->value;
+typedef struct SwampCoreListMapJob {
+    const SwampFunction* fn;
+    const SwampList* list;
+    SwampList* target;
+} SwampCoreListMapJob;
 
-    SwampResult fnResult;
-
-    SwampParameters parameters;
-    parameters.octetSize = list->itemSize;
+static void swampCoreListMapRange(SwampMachineContext* context, size_t startIndex, size_t endIndex, void* userData)
+{
+    const SwampCoreListMapJob* job = (const SwampCoreListMapJob*) userData;
+    const SwampList* list = job->list;
+    SwampList* target = job->target;
 
     SwampMachineContext ownContext;
     swampContextCreateTemp(&ownContext, context, "List.map()");
 
-    const SwampFunc* realFunc;
-    swampGetFunc(fn, &realFunc);
-    SwampList* target = swampListAllocatePrepare(context->dynamicMemory, list->count, realFunc->returnOctetSize, realFunc->returnAlign);
-    uint8_t* targetItemPointer = (uint8_t*)target->value;
-    for (size_t i = 0; i < list->count; ++i) {
-        swampContextReset(&ownContext);
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &realFunc);
-        fnResult.expectedOctetSize = realFunc->returnOctetSize;
-        parameters.parameterCount = realFunc->parameterCount;
-        swampMemoryPositionAlign(&pos, list->itemAlign);
-        tc_memcpy_octets(ownContext.bp + pos, sourceItemPointer, list->itemSize);
-        //CLOG_INFO("calling for index %d, value:%d", i, *(const SwampInt32*)sourceItemPointer);
-        swampRun(&fnResult, &ownContext, realFunc, parameters, 1);
-        tc_memcpy_octets(targetItemPointer, ownContext.bp, target->itemSize);
-        sourceItemPointer += list->itemSize;
-        targetItemPointer += target->itemSize;
+    SwampPreparedCall call;
+    SwampPreparedCallArgument item = {list->itemSize, list->itemAlign};
+    if (swampPreparedCallInit(&call, &ownContext, job->fn, &item, 1) < 0) {
+        CLOG_ERROR("List.map: could not prepare function")
     }
 
-    swampContextDestroyTemp(&ownContext);
+    int errorCode = swampPreparedCallInvokeMany(&call, SwampCollectionIndex(list, startIndex), endIndex - startIndex,
+                                                list->itemSize, (uint8_t*) SwampCollectionIndex(target, startIndex),
+                                                target->itemSize);
+    if (errorCode < 0) {
+        swampPanic(&ownContext, "List.map: function failed %d", errorCode);
+    }
 
-    *result = target;
+    swampContextDestroyTemp(&ownContext);
 }
 
+// (a -> b) -> List a -> List b
+static void swampCoreListMap(SwampList** result, SwampMachineContext* context, SwampFunction** _fn, const SwampList** _list)
+{
+    const SwampList* list = *_list;
+
+    const SwampFunc* realFunc;
+    swampGetFunc(*_fn, &realFunc);
+
+    SwampCoreListMapJob job;
+    job.fn = *_fn;
+    job.list = list;
+    job.target = swampListAllocatePrepare(context->dynamicMemory, list->count, realFunc->returnOctetSize, realFunc->returnAlign);
+
+    swampParallelFor(context, list->count, swampCoreListMapRange, &job);
+
+    *result = job.target;
+}
 
 // concatMap : (a -> List b) -> List a -> List b
 static void swampCoreListConcatMap(const SwampList** result, SwampMachineContext* context, SwampFunction** _fn, const SwampList** _list)
@@ -217,35 +229,30 @@ static void swampCoreListMap2(SwampList** result, SwampMachineContext* context,
         countToUse = listB->count;
     }
 
-    SwampResult fnResult;
-
-    SwampParameters parameters;
-
     SwampMachineContext ownContext;
     swampContextCreateTemp(&ownContext, context, "List.map2");
 
-    const SwampFunc* realFunc;
-    swampGetFunc(fn, &realFunc);
-    parameters.octetSize = realFunc->returnOctetSize;
+    SwampPreparedCall call;
+    SwampPreparedCallArgument arguments[2] = {{listA->itemSize, listA->itemAlign}, {listB->itemSize, listB->itemAlign}};
+    if (swampPreparedCallInit(&call, &ownContext, fn, arguments, 2) < 0) {
+        CLOG_ERROR("List.map2: could not prepare function")
+    }
+
+    const SwampFunc* realFunc = call.func;
     SwampList* target = swampListAllocatePrepare(context->dynamicMemory, countToUse, realFunc->returnOctetSize, realFunc->returnAlign);
 
+    uint8_t* argumentA = ownContext.bp + call.argumentPositions[0];
+    uint8_t* argumentB = ownContext.bp + call.argumentPositions[1];
+
     uint8_t* targetItemPointer = (uint8_t*)target->value;
     for (size_t i = 0; i < countToUse; ++i) {
-        swampContextReset(&ownContext);
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &realFunc);
-        fnResult.expectedOctetSize = realFunc->returnOctetSize;
-        parameters.parameterCount = realFunc->parameterCount;
-
-        swampMemoryPositionAlign(&pos, listA->itemAlign);
-        tc_memcpy_octets(ownContext.bp + pos, sourceAItemPointer, listA->itemSize);
-        pos += listA->itemSize;
-
-        swampMemoryPositionAlign(&pos, listB->itemAlign);
-        tc_memcpy_octets(ownContext.bp + pos, sourceBItemPointer, listB->itemSize);
-        pos += listB->itemSize;
-
-        //CLOG_INFO("calling for index %d, value:%d", i, *(const SwampInt32*)sourceItemPointer);
-        swampRun(&fnResult, &ownContext, realFunc, parameters, 1);
+        tc_memcpy_octets(argumentA, sourceAItemPointer, listA->itemSize);
+        tc_memcpy_octets(argumentB, sourceBItemPointer, listB->itemSize);
+        int errorCode = swampPreparedCallInvoke(&call);
+        if (errorCode < 0) {
+            swampPanic(&ownContext, "List.map2: function failed %d", errorCode);
+            break;
+        }
 
         tc_memcpy_octets(targetItemPointer, ownContext.bp, target->itemSize);
         sourceAItemPointer += listA->itemSize;
@@ -258,50 +265,59 @@ static void swampCoreListMap2(SwampList** result, SwampMachineContext* context,
     *result = target;
 }
 
-// indexedMap: (Int -> a -> b) -> List a -> List b
-static void swampCoreListIndexedMap(SwampList** result, SwampMachineContext* context, SwampFunction** _fn, const SwampList** _list)
+static void swampCoreListIndexedMapRange(SwampMachineContext* context, size_t startIndex, size_t endIndex, void* userData)
 {
-    const SwampList* list = *_list;
-    const uint8_t* sourceItemPointer = list->value;
-    const SwampFunction* fn = *_fn;
-
-
-    const SwampFunc* swampFn = 0;
-    swampGetFunc(fn, &swampFn);
-
-    SwampResult fnResult;
-    fnResult.expectedOctetSize = swampFn->returnOctetSize;
-
-    SwampParameters parameters;
-    parameters.parameterCount = swampFn->parameterCount;
-    parameters.octetSize = list->itemSize;
+    const SwampCoreListMapJob* job = (const SwampCoreListMapJob*) userData;
+    const SwampList* list = job->list;
+    SwampList* targetListB = job->target;
+    const uint8_t* sourceItemPointer = SwampCollectionIndex(list, startIndex);
 
     SwampMachineContext ownContext;
     swampContextCreateTemp(&ownContext, context, "List.indexedMap");
 
-    SwampList* targetListB = swampListAllocatePrepare(context->dynamicMemory, list->count, swampFn->returnOctetSize, swampFn->returnAlign);
-    uint8_t* targetItemPointer = (uint8_t*)targetListB->value;
-    for (size_t i = 0; i < list->count; ++i) {
-        const SwampFunc* internalFunction;
-        SwampMemoryPosition pos = swampExecutePrepare(fn, ownContext.bp, &internalFunction);
-        SwampInt32 index = i;
+    SwampPreparedCall call;
+    SwampPreparedCallArgument arguments[2] = {{sizeof(SwampInt32), sizeof(SwampInt32)}, {list->itemSize, list->itemAlign}};
+    if (swampPreparedCallInit(&call, &ownContext, job->fn, arguments, 2) < 0) {
+        CLOG_ERROR("List.indexedMap: could not prepare function")
+    }
 
-        swampMemoryPositionAlign(&pos, sizeof(SwampInt32));
-        tc_memcpy_octets(ownContext.bp + pos, &index, sizeof(SwampInt32));
-        pos += sizeof(SwampInt32);
+    uint8_t* indexArgument = ownContext.bp + call.argumentPositions[0];
+    uint8_t* itemArgument = ownContext.bp + call.argumentPositions[1];
 
-        swampMemoryPositionAlign(&pos, list->itemAlign);
-        tc_memcpy_octets(ownContext.bp + pos, sourceItemPointer, list->itemSize);
-        //CLOG_INFO("calling for index %d, value:%d", i, *(const SwampInt32*)sourceItemPointer);
-        swampRun(&fnResult, &ownContext, internalFunction, parameters, 1);
+    uint8_t* targetItemPointer = (uint8_t*) SwampCollectionIndex(targetListB, startIndex);
+    for (size_t i = startIndex; i < endIndex; ++i) {
+        SwampInt32 index = i;
+        tc_memcpy_octets(indexArgument, &index, sizeof(SwampInt32));
+        tc_memcpy_octets(itemArgument, sourceItemPointer, list->itemSize);
+        int errorCode = swampPreparedCallInvoke(&call);
+        if (errorCode < 0) {
+            swampPanic(&ownContext, "List.indexedMap: function failed %d", errorCode);
+            break;
+        }
         tc_memcpy_octets(targetItemPointer, ownContext.bp, targetListB->itemSize);
         sourceItemPointer += list->itemSize;
         targetItemPointer += targetListB->itemSize;
     }
 
     swampContextDestroyTemp(&ownContext);
+}
+
+// indexedMap: (Int -> a -> b) -> List a -> List b
+static void swampCoreListIndexedMap(SwampList** result, SwampMachineContext* context, SwampFunction** _fn, const SwampList** _list)
+{
+    const SwampList* list = *_list;
+
+    const SwampFunc* swampFn;
+    swampGetFunc(*_fn, &swampFn);
+
+    SwampCoreListMapJob job;
+    job.fn = *_fn;
+    job.list = list;
+    job.target = swampListAllocatePrepare(context->dynamicMemory, list->count, swampFn->returnOctetSize, swampFn->returnAlign);
 
-    *result = targetListB;
+    swampParallelFor(context, list->count, swampCoreListIndexedMapRange, &job);
+
+    *result = job.target;
 }
 
 // any : (a -> Bool) -> List a -> Bool
@@ -652,33 +668,35 @@ static void swampCoreListUnzip(void)
 
 
 
+static const SwampBindingInfo g_swampCoreListBindings[] = {
+    {"List.head", SWAMP_C_FN(swampCoreListHead)},
+    {"List.tail", SWAMP_C_FN(swampCoreListTail)},
+    {"List.isEmpty", SWAMP_C_FN(swampCoreListIsEmpty)},
+    {"List.length", SWAMP_C_FN(swampCoreListLength)},
+    {"List.map", SWAMP_C_FN(swampCoreListMap)},
+    {"List.map2", SWAMP_C_FN(swampCoreListMap2)},
+    {"List.indexedMap", SWAMP_C_FN(swampCoreListIndexedMap)},
+    {"List.filterMap", SWAMP_C_FN(swampCoreListFilterMap)},
+    {"List.foldl", SWAMP_C_FN(swampCoreListFoldl)},
+    {"List.foldlstop", SWAMP_C_FN(swampCoreListFoldlStop)},
+    {"List.reduce", SWAMP_C_FN(swampCoreListReduce)},
+    {"List.any", SWAMP_C_FN(swampCoreListAny)},
+    {"List.find", SWAMP_C_FN(swampCoreListFind)},
+    {"List.member", SWAMP_C_FN(swampCoreListMember)},
+    {"List.range", SWAMP_C_FN(swampCoreListRange)},
+    {"List.range0", SWAMP_C_FN(swampCoreListRange0)},
+    {"List.concatMap", SWAMP_C_FN(swampCoreListConcatMap)},
+};
+
+const SwampBindingInfo* swampCoreListBindings(size_t* outCount)
+{
+    *outCount = sizeof(g_swampCoreListBindings) / sizeof(g_swampCoreListBindings[0]);
+    return g_swampCoreListBindings;
+}
+
 const void* swampCoreListFindFunction(const char* fullyQualifiedName)
 {
-    SwampBindingInfo info[] = {
-        {"List.head", SWAMP_C_FN(swampCoreListHead)},
-        {"List.tail", SWAMP_C_FN(swampCoreListTail)},
-        {"List.isEmpty", SWAMP_C_FN(swampCoreListIsEmpty)},
-        {"List.length", SWAMP_C_FN(swampCoreListLength)},
-        {"List.map", SWAMP_C_FN(swampCoreListMap)},
-        {"List.map2", SWAMP_C_FN(swampCoreListMap2)},
-        {"List.indexedMap", SWAMP_C_FN(swampCoreListIndexedMap)},
-        {"List.filterMap", SWAMP_C_FN(swampCoreListFilterMap)},
-        {"List.foldl", SWAMP_C_FN(swampCoreListFoldl)},
-        {"List.foldlstop", SWAMP_C_FN(swampCoreListFoldlStop)},
-        {"List.reduce", SWAMP_C_FN(swampCoreListReduce)},
-        {"List.any", SWAMP_C_FN(swampCoreListAny)},
-        {"List.find", SWAMP_C_FN(swampCoreListFind)},
-        {"List.member", SWAMP_C_FN(swampCoreListMember)},
-        {"List.range", SWAMP_C_FN(swampCoreListRange)},
-        {"List.range0", SWAMP_C_FN(swampCoreListRange0)},
-        {"List.concatMap", SWAMP_C_FN(swampCoreListConcatMap)},
-    };
-
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreListBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
@@ -271,30 +271,32 @@ static void swampCoreMathMod(SwampInt32* result, SwampMachineContext* context, c
     *result = remainder;
 }
 
+static const SwampBindingInfo g_swampCoreMathBindings[] = {
+    {"Math.remainderBy", SWAMP_C_FN(swampCoreMathRemainderBy)},
+    {"Math.abs", SWAMP_C_FN(swampCoreMathAbs)},
+    {"Math.atan", SWAMP_C_FN(swampCoreMathATan)},
+    {"Math.atan2", SWAMP_C_FN(swampCoreMathATan)},
+    {"Math.clamp", SWAMP_C_FN(swampCoreMathClamp)},
+    {"Math.cos", SWAMP_C_FN(swampCoreMathCos)},
+    {"Math.sin", SWAMP_C_FN(swampCoreMathSin)},
+    {"Math.sign", SWAMP_C_FN(swampCoreMathSign)},
+    {"Math.drunk", SWAMP_C_FN(swampCoreMathRandomDelta)},
+    {"Math.lerp", SWAMP_C_FN(swampCoreMathLerp)},
+    {"Math.metronome", SWAMP_C_FN(swampCoreMathMetronome)},
+    {"Math.mid", SWAMP_C_FN(swampCoreMathMid)},
+    {"Math.mod", SWAMP_C_FN(swampCoreMathMod)},
+    {"Math.rnd", SWAMP_C_FN(swampCoreMathRnd)},
+};
+
+const SwampBindingInfo* swampCoreMathBindings(size_t* outCount)
+{
+    *outCount = sizeof(g_swampCoreMathBindings) / sizeof(g_swampCoreMathBindings[0]);
+    return g_swampCoreMathBindings;
+}
+
 const void* swampCoreMathFindFunction(const char* fullyQualifiedName)
 {
-    SwampBindingInfo info[] = {
-        {"Math.remainderBy", SWAMP_C_FN(swampCoreMathRemainderBy)},
-        {"Math.abs", SWAMP_C_FN(swampCoreMathAbs)},
-        {"Math.atan", SWAMP_C_FN(swampCoreMathATan)},
-        {"Math.atan2", SWAMP_C_FN(swampCoreMathATan)},
-        {"Math.clamp", SWAMP_C_FN(swampCoreMathClamp)},
-        {"Math.cos", SWAMP_C_FN(swampCoreMathCos)},
-        {"Math.sin", SWAMP_C_FN(swampCoreMathSin)},
-        {"Math.sign", SWAMP_C_FN(swampCoreMathSign)},
-        {"Math.drunk", SWAMP_C_FN(swampCoreMathRandomDelta)},
-        {"Math.lerp", SWAMP_C_FN(swampCoreMathLerp)},
-        {"Math.metronome", SWAMP_C_FN(swampCoreMathMetronome)},
-        {"Math.mid", SWAMP_C_FN(swampCoreMathMid)},
-        {"Math.mod", SWAMP_C_FN(swampCoreMathMod)},
-        {"Math.rnd", SWAMP_C_FN(swampCoreMathRnd)},
-    };
-
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreMathBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
@@ -122,18 +122,20 @@ static void swampCoreMaybeMaybe(void* result, SwampMachineContext* context, cons
     swampContextDestroyTemp(&newContext);
 }
 
+static const SwampBindingInfo g_swampCoreMaybeBindings[] = {
+    {"Maybe.withDefault", SWAMP_C_FN(swampCoreMaybeWithDefault)},
+    {"Maybe.maybe", SWAMP_C_FN(swampCoreMaybeMaybe)},
+};
+
+const SwampBindingInfo* swampCoreMaybeBindings(size_t* outCount)
+{
+    *outCount = sizeof(g_swampCoreMaybeBindings) / sizeof(g_swampCoreMaybeBindings[0]);
+    return g_swampCoreMaybeBindings;
+}
+
 const void* swampCoreMaybeFindFunction(const char* fullyQualifiedName)
 {
-    SwampBindingInfo info[] = {
-        {"Maybe.withDefault", SWAMP_C_FN(swampCoreMaybeWithDefault)},
-        {"Maybe.maybe", SWAMP_C_FN(swampCoreMaybeMaybe)},
-    };
-
-    for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-        if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-            return info[i].fn;
-        }
-    }
-    // SWAMP_LOG_INFO("didn't find: %s", function_name);
-    return 0;
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreMaybeBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
@@ -19,17 +19,19 @@ static void swampCoreStringFromInt(const SwampString** result, SwampMachineConte
     *result = s;
 }
 
-const void* swampCoreStringFindFunction(const char* fullyQualifiedName)
+static const SwampBindingInfo g_swampCoreStringBindings[] = {
+    {"String.fromInt", SWAMP_C_FN(swampCoreStringFromInt)},
+};
+
+const SwampBindingInfo* swampCoreStringBindings(size_t* outCount)
 {
-   SwampBindingInfo info[] = {
-       {"String.fromInt", SWAMP_C_FN(swampCoreStringFromInt)},
-   };
+    *outCount = sizeof(g_swampCoreStringBindings) / sizeof(g_swampCoreStringBindings[0]);
+    return g_swampCoreStringBindings;
+}
 
-   for (size_t i = 0; i < sizeof(info) / sizeof(info[0]); ++i) {
-       if (tc_str_equal(info[i].name, fullyQualifiedName)) {
-           return info[i].fn;
-       }
-   }
-   // SWAMP_LOG_INFO("didn't find: %s", function_name);
-   return 0;
+const void* swampCoreStringFindFunction(const char* fullyQualifiedName)
+{
+    size_t count;
+    const SwampBindingInfo* bindings = swampCoreStringBindings(&count);
+    return swampBindingInfoFind(bindings, count, fullyQualifiedName);
 }
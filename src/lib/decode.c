@@ -0,0 +1,726 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-runtime/decode.h>
+#include <swamp-runtime/fixup.h>
+#include <swamp-runtime/ledger.h>
+#include <swamp-runtime/opcodes.h>
+#include <swamp-runtime/static_memory.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define SWAMP_DECODE_NO_INSTRUCTION ((size_t) -1)
+#define SWAMP_DECODE_DATA_ALIGN (8)
+
+// Integer patterns use a jump table if it has at most this many entries per case, otherwise a binary search
+#define SWAMP_DECODE_DENSE_TABLE_FACTOR (4)
+
+// Rewrites common instruction sequences into superinstructions, see g_swampFusionRules
+#if !defined SWAMP_DECODE_FUSE_INSTRUCTIONS
+#define SWAMP_DECODE_FUSE_INSTRUCTIONS (1)
+#endif
+
+typedef struct SwampDecoder {
+    const SwampFunc* func;
+    const uint8_t* opcodes;
+    const SwampStaticMemory* constantStaticMemory;
+    size_t* positionToIndex;
+    SwampInstruction* instructions;
+    uint8_t* data;
+    size_t dataPosition;
+    int error;
+} SwampDecoder;
+
+static uint32_t readU32(const uint8_t** pc)
+{
+    uint32_t value;
+    tc_memcpy_octets(&value, *pc, sizeof(value));
+    *pc += sizeof(value);
+    return value;
+}
+
+static uint16_t readU16(const uint8_t** pc)
+{
+    uint16_t value;
+    tc_memcpy_octets(&value, *pc, sizeof(value));
+    *pc += sizeof(value);
+    return value;
+}
+
+static uint8_t readU8(const uint8_t** pc)
+{
+    uint8_t value = **pc;
+    *pc += 1;
+    return value;
+}
+
+static void* allocateData(SwampDecoder* self, size_t octetCount)
+{
+    size_t rest = self->dataPosition % SWAMP_DECODE_DATA_ALIGN;
+    if (rest != 0) {
+        self->dataPosition += SWAMP_DECODE_DATA_ALIGN - rest;
+    }
+    size_t position = self->dataPosition;
+    self->dataPosition += octetCount;
+
+    return self->data ? self->data + position : 0;
+}
+
+static const SwampInstruction* jumpTarget(SwampDecoder* self, const uint8_t* target)
+{
+    if (!self->instructions) {
+        return 0;
+    }
+
+    size_t position = target - self->opcodes;
+    if (position >= self->func->opcodeCount || self->positionToIndex[position] == SWAMP_DECODE_NO_INSTRUCTION) {
+        CLOG_SOFT_ERROR("decode: illegal jump to %zu in '%s'", position, self->func->debugName)
+        self->error = 1;
+        return 0;
+    }
+
+    return &self->instructions[self->positionToIndex[position]];
+}
+
+// Reads the case list with the cumulative jump offsets into cases, returns the number of cases
+static size_t readCases(SwampDecoder* self, const uint8_t** outPc, int isInteger, SwampInstructionCase* cases,
+                        const uint8_t** outPreviousJumpTarget)
+{
+    const uint8_t* pc = *outPc;
+    size_t caseCount = readU8(&pc);
+    const uint8_t* previousJumpTarget = 0;
+    for (size_t i = 0; i < caseCount; ++i) {
+        cases[i].value = isInteger ? (int32_t) readU32(&pc) : readU8(&pc);
+        uint16_t jumpOffset = readU16(&pc);
+        if (!previousJumpTarget) {
+            previousJumpTarget = pc;
+        }
+        previousJumpTarget += jumpOffset;
+        cases[i].target = jumpTarget(self, previousJumpTarget);
+    }
+
+    *outPc = pc;
+    *outPreviousJumpTarget = previousJumpTarget;
+
+    return caseCount;
+}
+
+// Lowered to a table indexed by the enum variant. 0xff matches any variant and is used for variants outside the table.
+// operands: [0] source, [1] table count. jump is the target for variants outside the table.
+static void decodeEnumCase(SwampDecoder* self, const uint8_t** pc, SwampInstruction* instruction)
+{
+    SwampInstructionCase cases[256];
+    const uint8_t* previousJumpTarget;
+
+    instruction->opcode = SwampOpcodeDecodedEnumCaseTable;
+    instruction->operands[0] = readU32(pc);
+    size_t caseCount = readCases(self, pc, 0, cases, &previousJumpTarget);
+
+    size_t tableCount = 0;
+    const SwampInstruction* anyTarget = 0;
+    for (size_t i = 0; i < caseCount; ++i) {
+        if (cases[i].value == 0xff) {
+            if (!anyTarget) {
+                anyTarget = cases[i].target;
+            }
+        } else if ((size_t) cases[i].value + 1 > tableCount) {
+            tableCount = cases[i].value + 1;
+        }
+    }
+
+    const SwampInstruction** targets = allocateData(self, tableCount * sizeof(SwampInstruction*));
+    if (targets) {
+        for (size_t variant = 0; variant < tableCount; ++variant) {
+            targets[variant] = 0;
+            for (size_t i = 0; i < caseCount; ++i) {
+                if (cases[i].value == (int32_t) variant || cases[i].value == 0xff) {
+                    targets[variant] = cases[i].target;
+                    break;
+                }
+            }
+        }
+    }
+
+    instruction->operands[1] = (uint32_t) tableCount;
+    instruction->jump = anyTarget;
+    instruction->data = targets;
+}
+
+// Lowered to a table indexed by (value - minimum) if the values are dense enough, otherwise to cases sorted on value
+// for a binary search.
+// operands: [0] source, [1] table or case count, [2] minimum value (table only). jump is the default target.
+static void decodePatternMatchingInt(SwampDecoder* self, const uint8_t** pc, SwampInstruction* instruction)
+{
+    SwampInstructionCase cases[256];
+    const uint8_t* previousJumpTarget;
+
+    instruction->operands[0] = readU32(pc);
+    size_t caseCount = readCases(self, pc, 1, cases, &previousJumpTarget);
+    uint16_t defaultJumpOffset = readU16(pc);
+    if (!previousJumpTarget) {
+        previousJumpTarget = *pc;
+    }
+    instruction->jump = jumpTarget(self, previousJumpTarget + defaultJumpOffset);
+
+    // Stable insertion sort, so the first of any duplicate values is kept, the same one the linear scan would match
+    for (size_t i = 1; i < caseCount; ++i) {
+        SwampInstructionCase item = cases[i];
+        size_t j = i;
+        while (j > 0 && cases[j - 1].value > item.value) {
+            cases[j] = cases[j - 1];
+            j--;
+        }
+        cases[j] = item;
+    }
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < caseCount; ++i) {
+        if (uniqueCount == 0 || cases[uniqueCount - 1].value != cases[i].value) {
+            cases[uniqueCount++] = cases[i];
+        }
+    }
+
+    int64_t range = uniqueCount == 0 ? 0 : (int64_t) cases[uniqueCount - 1].value - cases[0].value + 1;
+    if (uniqueCount > 0 && range <= (int64_t) (uniqueCount * SWAMP_DECODE_DENSE_TABLE_FACTOR)) {
+        const SwampInstruction** targets = allocateData(self, (size_t) range * sizeof(SwampInstruction*));
+        if (targets) {
+            for (int64_t i = 0; i < range; ++i) {
+                targets[i] = instruction->jump;
+            }
+            for (size_t i = 0; i < uniqueCount; ++i) {
+                targets[cases[i].value - cases[0].value] = cases[i].target;
+            }
+        }
+        instruction->opcode = SwampOpcodeDecodedPatternMatchingIntTable;
+        instruction->operands[1] = (uint32_t) range;
+        instruction->operands[2] = (uint32_t) cases[0].value;
+        instruction->data = targets;
+    } else {
+        SwampInstructionCase* sortedCases = allocateData(self, uniqueCount * sizeof(SwampInstructionCase));
+        if (sortedCases) {
+            tc_memcpy_octets(sortedCases, cases, uniqueCount * sizeof(SwampInstructionCase));
+        }
+        instruction->opcode = SwampOpcodeDecodedPatternMatchingIntSorted;
+        instruction->operands[1] = (uint32_t) uniqueCount;
+        instruction->data = sortedCases;
+    }
+}
+
+// Lowered to an open addressing hash table on the precomputed string hashes. For duplicate strings the first case is
+// kept.
+// operands: [0] source, [1] table capacity (power of two). jump is the default target.
+static void decodePatternMatchingString(SwampDecoder* self, const uint8_t** pc, SwampInstruction* instruction)
+{
+    instruction->operands[0] = readU32(pc);
+    size_t caseCount = readU8(pc);
+    size_t capacity = 1;
+    while (capacity < caseCount * 2) {
+        capacity *= 2;
+    }
+
+    SwampInstructionStringCase* table = allocateData(self, capacity * sizeof(SwampInstructionStringCase));
+    if (table) {
+        tc_mem_clear(table, capacity * sizeof(SwampInstructionStringCase));
+    }
+
+    const uint8_t* previousJumpTarget = 0;
+    for (size_t i = 0; i < caseCount; ++i) {
+        uint32_t stringPosition = readU32(pc);
+        uint16_t jumpOffset = readU16(pc);
+        if (!previousJumpTarget) {
+            previousJumpTarget = *pc;
+        }
+        previousJumpTarget += jumpOffset;
+        if (!table) {
+            continue;
+        }
+
+        const SwampString* caseString = swampStaticMemoryGet(self->constantStaticMemory, stringPosition);
+        uint32_t hash = swampStringHash(caseString);
+        size_t index = hash & (capacity - 1);
+        while (table[index].string && !swampStringEqual(table[index].string, caseString)) {
+            index = (index + 1) & (capacity - 1);
+        }
+        if (!table[index].string) {
+            table[index].hash = hash;
+            table[index].string = caseString;
+            table[index].target = jumpTarget(self, previousJumpTarget);
+        }
+    }
+    uint16_t defaultJumpOffset = readU16(pc);
+    if (!previousJumpTarget) {
+        previousJumpTarget = *pc;
+    }
+
+    instruction->operands[1] = (uint32_t) capacity;
+    instruction->jump = jumpTarget(self, previousJumpTarget + defaultJumpOffset);
+    instruction->data = table;
+}
+
+static int decodeInstruction(SwampDecoder* self, const uint8_t** outPc, SwampInstruction* instruction)
+{
+    const uint8_t* pc = *outPc;
+
+    instruction->opcodePosition = (uint32_t) (pc - self->opcodes);
+    instruction->opcode = readU8(&pc);
+    instruction->instructionCount = 1;
+    instruction->handler = 0;
+    instruction->jump = 0;
+    instruction->data = 0;
+
+    uint32_t* operands = instruction->operands;
+
+    switch (instruction->opcode) {
+        case SwampOpcodeReturn:
+            break;
+        case SwampOpcodeTailCall:
+            instruction->jump = self->instructions;
+            break;
+        case SwampOpcodeIntAdd:
+        case SwampOpcodeIntSub:
+        case SwampOpcodeIntMul:
+        case SwampOpcodeIntDiv:
+        case SwampOpcodeFixedMul:
+        case SwampOpcodeFixedDiv:
+        case SwampOpcodeIntEqual:
+        case SwampOpcodeIntNotEqual:
+        case SwampOpcodeIntLess:
+        case SwampOpcodeIntLessEqual:
+        case SwampOpcodeIntGreater:
+        case SwampOpcodeIntGreaterOrEqual:
+        case SwampOpcodeStringEqual:
+        case SwampOpcodeStringNotEqual:
+        case SwampOpcodeIntAnd:
+        case SwampOpcodeIntOr:
+        case SwampOpcodeIntXor:
+        case SwampOpcodeListAppend:
+        case SwampOpcodeStringAppend:
+        case SwampOpcodeCmpEnumEqual:
+        case SwampOpcodeCmpEnumNotEqual:
+        case SwampOpcodeIntShiftLeft:
+        case SwampOpcodeIntShiftRight:
+        case SwampOpcodeIntRemainder:
+        case SwampOpcodeBooleanEqual:
+        case SwampOpcodeBooleanNotEqual:
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            operands[2] = readU32(&pc);
+            break;
+        case SwampOpcodeIntNegate:
+        case SwampOpcodeIntNot:
+        case SwampOpcodeBoolNot:
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            break;
+        case SwampOpcodeJump: {
+            uint16_t jump = readU16(&pc);
+            instruction->jump = jumpTarget(self, pc + jump);
+        } break;
+        case SwampOpcodeBranchFalse:
+        case SwampOpcodeBranchTrue: {
+            operands[0] = readU32(&pc);
+            uint16_t jump = readU16(&pc);
+            instruction->jump = jumpTarget(self, pc + jump);
+        } break;
+        case SwampOpcodeCall:
+        case SwampOpcodeCallExternal:
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            break;
+        case SwampOpcodeCurry: {
+            operands[0] = readU32(&pc);
+            uint16_t typeIdIndex = readU16(&pc);
+            uint8_t align = readU8(&pc);
+            operands[1] = typeIdIndex | ((uint32_t) align << 16);
+            operands[2] = readU32(&pc);
+            operands[3] = readU32(&pc);
+            operands[4] = readU16(&pc);
+        } break;
+        case SwampOpcodeEnumCase:
+            decodeEnumCase(self, &pc, instruction);
+            break;
+        case SwampOpcodePatternMatchingInt:
+            decodePatternMatchingInt(self, &pc, instruction);
+            break;
+        case SwampOpcodePatternMatchingString:
+            decodePatternMatchingString(self, &pc, instruction);
+            break;
+        case SwampOpcodeListCreate:
+        case SwampOpcodeArrayCreate: {
+            operands[0] = readU32(&pc);
+            operands[1] = readU16(&pc);
+            operands[2] = readU8(&pc);
+            uint8_t itemCount = readU8(&pc);
+            operands[3] = itemCount;
+            uint32_t* itemPositions = allocateData(self, itemCount * sizeof(uint32_t));
+            for (uint8_t i = 0; i < itemCount; ++i) {
+                uint32_t itemPosition = readU32(&pc);
+                if (itemPositions) {
+                    itemPositions[i] = itemPosition;
+                }
+            }
+            instruction->data = itemPositions;
+        } break;
+        case SwampOpcodeListConj:
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            operands[2] = readU32(&pc);
+            operands[3] = readU16(&pc);
+            operands[4] = readU8(&pc);
+            break;
+        case SwampOpcodeLoadInteger:
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            break;
+        case SwampOpcodeLoadBoolean:
+        case SwampOpcodeLoadRune:
+            operands[0] = readU32(&pc);
+            operands[1] = readU8(&pc);
+            break;
+        case SwampOpcodeLoadZeroMemory: {
+            operands[0] = readU32(&pc);
+            uint32_t staticMemoryPosition = readU32(&pc);
+            instruction->data = swampStaticMemoryGet(self->constantStaticMemory, staticMemoryPosition);
+        } break;
+        case SwampOpcodeMemCopy:
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            operands[2] = readU16(&pc);
+            break;
+        case SwampOpcodeSetEnum:
+            operands[0] = readU32(&pc);
+            operands[1] = readU8(&pc);
+            operands[2] = readU16(&pc);
+            break;
+        case SwampOpcodeCallExternalWithSizes: {
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            uint8_t count = readU8(&pc);
+            operands[2] = count;
+            if (count == 0 || count > SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1) {
+                CLOG_SOFT_ERROR("decode: external call with %u arguments in '%s'", count, self->func->debugName)
+                return -1;
+            }
+            uint32_t* offsets = allocateData(self, count * sizeof(uint32_t));
+            for (uint8_t i = 0; i < count; ++i) {
+                uint16_t offset = readU16(&pc);
+                readU16(&pc); // size
+                if (offsets) {
+                    offsets[i] = offset;
+                }
+            }
+            instruction->data = offsets;
+        } break;
+        case SwampOpcodeCallExternalWithExtendedSizes: {
+            operands[0] = readU32(&pc);
+            operands[1] = readU32(&pc);
+            uint8_t count = readU8(&pc);
+            operands[2] = count;
+            if (count == 0 || count > SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1) {
+                CLOG_SOFT_ERROR("decode: external call with %u arguments in '%s'", count, self->func->debugName)
+                return -1;
+            }
+            uint32_t* offsetSizeAligns = allocateData(self, count * 3 * sizeof(uint32_t));
+            for (uint8_t i = 0; i < count; ++i) {
+                uint16_t offset = readU16(&pc);
+                uint16_t size = readU16(&pc);
+                uint8_t align = readU8(&pc);
+                if (offsetSizeAligns) {
+                    offsetSizeAligns[i * 3] = offset;
+                    offsetSizeAligns[i * 3 + 1] = size;
+                    offsetSizeAligns[i * 3 + 2] = align;
+                }
+            }
+            instruction->data = offsetSizeAligns;
+        } break;
+        default:
+            CLOG_SOFT_ERROR("decode: unknown opcode %02X at %u in '%s'", instruction->opcode,
+                            instruction->opcodePosition, self->func->debugName)
+            return -1;
+    }
+
+    *outPc = pc;
+
+    return self->error ? -2 : 0;
+}
+
+// Decodes all opcodes in the function. If instructions is not set, it only counts instructions and data
+static int decodeFunc(SwampDecoder* self, size_t* outInstructionCount)
+{
+    const uint8_t* pc = self->opcodes;
+    const uint8_t* end = self->opcodes + self->func->opcodeCount;
+    SwampInstruction scratch;
+    size_t index = 0;
+
+    while (pc < end) {
+        if (self->positionToIndex) {
+            self->positionToIndex[pc - self->opcodes] = index;
+        }
+        SwampInstruction* instruction = self->instructions ? &self->instructions[index] : &scratch;
+        int errorCode = decodeInstruction(self, &pc, instruction);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+        index++;
+    }
+
+    if (pc != end) {
+        CLOG_SOFT_ERROR("decode: opcodes did not end on an instruction boundary in '%s'", self->func->debugName)
+        return -3;
+    }
+
+    *outInstructionCount = index;
+
+    return 0;
+}
+
+// Returns 1 if second could be merged into first
+typedef int (*SwampFuseFn)(SwampInstruction* first, const SwampInstruction* second);
+
+typedef struct SwampFusionRule {
+    uint16_t first;
+    uint16_t second;
+    uint16_t fused;
+    SwampFuseFn fuse;
+} SwampFusionRule;
+
+// The compare result is still written, it can be read after the branch
+static int fuseCompareAndBranch(SwampInstruction* first, const SwampInstruction* second)
+{
+    if (second->operands[0] != first->operands[0]) {
+        return 0;
+    }
+    first->jump = second->jump;
+
+    return 1;
+}
+
+// operands: [0] load target, [1] integer, [2] target, [3] other source. The loaded integer is still written.
+static int fuseLoadIntegerAdd(SwampInstruction* first, const SwampInstruction* second)
+{
+    uint32_t loadTarget = first->operands[0];
+    if (second->operands[2] == loadTarget) {
+        first->operands[3] = second->operands[1];
+    } else if (second->operands[1] == loadTarget) {
+        first->operands[3] = second->operands[2];
+    } else {
+        return 0;
+    }
+    first->operands[2] = second->operands[0];
+
+    return 1;
+}
+
+static int fuseLoadIntegerSub(SwampInstruction* first, const SwampInstruction* second)
+{
+    if (second->operands[2] != first->operands[0]) {
+        return 0;
+    }
+    first->operands[2] = second->operands[0];
+    first->operands[3] = second->operands[1];
+
+    return 1;
+}
+
+// The memory copies that follow are kept in place, the fused instruction executes them in sequence
+static int fuseMemCopy(SwampInstruction* first, const SwampInstruction* second)
+{
+    (void) first;
+    (void) second;
+
+    return 1;
+}
+
+static const SwampFusionRule g_swampFusionRules[] = {
+    {SwampOpcodeIntEqual, SwampOpcodeBranchFalse, SwampOpcodeFusedIntEqualBranchFalse, fuseCompareAndBranch},
+    {SwampOpcodeIntNotEqual, SwampOpcodeBranchFalse, SwampOpcodeFusedIntNotEqualBranchFalse, fuseCompareAndBranch},
+    {SwampOpcodeIntLess, SwampOpcodeBranchFalse, SwampOpcodeFusedIntLessBranchFalse, fuseCompareAndBranch},
+    {SwampOpcodeIntLessEqual, SwampOpcodeBranchFalse, SwampOpcodeFusedIntLessEqualBranchFalse, fuseCompareAndBranch},
+    {SwampOpcodeIntGreater, SwampOpcodeBranchFalse, SwampOpcodeFusedIntGreaterBranchFalse, fuseCompareAndBranch},
+    {SwampOpcodeIntGreaterOrEqual, SwampOpcodeBranchFalse, SwampOpcodeFusedIntGreaterOrEqualBranchFalse,
+     fuseCompareAndBranch},
+    {SwampOpcodeIntEqual, SwampOpcodeBranchTrue, SwampOpcodeFusedIntEqualBranchTrue, fuseCompareAndBranch},
+    {SwampOpcodeIntNotEqual, SwampOpcodeBranchTrue, SwampOpcodeFusedIntNotEqualBranchTrue, fuseCompareAndBranch},
+    {SwampOpcodeIntLess, SwampOpcodeBranchTrue, SwampOpcodeFusedIntLessBranchTrue, fuseCompareAndBranch},
+    {SwampOpcodeIntLessEqual, SwampOpcodeBranchTrue, SwampOpcodeFusedIntLessEqualBranchTrue, fuseCompareAndBranch},
+    {SwampOpcodeIntGreater, SwampOpcodeBranchTrue, SwampOpcodeFusedIntGreaterBranchTrue, fuseCompareAndBranch},
+    {SwampOpcodeIntGreaterOrEqual, SwampOpcodeBranchTrue, SwampOpcodeFusedIntGreaterOrEqualBranchTrue,
+     fuseCompareAndBranch},
+    {SwampOpcodeLoadInteger, SwampOpcodeIntAdd, SwampOpcodeFusedIntAddImmediate, fuseLoadIntegerAdd},
+    {SwampOpcodeLoadInteger, SwampOpcodeIntSub, SwampOpcodeFusedIntSubImmediate, fuseLoadIntegerSub},
+    {SwampOpcodeMemCopy, SwampOpcodeMemCopy, SwampOpcodeFusedMemCopyMulti, fuseMemCopy},
+    {SwampOpcodeFusedMemCopyMulti, SwampOpcodeMemCopy, SwampOpcodeFusedMemCopyMulti, fuseMemCopy},
+};
+
+static const SwampFusionRule* findFusionRule(uint16_t first, uint16_t second)
+{
+    for (size_t i = 0; i < sizeof(g_swampFusionRules) / sizeof(g_swampFusionRules[0]); ++i) {
+        const SwampFusionRule* rule = &g_swampFusionRules[i];
+        if (rule->first == first && rule->second == second) {
+            return rule;
+        }
+    }
+
+    return 0;
+}
+
+// The instructions that are merged into a fused instruction are left in place, so jumps to them and all jump
+// targets still work.
+static void fuseInstructions(SwampInstruction* instructions, size_t instructionCount)
+{
+    for (size_t i = 0; i < instructionCount;) {
+        SwampInstruction* first = &instructions[i];
+        size_t nextIndex = i + first->instructionCount;
+        if (nextIndex < instructionCount) {
+            const SwampInstruction* second = &instructions[nextIndex];
+            const SwampFusionRule* rule = findFusionRule(first->opcode, second->opcode);
+            if (rule && rule->fuse(first, second)) {
+                first->opcode = rule->fused;
+                first->instructionCount += second->instructionCount;
+                continue;
+            }
+        }
+        i = nextIndex;
+    }
+}
+
+static size_t swampDecodedProgramHash(const SwampFunc* func, size_t capacity)
+{
+    uint64_t hash = (uint64_t) (uintptr_t) func * 0x9E3779B97F4A7C15ull;
+
+    return (size_t) (hash >> 32) & (capacity - 1);
+}
+
+const SwampDecodedFunc* swampDecodedProgramFind(const SwampDecodedProgram* self, const SwampFunc* func)
+{
+    size_t mask = self->lookupCapacity - 1;
+    for (size_t i = swampDecodedProgramHash(func, self->lookupCapacity);; i = (i + 1) & mask) {
+        const SwampDecodedFunc* decodedFunc = self->lookup[i];
+        if (decodedFunc == 0 || decodedFunc->func == func) {
+            return decodedFunc;
+        }
+    }
+}
+
+int swampDecodedProgramInit(SwampDecodedProgram* self, const SwampLedger* ledger,
+                            const SwampStaticMemory* constantStaticMemory)
+{
+    const SwampConstantLedgerEntry* entries = (const SwampConstantLedgerEntry*) ledger->ledgerOctets;
+
+    tc_mem_clear(self, sizeof(*self));
+
+    SwampDecoder decoder;
+    tc_mem_clear(&decoder, sizeof(decoder));
+    decoder.constantStaticMemory = constantStaticMemory;
+
+    size_t maxOpcodeCount = 0;
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        if (entry->constantType != LedgerTypeFunc) {
+            continue;
+        }
+        const SwampFunc* func = (const SwampFunc*) swampLedgerEntryPointer(ledger, entry);
+        decoder.func = func;
+        decoder.opcodes = func->opcodes;
+        size_t instructionCount;
+        int errorCode = decodeFunc(&decoder, &instructionCount);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+        self->instructionCount += instructionCount;
+        self->funcCount++;
+        if (func->opcodeCount > maxOpcodeCount) {
+            maxOpcodeCount = func->opcodeCount;
+        }
+    }
+
+    self->dataSize = decoder.dataPosition;
+    self->funcs = tc_malloc_type_count(SwampDecodedFunc, self->funcCount);
+    self->instructions = tc_malloc_type_count(SwampInstruction, self->instructionCount);
+    self->data = tc_malloc(self->dataSize + 1);
+    self->lookupCapacity = 8;
+    while (self->lookupCapacity < self->funcCount * 2) {
+        self->lookupCapacity *= 2;
+    }
+    self->lookup = tc_malloc_type_count(const SwampDecodedFunc*, self->lookupCapacity);
+    tc_mem_clear(self->lookup, sizeof(self->lookup[0]) * self->lookupCapacity);
+
+    size_t* positionToIndex = tc_malloc_type_count(size_t, maxOpcodeCount + 1);
+    decoder.dataPosition = 0;
+
+    SwampInstruction* instructions = self->instructions;
+    size_t funcIndex = 0;
+    int errorCode = 0;
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        if (entry->constantType != LedgerTypeFunc) {
+            continue;
+        }
+        const SwampFunc* func = (const SwampFunc*) swampLedgerEntryPointer(ledger, entry);
+        decoder.func = func;
+        decoder.opcodes = func->opcodes;
+
+        // First find where each instruction starts, so jumps can be resolved
+        for (size_t i = 0; i < func->opcodeCount; ++i) {
+            positionToIndex[i] = SWAMP_DECODE_NO_INSTRUCTION;
+        }
+        size_t instructionCount;
+        size_t dataPosition = decoder.dataPosition;
+        decoder.positionToIndex = positionToIndex;
+        decodeFunc(&decoder, &instructionCount);
+
+        decoder.dataPosition = dataPosition;
+        decoder.instructions = instructions;
+        decoder.data = self->data;
+        errorCode = decodeFunc(&decoder, &instructionCount);
+        decoder.instructions = 0;
+        decoder.data = 0;
+        decoder.positionToIndex = 0;
+        if (errorCode < 0) {
+            break;
+        }
+
+#if SWAMP_DECODE_FUSE_INSTRUCTIONS
+        fuseInstructions(instructions, instructionCount);
+#endif
+
+        SwampDecodedFunc* decodedFunc = &self->funcs[funcIndex++];
+        decodedFunc->func = func;
+        decodedFunc->instructions = instructions;
+        decodedFunc->instructionCount = instructionCount;
+        instructions += instructionCount;
+
+        size_t mask = self->lookupCapacity - 1;
+        size_t i = swampDecodedProgramHash(func, self->lookupCapacity);
+        while (self->lookup[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        self->lookup[i] = decodedFunc;
+    }
+
+    tc_free(positionToIndex);
+
+    if (errorCode < 0) {
+        swampDecodedProgramDestroy(self);
+        return errorCode;
+    }
+
+    for (size_t i = 0; i < self->instructionCount; ++i) {
+        self->instructions[i].handler = swampRunInstructionHandler(self->instructions[i].opcode);
+    }
+
+    return 0;
+}
+
+void swampDecodedProgramDestroy(SwampDecodedProgram* self)
+{
+    tc_free(self->funcs);
+    tc_free(self->instructions);
+    tc_free(self->data);
+    tc_free(self->lookup);
+    self->funcs = 0;
+    self->instructions = 0;
+    self->data = 0;
+    self->lookup = 0;
+    self->funcCount = 0;
+    self->instructionCount = 0;
+}
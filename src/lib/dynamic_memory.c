@@ -4,24 +4,84 @@
  *--------------------------------------------------------------------------------------------*/
 #include <clog/clog.h>
 #include <imprint/allocator.h>
+#include <swamp-runtime/allocation_profiler.h>
 #include <swamp-runtime/dynamic_memory.h>
 #include <swamp-runtime/log.h>
+#include <tiny-libc/tiny_libc.h>
 
-void swampDynamicMemoryInit(SwampDynamicMemory* self, void* memory, size_t maxOctetSize)
+// Fills memory with recognizable patterns, 0xfa for never allocated, 0xfd for allocated, 0xce after reset and
+// 0xbc after destroy. It writes all allocated memory an extra time, so it is only on by default for debug builds.
+#if !defined SWAMP_DYNAMIC_MEMORY_POISON
+#if defined CONFIGURATION_DEBUG || SWAMP_DYNAMIC_MEMORY_DEBUG
+#define SWAMP_DYNAMIC_MEMORY_POISON (1)
+#else
+#define SWAMP_DYNAMIC_MEMORY_POISON (0)
+#endif
+#endif
+
+// Same as swampDynamicMemoryInit, but leaves the memory as is, since it is borrowed from another dynamic memory
+void swampDynamicMemoryInitSlice(SwampDynamicMemory* self, void* memory, size_t maxOctetSize)
 {
     self->memory = memory;
     self->p = memory;
     self->maxAllocatedSize = maxOctetSize;
-    tc_memset_octets(memory, 0xfa, maxOctetSize);
 
-    self->ledgerCapacity = 512;
+    self->ledgerCapacity = 0;
     self->ledgerCount = 0;
-#if SWAMP_DYNAMIC_MEMORY_DEBUG
-    self->ledgerEntries = tc_malloc_type_count(SwampDynamicMemoryLedgerEntry, self->ledgerCapacity);
-    #else
     self->ledgerEntries = 0;
-    #endif
     self->ownAlloc = 0;
+
+    self->blocks = 0;
+    self->blockCount = 0;
+    self->blockCapacity = 0;
+    self->blockIndex = 0;
+    self->blockOctetSize = 0;
+    self->previousBlocksAllocatedSize = 0;
+    self->peakAllocatedSize = 0;
+    self->growCount = 0;
+    self->conjFront = 0;
+    self->conjBufferStart = 0;
+    self->stringAppendEnd = 0;
+    self->stringAppendBufferEnd = 0;
+    self->unterminatedStrings = 0;
+    self->unterminatedStringCount = 0;
+    self->unterminatedStringCapacity = 0;
+    self->allocationProfiler = 0;
+}
+
+void swampDynamicMemoryInit(SwampDynamicMemory* self, void* memory, size_t maxOctetSize)
+{
+    swampDynamicMemoryInitSlice(self, memory, maxOctetSize);
+#if SWAMP_DYNAMIC_MEMORY_POISON
+    tc_memset_octets(memory, 0xfa, maxOctetSize);
+#endif
+}
+
+static void swampDynamicMemoryInitBlocks(SwampDynamicMemory* self, void* memory, size_t maxOctetSize,
+                                         size_t blockOctetSize)
+{
+    self->blockOctetSize = blockOctetSize;
+    self->blockCapacity = 8;
+    self->blocks = tc_malloc_type_count(SwampDynamicMemoryBlock, self->blockCapacity);
+    self->blocks[0].memory = memory;
+    self->blocks[0].octetSize = maxOctetSize;
+    self->blockCount = 1;
+}
+
+// memory is used as the first block. When it is full, blocks of (at least) blockOctetSize are allocated and chained.
+// The blocks are kept on reset and reused for the following allocations.
+void swampDynamicMemoryInitGrowable(SwampDynamicMemory* self, void* memory, size_t maxOctetSize, size_t blockOctetSize)
+{
+    swampDynamicMemoryInit(self, memory, maxOctetSize);
+    swampDynamicMemoryInitBlocks(self, memory, maxOctetSize, blockOctetSize);
+}
+
+// Same as swampDynamicMemoryInitSlice, but moves on to blocks of its own when the slice is full
+void swampDynamicMemoryInitGrowableSlice(SwampDynamicMemory* self, void* memory, size_t maxOctetSize,
+                                         size_t blockOctetSize)
+{
+    swampDynamicMemoryInitSlice(self, memory, maxOctetSize);
+    swampDynamicMemoryInitBlocks(self, memory, maxOctetSize, blockOctetSize);
 }
 
 void swampDynamicMemoryInitOwnAlloc(SwampDynamicMemory* self, struct ImprintAllocator* allocator, size_t maxOctetSize)
@@ -32,9 +92,36 @@ void swampDynamicMemoryInitOwnAlloc(SwampDynamicMemory* self, struct ImprintAllo
 
 void swampDynamicMemoryReset(SwampDynamicMemory* self)
 {
+    size_t allocatedSize = swampDynamicMemoryAllocatedSize(self);
+    if (allocatedSize > self->peakAllocatedSize) {
+        self->peakAllocatedSize = allocatedSize;
+    }
+
+    if (self->blockCount > 0) {
+        self->blockIndex = 0;
+        self->memory = self->blocks[0].memory;
+        self->maxAllocatedSize = self->blocks[0].octetSize;
+        self->previousBlocksAllocatedSize = 0;
+    }
+
     self->p = self->memory;
     self->ledgerCount = 0;
-#if SWAMP_DYNAMIC_MEMORY_DEBUG
+    self->conjFront = 0;
+    self->conjBufferStart = 0;
+    self->stringAppendEnd = 0;
+    self->stringAppendBufferEnd = 0;
+    if (self->unterminatedStringCount > 0) {
+        tc_mem_clear(self->unterminatedStrings,
+                     sizeof(self->unterminatedStrings[0]) * self->unterminatedStringCapacity);
+        self->unterminatedStringCount = 0;
+    }
+    if (self->allocationProfiler) {
+        swampAllocationProfilerEndFrame(self->allocationProfiler);
+    }
+#if SWAMP_DYNAMIC_MEMORY_POISON
+    for (size_t i = 1; i < self->blockCount; ++i) {
+        tc_memset_octets(self->blocks[i].memory, 0xce, self->blocks[i].octetSize);
+    }
     tc_memset_octets(self->memory, 0xce, self->maxAllocatedSize);
 #endif
 }
@@ -44,8 +131,27 @@ void swampDynamicMemoryDestroy(SwampDynamicMemory* self)
     if (self->ledgerEntries != 0) {
         tc_free(self->ledgerEntries);
     }
+    if (self->unterminatedStrings != 0) {
+        tc_free(self->unterminatedStrings);
+        self->unterminatedStrings = 0;
+        self->unterminatedStringCount = 0;
+        self->unterminatedStringCapacity = 0;
+    }
+    if (self->blockCount > 0) {
+        // the first block is owned by the caller
+        for (size_t i = 1; i < self->blockCount; ++i) {
+            tc_free(self->blocks[i].memory);
+        }
+        self->memory = self->blocks[0].memory;
+        self->maxAllocatedSize = self->blocks[0].octetSize;
+        tc_free(self->blocks);
+        self->blocks = 0;
+        self->blockCount = 0;
+    }
     if (self->ownAlloc) {
+#if SWAMP_DYNAMIC_MEMORY_POISON
         tc_memset_octets(self->memory, 0xbc, self->maxAllocatedSize);
+#endif
         tc_free(self->memory);
         self->memory = 0;
     }
@@ -61,10 +167,108 @@ void swampDynamicMemoryDebugOutput(const SwampDynamicMemory* self)
 
 size_t swampDynamicMemoryAllocatedSize(const SwampDynamicMemory* self)
 {
-    return self->p - self->memory;
+    return self->previousBlocksAllocatedSize + (self->p - self->memory);
 }
 
-void* swampDynamicMemoryAlloc(SwampDynamicMemory* self, size_t itemCount, size_t itemSize, size_t align)
+// True if the pointer is in memory that has been allocated since the last reset
+int swampDynamicMemoryOwns(const SwampDynamicMemory* self, const void* pointer)
+{
+    const uint8_t* octets = pointer;
+    if (octets >= self->memory && octets < self->p) {
+        return 1;
+    }
+
+    // The blocks before the current one are all in use
+    for (size_t i = 0; i < self->blockIndex; ++i) {
+        const SwampDynamicMemoryBlock* block = &self->blocks[i];
+        if (octets >= block->memory && octets < block->memory + block->octetSize) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void swampDynamicMemoryGetStats(const SwampDynamicMemory* self, SwampDynamicMemoryStats* stats)
+{
+    stats->allocatedSize = swampDynamicMemoryAllocatedSize(self);
+    stats->peakAllocatedSize = self->peakAllocatedSize > stats->allocatedSize ? self->peakAllocatedSize
+                                                                              : stats->allocatedSize;
+    stats->growCount = self->growCount;
+    if (self->blockCount == 0) {
+        stats->blockCount = 1;
+        stats->blocksOctetSize = self->maxAllocatedSize;
+        stats->blocksInUseCount = 1;
+        return;
+    }
+
+    stats->blockCount = self->blockCount;
+    stats->blocksInUseCount = self->blockIndex + 1;
+    stats->blocksOctetSize = 0;
+    for (size_t i = 0; i < self->blockCount; ++i) {
+        stats->blocksOctetSize += self->blocks[i].octetSize;
+    }
+}
+
+// Moves on to the next block that has room for octetCount octets, allocating a new one if needed
+static int swampDynamicMemoryNextBlock(SwampDynamicMemory* self, size_t octetCount)
+{
+    if (self->blockCount == 0) {
+        return -1;
+    }
+
+    size_t allocatedSize = swampDynamicMemoryAllocatedSize(self);
+    if (allocatedSize > self->peakAllocatedSize) {
+        self->peakAllocatedSize = allocatedSize;
+    }
+
+    size_t nextIndex = self->blockIndex + 1;
+    if (nextIndex == self->blockCount || self->blocks[nextIndex].octetSize < octetCount) {
+        if (self->blockCount == self->blockCapacity) {
+            size_t newCapacity = self->blockCapacity * 2;
+            SwampDynamicMemoryBlock* newBlocks = tc_malloc_type_count(SwampDynamicMemoryBlock, newCapacity);
+            tc_memcpy_octets(newBlocks, self->blocks, self->blockCount * sizeof(SwampDynamicMemoryBlock));
+            tc_free(self->blocks);
+            self->blocks = newBlocks;
+            self->blockCapacity = newCapacity;
+        }
+        // Insert it directly after the current block, the blocks after it are still available for reuse
+        for (size_t i = self->blockCount; i > nextIndex; --i) {
+            self->blocks[i] = self->blocks[i - 1];
+        }
+        size_t octetSize = octetCount > self->blockOctetSize ? octetCount : self->blockOctetSize;
+        SwampDynamicMemoryBlock* block = &self->blocks[nextIndex];
+        block->memory = tc_malloc(octetSize);
+        block->octetSize = octetSize;
+#if SWAMP_DYNAMIC_MEMORY_POISON
+        tc_memset_octets(block->memory, 0xfa, octetSize);
+#endif
+        self->blockCount++;
+        self->growCount++;
+    }
+
+    self->previousBlocksAllocatedSize += self->p - self->memory;
+    self->blockIndex = nextIndex;
+    self->memory = self->blocks[nextIndex].memory;
+    self->maxAllocatedSize = self->blocks[nextIndex].octetSize;
+    self->p = self->memory;
+
+    return 0;
+}
+
+// Makes sure that the current block has at least octetCount octets free
+int swampDynamicMemoryReserve(SwampDynamicMemory* self, size_t octetCount)
+{
+    size_t usedSize = self->p - self->memory;
+    if (usedSize + octetCount <= self->maxAllocatedSize) {
+        return 0;
+    }
+
+    return swampDynamicMemoryNextBlock(self, octetCount);
+}
+
+static void* swampDynamicMemoryAllocInternal(SwampDynamicMemory* self, size_t itemCount, size_t itemSize,
+                                             size_t align, const char* debug)
 {
     if (align == 0 || align > 8) {
         CLOG_ERROR("illegal align")
@@ -79,31 +283,44 @@ void* swampDynamicMemoryAlloc(SwampDynamicMemory* self, size_t itemCount, size_t
 
 
     size_t total = itemCount * itemSize;
-    if (total > 2 * 1024 * 1024) {
+    if (total > 2 * 1024 * 1024 && self->blockCount == 0) {
         CLOG_ERROR("too large allocation %zu", total);
     }
     size_t usedSize = (uintptr_t )self->p - (uintptr_t )self->memory;
     if (usedSize + total > (long)self->maxAllocatedSize) {
-        SWAMP_LOG_ERROR("overrrun dynamic memory. Requested %zu items of %zu at %I64d of %zu", itemCount, itemSize, self->p - self->memory, self->maxAllocatedSize);
-        return 0;
+        if (swampDynamicMemoryNextBlock(self, total) < 0) {
+            SWAMP_LOG_ERROR("overrrun dynamic memory. Requested %zu items of %zu at %I64d of %zu", itemCount, itemSize, self->p - self->memory, self->maxAllocatedSize);
+            return 0;
+        }
     }
 
     void* allocated = self->p;
 
+#if SWAMP_DYNAMIC_MEMORY_POISON
     tc_memset_octets(self->p, 0xfd, total);
+#endif
 
     self->p += total;
 
+    if (self->allocationProfiler) {
+        swampAllocationProfilerAdd(self->allocationProfiler, total, debug);
+    }
 
     return allocated;
 }
 
+void* swampDynamicMemoryAlloc(SwampDynamicMemory* self, size_t itemCount, size_t itemSize, size_t align)
+{
+    return swampDynamicMemoryAllocInternal(self, itemCount, itemSize, align, 0);
+}
+
 void* swampDynamicMemoryAllocDebug(SwampDynamicMemory* self, size_t itemCount, size_t itemSize, size_t align, const char* debug)
 {
+    #if SWAMP_DYNAMIC_MEMORY_DEBUG
     if (self->ledgerCount == self->ledgerCapacity) {
-        CLOG_ERROR("out of ledger space");
+        self->ledgerCapacity = self->ledgerCapacity == 0 ? 512 : self->ledgerCapacity * 2;
+        self->ledgerEntries = tc_realloc(self->ledgerEntries, sizeof(self->ledgerEntries[0]) * self->ledgerCapacity);
     }
-    #if SWAMP_DYNAMIC_MEMORY_DEBUG
 
     SwampDynamicMemoryLedgerEntry * entry = &self->ledgerEntries[self->ledgerCount];
     self->ledgerCount++;
@@ -113,5 +330,5 @@ void* swampDynamicMemoryAllocDebug(SwampDynamicMemory* self, size_t itemCount, s
     entry->itemAlign = align;
     #endif
 
-    return swampDynamicMemoryAlloc(self, itemCount, itemSize, align);
+    return swampDynamicMemoryAllocInternal(self, itemCount, itemSize, align, debug);
 }
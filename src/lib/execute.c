@@ -3,7 +3,10 @@
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
 #include <clog/clog.h>
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/decode.h>
 #include <swamp-runtime/execute.h>
+#include <swamp-runtime/swamp.h>
 #include <swamp-runtime/types.h>
 #include <tiny-libc/tiny_libc.h>
 
@@ -44,3 +47,106 @@ int swampGetFunc(const SwampFunction* fn, const SwampFunc** outFn)
 
     return 0;
 }
+
+// The arguments are placed after the return value and the curried parameters, and must fill the parameters of the
+// function. Curried functions do not know how many parameters were curried, so they must have at least one more.
+int swampPreparedCallInit(SwampPreparedCall* self, SwampMachineContext* context, const SwampFunction* fn,
+                          const SwampPreparedCallArgument* arguments, size_t argumentCount)
+{
+    const SwampFunc* func;
+    if (fn->type == SwampFunctionTypeCurry) {
+        const SwampCurryFunc* curry = (const SwampCurryFunc*) fn;
+        func = curry->curryFunction;
+        self->curryOctets = curry->curryOctets;
+        self->curryOctetSize = curry->curryOctetSize;
+        self->curryPosition = func->returnOctetSize;
+        swampMemoryPositionAlign(&self->curryPosition, curry->firstParameterAlign);
+        self->argumentsPosition = self->curryPosition + curry->curryOctetSize;
+    } else if (fn->type == SwampFunctionTypeInternal) {
+        func = (const SwampFunc*) fn;
+        self->curryOctets = 0;
+        self->curryOctetSize = 0;
+        self->curryPosition = func->returnOctetSize;
+        self->argumentsPosition = func->returnOctetSize;
+    } else {
+        CLOG_SOFT_ERROR("prepared call: unknown function type %d", fn->type)
+        return -1;
+    }
+
+    if (func->returnOctetSize + func->parametersOctetSize > context->stackMemory.maximumStackMemory) {
+        CLOG_SOFT_ERROR("prepared call: '%s' needs more stack memory than is available", func->debugName)
+        return -2;
+    }
+
+    int isCurry = fn->type == SwampFunctionTypeCurry;
+    if (argumentCount > SWAMP_PREPARED_CALL_MAX_ARGUMENT_COUNT ||
+        (isCurry ? argumentCount >= func->parameterCount : argumentCount != func->parameterCount)) {
+        CLOG_SOFT_ERROR("prepared call: '%s' takes %zu parameters, can not be called with %zu%s arguments",
+                        func->debugName, func->parameterCount, argumentCount, isCurry ? " more" : "")
+        return -3;
+    }
+
+    SwampMemoryPosition position = self->argumentsPosition;
+    for (size_t i = 0; i < argumentCount; ++i) {
+        swampMemoryPositionAlign(&position, arguments[i].align);
+        self->argumentPositions[i] = position;
+        position += arguments[i].octetSize;
+    }
+    self->argumentCount = argumentCount;
+
+    // Only padding is allowed after the last argument
+    SwampMemoryPosition parametersEnd = func->returnOctetSize + func->parametersOctetSize;
+    swampMemoryPositionAlign(&parametersEnd, 8);
+    if (position > parametersEnd) {
+        CLOG_SOFT_ERROR("prepared call: the arguments end at %u, after the parameters of '%s' (%u)", position,
+                        func->debugName, parametersEnd)
+        return -4;
+    }
+
+    self->context = context;
+    self->func = func;
+    self->decodedFunc = context->decodedProgram ? swampDecodedProgramFind(context->decodedProgram, func) : 0;
+    self->result.expectedOctetSize = func->returnOctetSize;
+
+    return 0;
+}
+
+// The curried parameters are copied for every invoke, since the function is allowed to overwrite its own
+// parameters (e.g. for tail calls).
+int swampPreparedCallInvoke(SwampPreparedCall* self)
+{
+    uint8_t* bp = self->context->bp;
+    if (self->curryOctetSize > 0) {
+        tc_memcpy_octets(bp + self->curryPosition, self->curryOctets, self->curryOctetSize);
+    }
+
+    return swampRunPrepared(&self->result, self->context, self->func, self->decodedFunc);
+}
+
+// Calls the function once for each item, with the item as the only non curried argument. The return values are
+// written to results, one every resultStride octets.
+int swampPreparedCallInvokeMany(SwampPreparedCall* self, const uint8_t* items, size_t itemCount, size_t itemSize,
+                                uint8_t* results, size_t resultStride)
+{
+    if (self->argumentCount != 1) {
+        CLOG_SOFT_ERROR("prepared call: invoke many is only for functions with one argument")
+        return -1;
+    }
+
+    uint8_t* bp = self->context->bp;
+    uint8_t* itemTarget = bp + self->argumentPositions[0];
+    size_t returnOctetSize = self->func->returnOctetSize;
+
+    for (size_t i = 0; i < itemCount; ++i) {
+        tc_memcpy_octets(itemTarget, items, itemSize);
+        int errorCode = swampPreparedCallInvoke(self);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+        tc_memcpy_octets(results, bp, returnOctetSize);
+        items += itemSize;
+        results += resultStride;
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/external.h>
+#include <tiny-libc/tiny_libc.h>
+
+static void swampExternalThunk0(void* result, SwampMachineContext* context, const void* const* arguments,
+                                size_t argumentCount)
+{
+    ((SwampExternalFunction0) context->externalFunction->typedFunction)(result, context);
+}
+
+static void swampExternalThunk1(void* result, SwampMachineContext* context, const void* const* arguments,
+                                size_t argumentCount)
+{
+    ((SwampExternalFunction1) context->externalFunction->typedFunction)(result, context, arguments[0]);
+}
+
+static void swampExternalThunk2(void* result, SwampMachineContext* context, const void* const* arguments,
+                                size_t argumentCount)
+{
+    ((SwampExternalFunction2) context->externalFunction->typedFunction)(result, context, arguments[0], arguments[1]);
+}
+
+static void swampExternalThunk3(void* result, SwampMachineContext* context, const void* const* arguments,
+                                size_t argumentCount)
+{
+    ((SwampExternalFunction3) context->externalFunction->typedFunction)(result, context, arguments[0], arguments[1],
+                                                                        arguments[2]);
+}
+
+static void swampExternalThunk4(void* result, SwampMachineContext* context, const void* const* arguments,
+                                size_t argumentCount)
+{
+    ((SwampExternalFunction4) context->externalFunction->typedFunction)(result, context, arguments[0], arguments[1],
+                                                                        arguments[2], arguments[3]);
+}
+
+static void swampExternalThunk5(void* result, SwampMachineContext* context, const void* const* arguments,
+                                size_t argumentCount)
+{
+    ((SwampExternalFunction5) context->externalFunction->typedFunction)(result, context, arguments[0], arguments[1],
+                                                                        arguments[2], arguments[3], arguments[4]);
+}
+
+// Indexed with the parameter count
+static const SwampExternalFunctionArguments g_swampExternalThunks[] = {
+    swampExternalThunk0, swampExternalThunk1, swampExternalThunk2,
+    swampExternalThunk3, swampExternalThunk4, swampExternalThunk5,
+};
+
+void swampFunctionExternalBindArguments(SwampFunctionExternal* self, SwampExternalFunctionArguments function)
+{
+    self->call = function;
+    self->typedFunction = 0;
+}
+
+int swampFunctionExternalBindTyped(SwampFunctionExternal* self, SwampExternalFunction typedFunction)
+{
+    if (self->parameterCount > SWAMP_FUNCTION_EXTERNAL_MAX_TYPED_PARAMETER_COUNT) {
+        CLOG_SOFT_ERROR("external function '%s' has %zu parameters, typed functions support at most %d",
+                        self->fullyQualifiedName, self->parameterCount,
+                        SWAMP_FUNCTION_EXTERNAL_MAX_TYPED_PARAMETER_COUNT)
+        return -1;
+    }
+
+    self->call = g_swampExternalThunks[self->parameterCount];
+    self->typedFunction = typedFunction;
+
+    return 0;
+}
+
+int swampFunctionExternalBind(SwampFunctionExternal* self, SwampResolveExternalFunction bindFn,
+                              SwampResolveExternalFunctionArguments bindArgumentsFn)
+{
+    if (self->parameterCount > SWAMP_FUNCTION_EXTERNAL_MAX_PARAMETER_COUNT) {
+        CLOG_SOFT_ERROR("external function '%s' has too many parameters (%zu)", self->fullyQualifiedName,
+                        self->parameterCount)
+        return -1;
+    }
+
+    if (bindArgumentsFn) {
+        SwampExternalFunctionArguments function = bindArgumentsFn(self->fullyQualifiedName);
+        if (function) {
+            swampFunctionExternalBindArguments(self, function);
+            return 0;
+        }
+    }
+
+    const void* resolvedFunction = bindFn ? bindFn(self->fullyQualifiedName) : 0;
+    if (resolvedFunction == 0) {
+        CLOG_SOFT_ERROR("you must provide pointer for function '%s'", self->fullyQualifiedName);
+        return -1;
+    }
+
+    // The resolve function returns the function as an object pointer (like dlsym), ISO C does not allow a cast
+    SwampExternalFunction typedFunction;
+    tc_memcpy_octets(&typedFunction, &resolvedFunction, sizeof(typedFunction));
+
+    return swampFunctionExternalBindTyped(self, typedFunction);
+}
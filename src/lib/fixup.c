@@ -8,6 +8,7 @@
 #include <swamp-runtime/context.h>
 #include <swamp-runtime/debug.h>
 #include <swamp-runtime/debug_variables.h>
+#include <swamp-runtime/external.h>
 
 static void logMemory(const uint8_t* octets, size_t count) {
     const uint8_t* p = octets;
@@ -24,6 +25,12 @@ static void logMemory(const uint8_t* octets, size_t count) {
 
 
 const SwampFunc* swampFixupLedger(const uint8_t* const dynamicMemoryOctets, SwampResolveExternalFunction bindFn, const SwampConstantLedgerEntry* entries) {
+    return swampFixupLedgerWithArguments(dynamicMemoryOctets, bindFn, 0, entries);
+}
+
+const SwampFunc* swampFixupLedgerWithArguments(const uint8_t* const dynamicMemoryOctets, SwampResolveExternalFunction bindFn,
+                                               SwampResolveExternalFunctionArguments bindArgumentsFn,
+                                               const SwampConstantLedgerEntry* entries) {
     const SwampFunc* entryFunc = 0;
     const SwampConstantLedgerEntry* entry = entries;
     int detectedError = 0;
@@ -56,35 +63,11 @@ const SwampFunc* swampFixupLedger(const uint8_t* const dynamicMemoryOctets, Swam
                 SwampFunctionExternal* func = (SwampFunctionExternal *)p;
                 FIXUP_DYNAMIC_STRING(func->fullyQualifiedName);
                 //CLOG_INFO("looking up external function '%s'", func->fullyQualifiedName);
-                const void* resolvedFunctionPointer = bindFn(func->fullyQualifiedName);
-                if (resolvedFunctionPointer == 0) {
-                    CLOG_SOFT_ERROR("you must provide pointer for function '%s'", func->fullyQualifiedName);
+                if (swampFunctionExternalBind(func, bindFn, bindArgumentsFn) < 0) {
                     detectedError = 1;
                     entry++;
                     continue;
                 }
-                switch (func->parameterCount) {
-                    case 0:
-                        func->function0 = (SwampExternalFunction0) resolvedFunctionPointer;
-                        break;
-                    case 1:
-                        func->function1 = (SwampExternalFunction1) resolvedFunctionPointer;
-                        break;
-                    case 2:
-                        func->function2 = (SwampExternalFunction2) resolvedFunctionPointer;
-                        break;
-                    case 3:
-                        func->function3 = (SwampExternalFunction3) resolvedFunctionPointer;
-                        break;
-                    case 4:
-                        func->function4 = (SwampExternalFunction4) resolvedFunctionPointer;
-                        break;
-                    case 5:
-                        func->function5 = (SwampExternalFunction5) resolvedFunctionPointer;
-                        break;
-                    default:
-                        CLOG_ERROR("paramcount above 5 or below 0 is not supported (%zu)", func->parameterCount)
-                }
 //                CLOG_INFO("set now as parameter count %d", func->parameterCount);
   //              CLOG_INFO("  externalFunction: %s parameter count %d", func->fullyQualifiedName, func->parameterCount)
     //            CLOG_INFO("  externalFunction external: return pos %d range %d", func->returnValue.pos, func->returnValue.range);
@@ -2,26 +2,166 @@
  *  Copyright (c) Peter Bjorklund. All rights reserved.
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
 #include <swamp-runtime/ledger.h>
 #include <swamp-runtime/types.h>
 #include <swamp-runtime/fixup.h>
 #include <swamp-runtime/debug.h>
+#include <swamp-runtime/relocation.h>
+#include <tiny-libc/tiny_libc.h>
 
 void swampLedgerInit(SwampLedger* self, const uint8_t* ledgerOctets, size_t ledgerSize, const uint8_t* constantStaticMemory)
 {
     self->ledgerOctets =ledgerOctets;
     self->ledgerSize = ledgerSize;
     self->constantStaticMemory = constantStaticMemory;
+    self->relocation = 0;
+    self->index = 0;
+}
+
+const void* swampLedgerEntryPointer(const SwampLedger* self, const SwampConstantLedgerEntry* entry)
+{
+    if (self->relocation) {
+        return swampStaticRelocationGet(self->relocation, entry->offset);
+    }
+
+    return self->constantStaticMemory + entry->offset;
+}
+
+static uint32_t swampLedgerNameHash(const char* name)
+{
+    return swampHashFnv1a(SWAMP_FNV1A_OFFSET_BASIS, name, tc_strlen(name));
+}
+
+static size_t swampLedgerCapacity(size_t count)
+{
+    size_t capacity = 8;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+static SwampLedgerTypeIndexEntry* swampLedgerTypeIndexEntry(const SwampLedgerIndex* index, uint16_t typeIndex)
+{
+    size_t mask = index->typeIndexCapacity - 1;
+    size_t i = (typeIndex * 2654435761u) & mask;
+    while (index->typeIndices[i].count != 0 && index->typeIndices[i].typeIndex != typeIndex) {
+        i = (i + 1) & mask;
+    }
+
+    return &index->typeIndices[i];
+}
+
+// Builds hash tables for the functions, so lookups by name and type index don't have to walk the ledger.
+// Must be called after the ledger is fixed up or relocated, since the function names are read.
+void swampLedgerBuildIndex(SwampLedger* self)
+{
+    const SwampConstantLedgerEntry* entries = (const SwampConstantLedgerEntry*) self->ledgerOctets;
+
+    SwampLedgerIndex* index = tc_malloc_type(SwampLedgerIndex);
+    tc_mem_clear(index, sizeof(*index));
+
+    size_t funcCount = 0;
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        if (entry->constantType == LedgerTypeFunc) {
+            funcCount++;
+        }
+        if (entry->constantType < SWAMP_LEDGER_TYPE_COUNT && index->firstOfType[entry->constantType] == 0) {
+            index->firstOfType[entry->constantType] = swampLedgerEntryPointer(self, entry);
+        }
+    }
+
+    index->funcCount = funcCount;
+    index->nameCapacity = swampLedgerCapacity(funcCount);
+    index->names = tc_malloc_type_count(SwampLedgerNameEntry, index->nameCapacity);
+    tc_mem_clear(index->names, sizeof(index->names[0]) * index->nameCapacity);
+    index->typeIndexCapacity = swampLedgerCapacity(funcCount);
+    index->typeIndices = tc_malloc_type_count(SwampLedgerTypeIndexEntry, index->typeIndexCapacity);
+    tc_mem_clear(index->typeIndices, sizeof(index->typeIndices[0]) * index->typeIndexCapacity);
+    index->funcsByTypeIndex = tc_malloc_type_count(const SwampFunc*, funcCount + 1);
+
+    size_t nameMask = index->nameCapacity - 1;
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        if (entry->constantType != LedgerTypeFunc) {
+            continue;
+        }
+        const SwampFunc* func = (const SwampFunc*) swampLedgerEntryPointer(self, entry);
+
+        // The first function with a name wins, the same as when walking the ledger
+        uint32_t hash = swampLedgerNameHash(func->debugName);
+        size_t i = hash & nameMask;
+        while (index->names[i].func != 0 &&
+               !(index->names[i].hash == hash && tc_str_equal(index->names[i].func->debugName, func->debugName))) {
+            i = (i + 1) & nameMask;
+        }
+        if (index->names[i].func == 0) {
+            index->names[i].hash = hash;
+            index->names[i].func = func;
+        }
+
+        SwampLedgerTypeIndexEntry* typeIndexEntry = swampLedgerTypeIndexEntry(index, func->typeIndex);
+        typeIndexEntry->typeIndex = func->typeIndex;
+        typeIndexEntry->count++;
+    }
+
+    // Give each type index its range in funcsByTypeIndex, then fill the ranges in ledger order
+    size_t first = 0;
+    for (size_t i = 0; i < index->typeIndexCapacity; ++i) {
+        SwampLedgerTypeIndexEntry* typeIndexEntry = &index->typeIndices[i];
+        typeIndexEntry->first = first;
+        first += typeIndexEntry->count;
+        typeIndexEntry->count = 0;
+    }
+
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        if (entry->constantType != LedgerTypeFunc) {
+            continue;
+        }
+        const SwampFunc* func = (const SwampFunc*) swampLedgerEntryPointer(self, entry);
+        SwampLedgerTypeIndexEntry* typeIndexEntry = swampLedgerTypeIndexEntry(index, func->typeIndex);
+        index->funcsByTypeIndex[typeIndexEntry->first + typeIndexEntry->count++] = func;
+    }
+
+    self->index = index;
+}
+
+void swampLedgerDestroyIndex(SwampLedger* self)
+{
+    SwampLedgerIndex* index = self->index;
+    if (index == 0) {
+        return;
+    }
+
+    tc_free(index->names);
+    tc_free(index->typeIndices);
+    tc_free(index->funcsByTypeIndex);
+    tc_free(index);
+    self->index = 0;
 }
 
 const SwampFunc* swampLedgerFindFunction(const SwampLedger* self, const char* name)
 {
-    const uint8_t* const constantStaticMemory = self->constantStaticMemory;
+    const SwampLedgerIndex* index = self->index;
+    if (index) {
+        uint32_t hash = swampLedgerNameHash(name);
+        size_t mask = index->nameCapacity - 1;
+        size_t i = hash & mask;
+        while (index->names[i].func != 0) {
+            if (index->names[i].hash == hash && tc_str_equal(index->names[i].func->debugName, name)) {
+                return index->names[i].func;
+            }
+            i = (i + 1) & mask;
+        }
+        return 0;
+    }
+
     const SwampConstantLedgerEntry* entries = (const SwampConstantLedgerEntry*) self->ledgerOctets;
 
     const SwampConstantLedgerEntry* entry = entries;
     while (entry->constantType != 0) {
-        const uint8_t* p = (constantStaticMemory + entry->offset);
+        const uint8_t* p = swampLedgerEntryPointer(self, entry);
         switch (entry->constantType) {
             case LedgerTypeFunc: {
                 const SwampFunc* func = (const SwampFunc*) p;
@@ -36,43 +176,49 @@ const SwampFunc* swampLedgerFindFunction(const SwampLedger* self, const char* na
     return 0;
 }
 
-const SwampDebugInfoFiles* swampLedgerGetDebugInfoFiles(const SwampLedger* self)
+// Returns all functions with the type index, in ledger order. Needs the index.
+const SwampFunc* const* swampLedgerFindFunctionsWithTypeIndex(const SwampLedger* self, uint16_t typeIndex,
+                                                              size_t* outCount)
 {
-    const uint8_t* const constantStaticMemory = self->constantStaticMemory;
-    const SwampConstantLedgerEntry* entries = ( const SwampConstantLedgerEntry*)  self->ledgerOctets;
+    const SwampLedgerIndex* index = self->index;
+    if (index == 0) {
+        CLOG_SOFT_ERROR("swampLedgerFindFunctionsWithTypeIndex: ledger has no index")
+        *outCount = 0;
+        return 0;
+    }
 
-    const SwampConstantLedgerEntry* entry = entries;
-    while (entry->constantType != 0) {
-        const uint8_t* p = (constantStaticMemory + entry->offset);
-        switch (entry->constantType) {
-            case LedgerTypeDebugInfoFiles: {
-                const SwampDebugInfoFiles* debugInfoFiles = (const SwampDebugInfoFiles*) p;
-                    return debugInfoFiles;
-            }
-        }
-        entry++;
+    const SwampLedgerTypeIndexEntry* typeIndexEntry = swampLedgerTypeIndexEntry(index, typeIndex);
+    *outCount = typeIndexEntry->count;
+    if (typeIndexEntry->count == 0) {
+        return 0;
     }
 
-    return 0;
+    return &index->funcsByTypeIndex[typeIndexEntry->first];
 }
 
-const SwampResourceNameChunkEntry* swampLedgerFindResourceNames(const SwampLedger* self)
+// Returns the first constant of a ledger type (e.g. LedgerTypeDebugInfoFiles)
+const void* swampLedgerFindFirstOfType(const SwampLedger* self, uint32_t constantType)
 {
-    const uint8_t* const constantStaticMemory = self->constantStaticMemory;
-    const SwampConstantLedgerEntry* entries = ( const SwampConstantLedgerEntry*)  self->ledgerOctets;
+    if (self->index) {
+        return constantType < SWAMP_LEDGER_TYPE_COUNT ? self->index->firstOfType[constantType] : 0;
+    }
 
-    const SwampConstantLedgerEntry* entry = entries;
-    while (entry->constantType != 0) {
-        const uint8_t* p = (constantStaticMemory + entry->offset);
-        switch (entry->constantType) {
-            case LedgerTypeResourceNameChunk: {
-                const SwampResourceNameChunkEntry* resourceNames = (const SwampResourceNameChunkEntry*) p;
-                //CLOG_INFO("resource name count %d first is '%s'", resourceNames->resourceCount, *resourceNames->resourceNames);
-                return resourceNames;
-            }
+    const SwampConstantLedgerEntry* entries = (const SwampConstantLedgerEntry*) self->ledgerOctets;
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        if (entry->constantType == constantType) {
+            return swampLedgerEntryPointer(self, entry);
         }
-        entry++;
     }
 
     return 0;
 }
+
+const SwampDebugInfoFiles* swampLedgerGetDebugInfoFiles(const SwampLedger* self)
+{
+    return (const SwampDebugInfoFiles*) swampLedgerFindFirstOfType(self, LedgerTypeDebugInfoFiles);
+}
+
+const SwampResourceNameChunkEntry* swampLedgerFindResourceNames(const SwampLedger* self)
+{
+    return (const SwampResourceNameChunkEntry*) swampLedgerFindFirstOfType(self, LedgerTypeResourceNameChunk);
+}
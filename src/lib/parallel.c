@@ -0,0 +1,305 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-runtime/allocation_profiler.h>
+#include <swamp-runtime/parallel.h>
+#include <swamp-runtime/swamp_allocate.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+// Runs tasks until there are no more to take. Must be called with the mutex locked.
+static void swampWorkerPoolRunTasksLocked(SwampWorkerPool* self)
+{
+    while (self->nextTaskIndex < self->taskCount) {
+        size_t taskIndex = self->nextTaskIndex++;
+#if SWAMP_PARALLEL_USE_PTHREADS
+        pthread_mutex_unlock(&self->mutex);
+#endif
+        self->task(self->taskUserData, taskIndex);
+#if SWAMP_PARALLEL_USE_PTHREADS
+        pthread_mutex_lock(&self->mutex);
+#endif
+        self->completedTaskCount++;
+#if SWAMP_PARALLEL_USE_PTHREADS
+        if (self->completedTaskCount == self->taskCount) {
+            pthread_cond_signal(&self->workDone);
+        }
+#endif
+    }
+}
+
+#if SWAMP_PARALLEL_USE_PTHREADS
+static void* swampWorkerPoolThread(void* userData)
+{
+    SwampWorkerPool* self = (SwampWorkerPool*) userData;
+    size_t handledGeneration = 0;
+
+    pthread_mutex_lock(&self->mutex);
+    while (1) {
+        while (!self->quit && self->generation == handledGeneration) {
+            pthread_cond_wait(&self->workAvailable, &self->mutex);
+        }
+        if (self->quit) {
+            break;
+        }
+        handledGeneration = self->generation;
+        swampWorkerPoolRunTasksLocked(self);
+    }
+    pthread_mutex_unlock(&self->mutex);
+
+    return 0;
+}
+#endif
+
+int swampWorkerPoolInit(SwampWorkerPool* self, size_t threadCount)
+{
+#if !SWAMP_PARALLEL_USE_PTHREADS
+    threadCount = 0;
+#endif
+    if (threadCount > SWAMP_WORKER_POOL_MAX_THREAD_COUNT) {
+        threadCount = SWAMP_WORKER_POOL_MAX_THREAD_COUNT;
+    }
+
+    self->threadCount = 0;
+    self->task = 0;
+    self->taskUserData = 0;
+    self->taskCount = 0;
+    self->nextTaskIndex = 0;
+    self->completedTaskCount = 0;
+    self->generation = 0;
+    self->quit = 0;
+    self->minimumItemCount = SWAMP_WORKER_POOL_MINIMUM_ITEM_COUNT;
+    self->sliceOctetSize = SWAMP_WORKER_POOL_SLICE_OCTET_SIZE;
+    self->serialRerunCount = 0;
+
+    for (size_t i = 0; i < SWAMP_WORKER_POOL_MAX_THREAD_COUNT + 1; ++i) {
+        SwampWorkerSlot* slot = &self->slots[i];
+        swampMachineContextPoolInit(&slot->tempPool);
+        slot->tempResult = 0;
+        slot->tempResultSize = 0;
+    }
+
+#if SWAMP_PARALLEL_USE_PTHREADS
+    pthread_mutex_init(&self->mutex, 0);
+    pthread_cond_init(&self->workAvailable, 0);
+    pthread_cond_init(&self->workDone, 0);
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        int errorCode = pthread_create(&self->threads[i], 0, swampWorkerPoolThread, self);
+        if (errorCode != 0) {
+            CLOG_SOFT_ERROR("swampWorkerPoolInit: could not create worker thread %d", errorCode)
+            swampWorkerPoolDestroy(self);
+            return -1;
+        }
+        self->threadCount++;
+    }
+#endif
+
+    return 0;
+}
+
+void swampWorkerPoolDestroy(SwampWorkerPool* self)
+{
+#if SWAMP_PARALLEL_USE_PTHREADS
+    pthread_mutex_lock(&self->mutex);
+    self->quit = 1;
+    pthread_cond_broadcast(&self->workAvailable);
+    pthread_mutex_unlock(&self->mutex);
+
+    for (size_t i = 0; i < self->threadCount; ++i) {
+        pthread_join(self->threads[i], 0);
+    }
+
+    pthread_cond_destroy(&self->workDone);
+    pthread_cond_destroy(&self->workAvailable);
+    pthread_mutex_destroy(&self->mutex);
+#endif
+
+    for (size_t i = 0; i < SWAMP_WORKER_POOL_MAX_THREAD_COUNT + 1; ++i) {
+        SwampWorkerSlot* slot = &self->slots[i];
+        swampMachineContextPoolDestroy(&slot->tempPool);
+        if (slot->tempResult) {
+            tc_free(slot->tempResult);
+            slot->tempResult = 0;
+            slot->tempResultSize = 0;
+        }
+    }
+    self->threadCount = 0;
+}
+
+// Runs task(userData, taskIndex) for all task indices on the worker threads and the calling thread.
+// Returns when all tasks are completed.
+void swampWorkerPoolRun(SwampWorkerPool* self, SwampWorkerPoolTask task, void* userData, size_t taskCount)
+{
+#if SWAMP_PARALLEL_USE_PTHREADS
+    pthread_mutex_lock(&self->mutex);
+#endif
+    self->task = task;
+    self->taskUserData = userData;
+    self->taskCount = taskCount;
+    self->nextTaskIndex = 0;
+    self->completedTaskCount = 0;
+    self->generation++;
+#if SWAMP_PARALLEL_USE_PTHREADS
+    pthread_cond_broadcast(&self->workAvailable);
+#endif
+
+    swampWorkerPoolRunTasksLocked(self);
+
+#if SWAMP_PARALLEL_USE_PTHREADS
+    while (self->completedTaskCount < self->taskCount) {
+        pthread_cond_wait(&self->workDone, &self->mutex);
+    }
+    pthread_mutex_unlock(&self->mutex);
+#endif
+}
+
+typedef struct SwampParallelJob {
+    SwampWorkerPool* pool;
+    const SwampMachineContext* context;
+    SwampParallelRange range;
+    void* userData;
+    size_t count;
+    size_t taskCount;
+} SwampParallelJob;
+
+static void swampParallelTask(void* userData, size_t taskIndex)
+{
+    const SwampParallelJob* job = (const SwampParallelJob*) userData;
+    SwampWorkerSlot* slot = &job->pool->slots[taskIndex];
+
+    // The ranges only depend on the task index, so the result is the same no matter which thread runs the task
+    size_t startIndex = job->count * taskIndex / job->taskCount;
+    size_t endIndex = job->count * (taskIndex + 1) / job->taskCount;
+
+    SwampMachineContext workerRoot = *job->context;
+    workerRoot.dynamicMemory = &slot->dynamicMemory;
+    workerRoot.unmanagedMemory = job->context->unmanagedMemory ? &slot->unmanagedMemory : 0;
+    workerRoot.tempResult = slot->tempResult;
+    workerRoot.tempPool = &slot->tempPool;
+    workerRoot.workerPool = 0;
+    workerRoot.profiler = 0;
+
+    SwampMachineContext workerContext;
+    swampContextCreateTemp(&workerContext, &workerRoot, "worker");
+    job->range(&workerContext, startIndex, endIndex, job->userData);
+    swampContextDestroyTemp(&workerContext);
+}
+
+// Calls range for [0, count). If the context has a worker pool and there are enough items, the items are split into
+// one range per thread, each running on its own temp context with its own slice of the dynamic memory. The range
+// function must only write the result for its own items, so the output is the same as for a single range.
+void swampParallelFor(SwampMachineContext* context, size_t count, SwampParallelRange range, void* userData)
+{
+    SwampWorkerPool* pool = context->workerPool;
+    if (!pool || pool->threadCount == 0 || count < pool->minimumItemCount) {
+        range(context, 0, count, userData);
+        return;
+    }
+
+    size_t taskCount = pool->threadCount + 1;
+    SwampDynamicMemory* memory = context->dynamicMemory;
+
+    // The workers can pass strings of the caller to external functions, but must not terminate them in its memory
+    swampStringTerminateAll(memory);
+
+    // Growable dynamic memory can move on to a new block if the current one is too small for the slices
+    swampDynamicMemoryReserve(memory, taskCount * pool->sliceOctetSize + 8);
+
+    size_t usedSize = memory->p - memory->memory;
+    size_t rest = usedSize % 8;
+    if (rest != 0) {
+        usedSize += 8 - rest;
+    }
+
+    size_t freeSize = usedSize < memory->maxAllocatedSize ? memory->maxAllocatedSize - usedSize : 0;
+    size_t sliceSize = (freeSize / taskCount) & ~(size_t) 7;
+    if (sliceSize > pool->sliceOctetSize) {
+        sliceSize = pool->sliceOctetSize;
+    }
+
+    if (sliceSize == 0) {
+        range(context, 0, count, userData);
+        return;
+    }
+
+    uint8_t* sliceMemory = memory->memory + usedSize;
+    for (size_t i = 0; i < taskCount; ++i) {
+        SwampWorkerSlot* slot = &pool->slots[i];
+        swampDynamicMemoryInitGrowableSlice(&slot->dynamicMemory, sliceMemory + i * sliceSize, sliceSize,
+                                            pool->sliceOctetSize);
+        swampUnmanagedMemoryInit(&slot->unmanagedMemory);
+        if (slot->tempResultSize < context->tempResultSize) {
+            if (slot->tempResult) {
+                tc_free(slot->tempResult);
+            }
+            slot->tempResult = tc_malloc(context->tempResultSize);
+            slot->tempResultSize = context->tempResultSize;
+        }
+    }
+
+    SwampParallelJob job;
+    job.pool = pool;
+    job.context = context;
+    job.range = range;
+    job.userData = userData;
+    job.count = count;
+    job.taskCount = taskCount;
+
+    swampWorkerPoolRun(pool, swampParallelTask, &job, taskCount);
+
+    // A task that did not fit in its slice has allocated from blocks that are freed with the slot, and the results
+    // can point into them. Throw away everything the tasks allocated and run the whole range on the calling thread.
+    int outOfRoom = 0;
+    for (size_t i = 0; i < taskCount; ++i) {
+        if (pool->slots[i].dynamicMemory.blockIndex > 0) {
+            outOfRoom = 1;
+            break;
+        }
+    }
+
+    if (outOfRoom) {
+        for (size_t i = 0; i < taskCount; ++i) {
+            SwampWorkerSlot* slot = &pool->slots[i];
+            swampDynamicMemoryDestroy(&slot->dynamicMemory);
+            if (context->unmanagedMemory) {
+                swampUnmanagedMemoryReset(&slot->unmanagedMemory);
+            }
+        }
+        pool->serialRerunCount++;
+        CLOG_VERBOSE("parallel for: a task ran out of room in its slice of %zu octets, running %zu items serially",
+                     sliceSize, count)
+        range(context, 0, count, userData);
+        return;
+    }
+
+    // The results can point into the slices, so keep everything up to the last slice that was allocated from.
+    // Slices that were not allocated from at all are given back.
+    uint8_t* start = memory->p;
+    uint8_t* end = memory->p;
+    for (size_t i = 0; i < taskCount; ++i) {
+        SwampWorkerSlot* slot = &pool->slots[i];
+        if (slot->dynamicMemory.p != slot->dynamicMemory.memory) {
+            end = slot->dynamicMemory.p;
+        }
+        swampStringMoveUnterminated(memory, &slot->dynamicMemory);
+        swampDynamicMemoryDestroy(&slot->dynamicMemory);
+
+        if (context->unmanagedMemory) {
+            for (size_t j = 0; j < slot->unmanagedMemory.capacity; ++j) {
+                const SwampUnmanaged* unmanaged = slot->unmanagedMemory.unmanaged[j].unmanaged;
+                if (unmanaged) {
+                    swampUnmanagedMemoryMove(context->unmanagedMemory, &slot->unmanagedMemory, unmanaged);
+                }
+            }
+        }
+    }
+    memory->p = end;
+
+    // The workers allocate from unprofiled slices, so their allocations are added to the site that started them
+    if (memory->allocationProfiler && end != start) {
+        swampAllocationProfilerAdd(memory->allocationProfiler, end - start, "parallel workers");
+    }
+}
@@ -0,0 +1,365 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <stdlib.h> // qsort
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/opcodes.h>
+#include <swamp-runtime/profiler.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+void swampProfilerInit(SwampProfiler* self, size_t sampleInterval)
+{
+    self->sampleInterval = sampleInterval == 0 ? SWAMP_PROFILER_DEFAULT_SAMPLE_INTERVAL : sampleInterval;
+    self->functions = 0;
+    self->functionCapacity = 0;
+    self->nodes = 0;
+    self->nodeCapacity = 0;
+    swampProfilerReset(self);
+}
+
+void swampProfilerDestroy(SwampProfiler* self)
+{
+    tc_free(self->functions);
+    tc_free(self->nodes);
+    self->functions = 0;
+    self->functionCapacity = 0;
+    self->functionCount = 0;
+    self->nodes = 0;
+    self->nodeCapacity = 0;
+    self->nodeCount = 0;
+}
+
+void swampProfilerReset(SwampProfiler* self)
+{
+    self->countdown = self->sampleInterval;
+    self->runDepth = 0;
+    self->sampleCount = 0;
+    self->lastSampleTimeNs = 0;
+    self->sampledTimeNs = 0;
+    tc_mem_clear(self->opcodeCounts, sizeof(self->opcodeCounts));
+
+    self->functionCount = 0;
+    if (self->functions) {
+        tc_mem_clear(self->functions, sizeof(self->functions[0]) * self->functionCapacity);
+    }
+
+    if (self->nodeCapacity == 0) {
+        self->nodeCapacity = 256;
+        self->nodes = tc_malloc_type_count(SwampProfilerNode, self->nodeCapacity);
+    }
+    tc_mem_clear(&self->nodes[0], sizeof(self->nodes[0]));
+    self->nodeCount = 1;
+    self->maxNodeDepth = 0;
+}
+
+static size_t swampProfilerFunctionSlot(const SwampProfilerFunction* functions, size_t capacity,
+                                        const void* function)
+{
+    size_t mask = capacity - 1;
+    size_t i = (((uintptr_t) function >> 3) * 2654435761u) & mask;
+    while (functions[i].function != 0 && functions[i].function != function) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static SwampProfilerFunction* swampProfilerFunction(SwampProfiler* self, const void* function)
+{
+    if ((self->functionCount + 1) * 2 > self->functionCapacity) {
+        size_t capacity = self->functionCapacity == 0 ? 64 : self->functionCapacity * 2;
+        SwampProfilerFunction* functions = tc_malloc_type_count(SwampProfilerFunction, capacity);
+        tc_mem_clear(functions, sizeof(functions[0]) * capacity);
+        for (size_t i = 0; i < self->functionCapacity; ++i) {
+            if (self->functions[i].function) {
+                functions[swampProfilerFunctionSlot(functions, capacity, self->functions[i].function)] =
+                    self->functions[i];
+            }
+        }
+        tc_free(self->functions);
+        self->functions = functions;
+        self->functionCapacity = capacity;
+    }
+
+    SwampProfilerFunction* stats = &self->functions[swampProfilerFunctionSlot(self->functions,
+                                                                              self->functionCapacity, function)];
+    if (stats->function == 0) {
+        stats->function = function;
+        self->functionCount++;
+    }
+
+    return stats;
+}
+
+const SwampProfilerFunction* swampProfilerFindFunction(const SwampProfiler* self, const void* function)
+{
+    if (self->functionCapacity == 0) {
+        return 0;
+    }
+
+    const SwampProfilerFunction* stats = &self->functions[swampProfilerFunctionSlot(self->functions,
+                                                                                    self->functionCapacity, function)];
+    return stats->function ? stats : 0;
+}
+
+void swampProfilerCall(SwampProfiler* self, const void* function)
+{
+    swampProfilerFunction(self, function)->callCount++;
+}
+
+// Nested runs (e.g. List.map calling back into swampRun) are sampled as part of the outermost run
+void swampProfilerRunBegin(SwampProfiler* self, const SwampMachineContext* context, const SwampFunc* func)
+{
+    if (self->runDepth == 0) {
+        self->lastSampleTimeNs = monotonicTimeNanosecondsNow();
+    }
+    if (self->runDepth < SWAMP_PROFILER_MAX_RUN_DEPTH) {
+        self->runContexts[self->runDepth] = context;
+    }
+    self->runDepth++;
+    swampProfilerCall(self, func);
+}
+
+void swampProfilerRunEnd(SwampProfiler* self)
+{
+    self->runDepth--;
+}
+
+static size_t swampProfilerChild(SwampProfiler* self, size_t parent, const SwampFunc* func,
+                                 const SwampDebugInfoLinesEntry* line)
+{
+    size_t child = self->nodes[parent].firstChild;
+    while (child != 0) {
+        const SwampProfilerNode* node = &self->nodes[child];
+        if (node->func == func && node->line == line) {
+            return child;
+        }
+        child = node->nextSibling;
+    }
+
+    if (self->nodeCount == self->nodeCapacity) {
+        self->nodeCapacity *= 2;
+        self->nodes = tc_realloc(self->nodes, sizeof(self->nodes[0]) * self->nodeCapacity);
+    }
+
+    child = self->nodeCount++;
+    SwampProfilerNode* node = &self->nodes[child];
+    node->func = func;
+    node->line = line;
+    node->parent = parent;
+    node->firstChild = 0;
+    node->nextSibling = self->nodes[parent].firstChild;
+    node->selfTimeNs = 0;
+    node->sampleCount = 0;
+    node->depth = self->nodes[parent].depth + 1;
+    if (node->depth > self->maxNodeDepth) {
+        self->maxNodeDepth = node->depth;
+    }
+    self->nodes[parent].firstChild = child;
+
+    return child;
+}
+
+static size_t swampProfilerSampleStack(SwampProfiler* self, size_t node, const SwampCallStack* stack,
+                                       const uint32_t* topOpcodePosition, MonotonicTimeNanoseconds timeNs)
+{
+    for (size_t i = 0; i <= stack->count; ++i) {
+        const SwampCallStackEntry* entry = &stack->entries[i];
+        const SwampFunc* func = entry->func;
+        uint32_t opcodePosition = (i == stack->count && topOpcodePosition) ? *topOpcodePosition
+                                                                          : (uint32_t) (entry->pc - func->opcodes);
+        const SwampDebugInfoLinesEntry* line =
+            func->debugInfoLines ? swampDebugInfoFindLinesDebugLines(func->debugInfoLines, (uint16_t) opcodePosition)
+                                 : 0;
+        node = swampProfilerChild(self, node, func, line);
+
+        SwampProfilerFunction* stats = swampProfilerFunction(self, func);
+        if (stats->lastSampleIndex != self->sampleCount) {
+            stats->lastSampleIndex = self->sampleCount;
+            stats->inclusiveTimeNs += timeNs;
+        }
+    }
+
+    return node;
+}
+
+// Called by swampRun() every sampleInterval opcodes. opcodePosition is the position of the opcode that is about to
+// be executed in the innermost function of context.
+void swampProfilerSample(SwampProfiler* self, const SwampMachineContext* context, uint32_t opcodePosition)
+{
+    self->countdown = self->sampleInterval;
+
+    MonotonicTimeNanoseconds now = monotonicTimeNanosecondsNow();
+    MonotonicTimeNanoseconds timeNs = now - self->lastSampleTimeNs;
+    self->lastSampleTimeNs = now;
+    self->sampleCount++;
+    self->sampledTimeNs += timeNs;
+
+    // The call stacks of all running contexts, starting with the outermost
+    size_t runCount = self->runDepth < SWAMP_PROFILER_MAX_RUN_DEPTH ? self->runDepth : SWAMP_PROFILER_MAX_RUN_DEPTH;
+    size_t node = 0;
+    for (size_t i = 0; i < runCount; ++i) {
+        const SwampMachineContext* c = self->runContexts[i];
+        node = swampProfilerSampleStack(self, node, &c->callStack, c == context ? &opcodePosition : 0, timeNs);
+    }
+
+    SwampProfilerNode* leaf = &self->nodes[node];
+    leaf->selfTimeNs += timeNs;
+    leaf->sampleCount++;
+    if (leaf->func) {
+        swampProfilerFunction(self, leaf->func)->exclusiveTimeNs += timeNs;
+    }
+}
+
+// Bucket i is the number of functions that were called [2^i, 2^(i+1)) times
+void swampProfilerCallCountHistogram(const SwampProfiler* self,
+                                     size_t histogram[SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT])
+{
+    tc_mem_clear(histogram, sizeof(histogram[0]) * SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT);
+    for (size_t i = 0; i < self->functionCapacity; ++i) {
+        uint64_t callCount = self->functions[i].callCount;
+        if (self->functions[i].function == 0 || callCount == 0) {
+            continue;
+        }
+        size_t bucket = 0;
+        while (callCount > 1 && bucket < SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT - 1) {
+            callCount >>= 1;
+            bucket++;
+        }
+        histogram[bucket]++;
+    }
+}
+
+static const char* swampProfilerFunctionName(const void* function)
+{
+    const SwampFunction* swampFunction = (const SwampFunction*) function;
+    if (swampFunction->type == SwampFunctionTypeExternal) {
+        return ((const SwampFunctionExternal*) function)->fullyQualifiedName;
+    }
+
+    return ((const SwampFunc*) function)->debugName;
+}
+
+static void swampProfilerWriteFrame(const SwampProfilerNode* node, const SwampDebugInfoFiles* files, FILE* fp)
+{
+    fprintf(fp, "%s", node->func->debugName);
+    if (node->line == 0) {
+        return;
+    }
+
+    const char* filename = 0;
+    if (files && swampDebugInfoFilesFindFile(files, node->line->sourceFileId, &filename) >= 0) {
+        fprintf(fp, " (%s:%d)", filename, node->line->startLocation.line + 1);
+    } else {
+        fprintf(fp, " (:%d)", node->line->startLocation.line + 1);
+    }
+}
+
+// One line per sampled stack, "outer;inner microseconds", the collapsed format used by flamegraph.pl and speedscope
+int swampProfilerWriteCollapsed(const SwampProfiler* self, const SwampDebugInfoFiles* files, FILE* fp)
+{
+    size_t* path = tc_malloc_type_count(size_t, self->maxNodeDepth + 1);
+    for (size_t i = 1; i < self->nodeCount; ++i) {
+        const SwampProfilerNode* node = &self->nodes[i];
+        if (node->sampleCount == 0) {
+            continue;
+        }
+
+        size_t depth = 0;
+        for (size_t n = i; n != 0; n = self->nodes[n].parent) {
+            path[depth++] = n;
+        }
+        for (size_t j = depth; j > 0; --j) {
+            swampProfilerWriteFrame(&self->nodes[path[j - 1]], files, fp);
+            if (j > 1) {
+                fputc(';', fp);
+            }
+        }
+        fprintf(fp, " %llu\n", (unsigned long long) ((node->selfTimeNs + 500) / 1000));
+    }
+    tc_free(path);
+
+    return ferror(fp) ? -1 : 0;
+}
+
+int swampProfilerWriteCollapsedFilename(const SwampProfiler* self, const SwampDebugInfoFiles* files,
+                                        const char* filename)
+{
+    FILE* fp = fopen(filename, "w");
+    if (fp == 0) {
+        CLOG_SOFT_ERROR("swampProfilerWriteCollapsedFilename: could not open '%s'", filename)
+        return -1;
+    }
+
+    int errorCode = swampProfilerWriteCollapsed(self, files, fp);
+    if (fclose(fp) != 0) {
+        errorCode = -1;
+    }
+
+    return errorCode;
+}
+
+static int swampProfilerCompareExclusiveTime(const void* a, const void* b)
+{
+    const SwampProfilerFunction* x = *(const SwampProfilerFunction* const*) a;
+    const SwampProfilerFunction* y = *(const SwampProfilerFunction* const*) b;
+    if (x->exclusiveTimeNs != y->exclusiveTimeNs) {
+        return x->exclusiveTimeNs < y->exclusiveTimeNs ? 1 : -1;
+    }
+    if (x->callCount != y->callCount) {
+        return x->callCount < y->callCount ? 1 : -1;
+    }
+    return 0;
+}
+
+// Opcode counts, functions sorted on exclusive time and the call count histogram
+void swampProfilerWriteReport(const SwampProfiler* self, FILE* fp)
+{
+    fprintf(fp, "samples: %zu sampled time: %.3f ms\n", self->sampleCount, self->sampledTimeNs / 1000000.0);
+
+    fprintf(fp, "\n%-24s %16s\n", "opcode", "count");
+    for (size_t i = 0; i < 256; ++i) {
+        if (self->opcodeCounts[i] == 0) {
+            continue;
+        }
+        const char* name = swampOpcodeName((uint8_t) i);
+        if (name) {
+            fprintf(fp, "%-24s %16llu\n", name, (unsigned long long) self->opcodeCounts[i]);
+        } else {
+            fprintf(fp, "0x%02zx %19s %16llu\n", i, "", (unsigned long long) self->opcodeCounts[i]);
+        }
+    }
+
+    const SwampProfilerFunction** sorted = tc_malloc_type_count(const SwampProfilerFunction*,
+                                                                self->functionCount + 1);
+    size_t count = 0;
+    for (size_t i = 0; i < self->functionCapacity; ++i) {
+        if (self->functions[i].function) {
+            sorted[count++] = &self->functions[i];
+        }
+    }
+    qsort(sorted, count, sizeof(sorted[0]), swampProfilerCompareExclusiveTime);
+
+    fprintf(fp, "\n%-40s %12s %14s %14s\n", "function", "calls", "inclusive ms", "exclusive ms");
+    for (size_t i = 0; i < count; ++i) {
+        const SwampProfilerFunction* stats = sorted[i];
+        fprintf(fp, "%-40s %12llu %14.3f %14.3f\n", swampProfilerFunctionName(stats->function),
+                (unsigned long long) stats->callCount, stats->inclusiveTimeNs / 1000000.0,
+                stats->exclusiveTimeNs / 1000000.0);
+    }
+    tc_free(sorted);
+
+    size_t histogram[SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT];
+    swampProfilerCallCountHistogram(self, histogram);
+    fprintf(fp, "\n%-24s %12s\n", "calls", "functions");
+    for (size_t i = 0; i < SWAMP_PROFILER_HISTOGRAM_BUCKET_COUNT; ++i) {
+        if (histogram[i] == 0) {
+            continue;
+        }
+        fprintf(fp, "%10llu - %-11llu %12zu\n", 1ull << i, (2ull << i) - 1, histogram[i]);
+    }
+}
@@ -0,0 +1,213 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/debug_variables.h>
+#include <swamp-runtime/external.h>
+#include <swamp-runtime/fixup.h>
+#include <swamp-runtime/relocation.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define RELOCATE_POINTER(field, type) (type) (staticMemory + (uintptr_t) (field))
+
+static size_t alignOctetCount(size_t octetCount)
+{
+    return (octetCount + 7) & ~(size_t) 7;
+}
+
+// Returns the number of octets needed for the resolved copy, zero if the constant has no pointers
+static size_t resolvedOctetCount(const uint8_t* staticMemory, const SwampConstantLedgerEntry* entry)
+{
+    const uint8_t* p = staticMemory + entry->offset;
+    switch (entry->constantType) {
+        case LedgerTypeFunc: {
+            const SwampFunc* func = (const SwampFunc*) p;
+            const SwampDebugInfoVariables* variables = RELOCATE_POINTER(func->debugInfoVariables,
+                                                                        const SwampDebugInfoVariables*);
+            return alignOctetCount(sizeof(SwampFunc)) + alignOctetCount(sizeof(SwampDebugInfoLines)) +
+                   alignOctetCount(sizeof(SwampDebugInfoVariables)) +
+                   alignOctetCount(variables->count * sizeof(SwampDebugInfoVariablesEntry));
+        }
+        case LedgerTypeExternalFunc:
+            return alignOctetCount(sizeof(SwampFunctionExternal));
+        case LedgerTypeString:
+            return alignOctetCount(sizeof(SwampString));
+        case LedgerTypeResourceNameChunk: {
+            const SwampResourceNameChunkEntry* chunk = (const SwampResourceNameChunkEntry*) p;
+            return alignOctetCount(sizeof(SwampResourceNameChunkEntry)) +
+                   alignOctetCount(chunk->resourceCount * sizeof(const char*));
+        }
+        case LedgerTypeDebugInfoFiles: {
+            const SwampDebugInfoFiles* files = (const SwampDebugInfoFiles*) p;
+            return alignOctetCount(sizeof(SwampDebugInfoFiles)) + alignOctetCount(files->count * sizeof(const char*));
+        }
+        case LedgerTypeResourceName:
+            return 0;
+        default:
+            CLOG_ERROR("Unknown ledger relocation type %d", entry->constantType)
+            return 0;
+    }
+}
+
+static void* allocateResolved(uint8_t** target, size_t octetCount)
+{
+    void* p = *target;
+    *target += alignOctetCount(octetCount);
+    return p;
+}
+
+static const void* resolveEntry(const uint8_t* staticMemory, const SwampConstantLedgerEntry* entry,
+                                SwampResolveExternalFunction bindFn, SwampResolveExternalFunctionArguments bindArgumentsFn,
+                                uint8_t** target, int* detectedError)
+{
+    const uint8_t* p = staticMemory + entry->offset;
+    switch (entry->constantType) {
+        case LedgerTypeFunc: {
+            SwampFunc* func = allocateResolved(target, sizeof(SwampFunc));
+            *func = *(const SwampFunc*) p;
+            func->debugName = RELOCATE_POINTER(func->debugName, const char*);
+            func->opcodes = RELOCATE_POINTER(func->opcodes, const uint8_t*);
+
+            SwampDebugInfoLines* lines = allocateResolved(target, sizeof(SwampDebugInfoLines));
+            *lines = *RELOCATE_POINTER(func->debugInfoLines, const SwampDebugInfoLines*);
+            lines->lines = RELOCATE_POINTER(lines->lines, const SwampDebugInfoLinesEntry*);
+            func->debugInfoLines = lines;
+
+            SwampDebugInfoVariables* variables = allocateResolved(target, sizeof(SwampDebugInfoVariables));
+            *variables = *RELOCATE_POINTER(func->debugInfoVariables, const SwampDebugInfoVariables*);
+            const SwampDebugInfoVariablesEntry* sourceEntries = RELOCATE_POINTER(variables->variables,
+                                                                                 const SwampDebugInfoVariablesEntry*);
+            SwampDebugInfoVariablesEntry* variableEntries = allocateResolved(
+                target, variables->count * sizeof(SwampDebugInfoVariablesEntry));
+            for (size_t i = 0; i < variables->count; ++i) {
+                variableEntries[i] = sourceEntries[i];
+                variableEntries[i].name = RELOCATE_POINTER(variableEntries[i].name, const char*);
+            }
+            variables->variables = variableEntries;
+            func->debugInfoVariables = variables;
+            return func;
+        }
+        case LedgerTypeExternalFunc: {
+            SwampFunctionExternal* func = allocateResolved(target, sizeof(SwampFunctionExternal));
+            *func = *(const SwampFunctionExternal*) p;
+            func->fullyQualifiedName = RELOCATE_POINTER(func->fullyQualifiedName, const char*);
+            if (swampFunctionExternalBind(func, bindFn, bindArgumentsFn) < 0) {
+                *detectedError = 1;
+            }
+            return func;
+        }
+        case LedgerTypeString: {
+            SwampString* str = allocateResolved(target, sizeof(SwampString));
+            *str = *(const SwampString*) p;
+            str->characters = RELOCATE_POINTER(str->characters, const char*);
+            return str;
+        }
+        case LedgerTypeResourceNameChunk: {
+            SwampResourceNameChunkEntry* chunk = allocateResolved(target, sizeof(SwampResourceNameChunkEntry));
+            *chunk = *(const SwampResourceNameChunkEntry*) p;
+            const char* const* sourceNames = RELOCATE_POINTER(chunk->resourceNames, const char* const*);
+            const char** names = allocateResolved(target, chunk->resourceCount * sizeof(const char*));
+            for (size_t i = 0; i < chunk->resourceCount; ++i) {
+                names[i] = RELOCATE_POINTER(sourceNames[i], const char*);
+            }
+            chunk->resourceNames = names;
+            return chunk;
+        }
+        case LedgerTypeDebugInfoFiles: {
+            SwampDebugInfoFiles* files = allocateResolved(target, sizeof(SwampDebugInfoFiles));
+            *files = *(const SwampDebugInfoFiles*) p;
+            const char* const* sourceNames = RELOCATE_POINTER(files->filenames, const char* const*);
+            const char** names = allocateResolved(target, files->count * sizeof(const char*));
+            for (size_t i = 0; i < files->count; ++i) {
+                names[i] = RELOCATE_POINTER(sourceNames[i], const char*);
+            }
+            files->filenames = names;
+            return files;
+        }
+        default:
+            return 0;
+    }
+}
+
+int swampStaticRelocationInit(SwampStaticRelocation* self, const uint8_t* staticMemory,
+                              SwampResolveExternalFunction bindFn,
+                              SwampResolveExternalFunctionArguments bindArgumentsFn,
+                              const SwampConstantLedgerEntry* entries,
+                              const SwampFunc** outEntryFunc)
+{
+    self->staticMemory = staticMemory;
+    self->entryCount = 0;
+    self->resolvedOctetCount = 0;
+
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        size_t octetCount = resolvedOctetCount(staticMemory, entry);
+        if (octetCount != 0) {
+            self->entryCount++;
+            self->resolvedOctetCount += octetCount;
+        }
+    }
+
+    self->entries = tc_malloc_type_count(SwampStaticRelocationEntry, self->entryCount + 1);
+    self->resolvedOctets = tc_malloc(self->resolvedOctetCount + 1);
+
+    const SwampFunc* entryFunc = 0;
+    int detectedError = 0;
+    uint8_t* target = self->resolvedOctets;
+    size_t count = 0;
+    for (const SwampConstantLedgerEntry* entry = entries; entry->constantType != 0; entry++) {
+        const void* resolved = resolveEntry(staticMemory, entry, bindFn, bindArgumentsFn, &target, &detectedError);
+        if (resolved == 0) {
+            continue;
+        }
+        if (entry->constantType == LedgerTypeFunc && tc_str_equal(((const SwampFunc*) resolved)->debugName, "main")) {
+            entryFunc = (const SwampFunc*) resolved;
+        }
+
+        // The ledger is normally already sorted on offset, so this insertion is only a compare per entry
+        size_t i = count++;
+        while (i > 0 && self->entries[i - 1].offset > entry->offset) {
+            self->entries[i] = self->entries[i - 1];
+            i--;
+        }
+        self->entries[i].offset = entry->offset;
+        self->entries[i].resolved = resolved;
+    }
+
+    *outEntryFunc = entryFunc;
+
+    return detectedError ? -1 : 0;
+}
+
+void swampStaticRelocationDestroy(SwampStaticRelocation* self)
+{
+    tc_free(self->entries);
+    tc_free(self->resolvedOctets);
+    self->entries = 0;
+    self->resolvedOctets = 0;
+    self->entryCount = 0;
+    self->resolvedOctetCount = 0;
+}
+
+// Returns the resolved copy of the constant at offset, or the static memory itself if it has no pointers
+const void* swampStaticRelocationGet(const SwampStaticRelocation* self, uint32_t offset)
+{
+    size_t low = 0;
+    size_t high = self->entryCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        uint32_t middleOffset = self->entries[middle].offset;
+        if (middleOffset == offset) {
+            return self->entries[middle].resolved;
+        }
+        if (middleOffset < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return self->staticMemory + offset;
+}
@@ -4,12 +4,21 @@
 *--------------------------------------------------------------------------------------------*/
 #include <clog/clog.h>
 #include <swamp-runtime/log.h>
+#include <swamp-runtime/relocation.h>
 #include <swamp-runtime/static_memory.h>
 
 void swampStaticMemoryInit(SwampStaticMemory* self, const void* memory, size_t maxOctetSize)
 {
    self->memory = (uint8_t *) memory;
    self->maxAllocatedSize = maxOctetSize;
+   self->relocation = 0;
+}
+
+void swampStaticMemoryInitRelocated(SwampStaticMemory* self, const void* memory, size_t maxOctetSize,
+                                    const SwampStaticRelocation* relocation)
+{
+   swampStaticMemoryInit(self, memory, maxOctetSize);
+   self->relocation = relocation;
 }
 
 const void* swampStaticMemoryGet(const SwampStaticMemory* self, uint32_t position)
@@ -18,5 +27,9 @@ const void* swampStaticMemoryGet(const SwampStaticMemory* self, uint32_t positio
         CLOG_ERROR("position is invalid");
     }
 
+    if (self->relocation) {
+        return swampStaticRelocationGet(self->relocation, position);
+    }
+
     return self->memory + position;
 }
@@ -3,8 +3,11 @@
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
 #include <swamp-runtime/context.h>
+#include <swamp-runtime/decode.h>
 #include <swamp-runtime/log.h>
 #include <swamp-runtime/opcodes.h>
+#include <swamp-runtime/profiler.h>
+#include <swamp-runtime/allocation_profiler.h>
 #include <swamp-runtime/swamp.h>
 #include <swamp-runtime/swamp_allocate.h>
 #include <swamp-runtime/types.h>
@@ -26,6 +29,15 @@ static const char* swamp_opcode_name(uint8_t opcode)
 {
     return g_swamp_opcode_names[opcode];
 }
+
+const char* swampOpcodeName(uint8_t opcode)
+{
+    if (opcode >= sizeof(g_swamp_opcode_names) / sizeof(g_swamp_opcode_names[0])) {
+        return 0;
+    }
+
+    return g_swamp_opcode_names[opcode];
+}
 #define SWAMP_CONFIG_DEBUG 0
 
 typedef uint16_t SwampJump;
@@ -153,36 +165,844 @@ SWAMP_INLINE SwampInt32 readSourceIntStackPointerPos(const uint8_t** pc, const u
 
 #define swampMemoryMove(target, source, size) tc_memmove_octets((void*)(target), source, size)
 
+// Lets SwampMachineContext::profiler be set at runtime. Costs a predictable branch per opcode when not profiling.
+// Also lets SwampDynamicMemory::allocationProfiler attribute allocations to opcodes and external functions.
+#if !defined SWAMP_RUN_PROFILER
+#define SWAMP_RUN_PROFILER (1)
+#endif
+
+// All external functions are called through the uniform ABI, typed functions are called by a thunk, see external.h
+SWAMP_INLINE void callExternalWithArguments(const SwampFunctionExternal* externalFunction, const uint8_t* basePointer,
+                                            SwampMachineContext* context, const void* const* arguments,
+                                            size_t argumentCount)
+{
+    // External functions can read the characters of strings up to the terminating zero, which a string append may
+    // have overwritten. The arguments are not typed and strings can be anywhere in them, so all of them are fixed.
+    if (context->dynamicMemory->unterminatedStringCount != 0) {
+        swampStringTerminateAll(context->dynamicMemory);
+    }
+    context->externalFunction = externalFunction;
+#if SWAMP_RUN_PROFILER
+    SwampAllocationProfiler* allocationProfiler = context->dynamicMemory->allocationProfiler;
+    if (allocationProfiler) {
+        const SwampCallStackEntry* entry = &context->callStack.entries[context->callStack.count];
+        swampAllocationProfilerSetSite(allocationProfiler, entry->func, (uint32_t) (entry->pc - entry->func->opcodes),
+                                       externalFunction->fullyQualifiedName);
+    }
+#endif
+    externalFunction->call((void*) basePointer, context, arguments, argumentCount);
+}
+
+SWAMP_INLINE void callExternal(const SwampFunctionExternal* externalFunction, const uint8_t* basePointer,
+                               SwampMachineContext* context)
+{
+    const void* arguments[SWAMP_FUNCTION_EXTERNAL_MAX_PARAMETER_COUNT];
+    size_t argumentCount = externalFunction->parameterCount;
+    for (size_t i = 0; i < argumentCount; ++i) {
+        arguments[i] = basePointer + externalFunction->parameters[i].pos;
+    }
+    callExternalWithArguments(externalFunction, basePointer, context, arguments, argumentCount);
+}
+
+// params[0] is the return value
+SWAMP_INLINE void callExternalWithParameters(const SwampFunctionExternal* externalFunction,
+                                             const uint8_t* basePointer, SwampMachineContext* context,
+                                             const void** params, uint8_t count)
+{
+    callExternalWithArguments(externalFunction, basePointer, context, params + 1, count - 1);
+}
+
+// unknownTypes[0] is the return value
+SWAMP_INLINE void callExternalWithUnknownTypes(const SwampFunctionExternal* externalFunction,
+                                               const uint8_t* basePointer, SwampMachineContext* context,
+                                               const SwampUnknownType* unknownTypes, uint8_t count)
+{
+    const void* arguments[SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT];
+    for (uint8_t i = 1; i < count; ++i) {
+        arguments[i - 1] = &unknownTypes[i];
+    }
+    callExternalWithArguments(externalFunction, basePointer, context, arguments, count - 1);
+}
+
+// Moves the arguments to make room for the curried arguments and returns the function to call
+SWAMP_INLINE const SwampFunc* prepareCurry(const SwampFunc* func, uint8_t* basePointer)
+{
+    if (func->func.type != SwampFunctionTypeCurry) {
+        return func;
+    }
+
+    const SwampCurryFunc* curry = (const SwampCurryFunc*) func;
+    swampMemoryMove((basePointer + curry->curryOctetSize), basePointer, func->parametersOctetSize);
+    swampMemoryCopy(basePointer, curry->curryOctets, curry->curryOctetSize);
+
+    return curry->curryFunction;
+}
+
 #define SWAMP_RUN_MEASURE_PERFORMANCE (0)
 
-int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc* f, SwampParameters runParameters,
-             SwampBool verbose_flag)
+// Counts executed opcodes into a global counter, only meant for benchmarking (not thread safe)
+#if !defined SWAMP_RUN_COUNT_OPCODES
+#define SWAMP_RUN_COUNT_OPCODES (0)
+#endif
+
+// Direct threaded dispatch using computed goto (labels as values). Falls back to a switch for other compilers
+// and when tracing each opcode.
+#if !defined SWAMP_RUN_DIRECT_THREADED
+#if defined __GNUC__ && !SWAMP_CONFIG_DEBUG && !DEBUGLOG_PARAMS
+#define SWAMP_RUN_DIRECT_THREADED (1)
+#else
+#define SWAMP_RUN_DIRECT_THREADED (0)
+#endif
+#endif
+
+#if SWAMP_RUN_COUNT_OPCODES
+static size_t g_swampRunExecutedOpcodeCount;
+#define SWAMP_COUNT_OPCODE() executedOpcodeCount++
+#else
+#define SWAMP_COUNT_OPCODE()
+#endif
+
+#if SWAMP_RUN_PROFILER
+#define SWAMP_PROFILE_OPCODE(opcode, opcodePosition)                                                                   \
+    if (profiler) {                                                                                                    \
+        profiler->opcodeCounts[(opcode) &0xff]++;                                                                      \
+        if (--profiler->countdown == 0) {                                                                              \
+            swampProfilerSample(profiler, context, (opcodePosition));                                                  \
+        }                                                                                                              \
+    }
+#define SWAMP_PROFILE_CALL(function)                                                                                   \
+    if (profiler) {                                                                                                    \
+        swampProfilerCall(profiler, (function));                                                                       \
+    }
+#else
+#define SWAMP_PROFILE_OPCODE(opcode, opcodePosition)
+#define SWAMP_PROFILE_CALL(function)
+#endif
+#if SWAMP_RUN_PROFILER
+#define SWAMP_ALLOCATION_SITE(opcodePosition, opcode)                                                                  \
+    if (allocationProfiler) {                                                                                          \
+        swampAllocationProfilerSetSite(allocationProfiler, call_stack_entry->func, (opcodePosition),                   \
+                                       swampOpcodeName(opcode));                                                       \
+    }
+#else
+#define SWAMP_ALLOCATION_SITE(opcodePosition, opcode)
+#endif
+#define SWAMP_ALLOCATION_SITE_RAW(opcode)                                                                              \
+    SWAMP_ALLOCATION_SITE((uint32_t) (pc - 1 - call_stack_entry->func->opcodes), opcode)
+#define SWAMP_ALLOCATION_SITE_DECODED(opcode) SWAMP_ALLOCATION_SITE(instruction->opcodePosition, opcode)
+
+#define SWAMP_PROFILE_RAW_OPCODE() SWAMP_PROFILE_OPCODE(*pc, (uint32_t) (pc - call_stack_entry->func->opcodes))
+#define SWAMP_PROFILE_DECODED_OPCODE() SWAMP_PROFILE_OPCODE(instruction->opcode, instruction->opcodePosition)
+
+#if SWAMP_RUN_DIRECT_THREADED
+#define SWAMP_OPCODE(opcode) opcodeLabel##opcode:
+#define SWAMP_OPCODE_UNKNOWN opcodeLabelUnknown:
+#define SWAMP_DISPATCH_ENTRY(opcode) [opcode] = &&opcodeLabel##opcode
+#define SWAMP_DISPATCH(opcode) goto* dispatchTable[opcode];
+#define SWAMP_NEXT()                                                                                                   \
+    {                                                                                                                  \
+        SWAMP_COUNT_OPCODE();                                                                                          \
+        SWAMP_PROFILE_RAW_OPCODE();                                                                                    \
+        goto* dispatchTable[*pc++];                                                                                    \
+    }
+#else
+#define SWAMP_OPCODE(opcode) case opcode:
+#define SWAMP_OPCODE_UNKNOWN default:
+#define SWAMP_DISPATCH(opcode) switch (opcode)
+#define SWAMP_NEXT() break
+#endif
+
+size_t swampRunExecutedOpcodeCount(void)
 {
-    const uint8_t* pc = f->opcodes;
+#if SWAMP_RUN_COUNT_OPCODES
+    return g_swampRunExecutedOpcodeCount;
+#else
+    return 0;
+#endif
+}
+
+#if SWAMP_RUN_DIRECT_THREADED
+#define SWAMP_DECODED_OPCODE(opcode) decodedLabel##opcode:
+#define SWAMP_DECODED_OPCODE_UNKNOWN decodedLabelUnknown:
+#define SWAMP_DECODED_DISPATCH_ENTRY(opcode) [opcode] = &&decodedLabel##opcode
+#define SWAMP_DECODED_DISPATCH(instruction) goto*(instruction)->handler;
+#define SWAMP_DECODED_NEXT()                                                                                           \
+    {                                                                                                                  \
+        SWAMP_COUNT_OPCODE();                                                                                          \
+        instruction = pc++;                                                                                            \
+        SWAMP_PROFILE_DECODED_OPCODE();                                                                                \
+        goto* instruction->handler;                                                                                    \
+    }
+#else
+#define SWAMP_DECODED_OPCODE(opcode) case opcode:
+#define SWAMP_DECODED_OPCODE_UNKNOWN default:
+#define SWAMP_DECODED_DISPATCH(instruction) switch ((instruction)->opcode)
+#define SWAMP_DECODED_NEXT() break
+#endif
+
+#define DECODED_STACK_POINTER(index) ((void*) (bp + instruction->operands[index]))
+#define DECODED_INT(index) (*(const SwampInt32*) DECODED_STACK_POINTER(index))
+
+#define GET_DECODED_OPERATOR_INT()                                                                                     \
+    SwampInt32* targetRegister = (SwampInt32*) DECODED_STACK_POINTER(0);                                               \
+    SwampInt32 a = DECODED_INT(1);                                                                                     \
+    SwampInt32 b = DECODED_INT(2)
+
+#define GET_DECODED_UNARY_OPERATOR_INT()                                                                               \
+    SwampInt32* targetRegister = (SwampInt32*) DECODED_STACK_POINTER(0);                                               \
+    SwampInt32 a = DECODED_INT(1)
+
+// Writes the compare result and branches. The fused branch instruction is skipped if not taken
+#define DECODED_COMPARE_AND_BRANCH(condition, branchWhen)                                                              \
+    GET_DECODED_OPERATOR_INT();                                                                                        \
+    SwampBool truth = (condition);                                                                                     \
+    SET_OPERATOR_RESULT_BOOL(truth);                                                                                   \
+    pc = (truth == (branchWhen)) ? instruction->jump : instruction + instruction->instructionCount
+
+// Octet position in the original opcodes, so debug info and variable lookups work the same as for swampRun
+#define DECODED_DEBUG_PC(entry, nextInstruction) ((entry)->func->opcodes + (nextInstruction)->opcodePosition)
+
+// Labels as values, goto * and range initializers are GNU extensions. Only the dispatch loops use them.
+#if SWAMP_RUN_DIRECT_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+// Executes the pre-decoded instructions. If outDispatchTable is set, it only returns the dispatch table.
+static int swampRunDecoded(SwampResult* result, SwampMachineContext* context, const SwampDecodedFunc* decodedFunc,
+                           const void* const** outDispatchTable)
+{
+#if SWAMP_RUN_DIRECT_THREADED
+    static const void* const dispatchTable[256] = {
+        [0x00] = &&decodedLabelUnknown,
+        [SwampOpcodeEnumCase] = &&decodedLabelUnknown,
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeJump),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCall),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeReturn),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCallExternal),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeTailCall),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCurry),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntAdd),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntSub),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntMul),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntDiv),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntNegate),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFixedMul),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFixedDiv),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntNotEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntLess),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntLessEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntGreater),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntGreaterOrEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeBoolNot),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeStringEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeStringNotEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntAnd),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntOr),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntXor),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntNot),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeListCreate),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeArrayCreate),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeListConj),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeListAppend),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeStringAppend),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeLoadInteger),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeLoadBoolean),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeLoadRune),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeLoadZeroMemory),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeMemCopy),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeSetEnum),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCallExternalWithSizes),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCmpEnumEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCmpEnumNotEqual),
+        [SwampOpcodePatternMatchingInt] = &&decodedLabelUnknown,
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodePatternMatchingString),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeCallExternalWithExtendedSizes),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntShiftLeft),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntShiftRight),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeIntRemainder),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeBooleanEqual),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeBooleanNotEqual),
+        [SwampOpcodeBooleanNotEqual + 1 ... SwampOpcodeFusedIntEqualBranchFalse - 1] = &&decodedLabelUnknown,
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntEqualBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntNotEqualBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntLessBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntLessEqualBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntGreaterBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntGreaterOrEqualBranchFalse),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntEqualBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntNotEqualBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntLessBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntLessEqualBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntGreaterBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntGreaterOrEqualBranchTrue),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntAddImmediate),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedIntSubImmediate),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeFusedMemCopyMulti),
+        [SwampOpcodeFusedMemCopyMulti + 1 ... SwampOpcodeDecodedEnumCaseTable - 1] = &&decodedLabelUnknown,
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeDecodedEnumCaseTable),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeDecodedPatternMatchingIntTable),
+        SWAMP_DECODED_DISPATCH_ENTRY(SwampOpcodeDecodedPatternMatchingIntSorted),
+        [SwampOpcodeDecodedPatternMatchingIntSorted + 1 ... 0xff] = &&decodedLabelUnknown,
+    };
+
+    if (outDispatchTable) {
+        *outDispatchTable = dispatchTable;
+        return 0;
+    }
+#else
+    if (outDispatchTable) {
+        *outDispatchTable = 0;
+        return 0;
+    }
+#endif
+
+    const SwampFunc* f = decodedFunc->func;
+    const SwampDecodedProgram* program = context->decodedProgram;
+    const SwampInstruction* pc = decodedFunc->instructions;
+    const SwampInstruction* instruction;
     const uint8_t* bp = context->bp;
 
     SwampCallStack* stack = &context->callStack;
     SwampCallStackEntry* call_stack_entry = &stack->entries[0];
     call_stack_entry->func = f;
-    call_stack_entry->pc = pc;
+    call_stack_entry->pc = f->opcodes;
+    call_stack_entry->instruction = pc;
     call_stack_entry->basePointer = bp;
 
-    //CLOG_VERBOSE("SAVE start '%s' pc:%p bp:%p", f->debugName, pc, bp)
+#if SWAMP_RUN_COUNT_OPCODES
+    size_t executedOpcodeCount = 0;
+#endif
+#if SWAMP_RUN_PROFILER
+    SwampProfiler* profiler = context->profiler;
+    SwampAllocationProfiler* allocationProfiler = context->dynamicMemory->allocationProfiler;
+#endif
 
-    if (runParameters.parameterCount != f->parameterCount) {
-        // ERROR
-        SWAMP_LOG_INFO("mismatch! param count %zu vs function says %zu (%p, %s)", runParameters.parameterCount,
-                       f->parameterCount, (const void*) f, f->debugName);
-        // swamp_value_print((const swamp_value*) f, "swamp_run()");
-        return -3;
+    while (1) {
+        SWAMP_COUNT_OPCODE();
+        instruction = pc++;
+        SWAMP_PROFILE_DECODED_OPCODE();
+
+        SWAMP_DECODED_DISPATCH(instruction) {
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeReturn) {
+                if (stack->count == 0) {
+                    if (result->expectedOctetSize != f->returnOctetSize) {
+                        SWAMP_LOG_SOFT_ERROR("opcode return: expected result %zu, but function returns %zu (%s)",
+                                             result->expectedOctetSize, f->returnOctetSize, f->debugName);
+                        return -3;
+                    }
+#if SWAMP_RUN_COUNT_OPCODES
+                    g_swampRunExecutedOpcodeCount += executedOpcodeCount;
+#endif
+
+                    return 0;
+                }
+
+                call_stack_entry = &stack->entries[--stack->count];
+                pc = call_stack_entry->instruction;
+                bp = call_stack_entry->basePointer;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeLoadZeroMemory) {
+                *(const void**) DECODED_STACK_POINTER(0) = instruction->data;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeLoadInteger) {
+                *(SwampInt32*) DECODED_STACK_POINTER(0) = (SwampInt32) instruction->operands[1];
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeLoadBoolean) {
+                *(SwampBool*) DECODED_STACK_POINTER(0) = (SwampBool) instruction->operands[1];
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeLoadRune) {
+                *(SwampCharacter*) DECODED_STACK_POINTER(0) = (SwampCharacter) instruction->operands[1];
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeMemCopy) {
+                tc_memcpy_octets(DECODED_STACK_POINTER(0), DECODED_STACK_POINTER(1), instruction->operands[2]);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeSetEnum) {
+                uint8_t* target = (uint8_t*) DECODED_STACK_POINTER(0);
+                *target = (uint8_t) instruction->operands[1];
+                tc_mem_clear(target + 1, instruction->operands[2] - 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeListConj) {
+                SWAMP_ALLOCATION_SITE_DECODED(SwampOpcodeListConj);
+                SwampListReferenceData target = (SwampListReferenceData) DECODED_STACK_POINTER(0);
+                const SwampListReference sourceList = *(const SwampListReferenceData) DECODED_STACK_POINTER(1);
+                const void* sourceItem = DECODED_STACK_POINTER(2);
+                size_t itemSize = instruction->operands[3];
+                size_t itemAlign = instruction->operands[4];
+                if (sourceList->count != 0) {
+                    if (itemSize != sourceList->itemSize || itemAlign != sourceList->itemAlign) {
+                        CLOG_ERROR("wrong source list")
+                    }
+                }
+                *target = swampAllocateListConj(context->dynamicMemory, sourceList, sourceItem, itemSize, itemAlign);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeListAppend) {
+                SWAMP_ALLOCATION_SITE_DECODED(SwampOpcodeListAppend);
+                SwampListReferenceData target = (SwampListReferenceData) DECODED_STACK_POINTER(0);
+                const SwampListReference sourceListA = *(const SwampListReferenceData) DECODED_STACK_POINTER(1);
+                const SwampListReference sourceListB = *(const SwampListReferenceData) DECODED_STACK_POINTER(2);
+                *target = swampAllocateListAppendNoCopy(context->dynamicMemory, sourceListA, sourceListB);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeCallExternalWithSizes) {
+                call_stack_entry->pc = DECODED_DEBUG_PC(call_stack_entry, pc);
+                const uint8_t* basePointer = DECODED_STACK_POINTER(0);
+                const SwampFunctionExternal* externalFunction = *(const SwampFunctionExternal**) DECODED_STACK_POINTER(1);
+                uint8_t count = (uint8_t) instruction->operands[2];
+                const uint32_t* offsets = (const uint32_t*) instruction->data;
+                const void* params[SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1];
+                for (uint8_t i = 0; i < count; i++) {
+                    params[i] = basePointer + offsets[i];
+                }
+                SWAMP_PROFILE_CALL(externalFunction);
+                callExternalWithParameters(externalFunction, basePointer, context, params, count);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeCallExternalWithExtendedSizes) {
+                call_stack_entry->pc = DECODED_DEBUG_PC(call_stack_entry, pc);
+                const uint8_t* basePointer = DECODED_STACK_POINTER(0);
+                const SwampFunctionExternal* externalFunction = *(const SwampFunctionExternal**) DECODED_STACK_POINTER(1);
+                uint8_t count = (uint8_t) instruction->operands[2];
+                const uint32_t* offsetSizeAligns = (const uint32_t*) instruction->data;
+                SwampUnknownType unknownTypes[SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1];
+                for (uint8_t i = 0; i < count; i++) {
+                    unknownTypes[i].ptr = basePointer + offsetSizeAligns[i * 3];
+                    unknownTypes[i].size = offsetSizeAligns[i * 3 + 1];
+                    unknownTypes[i].align = offsetSizeAligns[i * 3 + 2];
+                }
+                SWAMP_PROFILE_CALL(externalFunction);
+                callExternalWithUnknownTypes(externalFunction, basePointer, context, unknownTypes, count);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeTailCall) {
+                pc = instruction->jump;
+                call_stack_entry->pc = call_stack_entry->func->opcodes;
+                call_stack_entry->instruction = pc;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeCall)
+            SWAMP_DECODED_OPCODE(SwampOpcodeCallExternal) {
+                const uint8_t* basePointer = DECODED_STACK_POINTER(0);
+                const SwampFunc* func = *(const SwampFunc**) DECODED_STACK_POINTER(1);
+
+                func = prepareCurry(func, (uint8_t*) basePointer);
+                SWAMP_PROFILE_CALL(func);
+
+                if (func->func.type == SwampFunctionTypeExternal) {
+                    call_stack_entry->pc = DECODED_DEBUG_PC(call_stack_entry, pc);
+                    callExternal((const SwampFunctionExternal*) func, basePointer, context);
+                } else {
+                    const SwampDecodedFunc* calledFunc = swampDecodedProgramFind(program, func);
+                    if (!calledFunc) {
+                        // Only functions in the ledger are decoded, the call stack is left for the next run
+                        SWAMP_LOG_SOFT_ERROR("decoded call: function '%s' was not decoded", func->debugName);
+                        stack->count = 0;
+                        return -4;
+                    }
+
+                    // Save current state
+                    call_stack_entry->pc = DECODED_DEBUG_PC(call_stack_entry, pc);
+                    call_stack_entry->instruction = pc;
+                    call_stack_entry->basePointer = bp;
+
+                    stack->count++;
+                    if (stack->count == stack->maxCount) {
+                        CLOG_ERROR("out of stack space");
+                    }
+                    // Set new stack entry
+                    call_stack_entry = &stack->entries[stack->count];
+                    call_stack_entry->func = func;
+                    call_stack_entry->pc = func->opcodes;
+                    call_stack_entry->instruction = calledFunc->instructions;
+                    call_stack_entry->basePointer = basePointer;
+
+                    // Set variables
+                    bp = basePointer;
+                    pc = calledFunc->instructions;
+                }
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeCurry) {
+                SWAMP_ALLOCATION_SITE_DECODED(SwampOpcodeCurry);
+                const SwampFunction** targetFunc = (const SwampFunction**) DECODED_STACK_POINTER(0);
+                uint16_t typeIdIndex = (uint16_t) (instruction->operands[1] & 0xffff);
+                uint8_t align = (uint8_t) (instruction->operands[1] >> 16);
+                const SwampFunc* sourceFunc = *(const SwampFunc**) DECODED_STACK_POINTER(2);
+                const void* argumentsStartPointer = DECODED_STACK_POINTER(3);
+                size_t argumentsRange = instruction->operands[4];
+                *targetFunc = (const SwampFunction*) swampCurryFuncAllocate(context->dynamicMemory, typeIdIndex, align, sourceFunc, argumentsStartPointer,
+                                                     argumentsRange);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeDecodedEnumCaseTable) {
+                uint8_t sourceUnionType = *(const uint8_t*) DECODED_STACK_POINTER(0);
+                const SwampInstruction* const* targets = (const SwampInstruction* const*) instruction->data;
+                const SwampInstruction* jumpToUse = sourceUnionType < instruction->operands[1] ? targets[sourceUnionType]
+                                                                                               : instruction->jump;
+                if (jumpToUse == 0) {
+                    CLOG_ERROR("could not find matching enum %d", sourceUnionType)
+                }
+                pc = jumpToUse;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeDecodedPatternMatchingIntTable) {
+                uint32_t index = (uint32_t) DECODED_INT(0) - instruction->operands[2];
+                const SwampInstruction* const* targets = (const SwampInstruction* const*) instruction->data;
+                pc = index < instruction->operands[1] ? targets[index] : instruction->jump;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeDecodedPatternMatchingIntSorted) {
+                SwampInt32 integerToMatch = DECODED_INT(0);
+                const SwampInstructionCase* cases = (const SwampInstructionCase*) instruction->data;
+                size_t low = 0;
+                size_t high = instruction->operands[1];
+                pc = instruction->jump;
+                while (low < high) {
+                    size_t middle = (low + high) / 2;
+                    if (cases[middle].value < integerToMatch) {
+                        low = middle + 1;
+                    } else if (cases[middle].value > integerToMatch) {
+                        high = middle;
+                    } else {
+                        pc = cases[middle].target;
+                        break;
+                    }
+                }
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodePatternMatchingString) {
+                const SwampString* stringToMatch = *(const SwampString**) DECODED_STACK_POINTER(0);
+                uint32_t hash = swampStringHash(stringToMatch);
+                const SwampInstructionStringCase* cases = (const SwampInstructionStringCase*) instruction->data;
+                uint32_t mask = instruction->operands[1] - 1;
+                pc = instruction->jump;
+                for (uint32_t i = hash & mask; cases[i].string; i = (i + 1) & mask) {
+                    if (cases[i].hash == hash && swampStringEqual(cases[i].string, stringToMatch)) {
+                        pc = cases[i].target;
+                        break;
+                    }
+                }
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeListCreate) {
+                SWAMP_ALLOCATION_SITE_DECODED(SwampOpcodeListCreate);
+                SwampListReferenceData listReferenceTarget = (SwampListReferenceData) DECODED_STACK_POINTER(0);
+                size_t itemSize = instruction->operands[1];
+                size_t itemAlign = instruction->operands[2];
+                size_t itemCount = instruction->operands[3];
+                const uint32_t* itemPositions = (const uint32_t*) instruction->data;
+                void* targetItems = swampDynamicMemoryAlloc(context->dynamicMemory, itemCount, itemSize, itemAlign);
+                uint8_t* pItems = targetItems;
+                for (size_t i = 0; i < itemCount; ++i) {
+                    swampMemoryCopy(pItems, bp + itemPositions[i], itemSize);
+                    pItems += itemSize;
+                }
+                const SwampList* list = swampListAllocateNoCopy(context->dynamicMemory, targetItems, itemCount,
+                                                                itemSize, itemAlign);
+                *listReferenceTarget = list;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeArrayCreate) {
+                SWAMP_ALLOCATION_SITE_DECODED(SwampOpcodeArrayCreate);
+                SwampArrayReferenceData arrayTarget = (SwampArrayReferenceData) DECODED_STACK_POINTER(0);
+                size_t itemSize = instruction->operands[1];
+                size_t itemAlign = instruction->operands[2];
+                size_t itemCount = instruction->operands[3];
+                const uint32_t* itemPositions = (const uint32_t*) instruction->data;
+                void* targetItems = swampDynamicMemoryAlloc(context->dynamicMemory, itemCount, itemSize, itemAlign);
+                uint8_t* pItems = targetItems;
+                for (size_t i = 0; i < itemCount; ++i) {
+                    swampMemoryCopy(pItems, bp + itemPositions[i], itemSize);
+                    pItems += itemSize;
+                }
+                SwampArray* newArray = (SwampArray*) swampDynamicMemoryAlloc(context->dynamicMemory, 1,
+                                                                             sizeof(SwampArray), 8);
+                newArray->value = targetItems;
+                newArray->count = itemCount;
+                newArray->itemSize = itemSize;
+                newArray->itemAlign = itemAlign;
+                *arrayTarget = newArray;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeStringAppend) {
+                SWAMP_ALLOCATION_SITE_DECODED(SwampOpcodeStringAppend);
+                const SwampStringReferenceData target = (SwampStringReferenceData) DECODED_STACK_POINTER(0);
+                const SwampStringReference sourceStringA = *(const SwampStringReferenceData) DECODED_STACK_POINTER(1);
+                const SwampStringReference sourceStringB = *(const SwampStringReferenceData) DECODED_STACK_POINTER(2);
+                *target = swampAllocateStringAppend(context->dynamicMemory, sourceStringA, sourceStringB);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeJump) {
+                pc = instruction->jump;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeBranchFalse) {
+                if (!*(const SwampBool*) DECODED_STACK_POINTER(0)) {
+                    pc = instruction->jump;
+                }
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeBranchTrue) {
+                if (*(const SwampBool*) DECODED_STACK_POINTER(0)) {
+                    pc = instruction->jump;
+                }
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeStringEqual) {
+                const SwampString* a = *(const SwampString**) DECODED_STACK_POINTER(1);
+                const SwampString* b = *(const SwampString**) DECODED_STACK_POINTER(2);
+                *(SwampBool*) DECODED_STACK_POINTER(0) = swampStringEqual(a, b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeStringNotEqual) {
+                const SwampString* a = *(const SwampString**) DECODED_STACK_POINTER(1);
+                const SwampString* b = *(const SwampString**) DECODED_STACK_POINTER(2);
+                *(SwampBool*) DECODED_STACK_POINTER(0) = !swampStringEqual(a, b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeCmpEnumEqual) {
+                const uint8_t* a = DECODED_STACK_POINTER(1);
+                const uint8_t* b = DECODED_STACK_POINTER(2);
+                *(SwampBool*) DECODED_STACK_POINTER(0) = *a == *b;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeCmpEnumNotEqual) {
+                const uint8_t* a = DECODED_STACK_POINTER(1);
+                const uint8_t* b = DECODED_STACK_POINTER(2);
+                *(SwampBool*) DECODED_STACK_POINTER(0) = *a != *b;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntAdd) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a + b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntSub) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a - b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntDiv) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a / b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntMul) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a * b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFixedDiv) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a * SWAMP_FIXED_FACTOR / b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFixedMul) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a * b / SWAMP_FIXED_FACTOR);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntGreater) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_BOOL(a > b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntGreaterOrEqual) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_BOOL(a >= b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntLess) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_BOOL(a < b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntLessEqual) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_BOOL(a <= b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntEqual) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_BOOL(a == b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntNotEqual) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_BOOL(a != b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeBooleanEqual) {
+                const SwampBool* a = DECODED_STACK_POINTER(1);
+                const SwampBool* b = DECODED_STACK_POINTER(2);
+                *(SwampBool*) DECODED_STACK_POINTER(0) = *a == *b;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeBooleanNotEqual) {
+                const SwampBool* a = DECODED_STACK_POINTER(1);
+                const SwampBool* b = DECODED_STACK_POINTER(2);
+                *(SwampBool*) DECODED_STACK_POINTER(0) = *a != *b;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntAnd) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a & b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntOr) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a | b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntXor) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a ^ b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntShiftLeft) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a << b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntShiftRight) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a >> b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntRemainder) {
+                GET_DECODED_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(a % b);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntNot) {
+                GET_DECODED_UNARY_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(~a);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeIntNegate) {
+                GET_DECODED_UNARY_OPERATOR_INT();
+                SET_OPERATOR_RESULT_INT(-a);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeBoolNot) {
+                *(SwampBool*) DECODED_STACK_POINTER(0) = !*(const SwampBool*) DECODED_STACK_POINTER(1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntEqualBranchFalse) {
+                DECODED_COMPARE_AND_BRANCH(a == b, 0);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntNotEqualBranchFalse) {
+                DECODED_COMPARE_AND_BRANCH(a != b, 0);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntLessBranchFalse) {
+                DECODED_COMPARE_AND_BRANCH(a < b, 0);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntLessEqualBranchFalse) {
+                DECODED_COMPARE_AND_BRANCH(a <= b, 0);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntGreaterBranchFalse) {
+                DECODED_COMPARE_AND_BRANCH(a > b, 0);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntGreaterOrEqualBranchFalse) {
+                DECODED_COMPARE_AND_BRANCH(a >= b, 0);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntEqualBranchTrue) {
+                DECODED_COMPARE_AND_BRANCH(a == b, 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntNotEqualBranchTrue) {
+                DECODED_COMPARE_AND_BRANCH(a != b, 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntLessBranchTrue) {
+                DECODED_COMPARE_AND_BRANCH(a < b, 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntLessEqualBranchTrue) {
+                DECODED_COMPARE_AND_BRANCH(a <= b, 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntGreaterBranchTrue) {
+                DECODED_COMPARE_AND_BRANCH(a > b, 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntGreaterOrEqualBranchTrue) {
+                DECODED_COMPARE_AND_BRANCH(a >= b, 1);
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntAddImmediate) {
+                SwampInt32 value = (SwampInt32) instruction->operands[1];
+                *(SwampInt32*) DECODED_STACK_POINTER(0) = value;
+                *(SwampInt32*) DECODED_STACK_POINTER(2) = DECODED_INT(3) + value;
+                pc = instruction + instruction->instructionCount;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedIntSubImmediate) {
+                SwampInt32 value = (SwampInt32) instruction->operands[1];
+                *(SwampInt32*) DECODED_STACK_POINTER(0) = value;
+                *(SwampInt32*) DECODED_STACK_POINTER(2) = DECODED_INT(3) - value;
+                pc = instruction + instruction->instructionCount;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE(SwampOpcodeFusedMemCopyMulti) {
+                const SwampInstruction* end = instruction + instruction->instructionCount;
+                for (const SwampInstruction* copy = instruction; copy != end; ++copy) {
+                    tc_memcpy_octets((void*) (bp + copy->operands[0]), bp + copy->operands[1], copy->operands[2]);
+                }
+                pc = end;
+            } SWAMP_DECODED_NEXT();
+
+            SWAMP_DECODED_OPCODE_UNKNOWN
+                SWAMP_ERROR("Unknown decoded opcode: %02x", instruction->opcode)
+                return 0;
+        }
     }
+}
 
-    if (result->expectedOctetSize != f->returnOctetSize) {
-        SWAMP_LOG_SOFT_ERROR("swampRun: expected result %zu, but function returns %zu (%s)", result->expectedOctetSize,
-                             f->returnOctetSize, f->debugName);
-        return -2;
+const void* swampRunInstructionHandler(uint16_t opcode)
+{
+    const void* const* dispatchTable;
+    swampRunDecoded(0, 0, 0, &dispatchTable);
+    if (!dispatchTable) {
+        return 0;
     }
 
+    return dispatchTable[opcode & 0xff];
+}
+
+// Executes the opcodes directly, parameters and result must already have been validated.
+static int swampRunOpcodes(SwampResult* result, SwampMachineContext* context, const SwampFunc* f,
+                           SwampBool verbose_flag)
+{
+    const uint8_t* pc = f->opcodes;
+    const uint8_t* bp = context->bp;
+
+    SwampCallStack* stack = &context->callStack;
+    SwampCallStackEntry* call_stack_entry = &stack->entries[0];
+    call_stack_entry->func = f;
+    call_stack_entry->pc = pc;
+    call_stack_entry->basePointer = bp;
+
+    //CLOG_VERBOSE("SAVE start '%s' pc:%p bp:%p", f->debugName, pc, bp)
+
 #if SWAMP_CALL_DEBUG
     CLOG_INFO("call '%s' %d", f->debugName, f->parameterCount);
     char temp[8*1024];
@@ -201,9 +1021,76 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
 
 #endif
 
+#if SWAMP_RUN_DIRECT_THREADED
+    static const void* const dispatchTable[256] = {
+        [0x00] = &&opcodeLabelUnknown,
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeEnumCase),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeBranchFalse),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeBranchTrue),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeJump),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCall),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeReturn),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCallExternal),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeTailCall),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCurry),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntAdd),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntSub),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntMul),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntDiv),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntNegate),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeFixedMul),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeFixedDiv),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntNotEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntLess),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntLessEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntGreater),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntGreaterOrEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeBoolNot),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeStringEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeStringNotEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntAnd),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntOr),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntXor),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntNot),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeListCreate),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeArrayCreate),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeListConj),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeListAppend),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeStringAppend),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeLoadInteger),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeLoadBoolean),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeLoadRune),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeLoadZeroMemory),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeMemCopy),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeSetEnum),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCallExternalWithSizes),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCmpEnumEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCmpEnumNotEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodePatternMatchingInt),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodePatternMatchingString),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeCallExternalWithExtendedSizes),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntShiftLeft),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntShiftRight),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeIntRemainder),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeBooleanEqual),
+        SWAMP_DISPATCH_ENTRY(SwampOpcodeBooleanNotEqual),
+        [SwampOpcodeBooleanNotEqual + 1 ... 0xff] = &&opcodeLabelUnknown,
+    };
+#endif
+
+#if SWAMP_RUN_COUNT_OPCODES
+    size_t executedOpcodeCount = 0;
+#endif
+#if SWAMP_RUN_PROFILER
+    SwampProfiler* profiler = context->profiler;
+    SwampAllocationProfiler* allocationProfiler = context->dynamicMemory->allocationProfiler;
+#endif
+
 #if SWAMP_RUN_MEASURE_PERFORMANCE
     call_stack_entry->debugBeforeTimeNs = monotonicTimeNanosecondsNow();
 #endif
+    // With direct threaded dispatch the loop is only entered once, each opcode jumps directly to the next one.
     while (1) {
 #if SWAMP_CONFIG_DEBUG || DEBUGLOG_PARAMS
         if (verbose_flag) {
@@ -215,10 +1102,12 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
             SWAMP_LOG_INFO("--- %d:'%s' %04X %s [0x%02x]", context->callStack.count, call_stack_entry->func->debugName, addr, swamp_opcode_name(*pc), *pc);
         }
 #endif
+        SWAMP_COUNT_OPCODE();
+        SWAMP_PROFILE_RAW_OPCODE();
 
-        switch (*pc++) {
+        SWAMP_DISPATCH(*pc++) {
 
-            case SwampOpcodeReturn: {
+            SWAMP_OPCODE(SwampOpcodeReturn) {
 #if SWAMP_RUN_MEASURE_PERFORMANCE
                 MonotonicTimeNanoseconds after = monotonicTimeNanosecondsNow();
                 MonotonicTimeNanoseconds timeSpent = after - call_stack_entry->debugBeforeTimeNs;
@@ -233,6 +1122,9 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                                              f->returnOctetSize, f->debugName);
                         return -3;
                     }
+#if SWAMP_RUN_COUNT_OPCODES
+                    g_swampRunExecutedOpcodeCount += executedOpcodeCount;
+#endif
 
                     return 0;
                 }
@@ -245,43 +1137,44 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                      //            bp - context->stackMemory.memory);
                 }
                 // context = &call_stack_entry->context;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeLoadZeroMemory: {
+            SWAMP_OPCODE(SwampOpcodeLoadZeroMemory) {
                 const void** target = readTargetStackPointerPos(&pc, bp);
                 *target = readSourceStaticMemoryPointerPos(&pc, context->constantStaticMemory);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeLoadInteger: {
+            SWAMP_OPCODE(SwampOpcodeLoadInteger) {
                 SwampInt32* target = ((SwampInt32*) readTargetStackPointerPos(&pc, bp));
                 *target = readInt32(&pc);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeLoadBoolean: {
+            SWAMP_OPCODE(SwampOpcodeLoadBoolean) {
                 SwampBool* target = ((SwampBool*) readTargetStackPointerPos(&pc, bp));
                 *target = readBool(&pc);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeLoadRune: {
+            SWAMP_OPCODE(SwampOpcodeLoadRune) {
                 SwampCharacter* target = ((SwampCharacter*) readTargetStackPointerPos(&pc, bp));
                 *target = readU8(&pc);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeMemCopy: {
+            SWAMP_OPCODE(SwampOpcodeMemCopy) {
                 uint8_t* target = ((uint8_t*) readTargetStackPointerPos(&pc, bp));
                 const uint8_t* source = ((const uint8_t*) readSourceStackPointerPos(&pc, bp));
                 uint16_t range = readShortRange(&pc);
                 tc_memcpy_octets(target, source, range);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeSetEnum: {
+            SWAMP_OPCODE(SwampOpcodeSetEnum) {
                 uint8_t* target = ((uint8_t*) readTargetStackPointerPos(&pc, bp));
                 *target = readU8(&pc);
                 size_t itemSize = readShortRange(&pc);
                 tc_mem_clear(target+1, itemSize-1);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeListConj: {
+            SWAMP_OPCODE(SwampOpcodeListConj) {
+                SWAMP_ALLOCATION_SITE_RAW(SwampOpcodeListConj);
                 SwampListReferenceData target = (SwampListReferenceData) readTargetStackPointerPos(&pc, bp);
                 const SwampListReference sourceList = *(const SwampListReferenceData) readSourceStackPointerPos(&pc, bp);
                 const void* sourceItem = readSourceStackPointerPos(&pc, bp);
@@ -292,67 +1185,45 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                         CLOG_ERROR("wrong source list")
                     }
                 }
-                SwampList* newList = (SwampList*) swampDynamicMemoryAlloc(context->dynamicMemory, 1, sizeof(SwampList), 8);
-                uint8_t* dynamicItemMemory = (uint8_t*) swampDynamicMemoryAlloc(context->dynamicMemory, sourceList->count+1, itemSize, itemAlign);
-                swampMemoryCopy(dynamicItemMemory, sourceItem, itemSize);
-                swampMemoryCopy(dynamicItemMemory + itemSize, sourceList->value, sourceList->count * itemSize);
-                newList->value = dynamicItemMemory;
-                newList->count = sourceList->count + 1;
-                newList->itemAlign = itemAlign;
-                newList->itemSize = itemSize;
-
-                *target = newList;
-            } break;
-
-            case SwampOpcodeListAppend: {
+                *target = swampAllocateListConj(context->dynamicMemory, sourceList, sourceItem, itemSize, itemAlign);
+            } SWAMP_NEXT();
+
+            SWAMP_OPCODE(SwampOpcodeListAppend) {
+                SWAMP_ALLOCATION_SITE_RAW(SwampOpcodeListAppend);
                 SwampListReferenceData target = (SwampListReferenceData) readTargetStackPointerPos(&pc, bp);
                 const SwampListReference sourceListA = *(const SwampListReferenceData) readSourceStackPointerPos(&pc, bp);
                 const SwampListReference sourceListB = *(const SwampListReferenceData) readSourceStackPointerPos(&pc, bp);
                 *target = swampAllocateListAppendNoCopy(context->dynamicMemory, sourceListA, sourceListB);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeCallExternalWithSizes: {
+            SWAMP_OPCODE(SwampOpcodeCallExternalWithSizes) {
                 call_stack_entry->pc = pc;
                 const uint8_t* basePointer = readSourceStackPointerPos(&pc, bp);
                 const SwampFunctionExternal* externalFunction = *(
                     (const SwampFunctionExternal**) readStackPointerPos(&pc, bp));
                 uint8_t count = readShortCount(&pc);
-                const void* params[8];
+                if (count == 0 || count > SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1) {
+                    SWAMP_LOG_ERROR("strange parameter count in external with sizes");
+                }
+                const void* params[SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1];
                 for (uint8_t i = 0; i < count; i++) {
                     uint16_t offset = readU16(&pc);
                     readU16(&pc); // uint16_t size =
                     params[i] = basePointer + offset;
                 }
-                switch (count - 1) { // externalfunction->paramCOunt
-                    case 0:
-                        externalFunction->function0((void*)basePointer, context);
-                        break;
-                    case 1:
-                        externalFunction->function1((void*)basePointer, context, params[1]);
-                        break;
-                    case 2:
-                        externalFunction->function2((void*)basePointer, context, params[1], params[2]);
-                        break;
-                    case 3:
-                        externalFunction->function3((void*)basePointer, context, params[1], params[2], params[3]);
-                        break;
-                    case 4:
-                        externalFunction->function4((void*)basePointer, context, params[1], params[2], params[3], params[4]);
-                        break;
-                    case 5:
-                        externalFunction->function5((void*)basePointer, context, params[1], params[2], params[3], params[4], params[5]);
-                        break;
-                    default:
-                        SWAMP_LOG_ERROR("strange parameter count in external with sizes");
-                }
-            } break;
-            case SwampOpcodeCallExternalWithExtendedSizes: {
+                SWAMP_PROFILE_CALL(externalFunction);
+                callExternalWithParameters(externalFunction, basePointer, context, params, count);
+            } SWAMP_NEXT();
+            SWAMP_OPCODE(SwampOpcodeCallExternalWithExtendedSizes) {
                 call_stack_entry->pc = pc;
                 const uint8_t* basePointer = readSourceStackPointerPos(&pc, bp);
                 const SwampFunctionExternal* externalFunction = *(
                     (const SwampFunctionExternal**) readStackPointerPos(&pc, bp));
                 uint8_t count = readShortCount(&pc);
-                SwampUnknownType unknownTypes[8];
+                if (count == 0 || count > SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1) {
+                    SWAMP_LOG_ERROR("strange parameter count in external with sizes");
+                }
+                SwampUnknownType unknownTypes[SWAMP_FUNCTION_EXTERNAL_MAX_ARGUMENT_COUNT + 1];
                 for (uint8_t i = 0; i < count; i++) {
                     uint16_t offset = readU16(&pc);
                     uint16_t size = readU16(&pc);
@@ -361,87 +1232,30 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                     unknownTypes[i].size = size;
                     unknownTypes[i].align = align;
                 }
-                switch (count - 1) { // externalfunction->paramCOunt
-                    case 1:
-                        externalFunction->function1((void*)basePointer, context, &unknownTypes[1]);
-                        break;
-                    case 2:
-                        externalFunction->function2((void*)basePointer, context, &unknownTypes[1], &unknownTypes[2]);
-                        break;
-                    case 3:
-                        externalFunction->function3((void*)basePointer, context, &unknownTypes[1], &unknownTypes[2], &unknownTypes[3]);
-                        break;
-                    case 4:
-                        externalFunction->function4((void*)basePointer, context, &unknownTypes[1], &unknownTypes[2], &unknownTypes[3], &unknownTypes[4]);
-                        break;
-                    case 5:
-                        externalFunction->function5((void*)basePointer, context, &unknownTypes[1], &unknownTypes[2], &unknownTypes[3], &unknownTypes[4], &unknownTypes[5]);
-                        break;
-                    default:
-                        SWAMP_LOG_ERROR("strange parameter count in external with sizes");
-                }
-            } break;
-            case SwampOpcodeTailCall: {
+                SWAMP_PROFILE_CALL(externalFunction);
+                callExternalWithUnknownTypes(externalFunction, basePointer, context, unknownTypes, count);
+            } SWAMP_NEXT();
+            SWAMP_OPCODE(SwampOpcodeTailCall) {
                 pc = call_stack_entry->func->opcodes;
                 call_stack_entry->pc = pc;
-            } break;
-            case SwampOpcodeCall:
-            case SwampOpcodeCallExternal: {
+            } SWAMP_NEXT();
+            SWAMP_OPCODE(SwampOpcodeCall)
+            SWAMP_OPCODE(SwampOpcodeCallExternal) {
                 const uint8_t* basePointer = readSourceStackPointerPos(&pc, bp);
                 const SwampFunc* func = *((const SwampFunc**) readStackPointerPos(&pc, bp));
 
-                if (func->func.type == SwampFunctionTypeCurry) {
-                    //CLOG_VERBOSE("SwampFunctionTypeCurry pc:%p bp:%p", pc, bp)
-                    const SwampCurryFunc* curry = (const SwampCurryFunc*) func;
-                    swampMemoryMove((basePointer + curry->curryOctetSize), basePointer, func->parametersOctetSize);
-                    swampMemoryCopy(basePointer, curry->curryOctets, curry->curryOctetSize);
-                    func = curry->curryFunction;
-                }
+                func = prepareCurry(func, (uint8_t*) basePointer);
+                SWAMP_PROFILE_CALL(func);
 
                 if (func->func.type == SwampFunctionTypeExternal) {
+                    call_stack_entry->pc = pc;
 #if SWAMP_RUN_MEASURE_PERFORMANCE
                     MonotonicTimeNanoseconds beforeTimeNs = monotonicTimeNanosecondsNow();
 #endif
                     const SwampFunctionExternal* externalFunction = (const SwampFunctionExternal*) func;
                     //CLOG_VERBOSE("Callexternal '%s' pc:%p bp:%d", externalFunction->fullyQualifiedName, pc,
                       //          bp - context->stackMemory.memory)
-                    switch (func->parameterCount) {
-                        case 0:
-                            externalFunction->function0((void*)basePointer, context);
-                            break;
-                        case 1:
-                            externalFunction->function1((void*)basePointer, context,
-                                                        basePointer + externalFunction->parameters[0].pos);
-                            break;
-                        case 2:
-                            externalFunction->function2((void*)basePointer, context,
-                                                        basePointer + externalFunction->parameters[0].pos,
-                                                        basePointer + externalFunction->parameters[1].pos);
-                            break;
-                        case 3:
-                            externalFunction->function3((void*)basePointer, context,
-                                                        basePointer + externalFunction->parameters[0].pos,
-                                                        basePointer + externalFunction->parameters[1].pos,
-                                                        basePointer + externalFunction->parameters[2].pos);
-                            break;
-                        case 4:
-                            externalFunction->function4((void*)basePointer, context,
-                                                        basePointer + externalFunction->parameters[0].pos,
-                                                        basePointer + externalFunction->parameters[1].pos,
-                                                        basePointer + externalFunction->parameters[2].pos,
-                                                        basePointer + externalFunction->parameters[3].pos);
-                            break;
-                        case 5:
-                            externalFunction->function5((void*)basePointer, context,
-                                                        basePointer + externalFunction->parameters[0].pos,
-                                                        basePointer + externalFunction->parameters[1].pos,
-                                                        basePointer + externalFunction->parameters[2].pos,
-                                                        basePointer + externalFunction->parameters[3].pos,
-                                                        basePointer + externalFunction->parameters[4].pos);
-                                                        break;
-                        default:
-                            SWAMP_LOG_ERROR("strange parameter count in external");
-                    }
+                    callExternal(externalFunction, basePointer, context);
 #if SWAMP_RUN_MEASURE_PERFORMANCE
                     MonotonicTimeNanoseconds afterTimeNs = monotonicTimeNanosecondsNow();
                     CLOG_INFO("external '%s' %lu ns", externalFunction->fullyQualifiedName, afterTimeNs - beforeTimeNs);
@@ -476,9 +1290,10 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                     call_stack_entry->debugBeforeTimeNs = monotonicTimeNanosecondsNow();
 #endif
                 }
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeCurry: {
+            SWAMP_OPCODE(SwampOpcodeCurry) {
+                SWAMP_ALLOCATION_SITE_RAW(SwampOpcodeCurry);
                 const SwampFunction** targetFunc = (const SwampFunction**) readTargetStackPointerPos(&pc, bp);
                 uint16_t typeIdIndex = readU16(&pc);
                 uint8_t align = readU8(&pc);
@@ -487,9 +1302,9 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                 size_t argumentsRange = readShortRange(&pc);
                 *targetFunc = (const SwampFunction*) swampCurryFuncAllocate(context->dynamicMemory, typeIdIndex, align, sourceFunc, argumentsStartPointer,
                                                      argumentsRange);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeEnumCase: {
+            SWAMP_OPCODE(SwampOpcodeEnumCase) {
                 const void* source = readSourceStackPointerPos(&pc, bp);
                 uint8_t caseCount = *pc++;
                 const uint8_t* jumpPcToUse = 0;
@@ -519,9 +1334,9 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                     CLOG_ERROR("could not find matching enum %d", sourceUnionType)
                 }
                 pc = jumpPcToUse;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodePatternMatchingInt: {
+            SWAMP_OPCODE(SwampOpcodePatternMatchingInt) {
                 SwampInt32 integerToMatch = readSourceIntStackPointerPos(&pc, bp);
                 size_t consequenceCount = readShortCount(&pc);
                 int found = 0;
@@ -550,9 +1365,47 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                     jumpToUse = previousJumpTarget;
                 }
                 pc = jumpToUse;
-            } break;
+            } SWAMP_NEXT();
+
+            // Same layout as PatternMatchingInt, but each case has a static memory position to a SwampString.
+            // The hashed lookup is only done for decoded functions, see decodePatternMatchingString(), since the raw
+            // opcodes have nowhere to keep the case hashes. The scan rejects most cases on the character count.
+            SWAMP_OPCODE(SwampOpcodePatternMatchingString) {
+                const SwampString* stringToMatch = *(const SwampString**) readSourceStackPointerPos(&pc, bp);
+                size_t consequenceCount = readShortCount(&pc);
+                int found = 0;
+                const uint8_t* jumpToUse = 0;
+                const uint8_t* previousJumpTarget = 0;
+                for (uint8_t consequenceIndex = 0; consequenceIndex < consequenceCount; ++consequenceIndex) {
+                    const SwampString* consequenceString = readSourceStaticMemoryPointerPos(&pc, context->constantStaticMemory);
+                    SwampJumpOffset jumpOffset = readJumpOffset(&pc);
+
+                    if (!previousJumpTarget) {
+                        previousJumpTarget = pc;
+                    }
+                    previousJumpTarget += jumpOffset;
+
+                    if (swampStringEqual(stringToMatch, consequenceString)) {
+                        jumpToUse = previousJumpTarget;
+                        uint8_t rest = consequenceCount - consequenceIndex - 1;
+                        pc += (rest * (4 + 2)) + 2;
+                        found = 1;
+                        break;
+                    }
+                }
+                if (!found) {
+                    SwampJumpOffset jumpOffset = readJumpOffset(&pc);
+                    if (!previousJumpTarget) {
+                        previousJumpTarget = pc;
+                    }
+                    previousJumpTarget += jumpOffset;
+                    jumpToUse = previousJumpTarget;
+                }
+                pc = jumpToUse;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeListCreate: {
+            SWAMP_OPCODE(SwampOpcodeListCreate) {
+                SWAMP_ALLOCATION_SITE_RAW(SwampOpcodeListCreate);
                 SwampListReferenceData listReferenceTarget = (SwampListReferenceData) readTargetStackPointerPos(&pc,
                                                                                                                 bp);
                 size_t itemSize = readShortRange(&pc);
@@ -568,9 +1421,10 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                 const SwampList* list = swampListAllocateNoCopy(context->dynamicMemory, targetItems, itemCount,
                                                                 itemSize, itemAlign);
                 *listReferenceTarget = list;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeArrayCreate: {
+            SWAMP_OPCODE(SwampOpcodeArrayCreate) {
+                SWAMP_ALLOCATION_SITE_RAW(SwampOpcodeArrayCreate);
                 SwampArrayReferenceData arrayTarget = (SwampArrayReferenceData) readTargetStackPointerPos(&pc, bp);
                 size_t itemSize = readShortRange(&pc);
                 size_t itemAlign = readAlign(&pc);
@@ -589,196 +1443,258 @@ int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc*
                 newArray->itemSize = itemSize;
                 newArray->itemAlign = itemAlign;
                 *arrayTarget = newArray;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeStringAppend: {
+            SWAMP_OPCODE(SwampOpcodeStringAppend) {
+                SWAMP_ALLOCATION_SITE_RAW(SwampOpcodeStringAppend);
                 const SwampStringReferenceData target = (SwampStringReferenceData) readTargetStackPointerPos(&pc, bp);
                 const SwampStringReference sourceStringA = *(
                     (const SwampStringReferenceData) readSourceStackPointerPos(&pc, bp));
                 const SwampStringReference sourceStringB = *(
                     (const SwampStringReferenceData) readSourceStackPointerPos(&pc, bp));
-                size_t totalCharacterCount = sourceStringA->characterCount + sourceStringB->characterCount;
-                char* newCharacters = swampDynamicMemoryAlloc(context->dynamicMemory, 1, totalCharacterCount + 1, 1);
-                tc_memcpy_octets(newCharacters, sourceStringA->characters, sourceStringA->characterCount);
-                tc_memcpy_octets(newCharacters + sourceStringA->characterCount, sourceStringB->characters,
-                                 sourceStringB->characterCount + 1);
-                SwampString* newString = swampDynamicMemoryAlloc(context->dynamicMemory, 1, sizeof(SwampString), 8);
-                newString->characterCount = totalCharacterCount;
-                newString->characters = newCharacters;
-                *target = newString;
-            } break;
-
-            case SwampOpcodeJump: {
+                *target = swampAllocateStringAppend(context->dynamicMemory, sourceStringA, sourceStringB);
+            } SWAMP_NEXT();
+
+            SWAMP_OPCODE(SwampOpcodeJump) {
                 SwampJump jump = readJump(&pc);
                 pc += jump;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeBranchFalse: {
+            SWAMP_OPCODE(SwampOpcodeBranchFalse) {
                 SwampBool truth = *((SwampBool*) readSourceStackPointerPos(&pc, bp));
                 SwampJump jump = readJump(&pc);
                 if (!truth) {
                     pc += jump;
                 }
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeBranchTrue: {
+            SWAMP_OPCODE(SwampOpcodeBranchTrue) {
                 SwampBool truth = *((SwampBool*) readSourceStackPointerPos(&pc, bp));
                 SwampJump jump = readJump(&pc);
                 if (truth) {
                     pc += jump;
                 }
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeStringEqual: {
+            SWAMP_OPCODE(SwampOpcodeStringEqual) {
                 SwampBool* target = (SwampBool*) readTargetStackPointerPos(&pc, bp);
                 const SwampString* a = *((SwampString**) readSourceStackPointerPos(&pc, bp));
                 const SwampString* b = *((SwampString**) readSourceStackPointerPos(&pc, bp));
                 *target = swampStringEqual(a, b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeStringNotEqual: {
+            SWAMP_OPCODE(SwampOpcodeStringNotEqual) {
                 SwampBool* target = (SwampBool*) readTargetStackPointerPos(&pc, bp);
                 const SwampString* a = *((SwampString**) readSourceStackPointerPos(&pc, bp));
                 const SwampString* b = *((SwampString**) readSourceStackPointerPos(&pc, bp));
                 *target = !swampStringEqual(a, b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeCmpEnumEqual: {
+            SWAMP_OPCODE(SwampOpcodeCmpEnumEqual) {
                 SwampBool* targetRegister = readTargetStackPointerPos(&pc, bp);
                 const uint8_t* a = readSourceStackPointerPos(&pc, bp);
                 const uint8_t* b = readSourceStackPointerPos(&pc, bp);
                 *targetRegister = *a == *b;
-            } break;
-            case SwampOpcodeCmpEnumNotEqual: {
+            } SWAMP_NEXT();
+            SWAMP_OPCODE(SwampOpcodeCmpEnumNotEqual) {
                 SwampBool* targetRegister = readTargetStackPointerPos(&pc, bp);
                 const uint8_t* a = readSourceStackPointerPos(&pc, bp);
                 const uint8_t* b = readSourceStackPointerPos(&pc, bp);
                 *targetRegister = *a != *b;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntAdd: {
+            SWAMP_OPCODE(SwampOpcodeIntAdd) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a + b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntSub: {
+            SWAMP_OPCODE(SwampOpcodeIntSub) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a - b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntDiv: {
+            SWAMP_OPCODE(SwampOpcodeIntDiv) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a / b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntMul: {
+            SWAMP_OPCODE(SwampOpcodeIntMul) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a * b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeFixedDiv: {
+            SWAMP_OPCODE(SwampOpcodeFixedDiv) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a * SWAMP_FIXED_FACTOR / b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeFixedMul: {
+            SWAMP_OPCODE(SwampOpcodeFixedMul) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a * b / SWAMP_FIXED_FACTOR);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntGreater: {
+            SWAMP_OPCODE(SwampOpcodeIntGreater) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_BOOL(a > b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntGreaterOrEqual: {
+            SWAMP_OPCODE(SwampOpcodeIntGreaterOrEqual) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_BOOL(a >= b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntLess: {
+            SWAMP_OPCODE(SwampOpcodeIntLess) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_BOOL(a < b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntLessEqual: {
+            SWAMP_OPCODE(SwampOpcodeIntLessEqual) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_BOOL(a <= b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntEqual: {
+            SWAMP_OPCODE(SwampOpcodeIntEqual) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_BOOL(a == b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntNotEqual: {
+            SWAMP_OPCODE(SwampOpcodeIntNotEqual) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_BOOL(a != b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeBooleanEqual: {
+            SWAMP_OPCODE(SwampOpcodeBooleanEqual) {
                 SwampBool* targetRegister = readTargetStackPointerPos(&pc, bp);
                 const SwampBool* a = readSourceStackPointerPos(&pc, bp);
                 const SwampBool* b = readSourceStackPointerPos(&pc, bp);
                 *targetRegister = *a == *b;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeBooleanNotEqual: {
+            SWAMP_OPCODE(SwampOpcodeBooleanNotEqual) {
                 SwampBool* targetRegister = readTargetStackPointerPos(&pc, bp);
                 const SwampBool* a = readSourceStackPointerPos(&pc, bp);
                 const SwampBool* b = readSourceStackPointerPos(&pc, bp);
                 *targetRegister = *a != *b;
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntAnd: {
+            SWAMP_OPCODE(SwampOpcodeIntAnd) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a & b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntOr: {
+            SWAMP_OPCODE(SwampOpcodeIntOr) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a | b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntXor: {
+            SWAMP_OPCODE(SwampOpcodeIntXor) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a ^ b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntShiftLeft: {
+            SWAMP_OPCODE(SwampOpcodeIntShiftLeft) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a << b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntShiftRight: {
+            SWAMP_OPCODE(SwampOpcodeIntShiftRight) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a >> b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntRemainder: {
+            SWAMP_OPCODE(SwampOpcodeIntRemainder) {
                 GET_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(a % b);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntNot: {
+            SWAMP_OPCODE(SwampOpcodeIntNot) {
                 GET_UNARY_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(~a);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeIntNegate: {
+            SWAMP_OPCODE(SwampOpcodeIntNegate) {
                 GET_UNARY_OPERATOR_INT();
                 SET_OPERATOR_RESULT_INT(-a);
-            } break;
+            } SWAMP_NEXT();
 
-            case SwampOpcodeBoolNot: {
+            SWAMP_OPCODE(SwampOpcodeBoolNot) {
                 SwampBool* target = (SwampBool*) readTargetStackPointerPos(&pc, bp);
                 SwampBool a = *((SwampBool*) readSourceStackPointerPos(&pc, bp));
                 *target = !a;
-            } break;
+            } SWAMP_NEXT();
 
-            default:
+            SWAMP_OPCODE_UNKNOWN
                 SWAMP_ERROR("Unknown opcode: %02x", *(pc - 1))
                 return 0;
         }
     }
 }
+
+#if SWAMP_RUN_DIRECT_THREADED
+#pragma GCC diagnostic pop
+#endif
+
+static int swampRunFunc(SwampResult* result, SwampMachineContext* context, const SwampFunc* f,
+                        const SwampDecodedFunc* decodedFunc, SwampBool verbose_flag)
+{
+#if SWAMP_RUN_PROFILER
+    SwampProfiler* profiler = context->profiler;
+    SwampAllocationProfiler* allocationProfiler = context->dynamicMemory->allocationProfiler;
+    if (profiler || allocationProfiler) {
+        // A nested run (from an external function) must not leave its sites behind for the external function
+        SwampAllocationProfilerSite allocationSite;
+        if (allocationProfiler) {
+            swampAllocationProfilerSaveSite(allocationProfiler, &allocationSite);
+        }
+        if (profiler) {
+            swampProfilerRunBegin(profiler, context, f);
+        }
+        int errorCode = decodedFunc ? swampRunDecoded(result, context, decodedFunc, 0)
+                                    : swampRunOpcodes(result, context, f, verbose_flag);
+        if (profiler) {
+            swampProfilerRunEnd(profiler);
+        }
+        if (allocationProfiler) {
+            swampAllocationProfilerRestoreSite(allocationProfiler, &allocationSite);
+        }
+        return errorCode;
+    }
+#endif
+
+    if (decodedFunc) {
+        return swampRunDecoded(result, context, decodedFunc, 0);
+    }
+
+    return swampRunOpcodes(result, context, f, verbose_flag);
+}
+
+int swampRun(SwampResult* result, SwampMachineContext* context, const SwampFunc* f, SwampParameters runParameters,
+             SwampBool verbose_flag)
+{
+    if (runParameters.parameterCount != f->parameterCount) {
+        // ERROR
+        SWAMP_LOG_INFO("mismatch! param count %zu vs function says %zu (%p, %s)", runParameters.parameterCount,
+                       f->parameterCount, (const void*) f, f->debugName);
+        // swamp_value_print((const swamp_value*) f, "swamp_run()");
+        return -3;
+    }
+
+    if (result->expectedOctetSize != f->returnOctetSize) {
+        SWAMP_LOG_SOFT_ERROR("swampRun: expected result %zu, but function returns %zu (%s)", result->expectedOctetSize,
+                             f->returnOctetSize, f->debugName);
+        return -2;
+    }
+
+    const SwampDecodedFunc* decodedFunc = 0;
+    if (context->decodedProgram) {
+        decodedFunc = swampDecodedProgramFind(context->decodedProgram, f);
+    }
+
+    return swampRunFunc(result, context, f, decodedFunc, verbose_flag);
+}
+
+int swampRunPrepared(SwampResult* result, SwampMachineContext* context, const SwampFunc* f,
+                     const SwampDecodedFunc* decodedFunc)
+{
+    return swampRunFunc(result, context, f, decodedFunc, 0);
+}
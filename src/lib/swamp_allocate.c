@@ -26,6 +26,110 @@ const SwampString* swampStringAllocate(SwampDynamicMemory* self, const char* s)
     return swampStringAllocateWithSize(self, s, stringLength);
 }
 
+static size_t swampUnterminatedStringIndex(const SwampString* string, size_t capacity)
+{
+    return (size_t) (((uintptr_t) string >> 3) * 0x9e3779b1u) & (capacity - 1);
+}
+
+static void swampUnterminatedStringAdd(SwampDynamicMemory* self, const SwampString* string)
+{
+    if ((self->unterminatedStringCount + 1) * 2 > self->unterminatedStringCapacity) {
+        const SwampString** oldStrings = self->unterminatedStrings;
+        size_t oldCapacity = self->unterminatedStringCapacity;
+        size_t capacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+        self->unterminatedStrings = tc_malloc(sizeof(self->unterminatedStrings[0]) * capacity);
+        tc_mem_clear(self->unterminatedStrings, sizeof(self->unterminatedStrings[0]) * capacity);
+        self->unterminatedStringCapacity = capacity;
+        self->unterminatedStringCount = 0;
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldStrings[i]) {
+                swampUnterminatedStringAdd(self, oldStrings[i]);
+            }
+        }
+        tc_free(oldStrings);
+    }
+
+    size_t mask = self->unterminatedStringCapacity - 1;
+    size_t index = swampUnterminatedStringIndex(string, self->unterminatedStringCapacity);
+    while (self->unterminatedStrings[index]) {
+        if (self->unterminatedStrings[index] == string) {
+            return;
+        }
+        index = (index + 1) & mask;
+    }
+    self->unterminatedStrings[index] = string;
+    self->unterminatedStringCount++;
+}
+
+// Appends the characters of b to the characters of a. The characters are placed in a buffer with free room after
+// them, so when the newest string is appended to again (e.g. when building a string in a loop), b is written after it
+// and the characters of a are shared. The terminating zero of a is overwritten, so a is remembered until it is given
+// characters of its own by swampStringTerminateAll(). The characterCount of existing strings is never changed.
+const SwampString* swampAllocateStringAppend(SwampDynamicMemory* self, const SwampString* a, const SwampString* b)
+{
+    SwampString* newString = (SwampString*) swampDynamicMemoryAlloc(self, 1, sizeof(SwampString), 8);
+    size_t totalCharacterCount = a->characterCount + b->characterCount;
+
+    char* characters;
+    if (a->characterCount != 0 && a->characters + a->characterCount == self->stringAppendEnd &&
+        (size_t) (self->stringAppendBufferEnd - a->characters) > totalCharacterCount) {
+        characters = (char*) a->characters;
+        swampUnterminatedStringAdd(self, a);
+    } else {
+        size_t capacity = (totalCharacterCount + 1) * 2;
+        if (capacity < 32) {
+            capacity = 32;
+        }
+        characters = (char*) swampDynamicMemoryAlloc(self, 1, capacity, 1);
+        tc_memcpy_octets(characters, a->characters, a->characterCount);
+        self->stringAppendBufferEnd = characters + capacity;
+    }
+
+    tc_memcpy_octets(characters + a->characterCount, b->characters, b->characterCount);
+    characters[totalCharacterCount] = 0;
+    self->stringAppendEnd = characters + totalCharacterCount;
+
+    newString->characters = characters;
+    newString->characterCount = totalCharacterCount;
+
+    return newString;
+}
+
+// Every string whose characters were shared by swampAllocateStringAppend() is given a terminated copy of its
+// characters. Each string is only copied once, since it is forgotten when it has characters of its own.
+void swampStringTerminateAll(SwampDynamicMemory* self)
+{
+    if (self->unterminatedStringCount == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < self->unterminatedStringCapacity; ++i) {
+        SwampString* string = (SwampString*) self->unterminatedStrings[i];
+        if (!string) {
+            continue;
+        }
+        self->unterminatedStrings[i] = 0;
+        if (string->characters[string->characterCount] == 0) {
+            continue;
+        }
+        char* characters = (char*) swampDynamicMemoryAlloc(self, 1, string->characterCount + 1, 1);
+        tc_memcpy_octets(characters, string->characters, string->characterCount);
+        characters[string->characterCount] = 0;
+        string->characters = characters;
+    }
+    self->unterminatedStringCount = 0;
+}
+
+// The strings must have been moved from source to target memory, e.g. by a parallel worker
+void swampStringMoveUnterminated(SwampDynamicMemory* target, const SwampDynamicMemory* source)
+{
+    for (size_t i = 0; i < source->unterminatedStringCapacity; ++i) {
+        if (source->unterminatedStrings[i]) {
+            swampUnterminatedStringAdd(target, source->unterminatedStrings[i]);
+        }
+    }
+}
+
 const SwampList* swampListEmptyAllocate(SwampDynamicMemory* self)
 {
     SwampList* emptyList = (SwampList*) swampDynamicMemoryAlloc(self, 1, sizeof(SwampList), 8);
@@ -168,6 +272,45 @@ const SwampList* swampAllocateListAppendNoCopy(SwampDynamicMemory* self, const S
     return newList;
 }
 
+// Prepends the item. The items are placed at the end of a buffer with free room in front of them, so when the newest
+// list is conj'ed again (e.g. when building a list with ::), the item is written in front of it and the rest of the
+// items are shared. Existing lists are never changed, since only octets in front of the newest list are claimed.
+const SwampList* swampAllocateListConj(SwampDynamicMemory* self, const SwampList* list, const void* item,
+                                       size_t itemSize, size_t itemAlign)
+{
+    SwampList* newList = (SwampList*) swampDynamicMemoryAlloc(self, 1, sizeof(SwampList), 8);
+
+    uint8_t* front;
+    if (list->count != 0 && list->value == self->conjFront &&
+        (size_t) (self->conjFront - self->conjBufferStart) >= itemSize) {
+        front = self->conjFront - itemSize;
+    } else {
+        // The free room grows with the list so the copies stay amortized, but is kept at a quarter of it since most
+        // lists are never conj'ed again
+        size_t freeCount = list->count / 4;
+        if (freeCount < 8) {
+            freeCount = 8;
+        }
+        size_t capacity = list->count + 1 + freeCount;
+        uint8_t* buffer = (uint8_t*) swampDynamicMemoryAlloc(self, capacity, itemSize, itemAlign);
+        front = buffer + (capacity - list->count - 1) * itemSize;
+        if (list->count != 0) {
+            tc_memcpy_octets(front + itemSize, list->value, list->count * itemSize);
+        }
+        self->conjBufferStart = buffer;
+    }
+
+    tc_memcpy_octets(front, item, itemSize);
+    self->conjFront = front;
+
+    newList->value = front;
+    newList->count = list->count + 1;
+    newList->itemSize = itemSize;
+    newList->itemAlign = itemAlign;
+
+    return newList;
+}
+
 static const uint8_t* swampAllocateOctets(SwampDynamicMemory* self, const uint8_t* octets, size_t octetCount)
 {
     uint8_t* target = (uint8_t*) swampDynamicMemoryAlloc(self, 1, octetCount, 1);
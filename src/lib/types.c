@@ -15,6 +15,22 @@ int swampStringEqual(const SwampString* a, const SwampString* b)
     return tc_memcmp(a->characters, b->characters, a->characterCount) == 0;
 }
 
+uint32_t swampHashFnv1a(uint32_t hash, const void* octets, size_t octetCount)
+{
+    const uint8_t* p = (const uint8_t*) octets;
+    for (size_t i = 0; i < octetCount; ++i) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+uint32_t swampStringHash(const SwampString* self)
+{
+    return swampHashFnv1a(SWAMP_FNV1A_OFFSET_BASIS, self->characters, self->characterCount);
+}
+
 void swampMemoryPositionAlign(SwampMemoryPosition* position, size_t align)
 {
     if (align > 8) {
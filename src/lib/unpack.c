@@ -11,7 +11,16 @@
 #include <raff/tag.h>
 
 #include <string.h> // strcmp
+#include <swamp-runtime/copy_plan.h>
 #include <swamp-runtime/fixup.h>
+#include <swamp-runtime/static_memory.h>
+
+#if SWAMP_UNPACK_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 static int readAndVerifyRaffHeader(SwampOctetStream* s)
 {
@@ -126,12 +135,17 @@ static int readConstantStaticMemory(SwampUnpack* self, SwampOctetStream* s, int
         SWAMP_LOG_INFO("done!\n");
     }
 
-    self->constantStaticMemoryMaxSize = 256 * 1024;
-    if (upcomingOctetsInChunk > self->constantStaticMemoryMaxSize) {
-        SWAMP_ERROR("too much static memory")
+    const uint8_t* chunkOctets = &s->octets[s->position];
+    if (s->octets == self->mappedOctets && ((uintptr_t) chunkOctets % 8) == 0) {
+        // The fixup patches the mapping directly, so only the pages it writes to get a private copy
+        self->constantStaticMemoryOctets = chunkOctets;
+        self->ownsConstantStaticMemory = 0;
+    } else {
+        self->constantStaticMemoryOctets = tc_malloc(upcomingOctetsInChunk);
+        tc_memcpy_octets((void*)self->constantStaticMemoryOctets, chunkOctets, upcomingOctetsInChunk);
+        self->ownsConstantStaticMemory = 1;
     }
-    self->constantStaticMemoryOctets = tc_malloc(self->constantStaticMemoryMaxSize);
-    tc_memcpy_octets((void*)self->constantStaticMemoryOctets, &s->octets[s->position], upcomingOctetsInChunk);
+    self->constantStaticMemoryMaxSize = upcomingOctetsInChunk;
     self->constantStaticMemorySize = upcomingOctetsInChunk;
 
     s->position += upcomingOctetsInChunk;
@@ -154,10 +168,19 @@ static int readLedger(SwampUnpack* self, SwampOctetStream* s, SwampResolveExtern
         SWAMP_LOG_INFO("done!\n");
     }
 
-    self->ledger.ledgerOctets = tc_malloc(upcomingOctetsInChunk);
-    tc_memcpy_octets((void*)self->ledger.ledgerOctets, &s->octets[s->position], upcomingOctetsInChunk);
-    self->ledger.ledgerSize = upcomingOctetsInChunk;
-    self->ledger.constantStaticMemory = self->constantStaticMemoryOctets;
+    const uint8_t* chunkOctets = &s->octets[s->position];
+    const uint8_t* ledgerOctets;
+    if (s->octets == self->mappedOctets && ((uintptr_t) chunkOctets % 4) == 0) {
+        // The ledger is only read, so it stays shared with the file
+        ledgerOctets = chunkOctets;
+        self->ownsLedger = 0;
+    } else {
+        uint8_t* copy = tc_malloc(upcomingOctetsInChunk);
+        tc_memcpy_octets(copy, chunkOctets, upcomingOctetsInChunk);
+        ledgerOctets = copy;
+        self->ownsLedger = 1;
+    }
+    swampLedgerInit(&self->ledger, ledgerOctets, upcomingOctetsInChunk, self->constantStaticMemoryOctets);
 
     s->position += upcomingOctetsInChunk;
 
@@ -194,15 +217,33 @@ int swampUnpackSwampOctetStream(SwampUnpack* self, SwampOctetStream* s, SwampRes
         return errorCode;
     }
 
-    self->entry = swampFixupLedger(self->constantStaticMemoryOctets, bindFn, (SwampConstantLedgerEntry*) self->ledger.ledgerOctets);
+    const SwampConstantLedgerEntry* entries = (const SwampConstantLedgerEntry*) self->ledger.ledgerOctets;
+    if (self->positionIndependent) {
+        errorCode = swampStaticRelocationInit(&self->relocation, self->constantStaticMemoryOctets, bindFn,
+                                              self->bindArgumentsFn, entries, &self->entry);
+        if (errorCode < 0) {
+            return errorCode;
+        }
+        self->ledger.relocation = &self->relocation;
+    } else {
+        self->entry = swampFixupLedgerWithArguments(self->constantStaticMemoryOctets, bindFn, self->bindArgumentsFn,
+                                                    entries);
+    }
     if (self->entry == 0) {
         return -1;
     }
+
+    swampLedgerBuildIndex(&self->ledger);
+
     return 0;
 }
 
 static void readWholeFile(const char* filename, SwampOctetStream* stream)
 {
+    stream->octets = 0;
+    stream->octetCount = 0;
+    stream->position = 0;
+
     FILE* fp = fopen(filename, "rb");
     if (fp == 0) {
         SWAMP_LOG_INFO("swampUnpack readWholeFile error:%s", filename);
@@ -237,16 +278,88 @@ static void readWholeFile(const char* filename, SwampOctetStream* stream)
     fclose(fp);
 }
 
+#if SWAMP_UNPACK_USE_MMAP
+// Maps the file privately and writable. Pages are shared with the page cache (and other processes that load the same
+// pack) until they are written to, which only happens for the pages that swampFixupLedger() patches. Position
+// independent packs are never written to, so they are mapped read-only.
+static int mapWholeFile(SwampUnpack* self, const char* filename, SwampOctetStream* stream)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        close(fd);
+        return -2;
+    }
+
+    size_t octetCount = (size_t) fileStat.st_size;
+    int protection = self->positionIndependent ? PROT_READ : PROT_READ | PROT_WRITE;
+    void* mapped = mmap(0, octetCount, protection, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return -3;
+    }
+
+    self->mappedOctets = (uint8_t*) mapped;
+    self->mappedOctetCount = octetCount;
+
+    stream->octets = self->mappedOctets;
+    stream->octetCount = octetCount;
+    stream->position = 0;
+
+    return 0;
+}
+#endif
+
 void swampUnpackInit(SwampUnpack* self, int verbose_flag)
 {
     self->entry = 0;
     self->verboseFlag = verbose_flag;
+    self->constantStaticMemoryOctets = 0;
+    self->constantStaticMemorySize = 0;
+    self->constantStaticMemoryMaxSize = 0;
+    self->ownsConstantStaticMemory = 0;
+    self->ledger.ledgerOctets = 0;
+    self->ledger.ledgerSize = 0;
+    self->ledger.constantStaticMemory = 0;
+    self->ledger.relocation = 0;
+    self->ledger.index = 0;
+    self->ownsLedger = 0;
+    self->positionIndependent = 0;
+    self->bindArgumentsFn = 0;
+    self->relocation.entries = 0;
+    self->relocation.entryCount = 0;
+    self->relocation.resolvedOctets = 0;
+    self->relocation.resolvedOctetCount = 0;
+    self->mappedOctets = 0;
+    self->mappedOctetCount = 0;
+    swampCopyPlanCacheInit(&self->copyPlans);
 }
 
 void swampUnpackFree(SwampUnpack* self)
 {
-    tc_free((void*)self->constantStaticMemoryOctets);
-    tc_free((void*)self->ledger.ledgerOctets);
+    if (self->ownsConstantStaticMemory) {
+        tc_free((void*)self->constantStaticMemoryOctets);
+    }
+    swampLedgerDestroyIndex(&self->ledger);
+    if (self->ownsLedger) {
+        tc_free((void*)self->ledger.ledgerOctets);
+    }
+    if (self->positionIndependent) {
+        swampStaticRelocationDestroy(&self->relocation);
+    }
+#if SWAMP_UNPACK_USE_MMAP
+    if (self->mappedOctets) {
+        munmap(self->mappedOctets, self->mappedOctetCount);
+        self->mappedOctets = 0;
+        self->mappedOctetCount = 0;
+    }
+#endif
+    // The copy plans are keyed on the type pointers
+    swampCopyPlanCacheDestroy(&self->copyPlans);
     swtiChunkDestroy(&self->typeInfoChunk);
 }
 
@@ -254,7 +367,16 @@ int swampUnpackFilename(SwampUnpack* self, const char* pack_filename, SwampResol
 {
     SwampOctetStream stream;
     SwampOctetStream* s = &stream;
+#if SWAMP_UNPACK_USE_MMAP
+    if (mapWholeFile(self, pack_filename, s) == 0) {
+        // Static memory and ledger point into the mapping, which is kept until swampUnpackFree()
+        return swampUnpackSwampOctetStream(self, s, bindFn, verboseFlag, allocator);
+    }
+#endif
     readWholeFile(pack_filename, s);
+    if (s->octets == 0) {
+        return -1;
+    }
     int result = swampUnpackSwampOctetStream(self, s, bindFn, verboseFlag, allocator);
     tc_free((void*) s->octets);
     return result;
@@ -264,3 +386,9 @@ const SwampFunc* swampUnpackEntryPoint(SwampUnpack* self)
 {
     return self->entry;
 }
+
+void swampUnpackStaticMemoryInit(const SwampUnpack* self, SwampStaticMemory* staticMemory)
+{
+    swampStaticMemoryInitRelocated(staticMemory, self->constantStaticMemoryOctets, self->constantStaticMemorySize,
+                                   self->positionIndependent ? &self->relocation : 0);
+}
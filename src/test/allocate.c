@@ -0,0 +1,292 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/parallel.h>
+#include <swamp-runtime/swamp_allocate.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+// Strings and lists that share their buffers with newer ones, see swampAllocateStringAppend()
+#define TEST_DYNAMIC_MEMORY_SIZE (1024 * 1024)
+
+static int checkString(const char* name, const SwampString* string, const char* expected)
+{
+    size_t expectedCount = tc_strlen(expected);
+    if (string->characterCount != expectedCount || tc_memcmp(string->characters, expected, expectedCount) != 0) {
+        CLOG_SOFT_ERROR("%s: expected '%s', but got '%.*s'", name, expected, (int) string->characterCount,
+                        string->characters)
+        return -1;
+    }
+
+    return 0;
+}
+
+static int checkTerminated(const char* name, const SwampString* string)
+{
+    if (string->characters[string->characterCount] != 0) {
+        CLOG_SOFT_ERROR("%s: '%.*s' is not terminated", name, (int) string->characterCount, string->characters)
+        return -1;
+    }
+
+    return 0;
+}
+
+// "ab" ++ "cd" ++ "ef", where the second append shares the characters of the first result
+static const SwampString* appendShared(SwampDynamicMemory* memory, const SwampString** prefix)
+{
+    const SwampString* ab = swampStringAllocate(memory, "ab");
+    const SwampString* cd = swampStringAllocate(memory, "cd");
+    const SwampString* ef = swampStringAllocate(memory, "ef");
+    *prefix = swampAllocateStringAppend(memory, ab, cd);
+
+    return swampAllocateStringAppend(memory, *prefix, ef);
+}
+
+static int testTerminateAll(SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(memory);
+
+    const SwampString* abcd;
+    const SwampString* abcdef = appendShared(memory, &abcd);
+    if (abcd->characters != abcdef->characters || memory->unterminatedStringCount != 1) {
+        CLOG_SOFT_ERROR("terminate-all: the append did not share the characters of the prefix")
+        failCount++;
+    }
+
+    swampStringTerminateAll(memory);
+    failCount += checkString("terminate-all prefix", abcd, "abcd") < 0;
+    failCount += checkTerminated("terminate-all prefix", abcd) < 0;
+    failCount += checkString("terminate-all result", abcdef, "abcdef") < 0;
+    failCount += checkTerminated("terminate-all result", abcdef) < 0;
+    if (memory->unterminatedStringCount != 0) {
+        CLOG_SOFT_ERROR("terminate-all: %zu strings are still remembered", memory->unterminatedStringCount)
+        failCount++;
+    }
+
+    return failCount;
+}
+
+// The strings that share a buffer must keep their own characters, whichever of them is appended to
+static int testAppendShared(SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(memory);
+
+    const SwampString* abcd;
+    const SwampString* abcdef = appendShared(memory, &abcd);
+
+    // abcd is not the newest string, so its characters must be copied and abcdef kept
+    const SwampString* abcdxy = swampAllocateStringAppend(memory, abcd, swampStringAllocate(memory, "xy"));
+    if (abcdxy->characters == abcd->characters) {
+        CLOG_SOFT_ERROR("append-shared: an append onto an older string wrote into the shared characters")
+        failCount++;
+    }
+    failCount += checkString("append-shared older", abcdxy, "abcdxy") < 0;
+    failCount += checkString("append-shared newer", abcdef, "abcdef") < 0;
+
+    // abcdxy is the newest string, and the append is too long for the free room, so a new buffer is used
+    char longCharacters[128];
+    tc_memset_octets(longCharacters, 'z', sizeof(longCharacters) - 1);
+    longCharacters[sizeof(longCharacters) - 1] = 0;
+    const SwampString* zs = swampStringAllocate(memory, longCharacters);
+    const SwampString* longString = swampAllocateStringAppend(memory, abcdxy, zs);
+    if (longString->characterCount != 6 + sizeof(longCharacters) - 1 ||
+        tc_memcmp(longString->characters, "abcdxy", 6) != 0 || longString->characters[6] != 'z') {
+        CLOG_SOFT_ERROR("append-shared: the long append is wrong")
+        failCount++;
+    }
+
+    failCount += checkString("append-shared prefix", abcd, "abcd") < 0;
+    failCount += checkString("append-shared before long", abcdxy, "abcdxy") < 0;
+
+    return failCount;
+}
+
+static int checkList(const char* name, const SwampList* list, const SwampInt32* expected, size_t expectedCount)
+{
+    if (list->count != expectedCount || tc_memcmp(list->value, expected, expectedCount * sizeof(SwampInt32)) != 0) {
+        CLOG_SOFT_ERROR("%s: the list items are wrong", name)
+        return -1;
+    }
+
+    return 0;
+}
+
+// The items are shared with the newest list only, a conj onto an older list must not claim the octets in front of it
+static int testConjShared(SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(memory);
+
+    SwampInt32 items[] = {1, 2, 3};
+    const SwampList* empty = swampListEmptyAllocate(memory);
+    const SwampList* one = swampAllocateListConj(memory, empty, &items[0], sizeof(SwampInt32), sizeof(SwampInt32));
+    const SwampList* twoOne = swampAllocateListConj(memory, one, &items[1], sizeof(SwampInt32), sizeof(SwampInt32));
+    if ((const uint8_t*) twoOne->value + sizeof(SwampInt32) != one->value) {
+        CLOG_SOFT_ERROR("conj-shared: the newest list was not shared")
+        failCount++;
+    }
+
+    const SwampList* threeOne = swampAllocateListConj(memory, one, &items[2], sizeof(SwampInt32), sizeof(SwampInt32));
+    if (threeOne->value == (const uint8_t*) twoOne->value) {
+        CLOG_SOFT_ERROR("conj-shared: a conj onto an older list wrote into the slot of the newer list")
+        failCount++;
+    }
+
+    const SwampInt32 expectedOne[] = {1};
+    const SwampInt32 expectedTwoOne[] = {2, 1};
+    const SwampInt32 expectedThreeOne[] = {3, 1};
+    failCount += checkList("conj-shared one", one, expectedOne, 1) < 0;
+    failCount += checkList("conj-shared two", twoOne, expectedTwoOne, 2) < 0;
+    failCount += checkList("conj-shared three", threeOne, expectedThreeOne, 2) < 0;
+
+    return failCount;
+}
+
+#define TEST_CONJ_LONG_COUNT (400)
+
+// A copied list only gets a quarter of its count as free room in front of it
+static int testConjFreeRoom(SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(memory);
+
+    SwampInt32 items[TEST_CONJ_LONG_COUNT];
+    for (size_t i = 0; i < TEST_CONJ_LONG_COUNT; ++i) {
+        items[i] = (SwampInt32) i;
+    }
+    const SwampList* list = swampListAllocate(memory, items, TEST_CONJ_LONG_COUNT, sizeof(SwampInt32),
+                                              sizeof(SwampInt32));
+    SwampInt32 item = -1;
+    const SwampList* longer = swampAllocateListConj(memory, list, &item, sizeof(SwampInt32), sizeof(SwampInt32));
+    size_t freeCount = (size_t) (memory->conjFront - memory->conjBufferStart) / sizeof(SwampInt32);
+    if (freeCount != TEST_CONJ_LONG_COUNT / 4) {
+        CLOG_SOFT_ERROR("conj-free-room: expected %d free items, but got %zu", TEST_CONJ_LONG_COUNT / 4, freeCount)
+        failCount++;
+    }
+    if (longer->count != TEST_CONJ_LONG_COUNT + 1 || *(const SwampInt32*) longer->value != -1 ||
+        tc_memcmp((const SwampInt32*) longer->value + 1, items, sizeof(items)) != 0) {
+        CLOG_SOFT_ERROR("conj-free-room: the list items are wrong")
+        failCount++;
+    }
+
+    return failCount;
+}
+
+// After a reset the memory of the newest list and string is handed out again, so they can not be shared any more
+static int testResetForgetsShared(SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(memory);
+
+    const SwampString* prefix;
+    appendShared(memory, &prefix);
+    SwampInt32 item = 1;
+    swampAllocateListConj(memory, swampListEmptyAllocate(memory), &item, sizeof(SwampInt32), sizeof(SwampInt32));
+
+    swampDynamicMemoryReset(memory);
+    if (memory->conjFront != 0 || memory->conjBufferStart != 0 || memory->stringAppendEnd != 0 ||
+        memory->stringAppendBufferEnd != 0 || memory->unterminatedStringCount != 0) {
+        CLOG_SOFT_ERROR("reset: the newest list or string is still remembered")
+        failCount++;
+    }
+
+    return failCount;
+}
+
+#define TEST_PARALLEL_ITEM_COUNT (64)
+
+// Each item is only written by the task that has it in its range
+typedef struct ParallelStrings {
+    const SwampDynamicMemory* callerMemory;
+    const SwampString* prefix;
+    uint8_t ranOnWorker[TEST_PARALLEL_ITEM_COUNT];
+    uint8_t wasTerminated[TEST_PARALLEL_ITEM_COUNT];
+} ParallelStrings;
+
+static void checkPrefixRange(SwampMachineContext* context, size_t startIndex, size_t endIndex, void* userData)
+{
+    ParallelStrings* self = (ParallelStrings*) userData;
+    for (size_t i = startIndex; i < endIndex; ++i) {
+        self->ranOnWorker[i] = context->dynamicMemory != self->callerMemory;
+        self->wasTerminated[i] = self->prefix->characters[self->prefix->characterCount] == 0;
+    }
+}
+
+// The workers can not terminate the strings of the caller, so it is done before they start
+static int testParallelForTerminates(SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(memory);
+
+    SwampWorkerPool pool;
+    swampWorkerPoolInit(&pool, 1);
+    pool.minimumItemCount = 1;
+
+    static const char* filenames[] = {"allocate.swamp"};
+    SwampDebugInfoFiles debugInfoFiles;
+    debugInfoFiles.count = 1;
+    debugInfoFiles.filenames = filenames;
+
+    SwampMachineContext context;
+    swampContextInit(&context, memory, 0, 0, 0, &debugInfoFiles, "parallel");
+    context.workerPool = &pool;
+
+    ParallelStrings strings;
+    tc_mem_clear(&strings, sizeof(strings));
+    strings.callerMemory = memory;
+    appendShared(memory, &strings.prefix);
+
+    swampParallelFor(&context, TEST_PARALLEL_ITEM_COUNT, checkPrefixRange, &strings);
+    size_t workerItemCount = 0;
+    size_t unterminatedCount = 0;
+    for (size_t i = 0; i < TEST_PARALLEL_ITEM_COUNT; ++i) {
+        workerItemCount += strings.ranOnWorker[i];
+        unterminatedCount += !strings.wasTerminated[i];
+    }
+    if (workerItemCount == 0) {
+        CLOG_SOFT_ERROR("parallel-for: no item was run by a worker")
+        failCount++;
+    }
+    if (unterminatedCount != 0) {
+        CLOG_SOFT_ERROR("parallel-for: %zu items read a string that was not terminated", unterminatedCount)
+        failCount++;
+    }
+
+    swampContextDestroy(&context);
+    swampWorkerPoolDestroy(&pool);
+
+    return failCount;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    uint8_t* octets = tc_malloc(TEST_DYNAMIC_MEMORY_SIZE);
+    SwampDynamicMemory memory;
+    swampDynamicMemoryInit(&memory, octets, TEST_DYNAMIC_MEMORY_SIZE);
+
+    int failCount = 0;
+    failCount += testTerminateAll(&memory);
+    failCount += testAppendShared(&memory);
+    failCount += testConjShared(&memory);
+    failCount += testConjFreeRoom(&memory);
+    failCount += testResetForgetsShared(&memory);
+    failCount += testParallelForTerminates(&memory);
+
+    CLOG_OUTPUT("allocate: %d failed", failCount)
+
+    swampDynamicMemoryDestroy(&memory);
+    tc_free(octets);
+
+    return failCount > 0 ? 1 : 0;
+}
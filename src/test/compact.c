@@ -0,0 +1,481 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <swamp-runtime/compact.h>
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/copy_plan.h>
+#include <swamp-runtime/parallel.h>
+#include <swamp-runtime/swamp_allocate.h>
+#include <swamp-runtime/types.h>
+#include <swamp-typeinfo/typeinfo.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+#define TEST_DYNAMIC_MEMORY_SIZE (8 * 1024 * 1024)
+
+// Larger than the memory that a part of swampCompactParallel() starts out with, so that part has to run again
+#define TEST_LARGE_STRING_SIZE (100 * 1024)
+
+// The types are written the way swtisDeserialize() leaves them. The states are lists of entities or worlds.
+typedef struct TestEntity {
+    SwampInt32 id;
+    const SwampString* name;
+    const SwampString* nameAlias;
+    const SwampList* path;
+    const SwampList* pathAlias;
+} TestEntity;
+
+typedef struct TestWorld {
+    const SwampUnmanaged* world;
+    const SwampUnmanaged* worldAlias;
+} TestWorld;
+
+typedef struct TestTypes {
+    SwtiType intType;
+    SwtiType stringType;
+    SwtiListType intListType;
+    SwtiUnmanagedType worldType;
+    SwtiRecordTypeField entityFields[5];
+    SwtiRecordType entityType;
+    SwtiListType entityListType;
+    SwtiRecordTypeField worldFields[2];
+    SwtiRecordType worldRecordType;
+    SwtiListType worldListType;
+} TestTypes;
+
+static void typesInitField(SwtiRecordTypeField* field, const char* name, const SwtiType* fieldType, size_t offset)
+{
+    field->name = name;
+    field->fieldType = fieldType;
+    field->memoryOffsetInfo.memoryOffset = offset;
+}
+
+static void typesInit(TestTypes* self)
+{
+    tc_mem_clear(self, sizeof(*self));
+    self->intType.type = SwtiTypeInt;
+    self->intType.name = "Int";
+    self->stringType.type = SwtiTypeString;
+    self->stringType.name = "String";
+    self->intListType.internal.type = SwtiTypeList;
+    self->intListType.internal.name = "List";
+    self->intListType.itemType = &self->intType;
+    // Ecs.World is the only unmanaged that can be compacted in this version, see swampIsBlittableOrEcs()
+    self->worldType.internal.type = SwtiTypeUnmanaged;
+    self->worldType.internal.name = "EcsWorld";
+
+    typesInitField(&self->entityFields[0], "id", &self->intType, offsetof(TestEntity, id));
+    typesInitField(&self->entityFields[1], "name", &self->stringType, offsetof(TestEntity, name));
+    typesInitField(&self->entityFields[2], "nameAlias", &self->stringType, offsetof(TestEntity, nameAlias));
+    typesInitField(&self->entityFields[3], "path", (const SwtiType*) &self->intListType, offsetof(TestEntity, path));
+    typesInitField(&self->entityFields[4], "pathAlias", (const SwtiType*) &self->intListType,
+                   offsetof(TestEntity, pathAlias));
+    self->entityType.internal.type = SwtiTypeRecord;
+    self->entityType.internal.name = "Entity";
+    self->entityType.fieldCount = 5;
+    self->entityType.fields = self->entityFields;
+    self->entityListType.internal.type = SwtiTypeList;
+    self->entityListType.internal.name = "List";
+    self->entityListType.itemType = (const SwtiType*) &self->entityType;
+
+    typesInitField(&self->worldFields[0], "world", (const SwtiType*) &self->worldType, offsetof(TestWorld, world));
+    typesInitField(&self->worldFields[1], "worldAlias", (const SwtiType*) &self->worldType,
+                   offsetof(TestWorld, worldAlias));
+    self->worldRecordType.internal.type = SwtiTypeRecord;
+    self->worldRecordType.internal.name = "World";
+    self->worldRecordType.fieldCount = 2;
+    self->worldRecordType.fields = self->worldFields;
+    self->worldListType.internal.type = SwtiTypeList;
+    self->worldListType.internal.name = "List";
+    self->worldListType.itemType = (const SwtiType*) &self->worldRecordType;
+}
+
+typedef struct TestMemory {
+    uint8_t* octets;
+    SwampDynamicMemory memory;
+} TestMemory;
+
+static void testMemoryInit(TestMemory* self)
+{
+    self->octets = tc_malloc(TEST_DYNAMIC_MEMORY_SIZE);
+    swampDynamicMemoryInit(&self->memory, self->octets, TEST_DYNAMIC_MEMORY_SIZE);
+}
+
+static void testMemoryDestroy(TestMemory* self)
+{
+    swampDynamicMemoryDestroy(&self->memory);
+    tc_free(self->octets);
+}
+
+static const SwampList* intListAllocate(SwampDynamicMemory* memory, SwampInt32 first, size_t count)
+{
+    SwampList* list = swampListAllocatePrepare(memory, count, sizeof(SwampInt32), sizeof(SwampInt32));
+    SwampInt32* items = (SwampInt32*) list->value;
+    for (size_t i = 0; i < count; ++i) {
+        items[i] = first + (SwampInt32) i;
+    }
+
+    return list;
+}
+
+static int checkStats(const char* name, const SwampCompactStats* stats, size_t objectCount,
+                      size_t sharedReferenceCount, size_t keptReferenceCount)
+{
+    if (stats->objectCount != objectCount || stats->sharedReferenceCount != sharedReferenceCount ||
+        stats->keptReferenceCount != keptReferenceCount) {
+        CLOG_SOFT_ERROR("%s: expected %zu objects, %zu shared and %zu kept, but got %zu, %zu and %zu", name,
+                        objectCount, sharedReferenceCount, keptReferenceCount, stats->objectCount,
+                        stats->sharedReferenceCount, stats->keptReferenceCount)
+        return -1;
+    }
+
+    return 0;
+}
+
+// The copies must have the same contents as the source, in memory of their own
+static int checkEntity(const char* name, const TestEntity* entity, const TestEntity* source,
+                       const SwampDynamicMemory* memory)
+{
+    int failCount = 0;
+    if (entity->id != source->id || !swampStringEqual(entity->name, source->name) ||
+        entity->path->count != source->path->count ||
+        tc_memcmp(entity->path->value, source->path->value, source->path->count * sizeof(SwampInt32)) != 0) {
+        CLOG_SOFT_ERROR("%s: entity %d is not the same as the source", name, source->id)
+        failCount++;
+    }
+    if (entity->name->characters[entity->name->characterCount] != 0) {
+        CLOG_SOFT_ERROR("%s: the name of entity %d is not terminated", name, source->id)
+        failCount++;
+    }
+    if (!swampDynamicMemoryOwns(memory, entity->name) || !swampDynamicMemoryOwns(memory, entity->name->characters) ||
+        !swampDynamicMemoryOwns(memory, entity->path) || !swampDynamicMemoryOwns(memory, entity->path->value)) {
+        CLOG_SOFT_ERROR("%s: entity %d was not copied", name, source->id)
+        failCount++;
+    }
+    if (entity->nameAlias != entity->name || entity->pathAlias != entity->path) {
+        CLOG_SOFT_ERROR("%s: the fields of entity %d are no longer aliased", name, source->id)
+        failCount++;
+    }
+
+    return failCount;
+}
+
+// Each field is aliased within the entity, and the name of the first entity is also used by the second. The names
+// are appended, so the characters are shared with a longer string and not terminated.
+static const SwampList* aliasedStateAllocate(SwampDynamicMemory* memory)
+{
+    const SwampString* prefix = swampAllocateStringAppend(memory, swampStringAllocate(memory, "ab"),
+                                                          swampStringAllocate(memory, "cd"));
+    swampAllocateStringAppend(memory, prefix, swampStringAllocate(memory, "ef"));
+
+    SwampList* state = swampListAllocatePrepare(memory, 2, sizeof(TestEntity), 8);
+    TestEntity* entities = (TestEntity*) state->value;
+    for (size_t i = 0; i < 2; ++i) {
+        TestEntity* entity = &entities[i];
+        entity->id = (SwampInt32) i;
+        entity->name = prefix;
+        entity->nameAlias = prefix;
+        entity->path = intListAllocate(memory, (SwampInt32) i * 10, 3);
+        entity->pathAlias = entity->path;
+    }
+
+    return state;
+}
+
+static int testAliased(SwampCompactor* compactor, const TestTypes* types, TestMemory* source, TestMemory* target)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(&source->memory);
+    swampDynamicMemoryReset(&target->memory);
+    const SwampList* state = aliasedStateAllocate(&source->memory);
+
+    void* compactedState;
+    SwampCompactStats stats;
+    if (swampCompactWithStats(compactor, &state, (const SwtiType*) &types->entityListType, &target->memory, 0, 0,
+                              &compactedState, &stats) < 0) {
+        CLOG_SOFT_ERROR("aliased: compact failed")
+        return 1;
+    }
+
+    const SwampList* compacted = *(const SwampList**) compactedState;
+    const TestEntity* entities = (const TestEntity*) compacted->value;
+    const TestEntity* sourceEntities = (const TestEntity*) state->value;
+    for (size_t i = 0; i < 2; ++i) {
+        failCount += checkEntity("aliased", &entities[i], &sourceEntities[i], &target->memory);
+    }
+    if (entities[0].name != entities[1].name) {
+        CLOG_SOFT_ERROR("aliased: the name is no longer shared between the entities")
+        failCount++;
+    }
+
+    // The entity list, the name and two paths. Every alias, and both fields of the second entity that use the name,
+    // are shared.
+    failCount += checkStats("aliased", &stats, 4, 5, 0) < 0;
+
+    return failCount;
+}
+
+static int destroyWorld(void* self)
+{
+    return 0;
+}
+
+// The unmanaged is moved to the target unmanaged memory once, and every reference to it is kept
+static int testAliasedUnmanaged(SwampCompactor* compactor, const TestTypes* types, TestMemory* source,
+                                TestMemory* target)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(&source->memory);
+    swampDynamicMemoryReset(&target->memory);
+
+    SwampUnmanagedMemory sourceUnmanaged;
+    SwampUnmanagedMemory targetUnmanaged;
+    swampUnmanagedMemoryInit(&sourceUnmanaged);
+    swampUnmanagedMemoryInit(&targetUnmanaged);
+    SwampUnmanaged* world = swampUnmanagedMemoryAllocate(&sourceUnmanaged, "EcsWorld");
+    const char* debugName = world->debugName;
+    tc_mem_clear(world, sizeof(*world));
+    world->debugName = debugName;
+    world->destroy = destroyWorld;
+
+    SwampList* state = swampListAllocatePrepare(&source->memory, 2, sizeof(TestWorld), 8);
+    TestWorld* worlds = (TestWorld*) state->value;
+    for (size_t i = 0; i < 2; ++i) {
+        worlds[i].world = world;
+        worlds[i].worldAlias = world;
+    }
+
+    void* compactedState;
+    SwampCompactStats stats;
+    if (swampCompactWithStats(compactor, &state, (const SwtiType*) &types->worldListType, &target->memory,
+                              &targetUnmanaged, &sourceUnmanaged, &compactedState, &stats) < 0) {
+        CLOG_SOFT_ERROR("aliased-unmanaged: compact failed")
+        failCount++;
+    } else {
+        const TestWorld* compacted = (const TestWorld*) (*(const SwampList**) compactedState)->value;
+        for (size_t i = 0; i < 2; ++i) {
+            if (compacted[i].world != world || compacted[i].worldAlias != world) {
+                CLOG_SOFT_ERROR("aliased-unmanaged: world %zu is not the same unmanaged", i)
+                failCount++;
+            }
+        }
+        if (targetUnmanaged.count != 1 || sourceUnmanaged.count != 0 ||
+            !swampUnmanagedMemoryOwns(&targetUnmanaged, world)) {
+            CLOG_SOFT_ERROR("aliased-unmanaged: the unmanaged was not moved once")
+            failCount++;
+        }
+        failCount += checkStats("aliased-unmanaged", &stats, 2, 3, 0) < 0;
+    }
+
+    swampUnmanagedMemoryDestroy(&sourceUnmanaged);
+    swampUnmanagedMemoryDestroy(&targetUnmanaged);
+
+    return failCount;
+}
+
+// The old generation has the compacted state of the previous frame. The frame changes the second entity and allocates
+// a new list in the nursery, the first entity still references the old generation.
+static int testGenerational(SwampCompactor* compactor, const TestTypes* types, TestMemory* source,
+                            TestMemory* oldGeneration)
+{
+    int failCount = 0;
+    const SwtiType* stateType = (const SwtiType*) &types->entityListType;
+    swampDynamicMemoryReset(&source->memory);
+    swampDynamicMemoryReset(&oldGeneration->memory);
+
+    const SwampList* previousState = aliasedStateAllocate(&source->memory);
+    void* oldState;
+    if (swampCompact(compactor, &previousState, stateType, &oldGeneration->memory, 0, 0, &oldState) < 0) {
+        CLOG_SOFT_ERROR("generational: compact to the old generation failed")
+        return 1;
+    }
+    const TestEntity* oldEntities = (const TestEntity*) (*(const SwampList**) oldState)->value;
+
+    SwampDynamicMemory* nursery = &source->memory;
+    swampDynamicMemoryReset(nursery);
+    SwampList* state = swampListAllocatePrepare(nursery, 2, sizeof(TestEntity), 8);
+    TestEntity* entities = (TestEntity*) state->value;
+    entities[0] = oldEntities[0];
+    entities[1].id = 1;
+    entities[1].name = swampStringAllocate(nursery, "changed");
+    entities[1].nameAlias = entities[1].name;
+    entities[1].path = intListAllocate(nursery, 100, 4);
+    entities[1].pathAlias = entities[1].path;
+
+    // The old generation is only appended to
+    size_t oldOctetCount = (size_t) (oldGeneration->memory.p - oldGeneration->memory.memory);
+    uint8_t* oldOctets = tc_malloc(oldOctetCount);
+    tc_memcpy_octets(oldOctets, oldGeneration->memory.memory, oldOctetCount);
+
+    void* compactedState;
+    SwampCompactStats stats;
+    if (swampCompactGenerational(compactor, &state, stateType, nursery, &oldGeneration->memory, &compactedState,
+                                 &stats) < 0) {
+        CLOG_SOFT_ERROR("generational: compact failed")
+        tc_free(oldOctets);
+        return 1;
+    }
+
+    if (tc_memcmp(oldOctets, oldGeneration->memory.memory, oldOctetCount) != 0) {
+        CLOG_SOFT_ERROR("generational: the old generation was changed")
+        failCount++;
+    }
+    tc_free(oldOctets);
+
+    const SwampList* compacted = *(const SwampList**) compactedState;
+    const TestEntity* compactedEntities = (const TestEntity*) compacted->value;
+    if (compacted == state || compactedEntities == entities) {
+        CLOG_SOFT_ERROR("generational: the list in the nursery was not moved")
+        failCount++;
+    }
+    if (compactedEntities[0].name != oldEntities[0].name || compactedEntities[0].path != oldEntities[0].path) {
+        CLOG_SOFT_ERROR("generational: the references to the old generation were not kept")
+        failCount++;
+    }
+    failCount += checkEntity("generational kept", &compactedEntities[0], &oldEntities[0], &oldGeneration->memory);
+    failCount += checkEntity("generational moved", &compactedEntities[1], &entities[1], &oldGeneration->memory);
+    if (compactedEntities[1].name == entities[1].name || compactedEntities[1].path == entities[1].path) {
+        CLOG_SOFT_ERROR("generational: the objects in the nursery were not moved")
+        failCount++;
+    }
+
+    // The list, the changed name and path. The aliases of the changed entity are shared, the four fields of the
+    // first entity are kept.
+    failCount += checkStats("generational", &stats, 3, 2, 4) < 0;
+
+    return failCount;
+}
+
+// Enough entities for the state list to be split, and the first one has a name that does not fit in a part
+static const SwampList* largeStateAllocate(SwampDynamicMemory* memory)
+{
+    const size_t entityCount = SWAMP_COMPACT_PARALLEL_MINIMUM_ITEM_COUNT;
+    char* largeName = tc_malloc(TEST_LARGE_STRING_SIZE + 1);
+    tc_memset_octets(largeName, 'x', TEST_LARGE_STRING_SIZE);
+    largeName[TEST_LARGE_STRING_SIZE] = 0;
+
+    SwampList* state = swampListAllocatePrepare(memory, entityCount, sizeof(TestEntity), 8);
+    TestEntity* entities = (TestEntity*) state->value;
+    for (size_t i = 0; i < entityCount; ++i) {
+        char name[16];
+        tc_snprintf(name, sizeof(name), "entity %zu", i);
+        TestEntity* entity = &entities[i];
+        entity->id = (SwampInt32) i;
+        entity->name = swampStringAllocate(memory, i == 0 ? largeName : name);
+        entity->nameAlias = entity->name;
+        entity->path = intListAllocate(memory, (SwampInt32) i, i % 4 + 1);
+        entity->pathAlias = entity->path;
+    }
+    tc_free(largeName);
+
+    return state;
+}
+
+static int compactParallel(SwampCompactor* compactor, const TestTypes* types, const SwampList* state,
+                           SwampDynamicMemory* target, SwampWorkerPool* pool, const SwampList** compacted)
+{
+    swampDynamicMemoryReset(target);
+    void* compactedState;
+    SwampCompactStats stats;
+    if (swampCompactParallel(compactor, &state, (const SwtiType*) &types->entityListType, target, 0, 0, pool,
+                             &compactedState, &stats) < 0) {
+        return -1;
+    }
+    *compacted = *(const SwampList**) compactedState;
+
+    return 0;
+}
+
+// The parts are copied to the target in order, so the layout is the same for every run, no matter which thread
+// compacted which part or if a part had to run again with more memory
+static int testParallel(const TestTypes* types, SwampCopyPlanCache* copyPlans, TestMemory* source, TestMemory* target)
+{
+    int failCount = 0;
+    swampDynamicMemoryReset(&source->memory);
+    const SwampList* state = largeStateAllocate(&source->memory);
+
+    SwampWorkerPool pool;
+    swampWorkerPoolInit(&pool, 1);
+
+    // A new compactor has no part memory, so the part with the large name runs out of room the first time
+    SwampCompactor compactor;
+    swampCompactorInit(&compactor, copyPlans);
+
+    const SwampList* compacted;
+    if (compactParallel(&compactor, types, state, &target->memory, &pool, &compacted) < 0) {
+        CLOG_SOFT_ERROR("parallel: compact failed")
+        failCount++;
+    } else {
+        const TestEntity* entities = (const TestEntity*) compacted->value;
+        const TestEntity* sourceEntities = (const TestEntity*) state->value;
+        if (compacted->count != state->count) {
+            CLOG_SOFT_ERROR("parallel: expected %zu entities, but got %zu", state->count, compacted->count)
+            failCount++;
+        }
+        for (size_t i = 0; i < compacted->count; ++i) {
+            failCount += checkEntity("parallel", &entities[i], &sourceEntities[i], &target->memory);
+        }
+
+        size_t octetCount = (size_t) (target->memory.p - target->memory.memory);
+        uint8_t* firstOctets = tc_malloc(octetCount);
+        tc_memcpy_octets(firstOctets, target->memory.memory, octetCount);
+
+        // The part memory is kept in the compactor, so the next runs do not run out of room
+        for (size_t run = 0; run < 2; ++run) {
+            const SwampList* again;
+            if (compactParallel(&compactor, types, state, &target->memory, &pool, &again) < 0) {
+                CLOG_SOFT_ERROR("parallel: compact failed in run %zu", run)
+                failCount++;
+                continue;
+            }
+            if (again != compacted || (size_t) (target->memory.p - target->memory.memory) != octetCount ||
+                tc_memcmp(firstOctets, target->memory.memory, octetCount) != 0) {
+                CLOG_SOFT_ERROR("parallel: the layout in run %zu is not the same as in the first run", run)
+                failCount++;
+            }
+        }
+        tc_free(firstOctets);
+    }
+
+    swampCompactorDestroy(&compactor);
+    swampWorkerPoolDestroy(&pool);
+
+    return failCount;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    TestTypes types;
+    typesInit(&types);
+
+    TestMemory source;
+    TestMemory target;
+    testMemoryInit(&source);
+    testMemoryInit(&target);
+
+    SwampCopyPlanCache copyPlans;
+    swampCopyPlanCacheInit(&copyPlans);
+    SwampCompactor compactor;
+    swampCompactorInit(&compactor, &copyPlans);
+
+    int failCount = 0;
+    failCount += testAliased(&compactor, &types, &source, &target);
+    failCount += testAliasedUnmanaged(&compactor, &types, &source, &target);
+    failCount += testGenerational(&compactor, &types, &source, &target);
+    failCount += testParallel(&types, &copyPlans, &source, &target);
+
+    CLOG_OUTPUT("compact: %d failed", failCount)
+
+    swampCompactorDestroy(&compactor);
+    swampCopyPlanCacheDestroy(&copyPlans);
+    testMemoryDestroy(&source);
+    testMemoryDestroy(&target);
+
+    return failCount > 0 ? 1 : 0;
+}
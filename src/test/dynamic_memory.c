@@ -0,0 +1,150 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <swamp-runtime/dynamic_memory.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+// The first block only has room for four items, so the rest are allocated from the blocks that are chained after it
+#define TEST_ITEM_SIZE (64)
+#define TEST_ITEM_COUNT (20)
+#define TEST_FIRST_BLOCK_SIZE (4 * TEST_ITEM_SIZE)
+#define TEST_BLOCK_SIZE (8 * TEST_ITEM_SIZE)
+#define TEST_LARGE_ITEM_SIZE (3 * TEST_BLOCK_SIZE)
+
+static void allocateItems(SwampDynamicMemory* memory, uint8_t** items)
+{
+    for (size_t i = 0; i < TEST_ITEM_COUNT; ++i) {
+        items[i] = swampDynamicMemoryAlloc(memory, 1, TEST_ITEM_SIZE, 8);
+        tc_memset_octets(items[i], (int) i + 1, TEST_ITEM_SIZE);
+    }
+}
+
+// Every item must keep its octets when the following items are allocated in other blocks
+static int checkItems(const char* name, const SwampDynamicMemory* memory, uint8_t* const* items)
+{
+    int failCount = 0;
+    for (size_t i = 0; i < TEST_ITEM_COUNT; ++i) {
+        for (size_t octetIndex = 0; octetIndex < TEST_ITEM_SIZE; ++octetIndex) {
+            if (items[i][octetIndex] != (uint8_t) (i + 1)) {
+                CLOG_SOFT_ERROR("%s: item %zu was overwritten", name, i)
+                failCount++;
+                break;
+            }
+        }
+        if (!swampDynamicMemoryOwns(memory, items[i])) {
+            CLOG_SOFT_ERROR("%s: item %zu is not owned", name, i)
+            failCount++;
+        }
+    }
+
+    return failCount;
+}
+
+static int checkStats(const char* name, const SwampDynamicMemory* memory, size_t allocatedSize,
+                      size_t peakAllocatedSize, size_t blockCount, size_t growCount)
+{
+    SwampDynamicMemoryStats stats;
+    swampDynamicMemoryGetStats(memory, &stats);
+    if (stats.allocatedSize != allocatedSize || stats.peakAllocatedSize != peakAllocatedSize ||
+        stats.blockCount != blockCount || stats.growCount != growCount) {
+        CLOG_SOFT_ERROR("%s: expected allocated %zu, peak %zu, %zu blocks and %zu grows, but got %zu, %zu, %zu and %zu",
+                        name, allocatedSize, peakAllocatedSize, blockCount, growCount, stats.allocatedSize,
+                        stats.peakAllocatedSize, stats.blockCount, stats.growCount)
+        return -1;
+    }
+
+    return 0;
+}
+
+static int testGrow(SwampDynamicMemory* memory, uint8_t** items)
+{
+    int failCount = 0;
+    allocateItems(memory, items);
+    failCount += checkItems("grow", memory, items);
+
+    // four items in the first block and eight in each of the two that were added
+    const size_t allocatedSize = TEST_ITEM_COUNT * TEST_ITEM_SIZE;
+    failCount += checkStats("grow", memory, allocatedSize, allocatedSize, 3, 2) < 0;
+
+    SwampDynamicMemoryStats stats;
+    swampDynamicMemoryGetStats(memory, &stats);
+    if (stats.blocksInUseCount != 3 || stats.blocksOctetSize != TEST_FIRST_BLOCK_SIZE + 2 * TEST_BLOCK_SIZE) {
+        CLOG_SOFT_ERROR("grow: expected three blocks in use, but got %zu of %zu octets", stats.blocksInUseCount,
+                        stats.blocksOctetSize)
+        failCount++;
+    }
+
+    // Larger than a block, so it gets a block of its own size
+    uint8_t* large = swampDynamicMemoryAlloc(memory, 1, TEST_LARGE_ITEM_SIZE, 8);
+    tc_memset_octets(large, 0x7e, TEST_LARGE_ITEM_SIZE);
+    if (!swampDynamicMemoryOwns(memory, large) || !swampDynamicMemoryOwns(memory, large + TEST_LARGE_ITEM_SIZE - 1)) {
+        CLOG_SOFT_ERROR("grow: the large item is not owned")
+        failCount++;
+    }
+    failCount += checkItems("grow large", memory, items);
+    failCount += checkStats("grow large", memory, allocatedSize + TEST_LARGE_ITEM_SIZE,
+                            allocatedSize + TEST_LARGE_ITEM_SIZE, 4, 3) < 0;
+
+    uint8_t notOwned[8];
+    if (swampDynamicMemoryOwns(memory, notOwned)) {
+        CLOG_SOFT_ERROR("grow: memory that was not allocated from it is owned")
+        failCount++;
+    }
+
+    return failCount;
+}
+
+// The blocks are kept on reset, so the same allocations give the same pointers without growing again
+static int testReuse(SwampDynamicMemory* memory, uint8_t* const* previousItems)
+{
+    int failCount = 0;
+    const size_t peakAllocatedSize = TEST_ITEM_COUNT * TEST_ITEM_SIZE + TEST_LARGE_ITEM_SIZE;
+
+    swampDynamicMemoryReset(memory);
+    failCount += checkStats("reset", memory, 0, peakAllocatedSize, 4, 3) < 0;
+    if (swampDynamicMemoryOwns(memory, previousItems[0]) ||
+        swampDynamicMemoryOwns(memory, previousItems[TEST_ITEM_COUNT - 1])) {
+        CLOG_SOFT_ERROR("reset: items from before the reset are still owned")
+        failCount++;
+    }
+
+    uint8_t* items[TEST_ITEM_COUNT];
+    allocateItems(memory, items);
+    failCount += checkItems("reuse", memory, items);
+    for (size_t i = 0; i < TEST_ITEM_COUNT; ++i) {
+        if (items[i] != previousItems[i]) {
+            CLOG_SOFT_ERROR("reuse: item %zu was not given the same memory as before the reset", i)
+            failCount++;
+            break;
+        }
+    }
+    failCount += checkStats("reuse", memory, TEST_ITEM_COUNT * TEST_ITEM_SIZE, peakAllocatedSize, 4, 3) < 0;
+
+    return failCount;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    uint8_t* octets = tc_malloc(TEST_FIRST_BLOCK_SIZE);
+    SwampDynamicMemory memory;
+    swampDynamicMemoryInitGrowable(&memory, octets, TEST_FIRST_BLOCK_SIZE, TEST_BLOCK_SIZE);
+
+    int failCount = 0;
+    uint8_t* items[TEST_ITEM_COUNT];
+    failCount += testGrow(&memory, items);
+    failCount += testReuse(&memory, items);
+
+    CLOG_OUTPUT("dynamic memory: %d failed", failCount)
+
+    swampDynamicMemoryDestroy(&memory);
+    tc_free(octets);
+
+    return failCount > 0 ? 1 : 0;
+}
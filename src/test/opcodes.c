@@ -0,0 +1,690 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <swamp-runtime/context.h>
+#include <swamp-runtime/debug.h>
+#include <swamp-runtime/decode.h>
+#include <swamp-runtime/fixup.h>
+#include <swamp-runtime/ledger.h>
+#include <swamp-runtime/opcodes.h>
+#include <swamp-runtime/swamp.h>
+#include <swamp-runtime/swamp_allocate.h>
+#include <swamp-runtime/types.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+// Runs the same opcode cases through swampRun() and through the decoded instructions. The test is built once with
+// SWAMP_RUN_DIRECT_THREADED and once without, see CMakeLists.txt, so both dispatch loops must give the same results.
+#define TEST_STATIC_MEMORY_SIZE (64 * 1024)
+#define TEST_DYNAMIC_MEMORY_SIZE (64 * 1024)
+#define TEST_MAX_FUNC_COUNT (64)
+
+// Frame of the test functions: Int -> Int -> Int
+#define FRAME_RETURN (0)
+#define FRAME_A (4)
+#define FRAME_B (8)
+#define FRAME_TEMP (12)
+#define FRAME_BOOL (16)
+#define FRAME_FN (24)
+#define FRAME_CALL (32)
+#define FRAME_STRING (40)
+#define FRAME_PARAMETERS_OCTET_SIZE (8)
+
+typedef struct TestCode {
+    uint8_t octets[256];
+    size_t count;
+} TestCode;
+
+static void emit8(TestCode* self, uint8_t value)
+{
+    self->octets[self->count++] = value;
+}
+
+static void emit16(TestCode* self, uint16_t value)
+{
+    tc_memcpy_octets(&self->octets[self->count], &value, sizeof(value));
+    self->count += sizeof(value);
+}
+
+static void emit32(TestCode* self, uint32_t value)
+{
+    tc_memcpy_octets(&self->octets[self->count], &value, sizeof(value));
+    self->count += sizeof(value);
+}
+
+static void emitOperator(TestCode* self, uint8_t opcode, uint32_t target, uint32_t a, uint32_t b)
+{
+    emit8(self, opcode);
+    emit32(self, target);
+    emit32(self, a);
+    emit32(self, b);
+}
+
+static void emitUnaryOperator(TestCode* self, uint8_t opcode, uint32_t target, uint32_t a)
+{
+    emit8(self, opcode);
+    emit32(self, target);
+    emit32(self, a);
+}
+
+static void emitLoadInteger(TestCode* self, uint32_t target, int32_t value)
+{
+    emit8(self, SwampOpcodeLoadInteger);
+    emit32(self, target);
+    emit32(self, (uint32_t) value);
+}
+
+static void emitMemCopy(TestCode* self, uint32_t target, uint32_t source, uint16_t octetCount)
+{
+    emit8(self, SwampOpcodeMemCopy);
+    emit32(self, target);
+    emit32(self, source);
+    emit16(self, octetCount);
+}
+
+static void emitReturnInt(TestCode* self, uint32_t source)
+{
+    emitMemCopy(self, FRAME_RETURN, source, sizeof(SwampInt32));
+    emit8(self, SwampOpcodeReturn);
+}
+
+// The jump is relative to the end of the branch, and both returns are the same size
+static void emitBranch(TestCode* self, uint8_t opcode, uint32_t condition)
+{
+    emit8(self, opcode);
+    emit32(self, condition);
+    emit16(self, 1 + 4 + 4 + 2 + 1);
+}
+
+// Only an operator and a return, target = a <op> b
+static void emitIntOperator(TestCode* self, uint8_t opcode)
+{
+    emitOperator(self, opcode, FRAME_RETURN, FRAME_A, FRAME_B);
+    emit8(self, SwampOpcodeReturn);
+}
+
+static void emitIntAdd(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntAdd);
+}
+
+static void emitIntSub(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntSub);
+}
+
+static void emitIntMul(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntMul);
+}
+
+static void emitIntDiv(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntDiv);
+}
+
+static void emitIntRemainder(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntRemainder);
+}
+
+static void emitIntAnd(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntAnd);
+}
+
+static void emitIntOr(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntOr);
+}
+
+static void emitIntXor(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntXor);
+}
+
+static void emitIntShiftLeft(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntShiftLeft);
+}
+
+static void emitIntShiftRight(TestCode* self)
+{
+    emitIntOperator(self, SwampOpcodeIntShiftRight);
+}
+
+static void emitIntNegate(TestCode* self)
+{
+    emitUnaryOperator(self, SwampOpcodeIntNegate, FRAME_RETURN, FRAME_A);
+    emit8(self, SwampOpcodeReturn);
+}
+
+static void emitIntNot(TestCode* self)
+{
+    emitUnaryOperator(self, SwampOpcodeIntNot, FRAME_RETURN, FRAME_A);
+    emit8(self, SwampOpcodeReturn);
+}
+
+// a + 7, decoded as an add immediate
+static void emitIntAddImmediate(TestCode* self)
+{
+    emitLoadInteger(self, FRAME_TEMP, 7);
+    emitOperator(self, SwampOpcodeIntAdd, FRAME_RETURN, FRAME_A, FRAME_TEMP);
+    emit8(self, SwampOpcodeReturn);
+}
+
+// if a < b then b else a, decoded as a fused compare and branch
+static void emitMax(TestCode* self)
+{
+    emitOperator(self, SwampOpcodeIntLess, FRAME_BOOL, FRAME_A, FRAME_B);
+    emitBranch(self, SwampOpcodeBranchFalse, FRAME_BOOL);
+    emitReturnInt(self, FRAME_B);
+    emitReturnInt(self, FRAME_A);
+}
+
+// if a > b then b else a
+static void emitMin(TestCode* self)
+{
+    emitOperator(self, SwampOpcodeIntGreater, FRAME_BOOL, FRAME_A, FRAME_B);
+    emitBranch(self, SwampOpcodeBranchTrue, FRAME_BOOL);
+    emitReturnInt(self, FRAME_A);
+    emitReturnInt(self, FRAME_B);
+}
+
+// if not (a /= b) then 1 else 0, the compare is not followed by a branch
+static void emitEqual(TestCode* self)
+{
+    emitOperator(self, SwampOpcodeIntNotEqual, FRAME_BOOL, FRAME_A, FRAME_B);
+    emit8(self, SwampOpcodeBoolNot);
+    emit32(self, FRAME_BOOL);
+    emit32(self, FRAME_BOOL);
+    emitLoadInteger(self, FRAME_TEMP, 1);
+    emit8(self, SwampOpcodeBranchTrue);
+    emit32(self, FRAME_BOOL);
+    emit16(self, 1 + 4 + 4);
+    emitLoadInteger(self, FRAME_TEMP, 0);
+    emitReturnInt(self, FRAME_TEMP);
+}
+
+// The jump skips the load of b
+static void emitJump(TestCode* self)
+{
+    emitMemCopy(self, FRAME_TEMP, FRAME_A, sizeof(SwampInt32));
+    emit8(self, SwampOpcodeJump);
+    emit16(self, 1 + 4 + 4 + 2);
+    emitMemCopy(self, FRAME_TEMP, FRAME_B, sizeof(SwampInt32));
+    emitReturnInt(self, FRAME_TEMP);
+}
+
+// case a of 1 -> 10, 2 -> 20, _ -> 30. The offsets are added up, starting after the first case.
+static void emitPatternMatchingInt(TestCode* self)
+{
+    const uint16_t returnOctetCount = 1 + 4 + 4 + 1 + 4 + 4 + 2 + 1;
+    emit8(self, SwampOpcodePatternMatchingInt);
+    emit32(self, FRAME_A);
+    emit8(self, 2);
+    emit32(self, 1);
+    emit16(self, 4 + 2 + 2);
+    emit32(self, 2);
+    emit16(self, returnOctetCount);
+    emit16(self, returnOctetCount);
+    for (int32_t i = 1; i <= 3; ++i) {
+        emitLoadInteger(self, FRAME_TEMP, i * 10);
+        emitReturnInt(self, FRAME_TEMP);
+    }
+}
+
+// Emits a return of each result, in order
+static void emitCaseResults(TestCode* self, const int32_t* results, size_t resultCount)
+{
+    for (size_t i = 0; i < resultCount; ++i) {
+        emitLoadInteger(self, FRAME_TEMP, results[i]);
+        emitReturnInt(self, FRAME_TEMP);
+    }
+}
+
+// case a of values[0] -> 10, values[1] -> 20, ..., _ -> 10 * (valueCount + 1)
+static void emitPatternMatchingIntValues(TestCode* self, const int32_t* values, size_t valueCount)
+{
+    const uint16_t returnOctetCount = 1 + 4 + 4 + 1 + 4 + 4 + 2 + 1;
+    emit8(self, SwampOpcodePatternMatchingInt);
+    emit32(self, FRAME_A);
+    emit8(self, (uint8_t) valueCount);
+    for (size_t i = 0; i < valueCount; ++i) {
+        emit32(self, (uint32_t) values[i]);
+        emit16(self, i == 0 ? (valueCount - 1) * (4 + 2) + 2 : returnOctetCount);
+    }
+    emit16(self, returnOctetCount);
+    for (size_t i = 0; i <= valueCount; ++i) {
+        emitLoadInteger(self, FRAME_TEMP, (int32_t) (i + 1) * 10);
+        emitReturnInt(self, FRAME_TEMP);
+    }
+}
+
+// case a of 3 -> 10, 5 -> 20, 4 -> 30, 5 -> 40, _ -> 50. Decoded as a table from 3 to 5, the first 5 wins.
+static void emitPatternMatchingIntDense(TestCode* self)
+{
+    static const int32_t values[] = {3, 5, 4, 5};
+    emitPatternMatchingIntValues(self, values, sizeof(values) / sizeof(values[0]));
+}
+
+// case a of -1000 -> 10, 7 -> 20, 100000 -> 30, 7 -> 40, _ -> 50. Too sparse for a table, so it is decoded as
+// sorted cases for a binary search.
+static void emitPatternMatchingIntSparse(TestCode* self)
+{
+    static const int32_t values[] = {-1000, 7, 100000, 7};
+    emitPatternMatchingIntValues(self, values, sizeof(values) / sizeof(values[0]));
+}
+
+// case a of V0 -> 10, V2 -> 20, V1 -> 30, V2 -> 40, _ -> 50, V5 -> 60. The variant is the first octet of a. EnumCase
+// has no default offset, the 0xff case matches any variant, so the first match wins for V5 and for the variants
+// outside of the decoded table.
+static void emitEnumCase(TestCode* self)
+{
+    const uint16_t returnOctetCount = 1 + 4 + 4 + 1 + 4 + 4 + 2 + 1;
+    static const uint8_t variants[] = {0, 2, 1, 2, 0xff, 5};
+    static const int32_t results[] = {10, 20, 30, 40, 50, 60};
+    const size_t caseCount = sizeof(variants) / sizeof(variants[0]);
+    emit8(self, SwampOpcodeEnumCase);
+    emit32(self, FRAME_A);
+    emit8(self, (uint8_t) caseCount);
+    for (size_t i = 0; i < caseCount; ++i) {
+        emit8(self, variants[i]);
+        emit16(self, i == 0 ? (caseCount - 1) * (1 + 2) : returnOctetCount);
+    }
+    emitCaseResults(self, results, sizeof(results) / sizeof(results[0]));
+}
+
+// Static memory positions of the case strings, set by programInit() before the cases are emitted
+#define TEST_CASE_STRING_COUNT (3)
+static uint32_t g_caseStringPositions[TEST_CASE_STRING_COUNT];
+
+// case s of "abcd" -> 10, "xy" -> 20, "abcd" -> 40, _ -> 30. The second "abcd" is a separate constant that is never
+// matched, since the first case wins.
+static void emitPatternMatchingString(TestCode* self)
+{
+    const uint16_t returnOctetCount = 1 + 4 + 4 + 1 + 4 + 4 + 2 + 1;
+    static const int32_t results[] = {10, 20, 40, 30};
+    emit8(self, SwampOpcodePatternMatchingString);
+    emit32(self, FRAME_STRING);
+    emit8(self, TEST_CASE_STRING_COUNT);
+    for (size_t i = 0; i < TEST_CASE_STRING_COUNT; ++i) {
+        emit32(self, g_caseStringPositions[i]);
+        emit16(self, i == 0 ? (TEST_CASE_STRING_COUNT - 1) * (4 + 2) + 2 : returnOctetCount);
+    }
+    emit16(self, returnOctetCount);
+    emitCaseResults(self, results, sizeof(results) / sizeof(results[0]));
+}
+
+// if a == 0 then b else loop (a - 1) (b + a)
+static void emitSumLoop(TestCode* self)
+{
+    emitLoadInteger(self, FRAME_TEMP, 0);
+    emitOperator(self, SwampOpcodeIntEqual, FRAME_BOOL, FRAME_A, FRAME_TEMP);
+    emitBranch(self, SwampOpcodeBranchFalse, FRAME_BOOL);
+    emitReturnInt(self, FRAME_B);
+    emitOperator(self, SwampOpcodeIntAdd, FRAME_B, FRAME_B, FRAME_A);
+    emitLoadInteger(self, FRAME_TEMP, 1);
+    emitOperator(self, SwampOpcodeIntSub, FRAME_A, FRAME_A, FRAME_TEMP);
+    emit8(self, SwampOpcodeTailCall);
+}
+
+// twice (twice a) - b, twice is stored in the frame by the test
+static void emitCall(TestCode* self)
+{
+    emitMemCopy(self, FRAME_CALL + 4, FRAME_A, sizeof(SwampInt32));
+    for (size_t i = 0; i < 2; ++i) {
+        emit8(self, SwampOpcodeCall);
+        emit32(self, FRAME_CALL);
+        emit32(self, FRAME_FN);
+        emitMemCopy(self, FRAME_CALL + 4, FRAME_CALL, sizeof(SwampInt32));
+    }
+    emitOperator(self, SwampOpcodeIntSub, FRAME_RETURN, FRAME_CALL, FRAME_B);
+    emit8(self, SwampOpcodeReturn);
+}
+
+typedef void (*TestEmitFn)(TestCode* self);
+typedef const SwampString* (*TestStringFn)(SwampDynamicMemory* memory);
+
+static const SwampString* stringAbcd(SwampDynamicMemory* memory)
+{
+    return swampStringAllocate(memory, "abcd");
+}
+
+static const SwampString* stringXy(SwampDynamicMemory* memory)
+{
+    return swampStringAllocate(memory, "xy");
+}
+
+// Same length as "abcd", so it is not rejected on the character count
+static const SwampString* stringAbce(SwampDynamicMemory* memory)
+{
+    return swampStringAllocate(memory, "abce");
+}
+
+// "ab" ++ "cd", followed by an append that shares its characters, so "abcd" is no longer terminated
+static const SwampString* stringSharedPrefix(SwampDynamicMemory* memory)
+{
+    const SwampString* prefix = swampAllocateStringAppend(memory, swampStringAllocate(memory, "ab"),
+                                                          swampStringAllocate(memory, "cd"));
+    swampAllocateStringAppend(memory, prefix, swampStringAllocate(memory, "ef"));
+
+    return prefix;
+}
+
+static const SwampString* stringSharedResult(SwampDynamicMemory* memory)
+{
+    const SwampString* prefix = stringSharedPrefix(memory);
+
+    return swampAllocateStringAppend(memory, prefix, swampStringAllocate(memory, "gh"));
+}
+
+typedef struct TestCase {
+    const char* name;
+    TestEmitFn emit;
+    SwampInt32 a;
+    SwampInt32 b;
+    SwampInt32 expected;
+    TestStringFn string; // stored at FRAME_STRING if set
+} TestCase;
+
+static const TestCase g_testCases[] = {
+    {"int-add", emitIntAdd, 40, 2, 42, 0},
+    {"int-sub", emitIntSub, 40, 42, -2, 0},
+    {"int-mul", emitIntMul, -6, 7, -42, 0},
+    {"int-div", emitIntDiv, 85, 2, 42, 0},
+    {"int-remainder", emitIntRemainder, 85, 43, 42, 0},
+    {"int-and", emitIntAnd, 0x6f, 0x3a, 0x2a, 0},
+    {"int-or", emitIntOr, 0x28, 0x0a, 0x2a, 0},
+    {"int-xor", emitIntXor, 0x7f, 0x55, 0x2a, 0},
+    {"int-shift-left", emitIntShiftLeft, 21, 1, 42, 0},
+    {"int-shift-right", emitIntShiftRight, 168, 2, 42, 0},
+    {"int-negate", emitIntNegate, -42, 0, 42, 0},
+    {"int-not", emitIntNot, -43, 0, 42, 0},
+    {"int-add-immediate", emitIntAddImmediate, 35, 0, 42, 0},
+    {"branch-false-taken", emitMax, 42, 3, 42, 0},
+    {"branch-false-not-taken", emitMax, 3, 42, 42, 0},
+    {"branch-true-taken", emitMin, 50, 42, 42, 0},
+    {"branch-true-not-taken", emitMin, 42, 50, 42, 0},
+    {"bool-not-equal", emitEqual, 42, 42, 1, 0},
+    {"bool-not-not-equal", emitEqual, 42, 41, 0, 0},
+    {"jump", emitJump, 42, 3, 42, 0},
+    {"pattern-matching-int-first", emitPatternMatchingInt, 1, 0, 10, 0},
+    {"pattern-matching-int-second", emitPatternMatchingInt, 2, 0, 20, 0},
+    {"pattern-matching-int-default", emitPatternMatchingInt, 99, 0, 30, 0},
+    {"tail-call", emitSumLoop, 100, 0, 5050, 0},
+    {"call-return", emitCall, 11, 2, 42, 0},
+    {"pattern-matching-int-dense-first", emitPatternMatchingIntDense, 3, 0, 10, 0},
+    {"pattern-matching-int-dense-duplicate", emitPatternMatchingIntDense, 5, 0, 20, 0},
+    {"pattern-matching-int-dense-middle", emitPatternMatchingIntDense, 4, 0, 30, 0},
+    {"pattern-matching-int-dense-below", emitPatternMatchingIntDense, 2, 0, 50, 0},
+    {"pattern-matching-int-dense-above", emitPatternMatchingIntDense, 6, 0, 50, 0},
+    {"pattern-matching-int-sparse-first", emitPatternMatchingIntSparse, -1000, 0, 10, 0},
+    {"pattern-matching-int-sparse-duplicate", emitPatternMatchingIntSparse, 7, 0, 20, 0},
+    {"pattern-matching-int-sparse-last", emitPatternMatchingIntSparse, 100000, 0, 30, 0},
+    {"pattern-matching-int-sparse-between", emitPatternMatchingIntSparse, 8, 0, 50, 0},
+    {"pattern-matching-int-sparse-minimum", emitPatternMatchingIntSparse, INT32_MIN, 0, 50, 0},
+    {"pattern-matching-int-sparse-maximum", emitPatternMatchingIntSparse, INT32_MAX, 0, 50, 0},
+    {"enum-case-first", emitEnumCase, 0, 0, 10, 0},
+    {"enum-case-duplicate", emitEnumCase, 2, 0, 20, 0},
+    {"enum-case-third", emitEnumCase, 1, 0, 30, 0},
+    {"enum-case-gap", emitEnumCase, 3, 0, 50, 0},
+    {"enum-case-any-first", emitEnumCase, 5, 0, 50, 0},
+    {"enum-case-outside-table", emitEnumCase, 9, 0, 50, 0},
+    {"pattern-matching-string-first", emitPatternMatchingString, 0, 0, 10, stringAbcd},
+    {"pattern-matching-string-second", emitPatternMatchingString, 0, 0, 20, stringXy},
+    {"pattern-matching-string-default", emitPatternMatchingString, 0, 0, 30, stringAbce},
+    {"pattern-matching-string-shared-prefix", emitPatternMatchingString, 0, 0, 10, stringSharedPrefix},
+    {"pattern-matching-string-shared-result", emitPatternMatchingString, 0, 0, 30, stringSharedResult},
+};
+
+#define TEST_CASE_COUNT (sizeof(g_testCases) / sizeof(g_testCases[0]))
+
+// A ledger and the static memory that it points into, the same as after the fixup of a pack
+typedef struct TestProgram {
+    uint8_t* octets;
+    size_t octetCount;
+    SwampConstantLedgerEntry entries[TEST_MAX_FUNC_COUNT + 1];
+    size_t entryCount;
+    SwampLedger ledger;
+    SwampStaticMemory staticMemory;
+} TestProgram;
+
+static void* programAllocate(TestProgram* self, size_t octetCount)
+{
+    size_t offset = (self->octetCount + 7) & ~(size_t) 7;
+    if (offset + octetCount > TEST_STATIC_MEMORY_SIZE) {
+        CLOG_ERROR("test static memory is too small")
+    }
+    self->octetCount = offset + octetCount;
+
+    return self->octets + offset;
+}
+
+static const SwampFunc* programAddFunc(TestProgram* self, const char* name, const TestCode* code,
+                                       size_t parameterCount, size_t parametersOctetSize)
+{
+    if (self->entryCount == TEST_MAX_FUNC_COUNT) {
+        CLOG_ERROR("too many test functions")
+    }
+
+    uint8_t* opcodes = programAllocate(self, code->count);
+    tc_memcpy_octets(opcodes, code->octets, code->count);
+
+    SwampFunc* func = programAllocate(self, sizeof(SwampFunc));
+    func->func.type = SwampFunctionTypeInternal;
+    func->parameterCount = parameterCount;
+    func->parametersOctetSize = parametersOctetSize;
+    func->opcodes = opcodes;
+    func->opcodeCount = code->count;
+    func->returnOctetSize = sizeof(SwampInt32);
+    func->returnAlign = sizeof(SwampInt32);
+    func->debugName = name;
+
+    SwampConstantLedgerEntry* entry = &self->entries[self->entryCount++];
+    entry->constantType = LedgerTypeFunc;
+    entry->offset = (uint32_t) ((uint8_t*) func - self->octets);
+
+    return func;
+}
+
+static uint32_t programAddString(TestProgram* self, const char* characters)
+{
+    size_t characterCount = tc_strlen(characters);
+    char* copy = programAllocate(self, characterCount + 1);
+    tc_memcpy_octets(copy, characters, characterCount + 1);
+
+    SwampString* string = programAllocate(self, sizeof(SwampString));
+    string->characters = copy;
+    string->characterCount = characterCount;
+
+    return (uint32_t) ((uint8_t*) string - self->octets);
+}
+
+static void programInit(TestProgram* self, const SwampFunc** funcs, const SwampFunc** twice)
+{
+    self->octets = tc_malloc(TEST_STATIC_MEMORY_SIZE);
+    tc_mem_clear(self->octets, TEST_STATIC_MEMORY_SIZE);
+    self->octetCount = 8;
+    self->entryCount = 0;
+
+    static const char* caseStrings[TEST_CASE_STRING_COUNT] = {"abcd", "xy", "abcd"};
+    for (size_t i = 0; i < TEST_CASE_STRING_COUNT; ++i) {
+        g_caseStringPositions[i] = programAddString(self, caseStrings[i]);
+    }
+
+    TestCode code;
+    for (size_t i = 0; i < TEST_CASE_COUNT; ++i) {
+        code.count = 0;
+        g_testCases[i].emit(&code);
+        funcs[i] = programAddFunc(self, g_testCases[i].name, &code, 2, FRAME_PARAMETERS_OCTET_SIZE);
+    }
+
+    // twice : Int -> Int
+    code.count = 0;
+    emitOperator(&code, SwampOpcodeIntAdd, FRAME_RETURN, 4, 4);
+    emit8(&code, SwampOpcodeReturn);
+    *twice = programAddFunc(self, "twice", &code, 1, sizeof(SwampInt32));
+
+    self->entries[self->entryCount].constantType = 0;
+    self->entries[self->entryCount].offset = 0;
+    swampLedgerInit(&self->ledger, (const uint8_t*) self->entries, sizeof(self->entries[0]) * (self->entryCount + 1),
+                    self->octets);
+    swampStaticMemoryInit(&self->staticMemory, self->octets, TEST_STATIC_MEMORY_SIZE);
+}
+
+static void programDestroy(TestProgram* self)
+{
+    tc_free(self->octets);
+}
+
+static int runCase(SwampMachineContext* context, const TestCase* testCase, const SwampFunc* func,
+                   const SwampFunc* twice)
+{
+    swampDynamicMemoryReset(context->dynamicMemory);
+    uint8_t* bp = context->bp;
+    tc_mem_clear(bp, FRAME_STRING + sizeof(const SwampString*));
+    *(SwampInt32*) (bp + FRAME_A) = testCase->a;
+    *(SwampInt32*) (bp + FRAME_B) = testCase->b;
+    *(const SwampFunc**) (bp + FRAME_FN) = twice;
+    if (testCase->string) {
+        *(const SwampString**) (bp + FRAME_STRING) = testCase->string(context->dynamicMemory);
+    }
+
+    SwampResult result;
+    result.expectedOctetSize = sizeof(SwampInt32);
+    SwampParameters parameters;
+    parameters.parameterCount = 2;
+    parameters.octetSize = FRAME_PARAMETERS_OCTET_SIZE;
+    if (swampRun(&result, context, func, parameters, 0) < 0) {
+        CLOG_SOFT_ERROR("%s (%s): swampRun failed", testCase->name, context->debugString)
+        return -1;
+    }
+
+    SwampInt32 value = *(const SwampInt32*) bp;
+    if (value != testCase->expected) {
+        CLOG_SOFT_ERROR("%s (%s): expected %d, but got %d", testCase->name, context->debugString, testCase->expected,
+                        value)
+        return -1;
+    }
+
+    return 0;
+}
+
+// The case opcodes are lowered to different instructions depending on the cases, check that each test gets the one
+// that it is written for
+typedef struct TestDecodedOpcode {
+    TestEmitFn emit;
+    uint16_t opcode;
+} TestDecodedOpcode;
+
+static const TestDecodedOpcode g_decodedOpcodes[] = {
+    {emitPatternMatchingInt, SwampOpcodeDecodedPatternMatchingIntTable},
+    {emitPatternMatchingIntDense, SwampOpcodeDecodedPatternMatchingIntTable},
+    {emitPatternMatchingIntSparse, SwampOpcodeDecodedPatternMatchingIntSorted},
+    {emitEnumCase, SwampOpcodeDecodedEnumCaseTable},
+    {emitPatternMatchingString, SwampOpcodePatternMatchingString},
+};
+
+static int checkDecodedOpcodes(const SwampDecodedProgram* decodedProgram, const SwampFunc** funcs)
+{
+    int failCount = 0;
+    for (size_t i = 0; i < sizeof(g_decodedOpcodes) / sizeof(g_decodedOpcodes[0]); ++i) {
+        const TestDecodedOpcode* expected = &g_decodedOpcodes[i];
+        size_t caseIndex = 0;
+        while (g_testCases[caseIndex].emit != expected->emit) {
+            caseIndex++;
+        }
+        const SwampDecodedFunc* decodedFunc = swampDecodedProgramFind(decodedProgram, funcs[caseIndex]);
+        if (!decodedFunc || decodedFunc->instructions[0].opcode != expected->opcode) {
+            CLOG_SOFT_ERROR("%s: expected decoded opcode %02X", g_testCases[caseIndex].name, expected->opcode)
+            failCount++;
+        }
+    }
+
+    return failCount;
+}
+
+// The copy of twice is not in the ledger, so it can only be called when the function is not decoded
+static int runNotDecodedCall(SwampMachineContext* context, const TestCase* callCase, const SwampFunc* callFunc,
+                             const SwampFunc* twice)
+{
+    SwampFunc notDecoded = *twice;
+    if (context->decodedProgram == 0) {
+        return runCase(context, callCase, callFunc, &notDecoded);
+    }
+
+    uint8_t* bp = context->bp;
+    *(SwampInt32*) (bp + FRAME_A) = callCase->a;
+    *(SwampInt32*) (bp + FRAME_B) = callCase->b;
+    *(const SwampFunc**) (bp + FRAME_FN) = &notDecoded;
+
+    SwampResult result;
+    result.expectedOctetSize = sizeof(SwampInt32);
+    SwampParameters parameters;
+    parameters.parameterCount = 2;
+    parameters.octetSize = FRAME_PARAMETERS_OCTET_SIZE;
+    if (swampRun(&result, context, callFunc, parameters, 0) >= 0) {
+        CLOG_SOFT_ERROR("call-not-decoded (%s): expected an error", context->debugString)
+        return -1;
+    }
+
+    // The context must still be usable after the error
+    return runCase(context, callCase, callFunc, twice);
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    TestProgram program;
+    const SwampFunc* funcs[TEST_CASE_COUNT];
+    const SwampFunc* twice;
+    programInit(&program, funcs, &twice);
+
+    SwampDecodedProgram decodedProgram;
+    if (swampDecodedProgramInit(&decodedProgram, &program.ledger, &program.staticMemory) < 0) {
+        CLOG_ERROR("could not decode the test program")
+    }
+
+    uint8_t* dynamicMemoryOctets = tc_malloc(TEST_DYNAMIC_MEMORY_SIZE);
+    SwampDynamicMemory dynamicMemory;
+    swampDynamicMemoryInit(&dynamicMemory, dynamicMemoryOctets, TEST_DYNAMIC_MEMORY_SIZE);
+
+    static const char* filenames[] = {"opcodes.swamp"};
+    SwampDebugInfoFiles debugInfoFiles;
+    debugInfoFiles.count = 1;
+    debugInfoFiles.filenames = filenames;
+
+    const char* contextNames[2] = {"raw", "decoded"};
+    SwampMachineContext contexts[2];
+    int failCount = checkDecodedOpcodes(&decodedProgram, funcs);
+    for (size_t i = 0; i < 2; ++i) {
+        SwampMachineContext* context = &contexts[i];
+        swampContextInit(context, &dynamicMemory, &program.staticMemory, 0, 0, &debugInfoFiles, contextNames[i]);
+        context->decodedProgram = i == 1 ? &decodedProgram : 0;
+        for (size_t caseIndex = 0; caseIndex < TEST_CASE_COUNT; ++caseIndex) {
+            const TestCase* testCase = &g_testCases[caseIndex];
+            if (runCase(context, testCase, funcs[caseIndex], twice) < 0) {
+                failCount++;
+            }
+            if (testCase->emit == emitCall && runNotDecodedCall(context, testCase, funcs[caseIndex], twice) < 0) {
+                failCount++;
+            }
+        }
+        swampContextDestroy(context);
+    }
+
+    CLOG_OUTPUT("%zu opcode cases, %d failed", TEST_CASE_COUNT * 2, failCount)
+
+    swampDynamicMemoryDestroy(&dynamicMemory);
+    tc_free(dynamicMemoryOctets);
+    swampDecodedProgramDestroy(&decodedProgram);
+    programDestroy(&program);
+
+    return failCount > 0 ? 1 : 0;
+}